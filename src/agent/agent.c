@@ -5,6 +5,7 @@
  */
 #include <arpa/inet.h>
 #include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,12 +17,15 @@
 #include "libbluechi/common/network.h"
 #include "libbluechi/common/opt.h"
 #include "libbluechi/common/parse-util.h"
+#include "libbluechi/common/pool.h"
 #include "libbluechi/common/time-util.h"
 #include "libbluechi/log/log.h"
 #include "libbluechi/service/shutdown.h"
 
 #include "agent.h"
+#include "bulk_reply.h"
 #include "proxy.h"
+#include "unit_filter.h"
 
 #ifdef USE_USER_API_BUS
 #        define ALWAYS_USER_API_BUS 1
@@ -32,25 +36,31 @@
 #define DEBUG_SYSTEMD_MESSAGES 0
 #define DEBUG_SYSTEMD_MESSAGES_CONTENT 0
 
+/* Maximum number of events sent in a single EventBatch signal */
+#define EVENT_BATCH_MAX_SIZE 64
+
 
 typedef struct AgentUnitInfoKey {
         char *object_path;
 } AgentUnitInfoKey;
 
-struct JobTracker {
-        char *job_object_path;
-        job_tracker_callback callback;
-        void *userdata;
-        free_func_t free_userdata;
-        LIST_FIELDS(JobTracker, tracked_jobs);
+struct UnitPattern {
+        char *pattern;
+        GlobPattern *glob;
+        char **properties; /* Forwarded in UnitPropertiesChanged, NULL for all */
+        LIST_FIELDS(UnitPattern, unit_patterns);
 };
 
-static bool
-                agent_track_job(Agent *agent,
-                                const char *job_object_path,
-                                job_tracker_callback callback,
-                                void *userdata,
-                                free_func_t free_userdata);
+static void unit_pattern_free(UnitPattern *pattern) {
+        glob_pattern_free(pattern->glob);
+        freev((void **) pattern->properties);
+        free_and_null(pattern->pattern);
+        free(pattern);
+}
+
+typedef struct AgentJobBatch AgentJobBatch;
+
+static void agent_job_batch_unref(AgentJobBatch *batch);
 
 /* Keep track of outstanding systemd job and connect it back to
    the originating bluechi job id so we can proxy changes to it. */
@@ -62,8 +72,19 @@ typedef struct {
         uint64_t job_start_micros;
         char *unit;
         char *method;
+
+        /* Set if the job was queued by StartUnits and friends, see AgentJobBatch */
+        AgentJobBatch *batch;
+        size_t batch_index;
+        char *deferred_result;
+
+        /* Most unit names fit, see pool_strdup() */
+        char unit_buf[64];
+        char method_buf[32];
 } AgentJobOp;
 
+static Pool agent_job_op_pool = POOL_INIT(AgentJobOp, 1024);
+
 static AgentJobOp *agent_job_op_ref(AgentJobOp *op) {
         op->ref_count++;
         return op;
@@ -75,24 +96,30 @@ static void agent_job_op_unref(AgentJobOp *op) {
                 return;
         }
 
+        if (op->batch != NULL) {
+                agent_job_batch_unref(op->batch);
+        }
         agent_unref(op->agent);
-        free_and_null(op->unit);
-        free_and_null(op->method);
-        free(op);
+        pool_strfree(op->unit_buf, op->unit);
+        pool_strfree(op->method_buf, op->method);
+        free_and_null(op->deferred_result);
+        pool_free(&agent_job_op_pool, op);
 }
 
 DEFINE_CLEANUP_FUNC(AgentJobOp, agent_job_op_unref)
 #define _cleanup_agent_job_op_ _cleanup_(agent_job_op_unrefp)
 
+static bool agent_track_job(Agent *agent, const char *job_object_path, AgentJobOp *op);
+
 static AgentJobOp *agent_job_new(Agent *agent, uint32_t bc_job_id, const char *unit, const char *method) {
-        AgentJobOp *op = malloc0(sizeof(AgentJobOp));
+        AgentJobOp *op = pool_alloc0(&agent_job_op_pool);
         if (op) {
                 op->ref_count = 1;
                 op->agent = agent_ref(agent);
                 op->bc_job_id = bc_job_id;
                 op->job_start_micros = 0;
-                op->unit = strdup(unit);
-                op->method = strdup(method);
+                op->unit = pool_strdup(op->unit_buf, sizeof(op->unit_buf), unit);
+                op->method = pool_strdup(op->method_buf, sizeof(op->method_buf), method);
         }
         return op;
 }
@@ -108,6 +135,167 @@ char *agent_is_online(Agent *agent) {
         return "offline";
 }
 
+/* Events count as proof of liveness for the controller, so heartbeats are only sent on an idle link */
+static int agent_send_to_controller(Agent *agent, sd_bus_message *m) {
+        int r = sd_bus_send(agent->peer_dbus, m, NULL);
+        if (r >= 0) {
+                agent->controller_last_sent_monotonic = get_time_micros_monotonic();
+        }
+        return r;
+}
+
+static int agent_flush_event_batch(Agent *agent) {
+        if (agent->event_batch == NULL) {
+                return 0;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *batch = steal_pointer(&agent->event_batch);
+        bc_log_debugf("Sending EventBatch with %zu events", agent->event_batch_size);
+        agent->event_batch_size = 0;
+
+        /* Once the controller handled the batch, it knows all unit events up to this sequence number */
+        int r = 0;
+        if (agent->resync_enabled) {
+                r = sd_bus_message_append(
+                                batch,
+                                EVENT_BATCH_ENTRY_STRUCT_TYPESTRING,
+                                AGENT_EVENT_SEQUENCE_SIGNAL_NAME,
+                                "(tt)",
+                                agent->session_id,
+                                event_journal_get_seq(agent->event_journal));
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        r = sd_bus_message_close_container(batch);
+        if (r < 0) {
+                return r;
+        }
+        return agent_send_to_controller(agent, batch);
+}
+
+static int agent_event_batch_callback(UNUSED sd_event_source *event_source, void *userdata) {
+        Agent *agent = userdata;
+
+        int r = agent_flush_event_batch(agent);
+        if (r < 0) {
+                bc_log_errorf("Failed to send EventBatch: %s", strerror(-r));
+        }
+        return 0;
+}
+
+static int agent_schedule_event_batch(Agent *agent) {
+        if (agent->event_batch_source != NULL) {
+                return sd_event_source_set_enabled(agent->event_batch_source, SD_EVENT_ONESHOT);
+        }
+
+        int r = sd_event_add_defer(
+                        agent->event, &agent->event_batch_source, agent_event_batch_callback, agent);
+        if (r < 0) {
+                return r;
+        }
+        /* Send the batch only once all other pending sources, e.g. queued systemd signals, are dispatched */
+        return sd_event_source_set_priority(agent->event_batch_source, SD_EVENT_PRIORITY_IDLE);
+}
+
+/*
+ * Starts an event signal to the controller and returns the message to append its arguments to.
+ * If the controller supports it, the event is added to the pending EventBatch signal instead
+ * of being sent on its own. Each entry of the batch holds the signal name and its arguments
+ * as a struct in a variant.
+ */
+static int agent_event_open(Agent *agent, const char *member, const char *types, sd_bus_message **ret) {
+        if (!agent->event_batch_enabled) {
+                return sd_bus_message_new_signal(
+                                agent->peer_dbus, ret, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, member);
+        }
+
+        int r = 0;
+        if (agent->event_batch == NULL) {
+                _cleanup_sd_bus_message_ sd_bus_message *batch = NULL;
+                r = sd_bus_message_new_signal(
+                                agent->peer_dbus,
+                                &batch,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                AGENT_EVENT_BATCH_SIGNAL_NAME);
+                if (r >= 0) {
+                        r = sd_bus_message_open_container(
+                                        batch, SD_BUS_TYPE_ARRAY, EVENT_BATCH_ENTRY_STRUCT_TYPESTRING);
+                }
+                if (r >= 0) {
+                        r = agent_schedule_event_batch(agent);
+                }
+                if (r < 0) {
+                        return r;
+                }
+                agent->event_batch = steal_pointer(&batch);
+        }
+
+        _cleanup_free_ char *contents = NULL;
+        if (asprintf(&contents, "(%s)", types) < 0) {
+                return -ENOMEM;
+        }
+
+        sd_bus_message *batch = agent->event_batch;
+        r = sd_bus_message_open_container(batch, SD_BUS_TYPE_STRUCT, EVENT_BATCH_ENTRY_TYPESTRING);
+        if (r >= 0) {
+                r = sd_bus_message_append(batch, "s", member);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_open_container(batch, SD_BUS_TYPE_VARIANT, contents);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_open_container(batch, SD_BUS_TYPE_STRUCT, types);
+        }
+        if (r < 0) {
+                return r;
+        }
+
+        *ret = sd_bus_message_ref(batch);
+        return 0;
+}
+
+/* Sends the event started by agent_event_open() or completes its entry in the pending EventBatch */
+static int agent_event_close(Agent *agent, sd_bus_message *m) {
+        if (m != agent->event_batch) {
+                return agent_send_to_controller(agent, m);
+        }
+
+        /* Close the arguments struct, the variant and the entry */
+        for (int i = 0; i < 3; i++) {
+                int r = sd_bus_message_close_container(m);
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        agent->event_batch_size++;
+        if (agent->event_batch_size >= EVENT_BATCH_MAX_SIZE) {
+                return agent_flush_event_batch(agent);
+        }
+        return 0;
+}
+
+static int agent_emit_event(Agent *agent, const char *member, const char *types, ...) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = agent_event_open(agent, member, types, &m);
+        if (r < 0) {
+                return r;
+        }
+
+        va_list ap;
+        va_start(ap, types);
+        r = sd_bus_message_appendv(m, types, ap);
+        va_end(ap);
+        if (r < 0) {
+                return r;
+        }
+
+        return agent_event_close(agent, m);
+}
+
 static int agent_stop_local_proxy_service(Agent *agent, ProxyService *proxy);
 static bool agent_connect(Agent *agent);
 static bool agent_reconnect(Agent *agent);
@@ -134,7 +322,7 @@ static int agent_disconnected(UNUSED sd_bus_message *message, void *userdata, UN
         return 0;
 }
 
-static int agent_reset_heartbeat_timer(Agent *agent, sd_event_source **event_source);
+static int agent_reset_heartbeat_timer(Agent *agent, sd_event_source **event_source, uint64_t usec);
 
 static bool agent_check_controller_liveness(Agent *agent) {
         uint64_t diff = 0;
@@ -182,16 +370,26 @@ static int agent_heartbeat_timer_callback(sd_event_source *event_source, UNUSED
                 }
                 agent->connection_state = AGENT_CONNECTION_STATE_RETRY;
         }
+        uint64_t interval = agent->heartbeat_interval_msec * USEC_PER_MSEC;
+        uint64_t idle = 0;
         if (agent->connection_state == AGENT_CONNECTION_STATE_CONNECTED &&
             agent_check_controller_liveness(agent)) {
-                r = sd_bus_emit_signal(
-                                agent->peer_dbus,
-                                INTERNAL_AGENT_OBJECT_PATH,
-                                INTERNAL_AGENT_INTERFACE,
-                                "Heartbeat",
-                                "");
-                if (r < 0) {
-                        bc_log_errorf("Failed to emit heartbeat signal: %s", strerror(-r));
+                /* Anything sent to the controller proves that we are alive, so only send
+                 * a heartbeat when the link has been idle for the interval */
+                uint64_t now = get_time_micros_monotonic();
+                idle = now > agent->controller_last_sent_monotonic ? now - agent->controller_last_sent_monotonic : 0;
+                if (idle >= interval) {
+                        r = sd_bus_emit_signal(
+                                        agent->peer_dbus,
+                                        INTERNAL_AGENT_OBJECT_PATH,
+                                        INTERNAL_AGENT_INTERFACE,
+                                        "Heartbeat",
+                                        "");
+                        if (r < 0) {
+                                bc_log_errorf("Failed to emit heartbeat signal: %s", strerror(-r));
+                        }
+                        agent->controller_last_sent_monotonic = now;
+                        idle = 0;
                 }
         } else if (agent->connection_state == AGENT_CONNECTION_STATE_RETRY) {
                 agent->connection_retry_count++;
@@ -208,7 +406,7 @@ static int agent_heartbeat_timer_callback(sd_event_source *event_source, UNUSED
                 }
         }
 
-        r = agent_reset_heartbeat_timer(agent, &event_source);
+        r = agent_reset_heartbeat_timer(agent, &event_source, interval - idle);
         if (r < 0) {
                 bc_log_errorf("Failed to reset agent heartbeat timer: %s", strerror(-r));
                 return r;
@@ -217,12 +415,12 @@ static int agent_heartbeat_timer_callback(sd_event_source *event_source, UNUSED
         return 0;
 }
 
-static int agent_reset_heartbeat_timer(Agent *agent, sd_event_source **event_source) {
+static int agent_reset_heartbeat_timer(Agent *agent, sd_event_source **event_source, uint64_t usec) {
         return event_reset_time_relative(
                         agent->event,
                         event_source,
                         CLOCK_BOOTTIME,
-                        agent->heartbeat_interval_msec * USEC_PER_MSEC,
+                        usec,
                         0,
                         agent_heartbeat_timer_callback,
                         agent,
@@ -243,7 +441,7 @@ static int agent_setup_heartbeat_timer(Agent *agent) {
                 return 0;
         }
 
-        r = agent_reset_heartbeat_timer(agent, &event_source);
+        r = agent_reset_heartbeat_timer(agent, &event_source, agent->heartbeat_interval_msec * USEC_PER_MSEC);
         if (r < 0) {
                 bc_log_errorf("Failed to reset agent heartbeat timer: %s", strerror(-r));
                 return r;
@@ -252,6 +450,9 @@ static int agent_setup_heartbeat_timer(Agent *agent) {
         return sd_event_source_set_floating(event_source, true);
 }
 
+/* Every call to systemd takes a request, so released ones are recycled */
+static Pool systemd_request_pool = POOL_INIT(SystemdRequest, 1024);
+
 SystemdRequest *systemd_request_ref(SystemdRequest *req) {
         req->ref_count++;
         return req;
@@ -275,7 +476,7 @@ void systemd_request_unref(SystemdRequest *req) {
 
         LIST_REMOVE(outstanding_requests, agent->outstanding_requests, req);
         agent_unref(req->agent);
-        free(req);
+        pool_free(&systemd_request_pool, req);
 }
 
 static SystemdRequest *agent_create_request_full(
@@ -284,7 +485,7 @@ static SystemdRequest *agent_create_request_full(
                 const char *object_path,
                 const char *iface,
                 const char *method) {
-        _cleanup_systemd_request_ SystemdRequest *req = malloc0(sizeof(SystemdRequest));
+        _cleanup_systemd_request_ SystemdRequest *req = pool_alloc0(&systemd_request_pool);
         if (req == NULL) {
                 return NULL;
         }
@@ -348,7 +549,11 @@ static void unit_info_clear(void *item) {
         AgentUnitInfo *info = item;
         free_and_null(info->object_path);
         free_and_null(info->unit);
-        free_and_null(info->substate);
+        info->substate = NULL;
+        freev((void **) info->properties);
+        info->properties = NULL;
+        freev((void **) info->pattern_properties);
+        info->pattern_properties = NULL;
 }
 
 static uint64_t unit_info_hash(const void *item, uint64_t seed0, uint64_t seed1) {
@@ -423,8 +628,7 @@ static bool unit_info_update_state(AgentUnitInfo *info, sd_bus_message *m) {
                 changed = true;
         }
         if (!streq(data.substate, unit_info_get_substate(info))) {
-                free(info->substate);
-                info->substate = strdup(data.substate);
+                info->substate = sub_state_intern(data.substate);
                 changed = true;
         }
 
@@ -452,6 +656,37 @@ Agent *agent_new(void) {
                 return NULL;
         }
 
+        _cleanup_property_cache_ PropertyCache *unit_property_cache = property_cache_new();
+        if (unit_property_cache == NULL) {
+                bc_log_error("Out of memory");
+                return NULL;
+        }
+
+        _cleanup_unit_state_windows_ UnitStateWindows *unit_state_windows = unit_state_windows_new();
+        if (unit_state_windows == NULL) {
+                bc_log_error("Out of memory");
+                return NULL;
+        }
+
+        _cleanup_tracked_jobs_ TrackedJobs *tracked_jobs = tracked_jobs_new();
+        if (tracked_jobs == NULL) {
+                bc_log_error("Out of memory");
+                return NULL;
+        }
+
+        _cleanup_event_journal_ EventJournal *event_journal = event_journal_new(AGENT_EVENT_JOURNAL_SIZE);
+        if (event_journal == NULL) {
+                bc_log_error("Out of memory");
+                return NULL;
+        }
+
+        sd_id128_t session_id;
+        r = sd_id128_randomize(&session_id);
+        if (r < 0) {
+                bc_log_errorf("Failed to create session id: %s", strerror(-r));
+                return NULL;
+        }
+
         struct hashmap *unit_infos = hashmap_new(
                         sizeof(AgentUnitInfo), 0, 0, 0, unit_info_hash, unit_info_compare, unit_info_clear, NULL);
         if (unit_infos == NULL) {
@@ -468,14 +703,31 @@ Agent *agent_new(void) {
         agent->connection_retry_count = 0;
         agent->controller_last_seen = 0;
         agent->controller_last_seen_monotonic = 0;
+        agent->controller_last_sent_monotonic = 0;
         agent->wildcard_subscription_active = false;
+        agent->unit_patterns_generation = 1;
+        agent->event_batch_enabled = false;
+        agent->event_batch_size = 0;
         agent->metrics_enabled = false;
         agent->disconnect_timestamp = 0;
         agent->disconnect_timestamp_monotonic = 0;
         agent->connection_retry_count_until_quiet = 0;
+        agent->unit_state_coalesce_window_msec = 0;
+        agent->unit_state_windows = steal_pointer(&unit_state_windows);
+        agent->unit_property_cache_ttl_msec = 0;
+        agent->unit_property_cache = steal_pointer(&unit_property_cache);
+        agent->unit_property_cache_sweep_source = NULL;
+        agent->unit_property_cache_hits = 0;
+        agent->unit_property_cache_misses = 0;
+        agent->tracked_jobs = steal_pointer(&tracked_jobs);
+        agent->resync_enabled = false;
+        /* 0 is sent by controllers that don't know the session */
+        memcpy(&agent->session_id, session_id.bytes, sizeof(agent->session_id));
+        agent->session_id |= 1;
+        agent->event_journal = steal_pointer(&event_journal);
         LIST_HEAD_INIT(agent->outstanding_requests);
-        LIST_HEAD_INIT(agent->tracked_jobs);
         LIST_HEAD_INIT(agent->proxy_services);
+        LIST_HEAD_INIT(agent->unit_patterns);
 
         return steal_pointer(&agent);
 }
@@ -541,6 +793,29 @@ void agent_unref(Agent *agent) {
         assert(LIST_IS_EMPTY(agent->proxy_services));
 
         hashmap_free(agent->unit_infos);
+        freev((void **) agent->wildcard_properties);
+        property_cache_free(agent->unit_property_cache);
+        tracked_jobs_free(agent->tracked_jobs);
+        event_journal_free(agent->event_journal);
+        unit_state_windows_free(agent->unit_state_windows);
+
+        UnitPattern *pattern = NULL;
+        UnitPattern *next_pattern = NULL;
+        LIST_FOREACH_SAFE(unit_patterns, pattern, next_pattern, agent->unit_patterns) {
+                unit_pattern_free(pattern);
+        }
+        if (agent->unit_state_window_source != NULL) {
+                sd_event_source_unrefp(&agent->unit_state_window_source);
+        }
+        if (agent->unit_property_cache_sweep_source != NULL) {
+                sd_event_source_unrefp(&agent->unit_property_cache_sweep_source);
+        }
+        if (agent->event_batch != NULL) {
+                sd_bus_message_unrefp(&agent->event_batch);
+        }
+        if (agent->event_batch_source != NULL) {
+                sd_event_source_unrefp(&agent->event_batch_source);
+        }
 
         free_and_null(agent->name);
         free_and_null(agent->host);
@@ -626,6 +901,28 @@ bool agent_set_controller_heartbeat_threshold(Agent *agent, const char *threshol
         return true;
 }
 
+bool agent_set_unit_state_coalesce_window(Agent *agent, const char *window_msec) {
+        long window = 0;
+
+        if (!parse_long(window_msec, &window) || window < 0) {
+                bc_log_errorf("Invalid unit state coalesce window format '%s'", window_msec);
+                return false;
+        }
+        agent->unit_state_coalesce_window_msec = window;
+        return true;
+}
+
+bool agent_set_unit_property_cache_ttl(Agent *agent, const char *ttl_msec) {
+        long ttl = 0;
+
+        if (!parse_long(ttl_msec, &ttl) || ttl < 0) {
+                bc_log_errorf("Invalid unit property cache TTL format '%s'", ttl_msec);
+                return false;
+        }
+        agent->unit_property_cache_ttl_msec = ttl;
+        return true;
+}
+
 void agent_set_systemd_user(Agent *agent, bool systemd_user) {
         agent->systemd_user = systemd_user;
 }
@@ -721,6 +1018,20 @@ bool agent_apply_config(Agent *agent) {
                 }
         }
 
+        value = cfg_get_value(agent->config, CFG_UNIT_STATE_COALESCE_WINDOW);
+        if (value) {
+                if (!agent_set_unit_state_coalesce_window(agent, value)) {
+                        return false;
+                }
+        }
+
+        value = cfg_get_value(agent->config, CFG_UNIT_PROPERTY_CACHE_TTL);
+        if (value) {
+                if (!agent_set_unit_property_cache_ttl(agent, value)) {
+                        return false;
+                }
+        }
+
         /* Set socket options used for peer connections with the agents */
         const char *keepidle = cfg_get_value(agent->config, CFG_TCP_KEEPALIVE_TIME);
         if (keepidle) {
@@ -781,7 +1092,7 @@ static AgentUnitInfo *agent_ensure_unit_info(Agent *agent, const char *unit) {
                 return NULL;
         }
 
-        AgentUnitInfo v = { unit_path, unit_copy, false, false, -1, NULL };
+        AgentUnitInfo v = { unit_path, unit_copy, false, false, -1, NULL, NULL, 0, false, NULL };
 
         AgentUnitInfo *replaced = (AgentUnitInfo *) hashmap_set(agent->unit_infos, &v);
         if (replaced == NULL && hashmap_oom(agent->unit_infos)) {
@@ -797,6 +1108,79 @@ static AgentUnitInfo *agent_ensure_unit_info(Agent *agent, const char *unit) {
         return info;
 }
 
+static bool strv_extend_all(char ***l, char **other) {
+        for (char **p = other; *p != NULL; p++) {
+                if (!strv_contains(*l, *p) && !strv_extend(l, *p)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/*
+ * Matches the unit against the unit patterns and collects the properties to forward for them,
+ * including those of the wildcard. The result is kept until the patterns change, so that events
+ * of the unit don't need to test all patterns again.
+ */
+static bool agent_unit_matches_patterns(Agent *agent, AgentUnitInfo *info) {
+        if (info->pattern_generation == agent->unit_patterns_generation) {
+                return info->pattern_matched;
+        }
+
+        bool matched = false;
+        bool all_properties = false;
+        _cleanup_freev_ char **properties = NULL;
+        UnitPattern *pattern = NULL;
+        LIST_FOREACH(unit_patterns, pattern, agent->unit_patterns) {
+                if (!glob_pattern_matches(pattern->glob, info->unit)) {
+                        continue;
+                }
+                matched = true;
+                /* Forward everything rather than too little if out of memory */
+                if (pattern->properties == NULL || !strv_extend_all(&properties, pattern->properties)) {
+                        all_properties = true;
+                }
+        }
+        if (matched && agent->wildcard_subscription_active &&
+            (agent->wildcard_properties == NULL || !strv_extend_all(&properties, agent->wildcard_properties))) {
+                all_properties = true;
+        }
+        if (all_properties) {
+                freev((void **) steal_pointer(&properties));
+        }
+
+        freev((void **) info->pattern_properties);
+        info->pattern_properties = steal_pointer(&properties);
+        info->pattern_matched = matched;
+        info->pattern_generation = agent->unit_patterns_generation;
+        return matched;
+}
+
+static bool agent_unit_is_subscribed(Agent *agent, AgentUnitInfo *info) {
+        return info->subscribed || agent->wildcard_subscription_active || agent_unit_matches_patterns(agent, info);
+}
+
+/* Returns the properties of the unit to forward in UnitPropertiesChanged, NULL for all */
+static char **agent_unit_get_properties(Agent *agent, AgentUnitInfo *info) {
+        if (info->subscribed) {
+                return info->properties;
+        }
+        if (agent_unit_matches_patterns(agent, info)) {
+                return info->pattern_properties;
+        }
+        return agent->wildcard_properties;
+}
+
+static UnitPattern *agent_find_unit_pattern(Agent *agent, const char *pattern) {
+        UnitPattern *p = NULL;
+        LIST_FOREACH(unit_patterns, p, agent->unit_patterns) {
+                if (streq(p->pattern, pattern)) {
+                        return p;
+                }
+        }
+        return NULL;
+}
+
 static int agent_method_passthrough_to_systemd_cb(
                 sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
         _cleanup_systemd_request_ SystemdRequest *req = userdata;
@@ -852,19 +1236,8 @@ static int list_units_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_
                 return sd_bus_reply_method_error(req->request_message, sd_bus_message_get_error(m));
         }
 
-        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
-
-        int r = sd_bus_message_new_method_return(req->request_message, &reply);
-        if (r < 0) {
-                return r;
-        }
-
-        r = sd_bus_message_copy(reply, m, true);
-        if (r < 0) {
-                return r;
-        }
-
-        return sd_bus_message_send(reply);
+        return bulk_reply_send(
+                        req->agent->event, req->request_message, m, UNIT_INFO_STRUCT_TYPESTRING, NULL, NULL, NULL);
 }
 
 static int agent_method_list_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
@@ -886,29 +1259,123 @@ static int agent_method_list_units(sd_bus_message *m, void *userdata, UNUSED sd_
 }
 
 /************************************************************************
- ********** org.eclipse.bluechi.internal.Agent.ListUnitFiles ************
+ ********** org.eclipse.bluechi.internal.Agent.ListUnitsFiltered ********
  ************************************************************************/
 
-static int list_unit_files_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+static int list_units_filtered_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
         _cleanup_systemd_request_ SystemdRequest *req = userdata;
 
         if (sd_bus_message_is_method_error(m, NULL)) {
+                /* Forward error */
                 return sd_bus_reply_method_error(req->request_message, sd_bus_message_get_error(m));
         }
 
-        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        /* States and patterns were applied by systemd, types and fields are applied here */
+        _cleanup_freev_ char **types = NULL;
+        _cleanup_freev_ char **fields = NULL;
+        int r = sd_bus_message_rewind(req->request_message, true);
+        if (r >= 0) {
+                r = sd_bus_message_skip(req->request_message, "asas");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(req->request_message, &types);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(req->request_message, &fields);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                req->request_message, SD_BUS_ERROR_FAILED, "Failed to read filter: %s", strerror(-r));
+        }
 
-        int r = sd_bus_message_new_method_return(req->request_message, &reply);
+        uint32_t mask = 0;
+        const char *invalid = NULL;
+        if (!unit_info_fields_parse(fields, &mask, &invalid)) {
+                return sd_bus_reply_method_errorf(
+                                req->request_message, SD_BUS_ERROR_INVALID_ARGS, "Invalid field '%s'", invalid);
+        }
+
+        UnitInfoFilter *filter = unit_info_filter_new(types, mask);
+        if (filter == NULL) {
+                return sd_bus_reply_method_errorf(req->request_message, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+        steal_pointer(&types);
+
+        return bulk_reply_send(
+                        req->agent->event,
+                        req->request_message,
+                        m,
+                        UNIT_INFO_STRUCT_TYPESTRING,
+                        unit_info_filter_copy_next,
+                        filter,
+                        (free_func_t) unit_info_filter_free);
+}
+
+static int agent_method_list_units_filtered(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Agent *agent = userdata;
+        _cleanup_freev_ char **states = NULL;
+        _cleanup_freev_ char **patterns = NULL;
+        _cleanup_freev_ char **types = NULL;
+        _cleanup_freev_ char **fields = NULL;
+
+        int r = sd_bus_message_read_strv(m, &states);
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(m, &patterns);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(m, &types);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(m, &fields);
+        }
         if (r < 0) {
-                return r;
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_INVALID_ARGS, "Invalid arguments: %s", strerror(-r));
         }
 
-        r = sd_bus_message_copy(reply, m, true);
+        /* Reject unknown fields before bothering systemd */
+        uint32_t mask = 0;
+        const char *invalid = NULL;
+        if (!unit_info_fields_parse(fields, &mask, &invalid)) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_INVALID_ARGS, "Invalid field '%s'", invalid);
+        }
+
+        _cleanup_systemd_request_ SystemdRequest *req = agent_create_request(agent, m, "ListUnitsByPatterns");
+        if (req == NULL) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                SD_BUS_ERROR_FAILED,
+                                "Failed to create a systemd request for the ListUnitsFiltered method");
+        }
+
+        r = sd_bus_message_append_strv(req->message, states);
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(req->message, patterns);
+        }
         if (r < 0) {
-                return r;
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Failed to append filter to systemd request: %s", strerror(-r));
         }
 
-        return sd_bus_message_send(reply);
+        if (!systemd_request_start(req, list_units_filtered_callback)) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to start systemd request");
+        }
+
+        return 1;
+}
+
+/************************************************************************
+ ********** org.eclipse.bluechi.internal.Agent.ListUnitFiles ************
+ ************************************************************************/
+
+static int list_unit_files_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        _cleanup_systemd_request_ SystemdRequest *req = userdata;
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                return sd_bus_reply_method_error(req->request_message, sd_bus_message_get_error(m));
+        }
+
+        return bulk_reply_send(
+                        req->agent->event, req->request_message, m, UNIT_FILE_INFO_STRUCT_TYPESTRING, NULL, NULL, NULL);
 }
 
 static int agent_method_list_unit_files(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
@@ -933,16 +1400,9 @@ static int agent_method_list_unit_files(sd_bus_message *m, void *userdata, UNUSE
  ******** org.eclipse.bluechi.internal.Agent.GetUnitProperties ************
  ************************************************************************/
 
-static int get_unit_properties_got_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
-        _cleanup_systemd_request_ SystemdRequest *req = userdata;
-
-        if (sd_bus_message_is_method_error(m, NULL)) {
-                /* Forward error */
-                return sd_bus_reply_method_error(req->request_message, sd_bus_message_get_error(m));
-        }
-
+static int agent_reply_unit_properties(sd_bus_message *request_message, sd_bus_message *m) {
         _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
-        int r = sd_bus_message_new_method_return(req->request_message, &reply);
+        int r = sd_bus_message_new_method_return(request_message, &reply);
         if (r < 0) {
                 return r;
         }
@@ -955,13 +1415,120 @@ static int get_unit_properties_got_properties(sd_bus_message *m, void *userdata,
         return sd_bus_message_send(reply);
 }
 
-static int agent_method_get_unit_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
-        Agent *agent = userdata;
-        const char *interface = NULL;
-        const char *unit = NULL;
-        _cleanup_free_ char *unit_path = NULL;
+/* Returns the cached reply of systemd for the unit properties, or NULL if it has to be queried */
+static sd_bus_message *agent_lookup_unit_properties(
+                Agent *agent, const char *unit_path, const char *interface, const char *property) {
+        if (agent->unit_property_cache_ttl_msec <= 0) {
+                return NULL;
+        }
 
-        int r = sd_bus_message_read(m, "ss", &unit, &interface);
+        sd_bus_message *cached = property_cache_get(
+                        agent->unit_property_cache,
+                        unit_path,
+                        interface,
+                        property,
+                        get_time_micros_monotonic(),
+                        (uint64_t) agent->unit_property_cache_ttl_msec * USEC_PER_MSEC);
+        if (cached != NULL) {
+                agent->unit_property_cache_hits++;
+        } else {
+                agent->unit_property_cache_misses++;
+        }
+        return cached;
+}
+
+static int agent_schedule_unit_property_cache_sweep(Agent *agent);
+
+/* Drops the values that expired without being read again, once per TTL while anything is cached */
+static int agent_unit_property_cache_sweep_callback(
+                UNUSED sd_event_source *event_source, UNUSED uint64_t usec, void *userdata) {
+        Agent *agent = userdata;
+
+        property_cache_expire(
+                        agent->unit_property_cache,
+                        get_time_micros_monotonic(),
+                        (uint64_t) agent->unit_property_cache_ttl_msec * USEC_PER_MSEC);
+        if (property_cache_size(agent->unit_property_cache) > 0) {
+                int r = agent_schedule_unit_property_cache_sweep(agent);
+                if (r < 0) {
+                        bc_log_errorf("Failed to schedule unit property cache sweep: %s", strerror(-r));
+                }
+        }
+        return 0;
+}
+
+static int agent_schedule_unit_property_cache_sweep(Agent *agent) {
+        uint64_t ttl = (uint64_t) agent->unit_property_cache_ttl_msec * USEC_PER_MSEC;
+        return event_reset_time_relative(
+                        agent->event,
+                        &agent->unit_property_cache_sweep_source,
+                        CLOCK_MONOTONIC,
+                        ttl,
+                        ttl,
+                        agent_unit_property_cache_sweep_callback,
+                        agent,
+                        0,
+                        "agent-unit-property-cache-sweep-source",
+                        false);
+}
+
+static void agent_cache_unit_properties(SystemdRequest *req, sd_bus_message *m, bool single_property) {
+        Agent *agent = req->agent;
+        const char *unit = NULL;
+        const char *interface = NULL;
+        const char *property = NULL;
+
+        if (agent->unit_property_cache_ttl_msec <= 0) {
+                return;
+        }
+
+        /* The request was read when it was received, read it again for the key */
+        int r = sd_bus_message_rewind(req->request_message, true);
+        if (r >= 0) {
+                r = single_property ? sd_bus_message_read(req->request_message, "sss", &unit, &interface, &property)
+                                    : sd_bus_message_read(req->request_message, "ss", &unit, &interface);
+        }
+        if (r >= 0) {
+                r = property_cache_put(
+                                agent->unit_property_cache,
+                                sd_bus_message_get_path(req->message),
+                                interface,
+                                property,
+                                m,
+                                get_time_micros_monotonic());
+        }
+        if (r >= 0) {
+                r = agent_schedule_unit_property_cache_sweep(agent);
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to cache properties of unit %s: %s", unit, strerror(-r));
+        }
+}
+
+static int get_unit_properties_got_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        _cleanup_systemd_request_ SystemdRequest *req = userdata;
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                /* Forward error */
+                return sd_bus_reply_method_error(req->request_message, sd_bus_message_get_error(m));
+        }
+
+        if (req->agent->unit_property_cache_ttl_msec > 0) {
+                /* Cache hits read the same message, so it can't be handed to a bulk reply */
+                agent_cache_unit_properties(req, m, false);
+                return agent_reply_unit_properties(req->request_message, m);
+        }
+
+        return bulk_reply_send(req->agent->event, req->request_message, m, "{sv}", NULL, NULL, NULL);
+}
+
+static int agent_method_get_unit_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Agent *agent = userdata;
+        const char *interface = NULL;
+        const char *unit = NULL;
+        _cleanup_free_ char *unit_path = NULL;
+
+        int r = sd_bus_message_read(m, "ss", &unit, &interface);
         if (r < 0) {
                 return sd_bus_reply_method_errorf(
                                 m,
@@ -975,6 +1542,11 @@ static int agent_method_get_unit_properties(sd_bus_message *m, void *userdata, U
                 return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_NO_MEMORY, "OOM when assembling unit path");
         }
 
+        sd_bus_message *cached = agent_lookup_unit_properties(agent, unit_path, interface, NULL);
+        if (cached != NULL) {
+                return agent_reply_unit_properties(m, cached);
+        }
+
         _cleanup_systemd_request_ SystemdRequest *req = agent_create_request_full(
                         agent, m, unit_path, "org.freedesktop.DBus.Properties", "GetAll");
         if (req == NULL) {
@@ -1012,18 +1584,8 @@ static int get_unit_property_got_property(sd_bus_message *m, void *userdata, UNU
                 return sd_bus_reply_method_error(req->request_message, sd_bus_message_get_error(m));
         }
 
-        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
-        int r = sd_bus_message_new_method_return(req->request_message, &reply);
-        if (r < 0) {
-                return r;
-        }
-
-        r = sd_bus_message_copy(reply, m, true);
-        if (r < 0) {
-                return r;
-        }
-
-        return sd_bus_message_send(reply);
+        agent_cache_unit_properties(req, m, true);
+        return agent_reply_unit_properties(req->request_message, m);
 }
 
 static int agent_method_get_unit_property(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
@@ -1047,6 +1609,11 @@ static int agent_method_get_unit_property(sd_bus_message *m, void *userdata, UNU
                 return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
         }
 
+        sd_bus_message *cached = agent_lookup_unit_properties(agent, unit_path, interface, property);
+        if (cached != NULL) {
+                return agent_reply_unit_properties(m, cached);
+        }
+
         _cleanup_systemd_request_ SystemdRequest *req = agent_create_request_full(
                         agent, m, unit_path, "org.freedesktop.DBus.Properties", "Get");
         if (req == NULL) {
@@ -1263,6 +1830,22 @@ static int agent_method_thaw_unit(sd_bus_message *m, void *userdata, UNUSED sd_b
         return 1;
 }
 
+static void agent_flush_unit_state_window_by_name(Agent *agent, const char *unit);
+
+static void agent_job_op_emit_done(AgentJobOp *op, const char *result) {
+        agent_flush_unit_state_window_by_name(op->agent, op->unit);
+
+        bc_log_infof("Sending JobDone %u, result: %s", op->bc_job_id, result);
+
+        int r = agent_emit_event(op->agent, "JobDone", "us", op->bc_job_id, result);
+        if (r < 0) {
+                bc_log_errorf("Failed to emit JobDone: %s", strerror(-r));
+        }
+}
+
+static bool agent_job_batch_is_replied(AgentJobBatch *batch);
+static void agent_job_batch_defer_done(AgentJobBatch *batch, AgentJobOp *op);
+
 static void agent_job_done(UNUSED sd_bus_message *m, const char *result, void *userdata) {
         AgentJobOp *op = userdata;
         Agent *agent = op->agent;
@@ -1276,19 +1859,20 @@ static void agent_job_done(UNUSED sd_bus_message *m, const char *result, void *u
                                 finalize_time_interval_micros(op->job_start_micros));
         }
 
-        bc_log_infof("Sending JobDone %u, result: %s", op->bc_job_id, result);
-
-        int r = sd_bus_emit_signal(
-                        agent->peer_dbus,
-                        INTERNAL_AGENT_OBJECT_PATH,
-                        INTERNAL_AGENT_INTERFACE,
-                        "JobDone",
-                        "us",
-                        op->bc_job_id,
-                        result);
-        if (r < 0) {
-                bc_log_errorf("Failed to emit JobDone: %s", strerror(-r));
+        if (op->batch != NULL && !agent_job_batch_is_replied(op->batch)) {
+                /* The controller only knows the job once the batch is answered */
+                free(op->deferred_result);
+                op->deferred_result = strdup(result);
+                if (op->deferred_result == NULL) {
+                        bc_log_error("Out of memory, JobDone is sent before the job is known");
+                        agent_job_op_emit_done(op, result);
+                        return;
+                }
+                agent_job_batch_defer_done(op->batch, op);
+                return;
         }
+
+        agent_job_op_emit_done(op, result);
 }
 
 static int unit_lifecycle_method_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
@@ -1312,12 +1896,7 @@ static int unit_lifecycle_method_callback(sd_bus_message *m, void *userdata, UNU
 
         AgentJobOp *op = req->userdata;
 
-        if (!agent_track_job(
-                            agent,
-                            job_object_path,
-                            agent_job_done,
-                            agent_job_op_ref(op),
-                            (free_func_t) agent_job_op_unref)) {
+        if (!agent_track_job(agent, job_object_path, op)) {
                 return sd_bus_reply_method_errorf(
                                 req->request_message, SD_BUS_ERROR_FAILED, "Failed to track a job");
         }
@@ -1406,20 +1985,264 @@ static int agent_method_reload_unit(sd_bus_message *m, void *userdata, UNUSED sd
         return agent_run_unit_lifecycle_method(m, (Agent *) userdata, "ReloadUnit");
 }
 
+/* StartUnits and friends queue the jobs of all units with systemd at once and answer when all of them are
+   queued. JobDone of a job that finishes before that is held back, as the controller does not know the job yet. */
+struct AgentJobBatch {
+        int ref_count;
+
+        sd_bus_message *request_message;
+        size_t n_units;
+        size_t n_pending;
+        bool replied;
+
+        char **errors;          /* Why the job of a unit was not queued, NULL if it was */
+        AgentJobOp **deferred;  /* Jobs that finished before the reply */
+        size_t n_deferred;
+};
+
+static AgentJobBatch *agent_job_batch_new(sd_bus_message *request_message, size_t n_units) {
+        _cleanup_free_ AgentJobBatch *batch = malloc0(sizeof(AgentJobBatch));
+        if (batch == NULL) {
+                return NULL;
+        }
+
+        batch->errors = calloc(n_units, sizeof(char *));
+        batch->deferred = calloc(n_units, sizeof(AgentJobOp *));
+        if ((batch->errors == NULL || batch->deferred == NULL) && n_units > 0) {
+                free(batch->errors);
+                free(batch->deferred);
+                return NULL;
+        }
+
+        batch->ref_count = 1;
+        batch->request_message = sd_bus_message_ref(request_message);
+        batch->n_units = n_units;
+        batch->n_pending = 1; /* Held until all units are submitted */
+        return steal_pointer(&batch);
+}
+
+static AgentJobBatch *agent_job_batch_ref(AgentJobBatch *batch) {
+        batch->ref_count++;
+        return batch;
+}
+
+static void agent_job_batch_unref(AgentJobBatch *batch) {
+        batch->ref_count--;
+        if (batch->ref_count != 0) {
+                return;
+        }
+
+        for (size_t i = 0; i < batch->n_units; i++) {
+                free(batch->errors[i]);
+        }
+        for (size_t i = 0; i < batch->n_deferred; i++) {
+                agent_job_op_unref(batch->deferred[i]);
+        }
+        free(batch->errors);
+        free(batch->deferred);
+        sd_bus_message_unrefp(&batch->request_message);
+        free(batch);
+}
+
+DEFINE_CLEANUP_FUNC(AgentJobBatch, agent_job_batch_unref)
+#define _cleanup_agent_job_batch_ _cleanup_(agent_job_batch_unrefp)
+
+static bool agent_job_batch_is_replied(AgentJobBatch *batch) {
+        return batch->replied;
+}
+
+static void agent_job_batch_defer_done(AgentJobBatch *batch, AgentJobOp *op) {
+        assert(batch->n_deferred < batch->n_units);
+        batch->deferred[batch->n_deferred++] = agent_job_op_ref(op);
+}
+
+static void agent_job_batch_set_error(AgentJobBatch *batch, size_t index, const char *error) {
+        free(batch->errors[index]);
+        batch->errors[index] = strdup(error != NULL ? error : "Failed to queue job");
+}
+
+static int agent_job_batch_reply(AgentJobBatch *batch) {
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        int r = sd_bus_message_new_method_return(batch->request_message, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "s");
+        }
+        for (size_t i = 0; r >= 0 && i < batch->n_units; i++) {
+                r = sd_bus_message_append(reply, "s", batch->errors[i] != NULL ? batch->errors[i] : "");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(reply);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_send(reply);
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to reply to batch of unit jobs: %s", strerror(-r));
+        }
+
+        batch->replied = true;
+        for (size_t i = 0; i < batch->n_deferred; i++) {
+                agent_job_op_emit_done(batch->deferred[i], batch->deferred[i]->deferred_result);
+                agent_job_op_unrefp(&batch->deferred[i]);
+        }
+        batch->n_deferred = 0;
+
+        return r;
+}
+
+static int agent_job_batch_unit_done(AgentJobBatch *batch) {
+        assert(batch->n_pending > 0);
+        batch->n_pending--;
+        if (batch->n_pending > 0) {
+                return 0;
+        }
+        return agent_job_batch_reply(batch);
+}
+
+static int batch_unit_lifecycle_method_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        _cleanup_systemd_request_ SystemdRequest *req = userdata;
+        AgentJobOp *op = req->userdata;
+        const char *job_object_path = NULL;
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                agent_job_batch_set_error(op->batch, op->batch_index, sd_bus_message_get_error(m)->message);
+        } else if (sd_bus_message_read(m, "o", &job_object_path) < 0) {
+                agent_job_batch_set_error(
+                                op->batch, op->batch_index, "Failed to read the object path of the job");
+        } else if (!agent_track_job(req->agent, job_object_path, op)) {
+                agent_job_batch_set_error(op->batch, op->batch_index, "Failed to track a job");
+        }
+
+        return agent_job_batch_unit_done(op->batch);
+}
+
+static bool agent_job_batch_submit(
+                Agent *agent,
+                AgentJobBatch *batch,
+                size_t index,
+                const char *method,
+                const char *name,
+                const char *mode,
+                uint32_t job_id) {
+        _cleanup_systemd_request_ SystemdRequest *req = agent_create_request(agent, batch->request_message, method);
+        if (req == NULL) {
+                return false;
+        }
+
+        _cleanup_agent_job_op_ AgentJobOp *op = agent_job_new(agent, job_id, name, method);
+        if (op == NULL) {
+                return false;
+        }
+        op->batch = agent_job_batch_ref(batch);
+        op->batch_index = index;
+
+        systemd_request_set_userdata(req, agent_job_op_ref(op), (free_func_t) agent_job_op_unref);
+
+        int r = sd_bus_message_append(req->message, "ss", name, mode);
+        if (r < 0) {
+                return false;
+        }
+
+        if (!systemd_request_start(req, batch_unit_lifecycle_method_callback)) {
+                return false;
+        }
+
+        batch->n_pending++;
+        return true;
+}
+
+static int agent_run_unit_lifecycle_method_batch(sd_bus_message *m, Agent *agent, const char *method) {
+        const char *mode = NULL;
+        uint32_t job_id = 0;
+        size_t n_units = 0;
+
+        /* The mode follows the units, so read it and count the units before submitting them */
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "(su)");
+        while (r >= 0 && (r = sd_bus_message_at_end(m, false)) == 0) {
+                r = sd_bus_message_skip(m, "(su)");
+                n_units++;
+        }
+        if (r >= 0) {
+                r = sd_bus_message_exit_container(m);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_read(m, "s", &mode);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_rewind(m, true);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "(su)");
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                SD_BUS_ERROR_INVALID_ARGS,
+                                "Failed to read a message containing units, job IDs, and mode: %s",
+                                strerror(-r));
+        }
+
+        bc_log_infof("Request to %s %zu units - Action: %s", method, n_units, mode);
+
+        _cleanup_agent_job_batch_ AgentJobBatch *batch = agent_job_batch_new(m, n_units);
+        if (batch == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+
+        for (size_t i = 0; i < n_units; i++) {
+                const char *name = NULL;
+                r = sd_bus_message_read(m, "(su)", &name, &job_id);
+                if (r <= 0) {
+                        agent_job_batch_set_error(batch, i, "Failed to read unit and job ID");
+                } else if (!agent_job_batch_submit(agent, batch, i, method, name, mode, job_id)) {
+                        agent_job_batch_set_error(batch, i, "Failed to start a systemd request");
+                }
+        }
+
+        /* Replies right away if no job could be submitted */
+        (void) agent_job_batch_unit_done(batch);
+        return 1;
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.internal.Agent.StartUnits  *
+ *************************************************************************/
+
+static int agent_method_start_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return agent_run_unit_lifecycle_method_batch(m, (Agent *) userdata, "StartUnit");
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.internal.Agent.StopUnits   *
+ *************************************************************************/
+
+static int agent_method_stop_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return agent_run_unit_lifecycle_method_batch(m, (Agent *) userdata, "StopUnit");
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.internal.Agent.RestartUnits *
+ *************************************************************************/
+
+static int agent_method_restart_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return agent_run_unit_lifecycle_method_batch(m, (Agent *) userdata, "RestartUnit");
+}
+
 /*************************************************************************
  ********** org.eclipse.bluechi.internal.Agent.Subscribe ***
  *************************************************************************/
 
+/* Virtual events only repeat the current state and are not needed for a resync */
+static void agent_journal_unit_event(Agent *agent, AgentUnitInfo *info, const char *reason) {
+        if (reason == NULL || !streq(reason, "virtual")) {
+                event_journal_add(agent->event_journal, info->unit);
+        }
+}
+
 static void agent_emit_unit_new(Agent *agent, AgentUnitInfo *info, const char *reason) {
         bc_log_debugf("Sending UnitNew %s, reason: %s", info->unit, reason);
-        int r = sd_bus_emit_signal(
-                        agent->peer_dbus,
-                        INTERNAL_AGENT_OBJECT_PATH,
-                        INTERNAL_AGENT_INTERFACE,
-                        "UnitNew",
-                        "ss",
-                        info->unit,
-                        reason);
+        agent_journal_unit_event(agent, info, reason);
+        int r = agent_emit_event(agent, "UnitNew", "ss", info->unit, reason);
         if (r < 0) {
                 bc_log_warn("Failed to emit UnitNew");
         }
@@ -1427,14 +2250,9 @@ static void agent_emit_unit_new(Agent *agent, AgentUnitInfo *info, const char *r
 
 static void agent_emit_unit_removed(Agent *agent, AgentUnitInfo *info) {
         bc_log_debugf("Sending UnitRemoved %s", info->unit);
+        agent_journal_unit_event(agent, info, NULL);
 
-        int r = sd_bus_emit_signal(
-                        agent->peer_dbus,
-                        INTERNAL_AGENT_OBJECT_PATH,
-                        INTERNAL_AGENT_INTERFACE,
-                        "UnitRemoved",
-                        "s",
-                        info->unit);
+        int r = agent_emit_event(agent, "UnitRemoved", "s", info->unit);
         if (r < 0) {
                 bc_log_warn("Failed to emit UnitRemoved");
         }
@@ -1446,10 +2264,9 @@ static void agent_emit_unit_state_changed(Agent *agent, AgentUnitInfo *info, con
                       active_state_to_string(info->active_state),
                       unit_info_get_substate(info),
                       reason);
-        int r = sd_bus_emit_signal(
-                        agent->peer_dbus,
-                        INTERNAL_AGENT_OBJECT_PATH,
-                        INTERNAL_AGENT_INTERFACE,
+        agent_journal_unit_event(agent, info, reason);
+        int r = agent_emit_event(
+                        agent,
                         "UnitStateChanged",
                         "ssss",
                         info->unit,
@@ -1457,8 +2274,162 @@ static void agent_emit_unit_state_changed(Agent *agent, AgentUnitInfo *info, con
                         unit_info_get_substate(info),
                         reason);
         if (r < 0) {
-                bc_log_warn("Failed to emit UnitStateChanged");
+                bc_log_warn("Failed to emit UnitStateChanged");
+        }
+}
+
+static int agent_unit_state_window_callback(sd_event_source *event_source, uint64_t usec, void *userdata);
+
+static int agent_arm_unit_state_window_timer(Agent *agent) {
+        uint64_t deadline = unit_state_windows_get_next_deadline(agent->unit_state_windows);
+        if (deadline == 0) {
+                return 0;
+        }
+
+        if (agent->unit_state_window_source == NULL) {
+                return sd_event_add_time(
+                                agent->event,
+                                &agent->unit_state_window_source,
+                                CLOCK_MONOTONIC,
+                                deadline,
+                                0,
+                                agent_unit_state_window_callback,
+                                agent);
+        }
+
+        int r = sd_event_source_set_time(agent->unit_state_window_source, deadline);
+        if (r < 0) {
+                return r;
+        }
+        return sd_event_source_set_enabled(agent->unit_state_window_source, SD_EVENT_ONESHOT);
+}
+
+static uint64_t agent_get_unit_state_window_length(Agent *agent) {
+        return (uint64_t) agent->unit_state_coalesce_window_msec * USEC_PER_MSEC;
+}
+
+/* Emits the latest state of the unit for a change that was held back, returns true if it was emitted */
+static bool agent_emit_held_back_unit_state(Agent *agent, AgentUnitInfo *info) {
+        if (!agent_unit_is_subscribed(agent, info)) {
+                return false;
+        }
+        if (!agent_is_connected(agent)) {
+                /* Never emitted, a resync has to report the unit as changed instead */
+                event_journal_add(agent->event_journal, info->unit);
+                return false;
+        }
+
+        agent_emit_unit_state_changed(agent, info, "real");
+        return true;
+}
+
+/*
+ * Closes the coalescing window of the unit and emits its latest state if a change was held
+ * back. Called before any other event of the unit is emitted, to keep the events in order.
+ */
+static void agent_flush_unit_state_window(Agent *agent, AgentUnitInfo *info) {
+        if (unit_state_windows_close(agent->unit_state_windows, info->object_path)) {
+                agent_emit_held_back_unit_state(agent, info);
+        }
+}
+
+static void agent_flush_unit_state_window_by_name(Agent *agent, const char *unit) {
+        _cleanup_free_ char *path = make_unit_path(unit);
+        AgentUnitInfo *info = path != NULL ? agent_get_unit_info(agent, path) : NULL;
+        if (info != NULL) {
+                agent_flush_unit_state_window(agent, info);
+        }
+}
+
+static int agent_unit_state_window_callback(
+                UNUSED sd_event_source *event_source, UNUSED uint64_t usec, void *userdata) {
+        Agent *agent = userdata;
+        uint64_t now = get_time_micros_monotonic();
+
+        char *unit_path = NULL;
+        while ((unit_path = unit_state_windows_expire(agent->unit_state_windows, now)) != NULL) {
+                /* Skip removed units */
+                AgentUnitInfo *info = agent_get_unit_info(agent, unit_path);
+                if (info != NULL && agent_emit_held_back_unit_state(agent, info)) {
+                        /* Changes following right after the emitted one are coalesced again */
+                        unit_state_windows_open(
+                                        agent->unit_state_windows,
+                                        unit_path,
+                                        now,
+                                        agent_get_unit_state_window_length(agent));
+                }
+                free(unit_path);
+        }
+
+        int r = agent_arm_unit_state_window_timer(agent);
+        if (r < 0) {
+                bc_log_errorf("Failed to arm unit state window timer: %s", strerror(-r));
+        }
+        return 0;
+}
+
+/*
+ * Emits a state change of the unit. If a coalescing window is configured, the first change is
+ * emitted right away and opens the window. Further changes within the window are collapsed and
+ * only the latest state is emitted when the window ends.
+ */
+static void agent_queue_unit_state_changed(Agent *agent, AgentUnitInfo *info) {
+        if (agent->unit_state_coalesce_window_msec <= 0) {
+                agent_emit_unit_state_changed(agent, info, "real");
+                return;
+        }
+
+        if (unit_state_windows_hold(
+                            agent->unit_state_windows,
+                            info->object_path,
+                            get_time_micros_monotonic(),
+                            agent_get_unit_state_window_length(agent))) {
+                return;
+        }
+
+        agent_emit_unit_state_changed(agent, info, "real");
+        int r = agent_arm_unit_state_window_timer(agent);
+        if (r < 0) {
+                bc_log_errorf("Failed to arm unit state window timer: %s", strerror(-r));
+        }
+}
+
+static int agent_subscribe_unit_pattern(Agent *agent, sd_bus_message *m, const char *unit) {
+        if (agent_find_unit_pattern(agent, unit) != NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Already subscribed");
         }
+
+        _cleanup_free_ UnitPattern *pattern = malloc0(sizeof(UnitPattern));
+        if (pattern == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to subscribe to the pattern");
+        }
+        pattern->pattern = strdup(unit);
+        pattern->glob = glob_pattern_new(unit);
+        if (pattern->pattern == NULL || pattern->glob == NULL) {
+                free(pattern->pattern);
+                glob_pattern_free(pattern->glob);
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to subscribe to the pattern");
+        }
+        LIST_INIT(unit_patterns, pattern);
+        LIST_APPEND(unit_patterns, agent->unit_patterns, pattern);
+        agent->unit_patterns_generation++;
+
+        /* Matching units that were already loaded, synthesize their UnitNew */
+        void *item = NULL;
+        size_t i = 0;
+        while (hashmap_iter(agent->unit_infos, &i, &item)) {
+                AgentUnitInfo *info = item;
+                if (!info->loaded || !glob_pattern_matches(pattern->glob, info->unit)) {
+                        continue;
+                }
+                agent_emit_unit_new(agent, info, "virtual");
+                if (info->active_state != _UNIT_ACTIVE_STATE_INVALID) {
+                        agent_emit_unit_state_changed(agent, info, "virtual");
+                }
+        }
+        steal_pointer(&pattern);
+
+        return sd_bus_reply_method_return(m, "");
 }
 
 static int agent_method_subscribe(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
@@ -1476,13 +2447,20 @@ static int agent_method_subscribe(sd_bus_message *m, void *userdata, UNUSED sd_b
                                         m, SD_BUS_ERROR_FAILED, "Already wildcard subscribed");
                 }
                 agent->wildcard_subscription_active = true;
+                agent->unit_patterns_generation++;
 
-                AgentUnitInfo info = { NULL, (char *) unit, true, true, _UNIT_ACTIVE_STATE_INVALID, NULL };
+                AgentUnitInfo info = {
+                        NULL, (char *) unit, true, true, _UNIT_ACTIVE_STATE_INVALID, NULL, NULL, 0, false, NULL
+                };
                 agent_emit_unit_new(agent, &info, "virtual");
 
                 return sd_bus_reply_method_return(m, "");
         }
 
+        if (is_glob(unit)) {
+                return agent_subscribe_unit_pattern(agent, m, unit);
+        }
+
         AgentUnitInfo *info = agent_ensure_unit_info(agent, unit);
         if (info == NULL) {
                 return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to ensure the unit info");
@@ -1525,6 +2503,20 @@ static int agent_method_unsubscribe(sd_bus_message *m, void *userdata, UNUSED sd
                                         m, SD_BUS_ERROR_FAILED, "No wildcard subscription active");
                 }
                 agent->wildcard_subscription_active = false;
+                freev((void **) agent->wildcard_properties);
+                agent->wildcard_properties = NULL;
+                agent->unit_patterns_generation++;
+                return sd_bus_reply_method_return(m, "");
+        }
+
+        if (is_glob(unit)) {
+                UnitPattern *pattern = agent_find_unit_pattern(agent, unit);
+                if (pattern == NULL) {
+                        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Not subscribed");
+                }
+                LIST_REMOVE(unit_patterns, agent->unit_patterns, pattern);
+                unit_pattern_free(pattern);
+                agent->unit_patterns_generation++;
                 return sd_bus_reply_method_return(m, "");
         }
 
@@ -1539,10 +2531,182 @@ static int agent_method_unsubscribe(sd_bus_message *m, void *userdata, UNUSED sd
         }
 
         info->subscribed = false;
+        freev((void **) info->properties);
+        info->properties = NULL;
         agent_update_unit_infos_for(agent, info);
         return sd_bus_reply_method_return(m, "");
 }
 
+/*************************************************************************
+ *** org.eclipse.bluechi.internal.Agent.SetPropertyFilter **
+ *************************************************************************/
+
+static int agent_method_set_property_filter(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Agent *agent = userdata;
+        const char *unit = NULL;
+        _cleanup_freev_ char **properties = NULL;
+
+        int r = sd_bus_message_read(m, "s", &unit);
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(m, &properties);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_INVALID_ARGS, "Invalid arguments for the filter: %s", strerror(-r));
+        }
+
+        /* An empty filter forwards all properties */
+        if (strv_length(properties) == 0) {
+                freev((void **) steal_pointer(&properties));
+        }
+
+        if (is_wildcard(unit)) {
+                if (!agent->wildcard_subscription_active) {
+                        return sd_bus_reply_method_errorf(
+                                        m, SD_BUS_ERROR_FAILED, "No wildcard subscription active");
+                }
+                freev((void **) agent->wildcard_properties);
+                agent->wildcard_properties = steal_pointer(&properties);
+                agent->unit_patterns_generation++;
+                return sd_bus_reply_method_return(m, "");
+        }
+
+        if (is_glob(unit)) {
+                UnitPattern *pattern = agent_find_unit_pattern(agent, unit);
+                if (pattern == NULL) {
+                        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Not subscribed");
+                }
+                freev((void **) pattern->properties);
+                pattern->properties = steal_pointer(&properties);
+                agent->unit_patterns_generation++;
+                return sd_bus_reply_method_return(m, "");
+        }
+
+        _cleanup_free_ char *path = make_unit_path(unit);
+        if (path == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to create the unit path");
+        }
+
+        AgentUnitInfo *info = agent_get_unit_info(agent, path);
+        if (info == NULL || !info->subscribed) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Not subscribed");
+        }
+
+        freev((void **) info->properties);
+        info->properties = steal_pointer(&properties);
+        return sd_bus_reply_method_return(m, "");
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.internal.Agent.Resync ******
+ *************************************************************************/
+
+/* Forgets all subscriptions, so that the controller can subscribe again from scratch */
+static void agent_reset_subscriptions(Agent *agent) {
+        agent->wildcard_subscription_active = false;
+        freev((void **) agent->wildcard_properties);
+        agent->wildcard_properties = NULL;
+
+        UnitPattern *pattern = NULL;
+        UnitPattern *next_pattern = NULL;
+        LIST_FOREACH_SAFE(unit_patterns, pattern, next_pattern, agent->unit_patterns) {
+                LIST_REMOVE(unit_patterns, agent->unit_patterns, pattern);
+                unit_pattern_free(pattern);
+        }
+        agent->unit_patterns_generation++;
+
+        /* Units that are neither subscribed nor loaded are dropped, which can't happen while iterating */
+        _cleanup_free_ char **unused_paths = malloc0_array(0, sizeof(char *), hashmap_count(agent->unit_infos));
+        size_t n_unused = 0;
+        void *item = NULL;
+        size_t i = 0;
+        while (hashmap_iter(agent->unit_infos, &i, &item)) {
+                AgentUnitInfo *info = item;
+                info->subscribed = false;
+                freev((void **) info->properties);
+                info->properties = NULL;
+                if (!info->loaded && unused_paths != NULL) {
+                        unused_paths[n_unused++] = info->object_path;
+                }
+        }
+        for (size_t u = 0; u < n_unused; u++) {
+                AgentUnitInfoKey key = { unused_paths[u] };
+                AgentUnitInfo *info = (AgentUnitInfo *) hashmap_delete(agent->unit_infos, &key);
+                if (info != NULL) {
+                        unit_info_clear(info);
+                }
+        }
+}
+
+/*
+ * Called by the controller after reconnecting, with the last sequence number
+ * it received from this agent. If the journal still covers all unit events
+ * since, the reply lists the units that changed and the current state of
+ * these units follows as virtual events, while all subscriptions are kept.
+ * Otherwise all subscriptions are dropped and the controller subscribes again.
+ */
+static int agent_method_resync(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Agent *agent = userdata;
+        uint64_t session_id = 0;
+        uint64_t seq = 0;
+
+        int r = sd_bus_message_read(m, "tt", &session_id, &seq);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_INVALID_ARGS, "Invalid arguments for the resync: %s", strerror(-r));
+        }
+
+        _cleanup_freev_ char **units = NULL;
+        bool incremental = false;
+        if (session_id == agent->session_id) {
+                r = event_journal_get_units_since(agent->event_journal, seq, &units);
+                incremental = r >= 0;
+        }
+
+        if (incremental) {
+                bc_log_infof("Resyncing %zu changed units with the controller", strv_length(units));
+        } else {
+                bc_log_info("Resyncing all subscriptions with the controller");
+                agent_reset_subscriptions(agent);
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        r = sd_bus_message_new_method_return(m, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_append(
+                                reply,
+                                "btt",
+                                incremental,
+                                agent->session_id,
+                                event_journal_get_seq(agent->event_journal));
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(reply, units);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_send(reply);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Failed to reply to the resync: %s", strerror(-r));
+        }
+
+        /* The controller applies the state of the changed units after the reply */
+        for (size_t i = 0; units != NULL && units[i] != NULL; i++) {
+                _cleanup_free_ char *path = make_unit_path(units[i]);
+                AgentUnitInfo *info = path != NULL ? agent_get_unit_info(agent, path) : NULL;
+                if (info == NULL || !info->loaded || !agent_unit_is_subscribed(agent, info)) {
+                        continue;
+                }
+                agent_emit_unit_new(agent, info, "virtual");
+                if (info->active_state != _UNIT_ACTIVE_STATE_INVALID) {
+                        agent_emit_unit_state_changed(agent, info, "virtual");
+                }
+        }
+
+        return 1;
+}
+
 /*************************************************************************
  ********** org.eclipse.bluechi.internal.Agent.StartDep ****
  *************************************************************************/
@@ -1757,17 +2921,6 @@ static int job_cancel_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_
         return sd_bus_message_send(reply);
 }
 
-static JobTracker *agent_find_jobtracker_by_bluechi_id(Agent *agent, uint32_t bc_job_id) {
-        JobTracker *track = NULL;
-        LIST_FOREACH(tracked_jobs, track, agent->tracked_jobs) {
-                AgentJobOp *op = (AgentJobOp *) track->userdata;
-                if (op->bc_job_id == bc_job_id) {
-                        return track;
-                }
-        }
-        return NULL;
-}
-
 static int agent_method_job_cancel(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
         uint32_t bc_job_id = 0;
         int r = sd_bus_message_read(m, "u", &bc_job_id);
@@ -1778,7 +2931,7 @@ static int agent_method_job_cancel(sd_bus_message *m, void *userdata, UNUSED sd_
         }
 
         Agent *agent = (Agent *) userdata;
-        JobTracker *tracker = agent_find_jobtracker_by_bluechi_id(agent, bc_job_id);
+        JobTracker *tracker = tracked_jobs_find_by_id(agent->tracked_jobs, bc_job_id);
         if (tracker == NULL) {
                 return sd_bus_reply_method_errorf(
                                 m, SD_BUS_ERROR_FAILED, "No job with ID '%d' found", bc_job_id);
@@ -1804,6 +2957,11 @@ static int agent_method_job_cancel(sd_bus_message *m, void *userdata, UNUSED sd_
 static const sd_bus_vtable internal_agent_vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("ListUnits", "", UNIT_INFO_STRUCT_ARRAY_TYPESTRING, agent_method_list_units, 0),
+        SD_BUS_METHOD("ListUnitsFiltered",
+                      "asasasas",
+                      UNIT_INFO_STRUCT_ARRAY_TYPESTRING,
+                      agent_method_list_units_filtered,
+                      0),
         SD_BUS_METHOD("ListUnitFiles", "", UNIT_FILE_INFO_STRUCT_ARRAY_TYPESTRING, agent_method_list_unit_files, 0),
         SD_BUS_METHOD("GetUnitFileState", "s", "s", agent_method_passthrough_to_systemd, 0),
         SD_BUS_METHOD("GetUnitProperties", "ss", "a{sv}", agent_method_get_unit_properties, 0),
@@ -1816,8 +2974,13 @@ static const sd_bus_vtable internal_agent_vtable[] = {
         SD_BUS_METHOD("ThawUnit", "s", "", agent_method_thaw_unit, 0),
         SD_BUS_METHOD("RestartUnit", "ssu", "", agent_method_restart_unit, 0),
         SD_BUS_METHOD("ReloadUnit", "ssu", "", agent_method_reload_unit, 0),
+        SD_BUS_METHOD("StartUnits", "a(su)s", "as", agent_method_start_units, 0),
+        SD_BUS_METHOD("StopUnits", "a(su)s", "as", agent_method_stop_units, 0),
+        SD_BUS_METHOD("RestartUnits", "a(su)s", "as", agent_method_restart_units, 0),
         SD_BUS_METHOD("Subscribe", "s", "", agent_method_subscribe, 0),
         SD_BUS_METHOD("Unsubscribe", "s", "", agent_method_unsubscribe, 0),
+        SD_BUS_METHOD("SetPropertyFilter", "sas", "", agent_method_set_property_filter, 0),
+        SD_BUS_METHOD("Resync", "tt", "bttas", agent_method_resync, 0),
         SD_BUS_METHOD("EnableMetrics", "", "", agent_method_enable_metrics, 0),
         SD_BUS_METHOD("DisableMetrics", "", "", agent_method_disable_metrics, 0),
         SD_BUS_METHOD("SetLogLevel", "s", "", agent_method_set_log_level, 0),
@@ -2022,6 +3185,19 @@ static int agent_property_get_status(
         return sd_bus_message_append(reply, "s", agent_is_online(agent));
 }
 
+static int agent_property_get_collapsed_unit_state_changes(
+                UNUSED sd_bus *bus,
+                UNUSED const char *path,
+                UNUSED const char *interface,
+                UNUSED const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                UNUSED sd_bus_error *ret_error) {
+        Agent *agent = userdata;
+
+        return sd_bus_message_append(reply, "t", unit_state_windows_get_collapsed(agent->unit_state_windows));
+}
+
 /*************************************************************************
  **** org.eclipse.bluechi.Agent.LogLevel ****************
  *************************************************************************/
@@ -2089,54 +3265,39 @@ static const sd_bus_vtable agent_vtable[] = {
                         NULL,
                         offsetof(Agent, assembled_controller_address),
                         SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("CollapsedUnitStateChanges",
+                        "t",
+                        agent_property_get_collapsed_unit_state_changes,
+                        0,
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
+        SD_BUS_PROPERTY("UnitPropertyCacheHits",
+                        "t",
+                        NULL,
+                        offsetof(Agent, unit_property_cache_hits),
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
+        SD_BUS_PROPERTY("UnitPropertyCacheMisses",
+                        "t",
+                        NULL,
+                        offsetof(Agent, unit_property_cache_misses),
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
         SD_BUS_VTABLE_END
 };
 
 
-static void job_tracker_free(JobTracker *track) {
-        if (track->userdata && track->free_userdata) {
-                track->free_userdata(track->userdata);
-        }
-        free_and_null(track->job_object_path);
-        free(track);
-}
-
-DEFINE_CLEANUP_FUNC(JobTracker, job_tracker_free)
-#define _cleanup_job_tracker_ _cleanup_(job_tracker_freep)
-
-static bool
-                agent_track_job(Agent *agent,
-                                const char *job_object_path,
-                                job_tracker_callback callback,
-                                void *userdata,
-                                free_func_t free_userdata) {
-        _cleanup_job_tracker_ JobTracker *track = malloc0(sizeof(JobTracker));
-        if (track == NULL) {
-                return false;
-        }
-
-        track->job_object_path = strdup(job_object_path);
-        if (track->job_object_path == NULL) {
+static bool agent_track_job(Agent *agent, const char *job_object_path, AgentJobOp *op) {
+        int r = tracked_jobs_add(
+                        agent->tracked_jobs,
+                        job_object_path,
+                        op->bc_job_id,
+                        agent_job_done,
+                        agent_job_op_ref(op),
+                        (free_func_t) agent_job_op_unref);
+        if (r < 0) {
+                bc_log_errorf("Failed to track job '%s': %s", job_object_path, strerror(-r));
                 return false;
         }
-
-// Disabling -Wanalyzer-malloc-leak temporarily due to false-positive
-//      Leak detected is based on steal_pointer setting track=NULL and, subsequently,
-//      not freeing allocated job_object_path. This is desired since the actual instance
-//      is added to and managed by the tracked_jobs list of the agent.
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-
-        track->callback = callback;
-        track->userdata = userdata;
-        track->free_userdata = free_userdata;
-        LIST_INIT(tracked_jobs, track);
-
-        LIST_PREPEND(tracked_jobs, agent->tracked_jobs, steal_pointer(&track));
-
         return true;
 }
-#pragma GCC diagnostic pop
 
 
 static int agent_match_job_changed(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
@@ -2144,8 +3305,6 @@ static int agent_match_job_changed(sd_bus_message *m, void *userdata, UNUSED sd_
         const char *interface = NULL;
         const char *state = NULL;
         const char *object_path = sd_bus_message_get_path(m);
-        JobTracker *track = NULL;
-        AgentJobOp *op = NULL;
 
         int r = sd_bus_message_read(m, "s", &interface);
         if (r < 0) {
@@ -2159,14 +3318,8 @@ static int agent_match_job_changed(sd_bus_message *m, void *userdata, UNUSED sd_
         }
 
         /* Look for tracked jobs */
-        LIST_FOREACH(tracked_jobs, track, agent->tracked_jobs) {
-                if (streq(track->job_object_path, object_path)) {
-                        op = track->userdata;
-                        break;
-                }
-        }
-
-        if (op == NULL) {
+        JobTracker *track = tracked_jobs_find_by_path(agent->tracked_jobs, object_path);
+        if (track == NULL) {
                 return 0;
         }
 
@@ -2179,21 +3332,106 @@ static int agent_match_job_changed(sd_bus_message *m, void *userdata, UNUSED sd_
                 return r;
         }
 
-        r = sd_bus_emit_signal(
-                        agent->peer_dbus,
-                        INTERNAL_AGENT_OBJECT_PATH,
-                        INTERNAL_AGENT_INTERFACE,
-                        "JobStateChanged",
-                        "us",
-                        op->bc_job_id,
-                        state);
-        if (r < 0) {
-                bc_log_errorf("Failed to emit JobStateChanged: %s", strerror(-r));
+        for (; track != NULL; track = track->merged) {
+                AgentJobOp *op = track->userdata;
+                agent_flush_unit_state_window_by_name(agent, op->unit);
+                r = agent_emit_event(agent, "JobStateChanged", "us", op->bc_job_id, state);
+                if (r < 0) {
+                        bc_log_errorf("Failed to emit JobStateChanged: %s", strerror(-r));
+                }
         }
 
         return 0;
 }
 
+/* Checks if the a{sv} in m has an entry whose key is in properties, leaves m within the array */
+static int agent_has_filtered_properties(sd_bus_message *m, char **properties) {
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+        if (r < 0) {
+                return r;
+        }
+
+        while ((r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+                const char *property = NULL;
+                r = sd_bus_message_read(m, "s", &property);
+                if (r < 0) {
+                        return r;
+                }
+                if (strv_contains(properties, property)) {
+                        return 1;
+                }
+
+                r = sd_bus_message_skip(m, "v");
+                if (r >= 0) {
+                        r = sd_bus_message_exit_container(m);
+                }
+                if (r < 0) {
+                        return r;
+                }
+        }
+        return r;
+}
+
+/* Copies the entries of the a{sv} in m whose key is in properties, returns the number of copied entries */
+static int agent_copy_filtered_properties(sd_bus_message *sig, sd_bus_message *m, char **properties) {
+        int n_copied = 0;
+
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+        if (r < 0) {
+                return r;
+        }
+        r = sd_bus_message_open_container(sig, SD_BUS_TYPE_ARRAY, "{sv}");
+        if (r < 0) {
+                return r;
+        }
+
+        while ((r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+                const char *property = NULL;
+                r = sd_bus_message_read(m, "s", &property);
+                if (r < 0) {
+                        return r;
+                }
+
+                if (strv_contains(properties, property)) {
+                        r = sd_bus_message_open_container(sig, SD_BUS_TYPE_DICT_ENTRY, "sv");
+                        if (r >= 0) {
+                                r = sd_bus_message_append(sig, "s", property);
+                        }
+                        if (r >= 0) {
+                                r = sd_bus_message_copy(sig, m, false);
+                        }
+                        if (r >= 0) {
+                                r = sd_bus_message_close_container(sig);
+                        }
+                        n_copied++;
+                } else {
+                        r = sd_bus_message_skip(m, "v");
+                }
+                if (r < 0) {
+                        return r;
+                }
+
+                r = sd_bus_message_exit_container(m);
+                if (r < 0) {
+                        return r;
+                }
+        }
+        if (r < 0) {
+                return r;
+        }
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0) {
+                return r;
+        }
+        r = sd_bus_message_close_container(sig);
+        if (r < 0) {
+                return r;
+        }
+
+        return n_copied;
+}
+
 static int agent_match_unit_changed(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
         Agent *agent = userdata;
         const char *interface = NULL;
@@ -2203,6 +3441,8 @@ static int agent_match_unit_changed(sd_bus_message *m, void *userdata, UNUSED sd
                 return r;
         }
 
+        property_cache_invalidate(agent->unit_property_cache, sd_bus_message_get_path(m));
+
         AgentUnitInfo *info = agent_get_unit_info(agent, sd_bus_message_get_path(m));
         if (info == NULL) {
                 return 0;
@@ -2210,12 +3450,12 @@ static int agent_match_unit_changed(sd_bus_message *m, void *userdata, UNUSED sd
 
         if (streq(interface, "org.freedesktop.systemd1.Unit")) {
                 bool state_changed = unit_info_update_state(info, m);
-                if (state_changed && (info->subscribed || agent->wildcard_subscription_active)) {
-                        agent_emit_unit_state_changed(agent, info, "real");
+                if (state_changed && agent_unit_is_subscribed(agent, info)) {
+                        agent_queue_unit_state_changed(agent, info);
                 }
         }
 
-        if (!info->subscribed && !agent->wildcard_subscription_active) {
+        if (!agent_unit_is_subscribed(agent, info)) {
                 return 0;
         }
 
@@ -2223,16 +3463,25 @@ static int agent_match_unit_changed(sd_bus_message *m, void *userdata, UNUSED sd
         (void) sd_bus_message_rewind(m, true);
         (void) sd_bus_message_skip(m, "s"); // re-skip interface
 
+        char **properties = agent_unit_get_properties(agent, info);
+        if (properties != NULL) {
+                /* Nothing left to forward if no requested property changed */
+                r = agent_has_filtered_properties(m, properties);
+                if (r <= 0) {
+                        return r;
+                }
+                (void) sd_bus_message_rewind(m, true);
+                (void) sd_bus_message_skip(m, "s");
+        }
+
+        /* A held back state change must not arrive after the properties that followed it */
+        agent_flush_unit_state_window(agent, info);
+
         bc_log_debugf("Sending UnitPropertiesChanged %s", info->unit);
 
         /* Forward the property changes */
         _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
-        r = sd_bus_message_new_signal(
-                        agent->peer_dbus,
-                        &sig,
-                        INTERNAL_AGENT_OBJECT_PATH,
-                        INTERNAL_AGENT_INTERFACE,
-                        "UnitPropertiesChanged");
+        r = agent_event_open(agent, "UnitPropertiesChanged", "ssa{sv}", &sig);
         if (r < 0) {
                 return r;
         }
@@ -2247,12 +3496,16 @@ static int agent_match_unit_changed(sd_bus_message *m, void *userdata, UNUSED sd
                 return r;
         }
 
-        r = sd_bus_message_copy(sig, m, false);
+        if (properties == NULL) {
+                r = sd_bus_message_copy(sig, m, false);
+        } else {
+                r = agent_copy_filtered_properties(sig, m, properties);
+        }
         if (r < 0) {
                 return r;
         }
 
-        return sd_bus_send(agent->peer_dbus, sig, NULL);
+        return agent_event_close(agent, sig);
 }
 
 static int agent_match_unit_new(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
@@ -2283,12 +3536,9 @@ static int agent_match_unit_new(sd_bus_message *m, void *userdata, UNUSED sd_bus
          * changes to "dead".
          */
         info->active_state = UNIT_INACTIVE;
-        if (info->substate != NULL) {
-                free_and_null(info->substate);
-        }
-        info->substate = strdup("dead");
+        info->substate = sub_state_intern("dead");
 
-        if (info->subscribed || agent->wildcard_subscription_active) {
+        if (agent_unit_is_subscribed(agent, info)) {
                 /* Forward the event */
                 agent_emit_unit_new(agent, info, "real");
         }
@@ -2308,16 +3558,21 @@ static int agent_match_unit_removed(sd_bus_message *m, void *userdata, UNUSED sd
                 return r;
         }
 
+        property_cache_invalidate(agent->unit_property_cache, path);
+
         AgentUnitInfo *info = agent_get_unit_info(agent, path);
         if (info == NULL) {
                 return 0;
         }
 
+        /* Report the final state before the unit goes away */
+        agent_flush_unit_state_window(agent, info);
+
         info->loaded = false;
         info->active_state = _UNIT_ACTIVE_STATE_INVALID;
-        free_and_null(info->substate);
+        info->substate = NULL;
 
-        if (info->subscribed || agent->wildcard_subscription_active) {
+        if (agent_unit_is_subscribed(agent, info)) {
                 /* Forward the event */
                 agent_emit_unit_removed(agent, info);
         }
@@ -2334,7 +3589,6 @@ static int agent_match_job_removed(sd_bus_message *m, void *userdata, UNUSED sd_
         const char *job_path = NULL;
         const char *unit = NULL;
         const char *result = NULL;
-        JobTracker *track = NULL, *next_track = NULL;
         uint32_t id = 0;
         int r = 0;
 
@@ -2346,38 +3600,36 @@ static int agent_match_job_removed(sd_bus_message *m, void *userdata, UNUSED sd_
 
         (void) sd_bus_message_rewind(m, true);
 
-        LIST_FOREACH_SAFE(tracked_jobs, track, next_track, agent->tracked_jobs) {
-                if (streq(track->job_object_path, job_path)) {
-                        LIST_REMOVE(tracked_jobs, agent->tracked_jobs, track);
-                        track->callback(m, result, track->userdata);
-                        job_tracker_free(track);
-                        break;
-                }
+        _cleanup_job_tracker_ JobTracker *track = tracked_jobs_remove(agent->tracked_jobs, job_path);
+        for (JobTracker *t = track; t != NULL; t = t->merged) {
+                t->callback(m, result, t->userdata);
         }
 
         return 0;
 }
 
-static int agent_match_heartbeat(UNUSED sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
+/* Any message from the controller proves that it is alive, not only its heartbeats */
+static int agent_on_controller_message(UNUSED sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
         Agent *agent = userdata;
         uint64_t now = 0;
         uint64_t now_monotonic = 0;
 
-        now = get_time_micros();
-        if (now == USEC_INFINITY) {
-                bc_log_error("Failed to get current time on heartbeat");
+        /* The time of the current event loop iteration is good enough and saves a syscall per message */
+        int r = sd_event_now(agent->event, CLOCK_REALTIME, &now);
+        if (r < 0) {
+                bc_log_errorf("Failed to get current time on controller message: %s", strerror(-r));
                 return 0;
         }
 
-        now_monotonic = get_time_micros_monotonic();
-        if (now_monotonic == USEC_INFINITY) {
-                bc_log_error("Failed to get current monotonic time on heartbeat");
+        r = sd_event_now(agent->event, CLOCK_MONOTONIC, &now_monotonic);
+        if (r < 0) {
+                bc_log_errorf("Failed to get current monotonic time on controller message: %s", strerror(-r));
                 return 0;
         }
 
         agent->controller_last_seen = now;
         agent->controller_last_seen_monotonic = now_monotonic;
-        return 1;
+        return 0;
 }
 
 static int debug_systemd_message_handler(
@@ -2439,10 +3691,7 @@ int agent_init_units(Agent *agent, sd_bus_message *m) {
                         assert(streq(info->object_path, object_path));
                         info->loaded = true;
                         info->active_state = active_state_from_string(active_state);
-                        if (info->substate != NULL) {
-                                free_and_null(info->substate);
-                        }
-                        info->substate = strdup(sub_state);
+                        info->substate = sub_state_intern(sub_state);
                 }
 
                 r = sd_bus_message_exit_container(m);
@@ -2749,11 +3998,20 @@ static bool agent_process_register_callback(sd_bus_message *m, Agent *agent) {
         }
 
         bc_log_info("Register call response received");
-        r = sd_bus_message_read(m, "");
+
+        /* Controllers not offering any features reply without arguments */
+        _cleanup_freev_ char **features = NULL;
+        if (sd_bus_message_has_signature(m, "as")) {
+                r = sd_bus_message_read_strv(m, &features);
+        } else {
+                r = sd_bus_message_read(m, "");
+        }
         if (r < 0) {
                 bc_log_errorf("Failed to parse response message: %s", strerror(-r));
                 return false;
         }
+        agent->event_batch_enabled = strv_contains(features, PEER_FEATURE_EVENT_BATCH);
+        agent->resync_enabled = agent->event_batch_enabled && strv_contains(features, PEER_FEATURE_RESYNC);
 
         /* Restore is_quiet setting if it has been disabled during reconnecting */
         bc_log_set_quiet(cfg_get_bool_value(agent->config, CFG_LOG_IS_QUIET));
@@ -2773,17 +4031,10 @@ static bool agent_process_register_callback(sd_bus_message *m, Agent *agent) {
                 bc_log_errorf("Failed to emit status property changed: %s", strerror(-r));
         }
 
-        r = sd_bus_match_signal(
-                        agent->peer_dbus,
-                        NULL,
-                        NULL,
-                        INTERNAL_CONTROLLER_OBJECT_PATH,
-                        INTERNAL_CONTROLLER_INTERFACE,
-                        CONTROLLER_HEARTBEAT_SIGNAL_NAME,
-                        agent_match_heartbeat,
-                        agent);
+        /* Heartbeats of the controller are covered as well */
+        r = sd_bus_add_filter(agent->peer_dbus, NULL, agent_on_controller_message, agent);
         if (r < 0) {
-                bc_log_errorf("Failed to add heartbeat signal match: %s", strerror(-r));
+                bc_log_errorf("Failed to add controller message filter: %s", strerror(-r));
                 return false;
         }
 
@@ -2911,6 +4162,13 @@ static void agent_peer_bus_close(Agent *agent) {
                 sd_bus_slot_unref(agent->register_call_slot);
                 agent->register_call_slot = NULL;
         }
+
+        /* Events are synthesized again when the controller subscribes after reconnecting */
+        sd_bus_message_unrefp(&agent->event_batch);
+        agent->event_batch = NULL;
+        agent->event_batch_size = 0;
+        agent->event_batch_enabled = false;
+        agent->resync_enabled = false;
         peer_bus_close(agent->peer_dbus);
         agent->peer_dbus = NULL;
 }
@@ -15,7 +15,14 @@
 #include "libbluechi/common/common.h"
 #include "libbluechi/socket.h"
 
+#include "event_journal.h"
+#include "job_tracker.h"
+#include "property_cache.h"
 #include "types.h"
+#include "unit_state_window.h"
+
+/* Number of unit events a reconnecting agent can replay instead of a full resync */
+#define AGENT_EVENT_JOURNAL_SIZE 4096
 
 typedef struct Agent Agent;
 typedef struct SystemdRequest SystemdRequest;
@@ -42,8 +49,7 @@ void systemd_request_unref(SystemdRequest *req);
 DEFINE_CLEANUP_FUNC(SystemdRequest, systemd_request_unref)
 #define _cleanup_systemd_request_ _cleanup_(systemd_request_unrefp)
 
-typedef void (*job_tracker_callback)(sd_bus_message *m, const char *result, void *userdata);
-typedef struct JobTracker JobTracker;
+typedef struct UnitPattern UnitPattern;
 
 typedef enum {
         AGENT_CONNECTION_STATE_DISCONNECTED,
@@ -66,11 +72,14 @@ struct Agent {
 
         long heartbeat_interval_msec;
         long controller_heartbeat_threshold_msec;
+        long unit_state_coalesce_window_msec;
+        long unit_property_cache_ttl_msec;
 
         AgentConnectionState connection_state;
         uint64_t connection_retry_count;
         uint64_t controller_last_seen;
         uint64_t controller_last_seen_monotonic;
+        uint64_t controller_last_sent_monotonic; /* Time of the last event or heartbeat sent to the controller */
         uint64_t disconnect_timestamp;
         uint64_t disconnect_timestamp_monotonic;
         uint64_t connection_retry_count_until_quiet;
@@ -89,11 +98,36 @@ struct Agent {
         sd_bus_slot *metrics_slot;
 
         LIST_HEAD(SystemdRequest, outstanding_requests);
-        LIST_HEAD(JobTracker, tracked_jobs);
+        TrackedJobs *tracked_jobs;
         LIST_HEAD(ProxyService, proxy_services);
 
+        bool event_batch_enabled;    /* Offered by the controller in the Register reply */
+        sd_bus_message *event_batch; /* Pending EventBatch signal, NULL if no event is queued */
+        size_t event_batch_size;
+        sd_event_source *event_batch_source;
+
+        /* Unit events sent to the controller, see agent_method_resync() */
+        bool resync_enabled; /* Offered by the controller in the Register reply */
+        uint64_t session_id; /* Random, a restarted agent starts a new journal */
+        EventJournal *event_journal;
+
         struct hashmap *unit_infos;
         bool wildcard_subscription_active;
+        char **wildcard_properties; /* Forwarded properties of units only covered by the wildcard, NULL for all */
+
+        /* Subscriptions to all units matching a glob, except for the wildcard */
+        LIST_HEAD(UnitPattern, unit_patterns);
+        uint64_t unit_patterns_generation; /* Bumped on any change of the patterns or their filters */
+
+        /* Open coalescing windows of UnitStateChanged, only used if the window is positive */
+        UnitStateWindows *unit_state_windows;
+        sd_event_source *unit_state_window_source;
+
+        /* Recent replies of systemd to GetUnitProperty(ies), only used if the TTL is positive */
+        PropertyCache *unit_property_cache;
+        sd_event_source *unit_property_cache_sweep_source;
+        uint64_t unit_property_cache_hits;
+        uint64_t unit_property_cache_misses;
 
         struct config *config;
 };
@@ -104,7 +138,14 @@ typedef struct AgentUnitInfo {
         bool subscribed;
         bool loaded;
         UnitActiveState active_state;
-        char *substate;
+        const char *substate; /* Interned, see sub_state_intern() */
+        char **properties; /* Forwarded in UnitPropertiesChanged, NULL for all */
+
+        /* Result of matching the unit against the unit patterns, only valid while
+         * pattern_generation equals the unit_patterns_generation of the agent */
+        uint64_t pattern_generation;
+        bool pattern_matched;
+        char **pattern_properties; /* Union of the filters of the matching patterns, NULL for all */
 } AgentUnitInfo;
 
 
@@ -117,6 +158,8 @@ bool agent_set_host(Agent *agent, const char *host);
 bool agent_set_assembled_controller_address(Agent *agent, const char *address);
 bool agent_set_name(Agent *agent, const char *name);
 bool agent_set_heartbeat_interval(Agent *agent, const char *interval_msec);
+bool agent_set_unit_state_coalesce_window(Agent *agent, const char *window_msec);
+bool agent_set_unit_property_cache_ttl(Agent *agent, const char *ttl_msec);
 void agent_set_systemd_user(Agent *agent, bool systemd_user);
 bool agent_parse_config(Agent *agent, const char *configfile);
 bool agent_apply_config(Agent *agent);
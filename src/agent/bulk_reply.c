@@ -0,0 +1,174 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+
+#include "libbluechi/common/event-util.h"
+#include "libbluechi/log/log.h"
+
+#include "bulk_reply.h"
+
+typedef struct BulkReply {
+        sd_bus_message *request_message;
+        sd_bus_message *m; /* Positioned in the array that is copied */
+        sd_bus_message *reply;
+        sd_event_source *slice_source;
+
+        bulk_reply_copy_func copy;
+        void *userdata;
+        free_func_t free_userdata;
+} BulkReply;
+
+static void bulk_reply_free(BulkReply *bulk) {
+        if (bulk == NULL) {
+                return;
+        }
+
+        if (bulk->slice_source != NULL) {
+                sd_event_source_set_enabled(bulk->slice_source, SD_EVENT_OFF);
+                sd_event_source_unrefp(&bulk->slice_source);
+        }
+        if (bulk->userdata && bulk->free_userdata) {
+                bulk->free_userdata(bulk->userdata);
+        }
+        sd_bus_message_unrefp(&bulk->request_message);
+        sd_bus_message_unrefp(&bulk->m);
+        sd_bus_message_unrefp(&bulk->reply);
+        free(bulk);
+}
+
+DEFINE_CLEANUP_FUNC(BulkReply, bulk_reply_free)
+#define _cleanup_bulk_reply_ _cleanup_(bulk_reply_freep)
+
+static int bulk_reply_copy_element(sd_bus_message *reply, sd_bus_message *m, UNUSED void *userdata) {
+        int r = sd_bus_message_at_end(m, false);
+        if (r != 0) {
+                return r < 0 ? r : 0;
+        }
+
+        r = sd_bus_message_copy(reply, m, false);
+        if (r < 0) {
+                return r;
+        }
+        return 1;
+}
+
+/* Returns > 0 if the whole array has been copied, 0 if elements are left */
+static int bulk_reply_copy_slice(BulkReply *bulk) {
+        for (size_t i = 0; i < BULK_REPLY_SLICE_SIZE; i++) {
+                int r = bulk->copy(bulk->reply, bulk->m, bulk->userdata);
+                if (r < 0) {
+                        return r;
+                }
+                if (r == 0) {
+                        r = sd_bus_message_close_container(bulk->reply);
+                        if (r < 0) {
+                                return r;
+                        }
+                        r = sd_bus_message_exit_container(bulk->m);
+                        return r < 0 ? r : 1;
+                }
+        }
+        return 0;
+}
+
+static int bulk_reply_finish(BulkReply *bulk, int r) {
+        if (r < 0) {
+                bc_log_errorf("Failed to copy %s reply: %s",
+                              sd_bus_message_get_member(bulk->request_message),
+                              strerror(-r));
+                return sd_bus_reply_method_errorf(
+                                bulk->request_message, SD_BUS_ERROR_FAILED, "Failed to copy reply: %s", strerror(-r));
+        }
+        return sd_bus_message_send(bulk->reply);
+}
+
+static int bulk_reply_schedule_slice(BulkReply *bulk, sd_event *event);
+
+static int bulk_reply_slice_callback(UNUSED sd_event_source *event_source, UNUSED uint64_t usec, void *userdata) {
+        BulkReply *bulk = userdata;
+
+        int r = bulk_reply_copy_slice(bulk);
+        if (r == 0) {
+                r = bulk_reply_schedule_slice(bulk, sd_event_source_get_event(bulk->slice_source));
+                if (r >= 0) {
+                        return 0;
+                }
+        }
+
+        r = bulk_reply_finish(bulk, r);
+        if (r < 0) {
+                bc_log_errorf("Failed to send reply: %s", strerror(-r));
+        }
+        bulk_reply_free(bulk);
+        return 0;
+}
+
+/*
+ * Each slice is scheduled from a timer that is due right away. Unlike a defer source, it becomes
+ * pending anew every time, so the slices take turns with the bus traffic of the same priority
+ * instead of starving it, or being starved by a steady stream of unit events.
+ */
+static int bulk_reply_schedule_slice(BulkReply *bulk, sd_event *event) {
+        return event_reset_time_relative(
+                        event,
+                        &bulk->slice_source,
+                        CLOCK_MONOTONIC,
+                        0,
+                        0,
+                        bulk_reply_slice_callback,
+                        bulk,
+                        SD_EVENT_PRIORITY_NORMAL,
+                        "bulk-reply-source",
+                        true);
+}
+
+int bulk_reply_send(
+                sd_event *event,
+                sd_bus_message *request_message,
+                sd_bus_message *m,
+                const char *contents,
+                bulk_reply_copy_func copy,
+                void *userdata,
+                free_func_t free_userdata) {
+        _cleanup_bulk_reply_ BulkReply *bulk = malloc0(sizeof(BulkReply));
+        if (bulk == NULL) {
+                if (userdata && free_userdata) {
+                        free_userdata(userdata);
+                }
+                return -ENOMEM;
+        }
+
+        bulk->request_message = sd_bus_message_ref(request_message);
+        bulk->m = sd_bus_message_ref(m);
+        bulk->copy = copy != NULL ? copy : bulk_reply_copy_element;
+        bulk->userdata = userdata;
+        bulk->free_userdata = free_userdata;
+
+        int r = sd_bus_message_new_method_return(request_message, &bulk->reply);
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, contents);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_open_container(bulk->reply, SD_BUS_TYPE_ARRAY, contents);
+        }
+        if (r < 0) {
+                return bulk_reply_finish(bulk, r);
+        }
+
+        /* Most replies fit into the first slice and are sent right away */
+        r = bulk_reply_copy_slice(bulk);
+        if (r != 0) {
+                return bulk_reply_finish(bulk, r);
+        }
+
+        r = bulk_reply_schedule_slice(bulk, event);
+        if (r < 0) {
+                return bulk_reply_finish(bulk, r);
+        }
+
+        steal_pointer(&bulk);
+        return 0;
+}
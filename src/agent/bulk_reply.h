@@ -0,0 +1,37 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#include "libbluechi/common/common.h"
+
+/* Number of array elements copied before yielding to the event loop */
+#define BULK_REPLY_SLICE_SIZE 256
+
+/*
+ * Copies the next element of the array m is positioned in to reply. Returns > 0 if an
+ * element was consumed, which may be dropped instead of copied, 0 at the end of the array.
+ */
+typedef int (*bulk_reply_copy_func)(sd_bus_message *reply, sd_bus_message *m, void *userdata);
+
+/*
+ * Replies to request_message with the array of type contents in m, e.g. the reply of
+ * ListUnits from systemd. Large arrays are copied in slices of BULK_REPLY_SLICE_SIZE
+ * elements that take turns with the bus traffic, so that a huge reply neither holds
+ * up heartbeats and unit events nor is held up by them. Without a copy function each element is copied as is.
+ * The userdata is owned by the bulk reply from then on and freed with free_userdata
+ * once the reply is sent or failed.
+ */
+int bulk_reply_send(
+                sd_event *event,
+                sd_bus_message *request_message,
+                sd_bus_message *m,
+                const char *contents,
+                bulk_reply_copy_func copy,
+                void *userdata,
+                free_func_t free_userdata);
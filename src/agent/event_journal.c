@@ -0,0 +1,93 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "event_journal.h"
+
+/* Ring buffer, the unit of event seq is stored at seq % size */
+struct EventJournal {
+        uint64_t seq;
+        size_t size;
+        char *units[0];
+};
+
+EventJournal *event_journal_new(size_t size) {
+        if (size == 0) {
+                return NULL;
+        }
+
+        EventJournal *journal = malloc0_array(sizeof(EventJournal), sizeof(char *), size);
+        if (journal == NULL) {
+                return NULL;
+        }
+        journal->size = size;
+
+        return journal;
+}
+
+void event_journal_free(EventJournal *journal) {
+        for (size_t i = 0; i < journal->size; i++) {
+                free(journal->units[i]);
+        }
+        free(journal);
+}
+
+uint64_t event_journal_add(EventJournal *journal, const char *unit) {
+        journal->seq++;
+
+        /* Without a copy the event is lost, which forces a full resync */
+        char **slot = &journal->units[journal->seq % journal->size];
+        free(*slot);
+        *slot = strdup(unit);
+
+        return journal->seq;
+}
+
+uint64_t event_journal_get_seq(EventJournal *journal) {
+        return journal->seq;
+}
+
+int event_journal_get_units_since(EventJournal *journal, uint64_t seq, char ***ret_units) {
+        if (seq > journal->seq || journal->seq - seq > journal->size) {
+                return -ERANGE;
+        }
+
+        size_t n_events = journal->seq - seq;
+        _cleanup_freev_ char **units = malloc0_array(0, sizeof(char *), n_events + 1);
+        if (units == NULL) {
+                return -ENOMEM;
+        }
+
+        for (size_t i = 0; i < n_events; i++) {
+                const char *unit = journal->units[(seq + 1 + i) % journal->size];
+                if (unit == NULL) {
+                        return -ERANGE;
+                }
+                units[i] = strdup(unit);
+                if (units[i] == NULL) {
+                        return -ENOMEM;
+                }
+        }
+
+        strv_sort(units);
+
+        /* Drop the duplicates, which are adjacent after sorting */
+        size_t n_units = 0;
+        for (size_t i = 0; i < n_events; i++) {
+                if (n_units > 0 && streq(units[n_units - 1], units[i])) {
+                        free(units[i]);
+                } else {
+                        units[n_units++] = units[i];
+                }
+                if (i >= n_units) {
+                        units[i] = NULL;
+                }
+        }
+
+        *ret_units = steal_pointer(&units);
+        return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include "libbluechi/common/common.h"
+
+/*
+ * The units of the most recent unit events sent to the controller, numbered
+ * by a sequence number starting at 1. When the agent reconnects, the
+ * controller names the last sequence number it received. The agent then only
+ * reports the units that changed since, unless more than size events
+ * happened in between and the journal no longer knows all of them.
+ */
+typedef struct EventJournal EventJournal;
+
+EventJournal *event_journal_new(size_t size);
+void event_journal_free(EventJournal *journal);
+
+/* Returns the sequence number of the event */
+uint64_t event_journal_add(EventJournal *journal, const char *unit);
+
+/* Sequence number of the last event, 0 if there was none */
+uint64_t event_journal_get_seq(EventJournal *journal);
+
+/*
+ * Returns the sorted units of the events after seq, each only once. Fails with
+ * -ERANGE if some of these events are no longer in the journal.
+ */
+int event_journal_get_units_since(EventJournal *journal, uint64_t seq, char ***ret_units);
+
+DEFINE_CLEANUP_FUNC(EventJournal, event_journal_free)
+#define _cleanup_event_journal_ _cleanup_(event_journal_freep)
@@ -0,0 +1,185 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <hashmap.h>
+#include <string.h>
+
+#include "job_tracker.h"
+
+/* Both maps store pointers to the trackers, which are owned by by_path */
+struct TrackedJobs {
+        struct hashmap *by_path;
+        struct hashmap *by_id;
+};
+
+void job_tracker_free(JobTracker *track) {
+        while (track != NULL) {
+                JobTracker *merged = track->merged;
+                if (track->userdata && track->free_userdata) {
+                        track->free_userdata(track->userdata);
+                }
+                free_and_null(track->job_object_path);
+                free(track);
+                track = merged;
+        }
+}
+
+static void job_tracker_clear(void *item) {
+        job_tracker_free(*(JobTracker **) item);
+}
+
+static uint64_t job_tracker_path_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const JobTracker *track = *(JobTracker * const *) item;
+        return hashmap_sip(track->job_object_path, strlen(track->job_object_path), seed0, seed1);
+}
+
+static int job_tracker_path_compare(const void *a, const void *b, UNUSED void *udata) {
+        const JobTracker *track_a = *(JobTracker * const *) a;
+        const JobTracker *track_b = *(JobTracker * const *) b;
+
+        return strcmp(track_a->job_object_path, track_b->job_object_path);
+}
+
+static uint64_t job_tracker_id_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const JobTracker *track = *(JobTracker * const *) item;
+        return hashmap_sip(&track->bc_job_id, sizeof(track->bc_job_id), seed0, seed1);
+}
+
+static int job_tracker_id_compare(const void *a, const void *b, UNUSED void *udata) {
+        const JobTracker *track_a = *(JobTracker * const *) a;
+        const JobTracker *track_b = *(JobTracker * const *) b;
+
+        if (track_a->bc_job_id == track_b->bc_job_id) {
+                return 0;
+        }
+        return track_a->bc_job_id < track_b->bc_job_id ? -1 : 1;
+}
+
+TrackedJobs *tracked_jobs_new(void) {
+        _cleanup_tracked_jobs_ TrackedJobs *jobs = malloc0(sizeof(TrackedJobs));
+        if (jobs == NULL) {
+                return NULL;
+        }
+
+        jobs->by_path = hashmap_new(
+                        sizeof(JobTracker *),
+                        0,
+                        0,
+                        0,
+                        job_tracker_path_hash,
+                        job_tracker_path_compare,
+                        job_tracker_clear,
+                        NULL);
+        if (jobs->by_path == NULL) {
+                return NULL;
+        }
+
+        jobs->by_id = hashmap_new(
+                        sizeof(JobTracker *), 0, 0, 0, job_tracker_id_hash, job_tracker_id_compare, NULL, NULL);
+        if (jobs->by_id == NULL) {
+                return NULL;
+        }
+
+        return steal_pointer(&jobs);
+}
+
+void tracked_jobs_free(TrackedJobs *jobs) {
+        if (jobs == NULL) {
+                return;
+        }
+        if (jobs->by_id != NULL) {
+                hashmap_free(jobs->by_id);
+        }
+        if (jobs->by_path != NULL) {
+                hashmap_free(jobs->by_path);
+        }
+        free(jobs);
+}
+
+int tracked_jobs_add(
+                TrackedJobs *jobs,
+                const char *job_object_path,
+                uint32_t bc_job_id,
+                job_tracker_callback callback,
+                void *userdata,
+                free_func_t free_userdata) {
+        _cleanup_job_tracker_ JobTracker *track = malloc0(sizeof(JobTracker));
+        if (track == NULL) {
+                if (userdata && free_userdata) {
+                        free_userdata(userdata);
+                }
+                return -ENOMEM;
+        }
+        track->bc_job_id = bc_job_id;
+        track->callback = callback;
+        track->userdata = userdata;
+        track->free_userdata = free_userdata;
+
+        track->job_object_path = strdup(job_object_path);
+        if (track->job_object_path == NULL) {
+                return -ENOMEM;
+        }
+
+        /* systemd returns the path of a pending job of the unit if it merged the new request into it */
+        JobTracker *item = track;
+        track->merged = tracked_jobs_find_by_path(jobs, job_object_path);
+
+        hashmap_set(jobs->by_id, &item);
+        if (hashmap_oom(jobs->by_id)) {
+                track->merged = NULL;
+                return -ENOMEM;
+        }
+        hashmap_set(jobs->by_path, &item);
+        if (hashmap_oom(jobs->by_path)) {
+                hashmap_delete(jobs->by_id, &item);
+                track->merged = NULL;
+                return -ENOMEM;
+        }
+
+        /* Now owned by by_path */
+        track = NULL;
+        return 0;
+}
+
+JobTracker *tracked_jobs_find_by_path(TrackedJobs *jobs, const char *job_object_path) {
+        JobTracker key = { .job_object_path = (char *) job_object_path };
+        JobTracker *key_item = &key;
+
+        JobTracker **item = (JobTracker **) hashmap_get(jobs->by_path, &key_item);
+        return item != NULL ? *item : NULL;
+}
+
+JobTracker *tracked_jobs_find_by_id(TrackedJobs *jobs, uint32_t bc_job_id) {
+        JobTracker key = { .bc_job_id = bc_job_id };
+        JobTracker *key_item = &key;
+
+        JobTracker **item = (JobTracker **) hashmap_get(jobs->by_id, &key_item);
+        return item != NULL ? *item : NULL;
+}
+
+JobTracker *tracked_jobs_remove(TrackedJobs *jobs, const char *job_object_path) {
+        JobTracker key = { .job_object_path = (char *) job_object_path };
+        JobTracker *key_item = &key;
+
+        JobTracker **item = (JobTracker **) hashmap_delete(jobs->by_path, &key_item);
+        if (item == NULL) {
+                return NULL;
+        }
+        JobTracker *track = *item;
+
+        /* Only drop the ids that were not taken over by a newer job */
+        for (JobTracker *t = track; t != NULL; t = t->merged) {
+                if (tracked_jobs_find_by_id(jobs, t->bc_job_id) == t) {
+                        hashmap_delete(jobs->by_id, &t);
+                }
+        }
+
+        return track;
+}
+
+size_t tracked_jobs_size(TrackedJobs *jobs) {
+        return hashmap_count(jobs->by_path);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <systemd/sd-bus.h>
+
+#include "libbluechi/common/common.h"
+
+typedef void (*job_tracker_callback)(sd_bus_message *m, const char *result, void *userdata);
+
+typedef struct JobTracker {
+        char *job_object_path; /* systemd job */
+        uint32_t bc_job_id;    /* BlueChi job */
+        job_tracker_callback callback;
+        void *userdata;
+        free_func_t free_userdata;
+
+        /* Older BlueChi jobs that systemd merged into the same job */
+        struct JobTracker *merged;
+} JobTracker;
+
+void job_tracker_free(JobTracker *track);
+
+DEFINE_CLEANUP_FUNC(JobTracker, job_tracker_free)
+#define _cleanup_job_tracker_ _cleanup_(job_tracker_freep)
+
+/*
+ * The systemd jobs the agent waits for, indexed both by the object path of
+ * the systemd job, which is used by the JobRemoved signal and the property
+ * changes of the job, and by the id of the BlueChi job, which is used by
+ * the controller to cancel it.
+ */
+typedef struct TrackedJobs TrackedJobs;
+
+TrackedJobs *tracked_jobs_new(void);
+void tracked_jobs_free(TrackedJobs *jobs);
+
+/*
+ * Takes ownership of userdata, also on failure. If systemd merged the job into
+ * one that is already tracked, the tracker of the new BlueChi job is put in
+ * front of the existing ones.
+ */
+int tracked_jobs_add(
+                TrackedJobs *jobs,
+                const char *job_object_path,
+                uint32_t bc_job_id,
+                job_tracker_callback callback,
+                void *userdata,
+                free_func_t free_userdata);
+
+JobTracker *tracked_jobs_find_by_path(TrackedJobs *jobs, const char *job_object_path);
+JobTracker *tracked_jobs_find_by_id(TrackedJobs *jobs, uint32_t bc_job_id);
+
+/* Stops tracking the job and returns it with all merged jobs, the caller has to free it */
+JobTracker *tracked_jobs_remove(TrackedJobs *jobs, const char *job_object_path);
+
+size_t tracked_jobs_size(TrackedJobs *jobs);
+
+DEFINE_CLEANUP_FUNC(TrackedJobs, tracked_jobs_free)
+#define _cleanup_tracked_jobs_ _cleanup_(tracked_jobs_freep)
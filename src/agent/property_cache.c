@@ -0,0 +1,228 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <hashmap.h>
+#include <string.h>
+
+#include "libbluechi/common/list.h"
+#include "libbluechi/common/string-util.h"
+
+#include "property_cache.h"
+
+typedef struct PropertyCacheEntry PropertyCacheEntry;
+
+struct PropertyCacheEntry {
+        char *interface;
+        char *property; /* NULL for all properties of the interface */
+        sd_bus_message *value;
+        uint64_t timestamp;
+
+        LIST_FIELDS(PropertyCacheEntry, entries);
+};
+
+typedef struct PropertyCacheUnit {
+        char *unit_path; /* key */
+        LIST_HEAD(PropertyCacheEntry, entries);
+} PropertyCacheUnit;
+
+struct PropertyCache {
+        struct hashmap *units;
+};
+
+static void property_cache_entry_free(PropertyCacheEntry *entry) {
+        sd_bus_message_unrefp(&entry->value);
+        free(entry->interface);
+        free(entry->property);
+        free(entry);
+}
+
+static void property_cache_unit_clear(void *item) {
+        PropertyCacheUnit *unit = item;
+
+        PropertyCacheEntry *entry = NULL;
+        PropertyCacheEntry *next_entry = NULL;
+        LIST_FOREACH_SAFE(entries, entry, next_entry, unit->entries) {
+                property_cache_entry_free(entry);
+        }
+        free(unit->unit_path);
+}
+
+static uint64_t property_cache_unit_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const PropertyCacheUnit *unit = item;
+        return hashmap_sip(unit->unit_path, strlen(unit->unit_path), seed0, seed1);
+}
+
+static int property_cache_unit_compare(const void *a, const void *b, UNUSED void *udata) {
+        const PropertyCacheUnit *unit_a = a;
+        const PropertyCacheUnit *unit_b = b;
+
+        return strcmp(unit_a->unit_path, unit_b->unit_path);
+}
+
+PropertyCache *property_cache_new(void) {
+        _cleanup_free_ PropertyCache *cache = malloc0(sizeof(PropertyCache));
+        if (cache == NULL) {
+                return NULL;
+        }
+
+        cache->units = hashmap_new(
+                        sizeof(PropertyCacheUnit),
+                        0,
+                        0,
+                        0,
+                        property_cache_unit_hash,
+                        property_cache_unit_compare,
+                        property_cache_unit_clear,
+                        NULL);
+        if (cache->units == NULL) {
+                return NULL;
+        }
+
+        return steal_pointer(&cache);
+}
+
+void property_cache_free(PropertyCache *cache) {
+        if (cache == NULL) {
+                return;
+        }
+        hashmap_free(cache->units);
+        free(cache);
+}
+
+static PropertyCacheEntry *property_cache_unit_find(
+                PropertyCacheUnit *unit, const char *interface, const char *property) {
+        PropertyCacheEntry *entry = NULL;
+        LIST_FOREACH(entries, entry, unit->entries) {
+                if (!streq(entry->interface, interface)) {
+                        continue;
+                }
+                if (entry->property == NULL ? property == NULL : property != NULL && streq(entry->property, property)) {
+                        return entry;
+                }
+        }
+        return NULL;
+}
+
+sd_bus_message *property_cache_get(
+                PropertyCache *cache,
+                const char *unit_path,
+                const char *interface,
+                const char *property,
+                uint64_t now,
+                uint64_t ttl) {
+        PropertyCacheUnit key = { .unit_path = (char *) unit_path };
+        PropertyCacheUnit *unit = (PropertyCacheUnit *) hashmap_get(cache->units, &key);
+        if (unit == NULL) {
+                return NULL;
+        }
+
+        PropertyCacheEntry *entry = property_cache_unit_find(unit, interface, property);
+        if (entry == NULL) {
+                return NULL;
+        }
+        if (now >= entry->timestamp + ttl) {
+                LIST_REMOVE(entries, unit->entries, entry);
+                property_cache_entry_free(entry);
+                return NULL;
+        }
+
+        if (sd_bus_message_rewind(entry->value, true) < 0) {
+                return NULL;
+        }
+        return entry->value;
+}
+
+int property_cache_put(
+                PropertyCache *cache,
+                const char *unit_path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *m,
+                uint64_t now) {
+        PropertyCacheUnit key = { .unit_path = (char *) unit_path };
+        PropertyCacheUnit *unit = (PropertyCacheUnit *) hashmap_get(cache->units, &key);
+        if (unit == NULL) {
+                _cleanup_free_ char *unit_path_copy = strdup(unit_path);
+                if (unit_path_copy == NULL) {
+                        return -ENOMEM;
+                }
+
+                PropertyCacheUnit new_unit = { .unit_path = unit_path_copy };
+                LIST_HEAD_INIT(new_unit.entries);
+                hashmap_set(cache->units, &new_unit);
+                if (hashmap_oom(cache->units)) {
+                        return -ENOMEM;
+                }
+                steal_pointer(&unit_path_copy);
+                unit = (PropertyCacheUnit *) hashmap_get(cache->units, &key);
+        }
+
+        PropertyCacheEntry *entry = property_cache_unit_find(unit, interface, property);
+        if (entry == NULL) {
+                _cleanup_free_ PropertyCacheEntry *new_entry = malloc0(sizeof(PropertyCacheEntry));
+                if (new_entry == NULL) {
+                        return -ENOMEM;
+                }
+                new_entry->interface = strdup(interface);
+                new_entry->property = property != NULL ? strdup(property) : NULL;
+                if (new_entry->interface == NULL || (property != NULL && new_entry->property == NULL)) {
+                        free(new_entry->interface);
+                        free(new_entry->property);
+                        return -ENOMEM;
+                }
+                LIST_INIT(entries, new_entry);
+                LIST_PREPEND(entries, unit->entries, new_entry);
+                entry = steal_pointer(&new_entry);
+        }
+
+        sd_bus_message_unrefp(&entry->value);
+        entry->value = sd_bus_message_ref(m);
+        entry->timestamp = now;
+        return 0;
+}
+
+void property_cache_invalidate(PropertyCache *cache, const char *unit_path) {
+        PropertyCacheUnit key = { .unit_path = (char *) unit_path };
+        PropertyCacheUnit *unit = (PropertyCacheUnit *) hashmap_delete(cache->units, &key);
+        if (unit != NULL) {
+                property_cache_unit_clear(unit);
+        }
+}
+
+void property_cache_expire(PropertyCache *cache, uint64_t now, uint64_t ttl) {
+        size_t n_empty_units = 0;
+        _cleanup_free_ char **empty_units = malloc0_array(0, sizeof(char *), hashmap_count(cache->units));
+        void *item = NULL;
+        size_t i = 0;
+
+        while (hashmap_iter(cache->units, &i, &item)) {
+                PropertyCacheUnit *unit = item;
+                PropertyCacheEntry *entry = NULL;
+                PropertyCacheEntry *next_entry = NULL;
+                LIST_FOREACH_SAFE(entries, entry, next_entry, unit->entries) {
+                        if (now >= entry->timestamp + ttl) {
+                                LIST_REMOVE(entries, unit->entries, entry);
+                                property_cache_entry_free(entry);
+                        }
+                }
+                if (LIST_IS_EMPTY(unit->entries) && empty_units != NULL) {
+                        empty_units[n_empty_units++] = unit->unit_path;
+                }
+        }
+
+        /* The paths are owned by the units, so each is looked up by a copy of the key */
+        for (i = 0; i < n_empty_units; i++) {
+                PropertyCacheUnit key = { .unit_path = empty_units[i] };
+                PropertyCacheUnit *unit = (PropertyCacheUnit *) hashmap_delete(cache->units, &key);
+                if (unit != NULL) {
+                        property_cache_unit_clear(unit);
+                }
+        }
+}
+
+size_t property_cache_size(PropertyCache *cache) {
+        return hashmap_count(cache->units);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <systemd/sd-bus.h>
+
+#include "libbluechi/common/common.h"
+
+/*
+ * Short-lived copy of the unit properties returned by systemd, keyed by the
+ * object path of the unit, the interface and the property. A NULL property
+ * stands for all properties of the interface (GetAll). Entries are dropped
+ * once they are found to be older than the TTL, by property_cache_expire(),
+ * or when systemd reports a change of the unit.
+ */
+typedef struct PropertyCache PropertyCache;
+
+PropertyCache *property_cache_new(void);
+void property_cache_free(PropertyCache *cache);
+
+/* Returns the cached reply of systemd, rewound for reading, or NULL if there is none younger than ttl */
+sd_bus_message *property_cache_get(
+                PropertyCache *cache,
+                const char *unit_path,
+                const char *interface,
+                const char *property,
+                uint64_t now,
+                uint64_t ttl);
+
+/* Stores the sealed reply m of systemd, replacing an older one */
+int property_cache_put(
+                PropertyCache *cache,
+                const char *unit_path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *m,
+                uint64_t now);
+
+/* Drops all cached properties of a unit */
+void property_cache_invalidate(PropertyCache *cache, const char *unit_path);
+
+/* Drops all values older than ttl and the units left without any, for values that are never read again */
+void property_cache_expire(PropertyCache *cache, uint64_t now, uint64_t ttl);
+
+size_t property_cache_size(PropertyCache *cache);
+
+DEFINE_CLEANUP_FUNC(PropertyCache, property_cache_free)
+#define _cleanup_property_cache_ _cleanup_(property_cache_freep)
@@ -181,6 +181,78 @@ bool test_agent_apply_config_invalid_heartbeat() {
         return true;
 }
 
+bool test_agent_apply_config_unit_state_coalesce_window() {
+        _cleanup_agent_ Agent *agent = agent_new();
+        int r = cfg_initialize(&agent->config);
+        if (r < 0) {
+                fprintf(stderr, "Unexpected error when initializing config: %s", strerror(-r));
+                return false;
+        }
+
+        cfg_set_value(agent->config, CFG_UNIT_STATE_COALESCE_WINDOW, "250");
+
+        bool result = agent_apply_config(agent);
+        if (!result) {
+                print_error_result(__func__, true, result);
+                return false;
+        }
+        if (agent->unit_state_coalesce_window_msec != 250) {
+                fprintf(stderr,
+                        "FAILED: expected unit state coalesce window 250, but got %ld\n",
+                        agent->unit_state_coalesce_window_msec);
+                return false;
+        }
+
+        cfg_set_value(agent->config, CFG_UNIT_STATE_COALESCE_WINDOW, "invalid");
+
+        result = agent_apply_config(agent);
+        if (result) {
+                print_error_result(__func__, false, result);
+                return false;
+        }
+
+        cfg_set_value(agent->config, CFG_UNIT_STATE_COALESCE_WINDOW, "-1");
+
+        result = agent_apply_config(agent);
+        if (result) {
+                print_error_result(__func__, false, result);
+                return false;
+        }
+        return true;
+}
+
+bool test_agent_apply_config_unit_property_cache_ttl() {
+        _cleanup_agent_ Agent *agent = agent_new();
+        int r = cfg_initialize(&agent->config);
+        if (r < 0) {
+                fprintf(stderr, "Unexpected error when initializing config: %s", strerror(-r));
+                return false;
+        }
+
+        cfg_set_value(agent->config, CFG_UNIT_PROPERTY_CACHE_TTL, "2000");
+
+        bool result = agent_apply_config(agent);
+        if (!result) {
+                print_error_result(__func__, true, result);
+                return false;
+        }
+        if (agent->unit_property_cache_ttl_msec != 2000) {
+                fprintf(stderr,
+                        "FAILED: expected unit property cache TTL 2000, but got %ld\n",
+                        agent->unit_property_cache_ttl_msec);
+                return false;
+        }
+
+        cfg_set_value(agent->config, CFG_UNIT_PROPERTY_CACHE_TTL, "-1");
+
+        result = agent_apply_config(agent);
+        if (result) {
+                print_error_result(__func__, false, result);
+                return false;
+        }
+        return true;
+}
+
 bool test_agent_apply_config_invalid_tcpkeeptime() {
         _cleanup_agent_ Agent *agent = agent_new();
         int r = cfg_initialize(&agent->config);
@@ -241,6 +313,8 @@ int main() {
         result = result && test_agent_apply_config_valid_all();
         result = result && test_agent_apply_config_invalid_port();
         result = result && test_agent_apply_config_invalid_heartbeat();
+        result = result && test_agent_apply_config_unit_state_coalesce_window();
+        result = result && test_agent_apply_config_unit_property_cache_ttl();
         result = result && test_agent_apply_config_invalid_tcpkeeptime();
         result = result && test_agent_apply_config_invalid_tcpkeepintvl();
         result = result && test_agent_apply_config_invalid_tcpkeepcnt();
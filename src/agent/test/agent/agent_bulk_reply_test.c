@@ -0,0 +1,289 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+#include "libbluechi/common/time-util.h"
+
+#include "agent/bulk_reply.h"
+#include "agent/unit_filter.h"
+
+#define NUMBER_OF_UNITS 3000
+#define MAX_PINGS 100000
+
+typedef struct BulkReplyTest {
+        sd_event *event;
+        sd_bus *server;
+        sd_bus *client;
+
+        sd_bus_message *units; /* Fake ListUnits reply of systemd */
+        bool filtered;
+        bool flooded; /* Keep calling Ping until the ListUnits reply is done */
+        int n_pings;
+
+        bool ping_replied_first; /* Ping sent after ListUnits was answered before it */
+        bool ping_received;
+        bool reply_received;
+        int n_units;
+        bool units_in_order;
+} BulkReplyTest;
+
+static void bulk_reply_test_clear(BulkReplyTest *test) {
+        sd_bus_message_unrefp(&test->units);
+        sd_bus_unrefp(&test->client);
+        sd_bus_unrefp(&test->server);
+        sd_event_unrefp(&test->event);
+}
+
+static int server_filter(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        BulkReplyTest *test = userdata;
+        if (sd_bus_message_is_method_call(m, "org.test", "Ping")) {
+                return sd_bus_reply_method_return(m, "");
+        }
+        if (!sd_bus_message_is_method_call(m, "org.test", "ListUnits")) {
+                return 0;
+        }
+
+        int r = sd_bus_message_rewind(test->units, true);
+        if (r < 0) {
+                return r;
+        }
+
+        /* The reply may still be in the making, so the call is marked as handled either way */
+        if (!test->filtered) {
+                r = bulk_reply_send(test->event, m, test->units, UNIT_INFO_STRUCT_TYPESTRING, NULL, NULL, NULL);
+                return r < 0 ? r : 1;
+        }
+
+        char **types = calloc(2, sizeof(char *));
+        if (types == NULL || (types[0] = strdup("service")) == NULL) {
+                free(types);
+                return -ENOMEM;
+        }
+        UnitInfoFilter *filter = unit_info_filter_new(types, UNIT_INFO_FIELDS_ALL);
+        if (filter == NULL) {
+                freev((void **) types);
+                return -ENOMEM;
+        }
+        r = bulk_reply_send(
+                        test->event,
+                        m,
+                        test->units,
+                        UNIT_INFO_STRUCT_TYPESTRING,
+                        unit_info_filter_copy_next,
+                        filter,
+                        (free_func_t) unit_info_filter_free);
+        return r < 0 ? r : 1;
+}
+
+static int ping_reply(UNUSED sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        BulkReplyTest *test = userdata;
+        if (!test->ping_received) {
+                test->ping_received = true;
+                test->ping_replied_first = !test->reply_received;
+        }
+        test->n_pings++;
+        if (!test->flooded || test->reply_received || test->n_pings >= MAX_PINGS) {
+                return 0;
+        }
+        return sd_bus_call_method_async(
+                        test->client, NULL, NULL, "/org/test", "org.test", "Ping", ping_reply, test, "");
+}
+
+static int list_units_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        BulkReplyTest *test = userdata;
+        test->reply_received = true;
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                fprintf(stderr, "FAILED: ListUnits failed: %s\n", sd_bus_message_get_error(m)->message);
+                return 0;
+        }
+
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        test->units_in_order = r >= 0;
+        while (r >= 0) {
+                const char *id = NULL;
+                r = sd_bus_message_read(
+                                m,
+                                UNIT_INFO_STRUCT_TYPESTRING,
+                                &id,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL);
+                if (r <= 0) {
+                        break;
+                }
+
+                int i = test->filtered ? test->n_units * 2 : test->n_units;
+                char expected[32];
+                snprintf(expected, sizeof(expected), "unit-%d.%s", i, (i % 2) ? "timer" : "service");
+                if (!streq(id, expected)) {
+                        test->units_in_order = false;
+                }
+                test->n_units++;
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not read reply: %s\n", strerror(-r));
+                test->units_in_order = false;
+        }
+        return 0;
+}
+
+/* Every other unit is a service, the rest are timers */
+sd_bus_message *new_units(sd_bus *bus) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_method_call(bus, &m, NULL, "/org/test", "org.test", "Units");
+        if (r >= 0) {
+                r = sd_bus_message_open_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        }
+        for (int i = 0; i < NUMBER_OF_UNITS && r >= 0; i++) {
+                char name[32];
+                snprintf(name, sizeof(name), "unit-%d.%s", i, (i % 2) ? "timer" : "service");
+                r = sd_bus_message_append(
+                                m,
+                                UNIT_INFO_STRUCT_TYPESTRING,
+                                name,
+                                "Some description",
+                                "loaded",
+                                "active",
+                                "running",
+                                "",
+                                "/org/freedesktop/systemd1/unit/some",
+                                0,
+                                "",
+                                "/");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(m);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(m, 1, 0);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not build units: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&m);
+}
+
+bool bulk_reply_test_setup(BulkReplyTest *test) {
+        int fds[2] = { -1, -1 };
+        int r = sd_event_new(&test->event);
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not create event loop: %s\n", strerror(-r));
+                return false;
+        }
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+                fprintf(stderr, "FAILED: could not create socket pair: %s\n", strerror(errno));
+                return false;
+        }
+
+        test->server = peer_bus_open_server(test->event, "test-server-bus", "org.test", fds[0]);
+        if (test->server == NULL) {
+                fprintf(stderr, "FAILED: could not open server bus\n");
+                close(fds[1]);
+                return false;
+        }
+        r = sd_bus_add_filter(test->server, NULL, server_filter, test);
+        if (r >= 0) {
+                r = sd_bus_new(&test->client);
+        }
+        if (r >= 0) {
+                r = sd_bus_set_fd(test->client, fds[1], fds[1]);
+        }
+        if (r >= 0) {
+                r = sd_bus_start(test->client);
+        }
+        if (r >= 0) {
+                r = sd_bus_attach_event(test->client, test->event, SD_EVENT_PRIORITY_NORMAL);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not set up test: %s\n", strerror(-r));
+                return false;
+        }
+
+        test->units = new_units(test->client);
+        return test->units != NULL;
+}
+
+bool run_list_units(BulkReplyTest *test) {
+        int r = sd_bus_call_method_async(
+                        test->client, NULL, NULL, "/org/test", "org.test", "ListUnits", list_units_reply, test, "");
+        if (r >= 0) {
+                r = sd_bus_call_method_async(
+                                test->client, NULL, NULL, "/org/test", "org.test", "Ping", ping_reply, test, "");
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call test methods: %s\n", strerror(-r));
+                return false;
+        }
+
+        while (!test->reply_received || !test->ping_received) {
+                r = sd_event_run(test->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: no reply to ListUnits or Ping\n");
+                        return false;
+                }
+        }
+        return true;
+}
+
+bool test_bulk_reply(bool filtered, bool flooded) {
+        _cleanup_(bulk_reply_test_clear) BulkReplyTest test = { 0 };
+        test.filtered = filtered;
+        test.flooded = flooded;
+        if (!bulk_reply_test_setup(&test) || !run_list_units(&test)) {
+                return false;
+        }
+
+        int expected_units = filtered ? NUMBER_OF_UNITS / 2 : NUMBER_OF_UNITS;
+        if (test.n_units != expected_units || !test.units_in_order) {
+                fprintf(stderr,
+                        "FAILED: expected %d units in order, got %d (%s)\n",
+                        expected_units,
+                        test.n_units,
+                        test.units_in_order ? "in order" : "out of order");
+                return false;
+        }
+
+        /* Bus traffic is served in between the slices of the large reply */
+        if (!test.ping_replied_first) {
+                fprintf(stderr, "FAILED: expected Ping to be answered before the ListUnits reply was done\n");
+                return false;
+        }
+
+        /* Steady bus traffic does not hold up the slices either */
+        if (test.n_pings >= MAX_PINGS) {
+                fprintf(stderr, "FAILED: expected the ListUnits reply to be done while Ping kept being called\n");
+                return false;
+        }
+
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_bulk_reply(false, false);
+        result = result && test_bulk_reply(true, false);
+        result = result && test_bulk_reply(false, true);
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/common/common.h"
+
+#include "agent/event_journal.h"
+
+#define JOURNAL_SIZE 4
+
+bool expect_units_since(EventJournal *journal, uint64_t seq, int expected_r, char **expected_units) {
+        _cleanup_freev_ char **units = NULL;
+        int r = event_journal_get_units_since(journal, seq, &units);
+        if (r != expected_r) {
+                fprintf(stderr,
+                        "FAILED: expected %d for the units since %" PRIu64 ", got %d\n",
+                        expected_r,
+                        seq,
+                        r);
+                return false;
+        }
+        if (r == 0 && !strv_equal(units, expected_units)) {
+                fprintf(stderr, "FAILED: unexpected units since %" PRIu64 "\n", seq);
+                return false;
+        }
+        return true;
+}
+
+bool test_event_journal() {
+        _cleanup_event_journal_ EventJournal *journal = event_journal_new(JOURNAL_SIZE);
+        if (journal == NULL) {
+                fprintf(stderr, "FAILED: could not create journal\n");
+                return false;
+        }
+
+        bool result = true;
+        char *none[] = { NULL };
+        result = result && expect_units_since(journal, 0, 0, none);
+        result = result && expect_units_since(journal, 1, -ERANGE, none);
+
+        uint64_t seq = event_journal_add(journal, "b.service");
+        event_journal_add(journal, "a.service");
+        event_journal_add(journal, "b.service");
+        if (seq != 1 || event_journal_get_seq(journal) != 3) {
+                fprintf(stderr, "FAILED: expected events 1 to 3, got %" PRIu64 "\n", event_journal_get_seq(journal));
+                result = false;
+        }
+
+        /* Units are reported once, in order */
+        char *all[] = { "a.service", "b.service", NULL };
+        char *last[] = { "b.service", NULL };
+        result = result && expect_units_since(journal, 0, 0, all);
+        result = result && expect_units_since(journal, 2, 0, last);
+        result = result && expect_units_since(journal, 3, 0, none);
+
+        /* Older events are overwritten once the journal is full */
+        event_journal_add(journal, "c.service");
+        event_journal_add(journal, "c.service");
+        char *recent[] = { "a.service", "b.service", "c.service", NULL };
+        result = result && expect_units_since(journal, 0, -ERANGE, none);
+        result = result && expect_units_since(journal, 1, 0, recent);
+        result = result && expect_units_since(journal, 6, -ERANGE, none);
+
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_event_journal();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/common/common.h"
+
+#include "agent/job_tracker.h"
+
+#define N_JOBS 100
+#define JOB_PATH_PREFIX "/org/freedesktop/systemd1/job/"
+
+static int freed_userdata = 0;
+
+static void count_free(UNUSED void *userdata) {
+        freed_userdata++;
+}
+
+static void job_path(char *buf, size_t size, int i) {
+        snprintf(buf, size, JOB_PATH_PREFIX "%d", i);
+}
+
+/* The systemd job i belongs to the BlueChi job 100000 + i */
+static uint32_t job_id(int i) {
+        return 100000 + (uint32_t) i;
+}
+
+bool expect_job(TrackedJobs *jobs, int i) {
+        char path[64];
+        job_path(path, sizeof(path), i);
+
+        JobTracker *by_path = tracked_jobs_find_by_path(jobs, path);
+        JobTracker *by_id = tracked_jobs_find_by_id(jobs, job_id(i));
+        if (by_path == NULL || by_path != by_id || by_path->bc_job_id != job_id(i) ||
+            !streq(by_path->job_object_path, path)) {
+                fprintf(stderr, "FAILED: expected job %s with id %u to be tracked\n", path, job_id(i));
+                return false;
+        }
+        return true;
+}
+
+bool expect_no_job(TrackedJobs *jobs, int i) {
+        char path[64];
+        job_path(path, sizeof(path), i);
+
+        if (tracked_jobs_find_by_path(jobs, path) != NULL || tracked_jobs_find_by_id(jobs, job_id(i)) != NULL) {
+                fprintf(stderr, "FAILED: expected job %s with id %u not to be tracked\n", path, job_id(i));
+                return false;
+        }
+        return true;
+}
+
+bool test_tracked_jobs() {
+        _cleanup_tracked_jobs_ TrackedJobs *jobs = tracked_jobs_new();
+        if (jobs == NULL) {
+                return false;
+        }
+
+        char path[64];
+        for (int i = 0; i < N_JOBS; i++) {
+                job_path(path, sizeof(path), i);
+                int r = tracked_jobs_add(jobs, path, job_id(i), NULL, &freed_userdata, count_free);
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not track job %s: %s\n", path, strerror(-r));
+                        return false;
+                }
+        }
+        if (tracked_jobs_size(jobs) != N_JOBS) {
+                fprintf(stderr, "FAILED: expected %d tracked jobs, got %zu\n", N_JOBS, tracked_jobs_size(jobs));
+                return false;
+        }
+
+        bool result = true;
+        for (int i = 0; i < N_JOBS && result; i++) {
+                result = expect_job(jobs, i);
+        }
+        result = result && expect_no_job(jobs, N_JOBS);
+
+        /* Jobs finish in any order, remove every other one */
+        for (int i = 0; i < N_JOBS && result; i += 2) {
+                job_path(path, sizeof(path), i);
+                _cleanup_job_tracker_ JobTracker *track = tracked_jobs_remove(jobs, path);
+                if (track == NULL || track->bc_job_id != job_id(i)) {
+                        fprintf(stderr, "FAILED: could not remove job %s\n", path);
+                        result = false;
+                }
+        }
+        for (int i = 0; i < N_JOBS && result; i++) {
+                result = (i % 2 == 0) ? expect_no_job(jobs, i) : expect_job(jobs, i);
+        }
+        if (result && tracked_jobs_remove(jobs, JOB_PATH_PREFIX "0") != NULL) {
+                fprintf(stderr, "FAILED: expected a removed job not to be removed again\n");
+                result = false;
+        }
+        if (result && (tracked_jobs_size(jobs) != N_JOBS / 2 || freed_userdata != N_JOBS / 2)) {
+                fprintf(stderr,
+                        "FAILED: expected %d tracked and freed jobs, got %zu and %d\n",
+                        N_JOBS / 2,
+                        tracked_jobs_size(jobs),
+                        freed_userdata);
+                result = false;
+        }
+
+        return result;
+}
+
+bool test_tracked_jobs_free() {
+        freed_userdata = 0;
+
+        TrackedJobs *jobs = tracked_jobs_new();
+        if (jobs == NULL) {
+                return false;
+        }
+        int r = tracked_jobs_add(jobs, JOB_PATH_PREFIX "1", 1, NULL, &freed_userdata, count_free);
+        if (r >= 0) {
+                r = tracked_jobs_add(jobs, JOB_PATH_PREFIX "2", 2, NULL, &freed_userdata, count_free);
+        }
+        tracked_jobs_free(jobs);
+
+        if (r < 0 || freed_userdata != 2) {
+                fprintf(stderr, "FAILED: expected the userdata of 2 jobs to be freed, got %d\n", freed_userdata);
+                return false;
+        }
+        return true;
+}
+
+bool test_tracked_jobs_merged() {
+        freed_userdata = 0;
+
+        _cleanup_tracked_jobs_ TrackedJobs *jobs = tracked_jobs_new();
+        if (jobs == NULL) {
+                return false;
+        }
+
+        /* systemd merged the second start of the unit into the pending job */
+        int r = tracked_jobs_add(jobs, JOB_PATH_PREFIX "1", 1, NULL, &freed_userdata, count_free);
+        if (r >= 0) {
+                r = tracked_jobs_add(jobs, JOB_PATH_PREFIX "1", 2, NULL, &freed_userdata, count_free);
+        }
+        if (r < 0 || tracked_jobs_size(jobs) != 1 || freed_userdata != 0) {
+                fprintf(stderr, "FAILED: expected the merged jobs to be tracked together\n");
+                return false;
+        }
+
+        JobTracker *first = tracked_jobs_find_by_id(jobs, 1);
+        JobTracker *second = tracked_jobs_find_by_id(jobs, 2);
+        if (first == NULL || second == NULL || tracked_jobs_find_by_path(jobs, JOB_PATH_PREFIX "1") != second ||
+            second->merged != first) {
+                fprintf(stderr, "FAILED: expected both merged jobs to be found\n");
+                return false;
+        }
+
+        _cleanup_job_tracker_ JobTracker *track = tracked_jobs_remove(jobs, JOB_PATH_PREFIX "1");
+        if (track != second || tracked_jobs_find_by_id(jobs, 1) != NULL || tracked_jobs_find_by_id(jobs, 2) != NULL) {
+                fprintf(stderr, "FAILED: expected both merged jobs to be removed\n");
+                return false;
+        }
+        job_tracker_freep(&track);
+        if (freed_userdata != 2) {
+                fprintf(stderr, "FAILED: expected the userdata of 2 merged jobs to be freed, got %d\n", freed_userdata);
+                return false;
+        }
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_tracked_jobs();
+        result = result && test_tracked_jobs_free();
+        result = result && test_tracked_jobs_merged();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "agent/property_cache.h"
+
+#define UNIT_A "/org/freedesktop/systemd1/unit/a_2eservice"
+#define UNIT_B "/org/freedesktop/systemd1/unit/b_2eservice"
+#define SERVICE_INTERFACE "org.freedesktop.systemd1.Service"
+#define TTL (2 * USEC_PER_SEC)
+
+/* Messages only need a bus that is not closed, the peer end is never read */
+static int peer_fd = -1;
+
+sd_bus *open_message_bus() {
+        int fds[2] = { -1, -1 };
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+                fprintf(stderr, "FAILED: could not create socket pair: %s\n", strerror(errno));
+                return NULL;
+        }
+        peer_fd = fds[1];
+
+        _cleanup_sd_bus_ sd_bus *bus = NULL;
+        int r = sd_bus_new(&bus);
+        if (r >= 0) {
+                r = sd_bus_set_fd(bus, fds[0], fds[0]);
+        }
+        if (r >= 0) {
+                r = sd_bus_start(bus);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not set up bus: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&bus);
+}
+
+/* Builds a sealed message with a single uint64 value, like the reply of systemd to Get */
+sd_bus_message *new_value(sd_bus *bus, uint64_t value) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_method_call(bus, &m, "org.test", "/org/test", "org.test", "Test");
+        if (r >= 0) {
+                r = sd_bus_message_append(m, "v", "t", value);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(m, 1, 0);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not create message: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&m);
+}
+
+bool expect_value(
+                PropertyCache *cache,
+                const char *unit_path,
+                const char *property,
+                uint64_t now,
+                bool expect_hit,
+                uint64_t expected_value) {
+        sd_bus_message *m = property_cache_get(cache, unit_path, SERVICE_INTERFACE, property, now, TTL);
+        if (!expect_hit) {
+                if (m != NULL) {
+                        fprintf(stderr, "FAILED: expected no cached value of %s %s\n", unit_path, property);
+                        return false;
+                }
+                return true;
+        }
+
+        uint64_t value = 0;
+        if (m == NULL || sd_bus_message_read(m, "v", "t", &value) < 0 || value != expected_value) {
+                fprintf(stderr,
+                        "FAILED: expected cached value %" PRIu64 " of %s %s\n",
+                        expected_value,
+                        unit_path,
+                        property);
+                return false;
+        }
+        return true;
+}
+
+bool test_property_cache() {
+        _cleanup_sd_bus_ sd_bus *bus = open_message_bus();
+        _cleanup_property_cache_ PropertyCache *cache = property_cache_new();
+        if (bus == NULL || cache == NULL) {
+                return false;
+        }
+        _cleanup_sd_bus_message_ sd_bus_message *memory = new_value(bus, 1024);
+        _cleanup_sd_bus_message_ sd_bus_message *cpu = new_value(bus, 42);
+        _cleanup_sd_bus_message_ sd_bus_message *all = new_value(bus, 7);
+        _cleanup_sd_bus_message_ sd_bus_message *other = new_value(bus, 3);
+        if (memory == NULL || cpu == NULL || all == NULL || other == NULL) {
+                return false;
+        }
+
+        bool result = true;
+        uint64_t now = USEC_PER_SEC;
+
+        result = result && expect_value(cache, UNIT_A, "MemoryCurrent", now, false, 0);
+
+        int r = property_cache_put(cache, UNIT_A, SERVICE_INTERFACE, "MemoryCurrent", memory, now);
+        if (r >= 0) {
+                r = property_cache_put(cache, UNIT_A, SERVICE_INTERFACE, "CPUUsageNSec", cpu, now);
+        }
+        if (r >= 0) {
+                r = property_cache_put(cache, UNIT_A, SERVICE_INTERFACE, NULL, all, now);
+        }
+        if (r >= 0) {
+                r = property_cache_put(cache, UNIT_B, SERVICE_INTERFACE, "MemoryCurrent", other, now);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not cache values: %s\n", strerror(-r));
+                return false;
+        }
+
+        /* Each unit, property and all properties are cached separately and can be read repeatedly */
+        result = result && expect_value(cache, UNIT_A, "MemoryCurrent", now, true, 1024);
+        result = result && expect_value(cache, UNIT_A, "MemoryCurrent", now, true, 1024);
+        result = result && expect_value(cache, UNIT_A, "CPUUsageNSec", now, true, 42);
+        result = result && expect_value(cache, UNIT_A, NULL, now, true, 7);
+        result = result && expect_value(cache, UNIT_B, "MemoryCurrent", now, true, 3);
+        result = result && expect_value(cache, UNIT_A, "TasksCurrent", now, false, 0);
+        if (result && property_cache_get(cache, UNIT_A, "org.freedesktop.systemd1.Unit", NULL, now, TTL) != NULL) {
+                fprintf(stderr, "FAILED: expected properties of another interface not to be cached\n");
+                result = false;
+        }
+
+        /* Values expire after the TTL, a newer value restarts it */
+        r = property_cache_put(cache, UNIT_A, SERVICE_INTERFACE, "CPUUsageNSec", cpu, now + USEC_PER_SEC);
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not cache value: %s\n", strerror(-r));
+                return false;
+        }
+        result = result && expect_value(cache, UNIT_A, "MemoryCurrent", now + TTL - 1, true, 1024);
+        result = result && expect_value(cache, UNIT_A, "MemoryCurrent", now + TTL, false, 0);
+        result = result && expect_value(cache, UNIT_A, "CPUUsageNSec", now + TTL, true, 42);
+
+        /* A change of a unit drops all of its values */
+        property_cache_invalidate(cache, UNIT_A);
+        result = result && expect_value(cache, UNIT_A, "CPUUsageNSec", now, false, 0);
+        result = result && expect_value(cache, UNIT_A, NULL, now, false, 0);
+        result = result && expect_value(cache, UNIT_B, "MemoryCurrent", now, true, 3);
+        if (result && property_cache_size(cache) != 1) {
+                fprintf(stderr, "FAILED: expected 1 cached unit, got %zu\n", property_cache_size(cache));
+                result = false;
+        }
+
+        return result;
+}
+
+bool test_property_cache_expire() {
+        _cleanup_sd_bus_ sd_bus *bus = open_message_bus();
+        _cleanup_property_cache_ PropertyCache *cache = property_cache_new();
+        if (bus == NULL || cache == NULL) {
+                return false;
+        }
+        _cleanup_sd_bus_message_ sd_bus_message *memory = new_value(bus, 1024);
+        _cleanup_sd_bus_message_ sd_bus_message *cpu = new_value(bus, 42);
+        if (memory == NULL || cpu == NULL) {
+                return false;
+        }
+
+        uint64_t now = USEC_PER_SEC;
+        int r = property_cache_put(cache, UNIT_A, SERVICE_INTERFACE, NULL, memory, now);
+        if (r >= 0) {
+                r = property_cache_put(cache, UNIT_B, SERVICE_INTERFACE, NULL, memory, now);
+        }
+        if (r >= 0) {
+                r = property_cache_put(cache, UNIT_B, SERVICE_INTERFACE, "CPUUsageNSec", cpu, now + USEC_PER_SEC);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not cache values: %s\n", strerror(-r));
+                return false;
+        }
+
+        /* Values that are never read again are dropped too, along with units left empty */
+        bool result = true;
+        property_cache_expire(cache, now + TTL, TTL);
+        if (property_cache_size(cache) != 1) {
+                fprintf(stderr,
+                        "FAILED: expected 1 cached unit after the sweep, got %zu\n",
+                        property_cache_size(cache));
+                result = false;
+        }
+        result = result && expect_value(cache, UNIT_B, NULL, now, false, 0);
+        result = result && expect_value(cache, UNIT_B, "CPUUsageNSec", now + TTL, true, 42);
+
+        property_cache_expire(cache, now + USEC_PER_SEC + TTL, TTL);
+        if (result && property_cache_size(cache) != 0) {
+                fprintf(stderr,
+                        "FAILED: expected no cached unit after the sweep, got %zu\n",
+                        property_cache_size(cache));
+                result = false;
+        }
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_property_cache();
+        result = result && test_property_cache_expire();
+
+        if (peer_fd >= 0) {
+                close(peer_fd);
+        }
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+
+#include "agent/unit_filter.h"
+
+/* Messages only need a bus that is not closed, the peer end is never read */
+static int peer_fd = -1;
+
+sd_bus *open_message_bus() {
+        int fds[2] = { -1, -1 };
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+                fprintf(stderr, "FAILED: could not create socket pair: %s\n", strerror(errno));
+                return NULL;
+        }
+        peer_fd = fds[1];
+
+        _cleanup_sd_bus_ sd_bus *bus = NULL;
+        int r = sd_bus_new(&bus);
+        if (r >= 0) {
+                r = sd_bus_set_fd(bus, fds[0], fds[0]);
+        }
+        if (r >= 0) {
+                r = sd_bus_start(bus);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not set up bus: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&bus);
+}
+
+sd_bus_message *new_message(sd_bus *bus) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_method_call(bus, &m, "org.test", "/org/test", "org.test", "Test");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not create message: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&m);
+}
+
+int append_unit(sd_bus_message *m, const char *name) {
+        return sd_bus_message_append(
+                        m,
+                        UNIT_INFO_STRUCT_TYPESTRING,
+                        name,
+                        "Some description",
+                        "loaded",
+                        "active",
+                        "running",
+                        "",
+                        "/org/freedesktop/systemd1/unit/some",
+                        42,
+                        "start",
+                        "/org/freedesktop/systemd1/job/42");
+}
+
+bool test_unit_info_fields_parse() {
+        bool result = true;
+        uint32_t mask = 0;
+        const char *invalid = NULL;
+
+        char *none[] = { NULL };
+        if (!unit_info_fields_parse(none, &mask, &invalid) || mask != UNIT_INFO_FIELDS_ALL) {
+                fprintf(stderr, "FAILED: expected no fields to select all fields\n");
+                result = false;
+        }
+
+        char *some[] = { "sub_state", "job_id", NULL };
+        if (!unit_info_fields_parse(some, &mask, &invalid) ||
+            mask != (UNIT_INFO_FIELD_NAME | UNIT_INFO_FIELD_SUB_STATE | UNIT_INFO_FIELD_JOB_ID)) {
+                fprintf(stderr, "FAILED: unexpected mask 0x%x for 'sub_state,job_id'\n", mask);
+                result = false;
+        }
+
+        char *unknown[] = { "name", "color", NULL };
+        if (unit_info_fields_parse(unknown, &mask, &invalid) || invalid == NULL || !streq(invalid, "color")) {
+                fprintf(stderr, "FAILED: expected 'color' to be rejected\n");
+                result = false;
+        }
+
+        return result;
+}
+
+bool test_unit_type_matches() {
+        bool result = true;
+        char *none[] = { NULL };
+        char *types[] = { "service", "socket", NULL };
+
+        if (!unit_type_matches("foo.timer", none)) {
+                fprintf(stderr, "FAILED: expected no types to match all units\n");
+                result = false;
+        }
+        if (!unit_type_matches("foo.bar.service", types) || !unit_type_matches("dbus.socket", types)) {
+                fprintf(stderr, "FAILED: expected service and socket units to match\n");
+                result = false;
+        }
+        if (unit_type_matches("foo.timer", types) || unit_type_matches("foo", types) ||
+            unit_type_matches("foo.servicex", types)) {
+                fprintf(stderr, "FAILED: expected other units not to match\n");
+                result = false;
+        }
+
+        return result;
+}
+
+bool test_unit_info_copy_filtered() {
+        _cleanup_sd_bus_ sd_bus *bus = open_message_bus();
+        if (bus == NULL) {
+                return false;
+        }
+        _cleanup_sd_bus_message_ sd_bus_message *m = new_message(bus);
+        _cleanup_sd_bus_message_ sd_bus_message *reply = new_message(bus);
+        if (m == NULL || reply == NULL) {
+                return false;
+        }
+
+        int r = sd_bus_message_open_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        if (r >= 0) {
+                r = append_unit(m, "foo.service");
+        }
+        if (r >= 0) {
+                r = append_unit(m, "foo.timer");
+        }
+        if (r >= 0) {
+                r = append_unit(m, "bar.service");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(m);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(m, 1, 0);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not build unit list: %s\n", strerror(-r));
+                return false;
+        }
+
+        char *types[] = { "service", NULL };
+        r = unit_info_copy_filtered(reply, m, types, UNIT_INFO_FIELD_NAME | UNIT_INFO_FIELD_ACTIVE_STATE);
+        if (r >= 0) {
+                r = sd_bus_message_seal(reply, 2, 0);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not filter unit list: %s\n", strerror(-r));
+                return false;
+        }
+
+        const char *expected_names[] = { "foo.service", "bar.service" };
+        for (size_t i = 0; i < 2; i++) {
+                const char *id = NULL, *description = NULL, *load_state = NULL, *active_state = NULL;
+                const char *sub_state = NULL, *following = NULL, *unit_path = NULL;
+                uint32_t job_id = 0;
+                const char *job_type = NULL, *job_path = NULL;
+
+                r = sd_bus_message_read(
+                                reply,
+                                UNIT_INFO_STRUCT_TYPESTRING,
+                                &id,
+                                &description,
+                                &load_state,
+                                &active_state,
+                                &sub_state,
+                                &following,
+                                &unit_path,
+                                &job_id,
+                                &job_type,
+                                &job_path);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: expected unit '%s' in filtered list\n", expected_names[i]);
+                        return false;
+                }
+                if (!streq(id, expected_names[i]) || !streq(active_state, "active") || !streq(description, "") ||
+                    !streq(load_state, "") || !streq(sub_state, "") || !streq(unit_path, "/") || job_id != 0 ||
+                    !streq(job_type, "") || !streq(job_path, "/")) {
+                        fprintf(stderr, "FAILED: unexpected projection of unit '%s'\n", id);
+                        return false;
+                }
+        }
+
+        if (sd_bus_message_at_end(reply, false) == 0) {
+                fprintf(stderr, "FAILED: expected only the service units in filtered list\n");
+                return false;
+        }
+
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_unit_info_fields_parse();
+        result = result && test_unit_type_matches();
+        result = result && test_unit_info_copy_filtered();
+        if (peer_fd >= 0) {
+                close(peer_fd);
+        }
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/common/common.h"
+
+#include "agent/unit_state_window.h"
+
+#define FOO "/org/freedesktop/systemd1/unit/foo_2eservice"
+#define BAR "/org/freedesktop/systemd1/unit/bar_2eservice"
+#define LENGTH 100
+
+bool expect_hold(UnitStateWindows *windows, const char *unit_path, uint64_t now, bool expected) {
+        if (unit_state_windows_hold(windows, unit_path, now, LENGTH) != expected) {
+                fprintf(stderr,
+                        "FAILED: expected the change of %s at %" PRIu64 " to be %s\n",
+                        unit_path,
+                        now,
+                        expected ? "held back" : "emitted");
+                return false;
+        }
+        return true;
+}
+
+bool expect_expire(UnitStateWindows *windows, uint64_t now, const char *expected) {
+        _cleanup_free_ char *unit_path = unit_state_windows_expire(windows, now);
+        if (expected == NULL ? unit_path != NULL : unit_path == NULL || !streq(unit_path, expected)) {
+                fprintf(stderr,
+                        "FAILED: expected %s to expire at %" PRIu64 ", got %s\n",
+                        expected != NULL ? expected : "nothing",
+                        now,
+                        unit_path != NULL ? unit_path : "nothing");
+                return false;
+        }
+        return true;
+}
+
+bool test_unit_state_window_coalesce() {
+        _cleanup_unit_state_windows_ UnitStateWindows *windows = unit_state_windows_new();
+        if (windows == NULL) {
+                fprintf(stderr, "FAILED: could not create windows\n");
+                return false;
+        }
+
+        /* The first change is emitted, the following ones collapse into the last */
+        bool result = true;
+        result = result && expect_hold(windows, FOO, 0, false);
+        result = result && expect_hold(windows, FOO, 10, true);
+        result = result && expect_hold(windows, FOO, 20, true);
+        result = result && expect_hold(windows, FOO, 30, true);
+        result = result && expect_hold(windows, BAR, 50, false);
+        if (result && unit_state_windows_get_collapsed(windows) != 2) {
+                fprintf(stderr,
+                        "FAILED: expected 2 collapsed changes, got %" PRIu64 "\n",
+                        unit_state_windows_get_collapsed(windows));
+                result = false;
+        }
+        if (result && unit_state_windows_get_next_deadline(windows) != LENGTH) {
+                fprintf(stderr, "FAILED: expected the window of %s to end first\n", FOO);
+                result = false;
+        }
+
+        /* Only windows holding back a change are reported when they end */
+        result = result && expect_expire(windows, LENGTH - 1, NULL);
+        result = result && expect_expire(windows, LENGTH, FOO);
+        result = result && expect_expire(windows, 50 + LENGTH, NULL);
+        if (result && unit_state_windows_get_next_deadline(windows) != 0) {
+                fprintf(stderr, "FAILED: expected no open window\n");
+                result = false;
+        }
+        result = result && expect_hold(windows, BAR, 50 + LENGTH, false);
+
+        return result;
+}
+
+bool test_unit_state_window_close() {
+        _cleanup_unit_state_windows_ UnitStateWindows *windows = unit_state_windows_new();
+        if (windows == NULL) {
+                fprintf(stderr, "FAILED: could not create windows\n");
+                return false;
+        }
+
+        /* Closing a window early releases the held back change before other events of the unit */
+        bool result = true;
+        result = result && expect_hold(windows, FOO, 0, false);
+        if (result && unit_state_windows_close(windows, FOO)) {
+                fprintf(stderr, "FAILED: expected no held back change\n");
+                result = false;
+        }
+        result = result && expect_hold(windows, FOO, 10, false);
+        result = result && expect_hold(windows, FOO, 20, true);
+        if (result && !unit_state_windows_close(windows, FOO)) {
+                fprintf(stderr, "FAILED: expected the held back change on close\n");
+                result = false;
+        }
+
+        /* Closed windows are not reported, a window opened again ends later */
+        result = result && expect_hold(windows, FOO, 30, false);
+        result = result && expect_hold(windows, FOO, 40, true);
+        result = result && expect_expire(windows, 10 + LENGTH, NULL);
+        result = result && expect_expire(windows, 30 + LENGTH, FOO);
+
+        /* An emitted change opens the next window */
+        if (result && !unit_state_windows_open(windows, FOO, 30 + LENGTH, LENGTH)) {
+                fprintf(stderr, "FAILED: could not open window\n");
+                result = false;
+        }
+        result = result && expect_hold(windows, FOO, 40 + LENGTH, true);
+        result = result && expect_expire(windows, 30 + 2 * LENGTH, FOO);
+        if (result && unit_state_windows_get_collapsed(windows) != 0) {
+                fprintf(stderr, "FAILED: expected no collapsed changes\n");
+                result = false;
+        }
+
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_unit_state_window_coalesce();
+        result = result && test_unit_state_window_close();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <string.h>
+
+#include "libbluechi/common/protocol.h"
+#include "libbluechi/common/string-util.h"
+
+#include "unit_filter.h"
+
+typedef struct UnitInfoFieldName {
+        const char *name;
+        UnitInfoField field;
+} UnitInfoFieldName;
+
+static const UnitInfoFieldName unit_info_field_names[] = {
+        { "name", UNIT_INFO_FIELD_NAME },
+        { "description", UNIT_INFO_FIELD_DESCRIPTION },
+        { "load_state", UNIT_INFO_FIELD_LOAD_STATE },
+        { "active_state", UNIT_INFO_FIELD_ACTIVE_STATE },
+        { "sub_state", UNIT_INFO_FIELD_SUB_STATE },
+        { "following", UNIT_INFO_FIELD_FOLLOWING },
+        { "object_path", UNIT_INFO_FIELD_OBJECT_PATH },
+        { "job_id", UNIT_INFO_FIELD_JOB_ID },
+        { "job_type", UNIT_INFO_FIELD_JOB_TYPE },
+        { "job_path", UNIT_INFO_FIELD_JOB_PATH },
+        { NULL, 0 },
+};
+
+static const UnitInfoFieldName *unit_info_field_lookup(const char *name) {
+        for (const UnitInfoFieldName *f = unit_info_field_names; f->name != NULL; f++) {
+                if (streq(f->name, name)) {
+                        return f;
+                }
+        }
+        return NULL;
+}
+
+bool unit_info_fields_parse(char **fields, uint32_t *ret_mask, const char **ret_invalid) {
+        if (strv_length(fields) == 0) {
+                *ret_mask = UNIT_INFO_FIELDS_ALL;
+                return true;
+        }
+
+        uint32_t mask = UNIT_INFO_FIELD_NAME;
+        for (size_t i = 0; fields[i] != NULL; i++) {
+                const UnitInfoFieldName *f = unit_info_field_lookup(fields[i]);
+                if (f == NULL) {
+                        *ret_invalid = fields[i];
+                        return false;
+                }
+                mask |= f->field;
+        }
+
+        *ret_mask = mask;
+        return true;
+}
+
+bool unit_type_matches(const char *unit, char **types) {
+        if (strv_length(types) == 0) {
+                return true;
+        }
+
+        const char *suffix = strrchr(unit, '.');
+        return suffix != NULL && strv_contains(types, suffix + 1);
+}
+
+static const char *unit_info_field_str(const char *value, uint32_t mask, UnitInfoField field) {
+        return (mask & field) ? value : "";
+}
+
+static const char *unit_info_field_path(const char *value, uint32_t mask, UnitInfoField field) {
+        return (mask & field) ? value : "/";
+}
+
+int unit_info_copy_filtered_next(sd_bus_message *reply, sd_bus_message *m, char **types, uint32_t mask) {
+        const char *id = NULL, *description = NULL, *load_state = NULL, *active_state = NULL;
+        const char *sub_state = NULL, *following = NULL, *unit_path = NULL;
+        uint32_t job_id = 0;
+        const char *job_type = NULL, *job_path = NULL;
+
+        int r = sd_bus_message_read(
+                        m,
+                        UNIT_INFO_STRUCT_TYPESTRING,
+                        &id,
+                        &description,
+                        &load_state,
+                        &active_state,
+                        &sub_state,
+                        &following,
+                        &unit_path,
+                        &job_id,
+                        &job_type,
+                        &job_path);
+        if (r <= 0) {
+                return r;
+        }
+
+        if (!unit_type_matches(id, types)) {
+                return 1;
+        }
+
+        r = sd_bus_message_append(
+                        reply,
+                        UNIT_INFO_STRUCT_TYPESTRING,
+                        id,
+                        unit_info_field_str(description, mask, UNIT_INFO_FIELD_DESCRIPTION),
+                        unit_info_field_str(load_state, mask, UNIT_INFO_FIELD_LOAD_STATE),
+                        unit_info_field_str(active_state, mask, UNIT_INFO_FIELD_ACTIVE_STATE),
+                        unit_info_field_str(sub_state, mask, UNIT_INFO_FIELD_SUB_STATE),
+                        unit_info_field_str(following, mask, UNIT_INFO_FIELD_FOLLOWING),
+                        unit_info_field_path(unit_path, mask, UNIT_INFO_FIELD_OBJECT_PATH),
+                        (mask & UNIT_INFO_FIELD_JOB_ID) ? job_id : 0,
+                        unit_info_field_str(job_type, mask, UNIT_INFO_FIELD_JOB_TYPE),
+                        unit_info_field_path(job_path, mask, UNIT_INFO_FIELD_JOB_PATH));
+        if (r < 0) {
+                return r;
+        }
+        return 1;
+}
+
+int unit_info_copy_filtered(sd_bus_message *reply, sd_bus_message *m, char **types, uint32_t mask) {
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        if (r < 0) {
+                return r;
+        }
+
+        r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        if (r < 0) {
+                return r;
+        }
+
+        do {
+                r = unit_info_copy_filtered_next(reply, m, types, mask);
+        } while (r > 0);
+        if (r < 0) {
+                return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0) {
+                return r;
+        }
+
+        return sd_bus_message_exit_container(m);
+}
+
+UnitInfoFilter *unit_info_filter_new(char **types, uint32_t mask) {
+        UnitInfoFilter *filter = malloc0(sizeof(UnitInfoFilter));
+        if (filter == NULL) {
+                return NULL;
+        }
+        filter->types = types;
+        filter->mask = mask;
+        return filter;
+}
+
+void unit_info_filter_free(UnitInfoFilter *filter) {
+        if (filter == NULL) {
+                return;
+        }
+        freev((void **) filter->types);
+        free(filter);
+}
+
+int unit_info_filter_copy_next(sd_bus_message *reply, sd_bus_message *m, void *userdata) {
+        UnitInfoFilter *filter = userdata;
+        return unit_info_copy_filtered_next(reply, m, filter->types, filter->mask);
+}
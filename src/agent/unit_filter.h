@@ -0,0 +1,57 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <systemd/sd-bus.h>
+
+#include "libbluechi/common/common.h"
+
+/*
+ * Columns of a unit listing that can be requested from ListUnitsFiltered. The unit
+ * name is always sent, all other columns not in the mask are left empty so they
+ * cost next to nothing on the wire, while the reply keeps the ListUnits signature.
+ */
+typedef enum UnitInfoField {
+        UNIT_INFO_FIELD_NAME = 1 << 0,
+        UNIT_INFO_FIELD_DESCRIPTION = 1 << 1,
+        UNIT_INFO_FIELD_LOAD_STATE = 1 << 2,
+        UNIT_INFO_FIELD_ACTIVE_STATE = 1 << 3,
+        UNIT_INFO_FIELD_SUB_STATE = 1 << 4,
+        UNIT_INFO_FIELD_FOLLOWING = 1 << 5,
+        UNIT_INFO_FIELD_OBJECT_PATH = 1 << 6,
+        UNIT_INFO_FIELD_JOB_ID = 1 << 7,
+        UNIT_INFO_FIELD_JOB_TYPE = 1 << 8,
+        UNIT_INFO_FIELD_JOB_PATH = 1 << 9,
+} UnitInfoField;
+
+#define UNIT_INFO_FIELDS_ALL ((1u << 10) - 1)
+
+/* Returns false and the offending name in ret_invalid if a field is unknown.
+ * An empty list selects all fields. */
+bool unit_info_fields_parse(char **fields, uint32_t *ret_mask, const char **ret_invalid);
+
+/* Matches the unit type, i.e. the suffix of the unit name, against types. An empty list matches all units. */
+bool unit_type_matches(const char *unit, char **types);
+
+/* Copies the units of a ListUnits style array in m to reply, dropping the units not matching types and
+ * blanking the fields not in mask */
+int unit_info_copy_filtered(sd_bus_message *reply, sd_bus_message *m, char **types, uint32_t mask);
+
+/* Same as unit_info_copy_filtered, but for the next unit of the array m is positioned in only.
+ * Returns > 0 if a unit was read, whether it matched or not, and 0 at the end of the array. */
+int unit_info_copy_filtered_next(sd_bus_message *reply, sd_bus_message *m, char **types, uint32_t mask);
+
+typedef struct UnitInfoFilter {
+        char **types;
+        uint32_t mask;
+} UnitInfoFilter;
+
+/* Takes ownership of types */
+UnitInfoFilter *unit_info_filter_new(char **types, uint32_t mask);
+void unit_info_filter_free(UnitInfoFilter *filter);
+
+/* A bulk_reply_copy_func applying the UnitInfoFilter passed as userdata */
+int unit_info_filter_copy_next(sd_bus_message *reply, sd_bus_message *m, void *userdata);
@@ -0,0 +1,190 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <hashmap.h>
+#include <string.h>
+
+#include "libbluechi/common/list.h"
+#include "libbluechi/common/string-util.h"
+
+#include "unit_state_window.h"
+
+typedef struct UnitStateWindow UnitStateWindow;
+
+/* Entry of the queue of windows ordered by deadline, outdated once its window is closed */
+struct UnitStateWindow {
+        char *unit_path;
+        uint64_t deadline;
+
+        LIST_FIELDS(UnitStateWindow, queue);
+};
+
+typedef struct UnitStateWindowUnit {
+        char *unit_path; /* key */
+        uint64_t deadline;
+        bool pending; /* A change is held back until the window ends */
+} UnitStateWindowUnit;
+
+struct UnitStateWindows {
+        struct hashmap *units;
+        LIST_HEAD(UnitStateWindow, queue);
+        UnitStateWindow *queue_tail;
+        uint64_t n_collapsed;
+};
+
+static void unit_state_window_free(UnitStateWindow *window) {
+        free(window->unit_path);
+        free(window);
+}
+
+static void unit_state_window_unit_clear(void *item) {
+        UnitStateWindowUnit *unit = item;
+        free(unit->unit_path);
+}
+
+static uint64_t unit_state_window_unit_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const UnitStateWindowUnit *unit = item;
+        return hashmap_sip(unit->unit_path, strlen(unit->unit_path), seed0, seed1);
+}
+
+static int unit_state_window_unit_compare(const void *a, const void *b, UNUSED void *udata) {
+        const UnitStateWindowUnit *unit_a = a;
+        const UnitStateWindowUnit *unit_b = b;
+
+        return strcmp(unit_a->unit_path, unit_b->unit_path);
+}
+
+UnitStateWindows *unit_state_windows_new(void) {
+        _cleanup_free_ UnitStateWindows *windows = malloc0(sizeof(UnitStateWindows));
+        if (windows == NULL) {
+                return NULL;
+        }
+
+        windows->units = hashmap_new(
+                        sizeof(UnitStateWindowUnit),
+                        0,
+                        0,
+                        0,
+                        unit_state_window_unit_hash,
+                        unit_state_window_unit_compare,
+                        unit_state_window_unit_clear,
+                        NULL);
+        if (windows->units == NULL) {
+                return NULL;
+        }
+        LIST_HEAD_INIT(windows->queue);
+
+        return steal_pointer(&windows);
+}
+
+void unit_state_windows_free(UnitStateWindows *windows) {
+        if (windows == NULL) {
+                return;
+        }
+
+        UnitStateWindow *window = NULL;
+        UnitStateWindow *next_window = NULL;
+        LIST_FOREACH_SAFE(queue, window, next_window, windows->queue) {
+                unit_state_window_free(window);
+        }
+        hashmap_free(windows->units);
+        free(windows);
+}
+
+static UnitStateWindowUnit *unit_state_windows_find(UnitStateWindows *windows, const char *unit_path) {
+        UnitStateWindowUnit key = { .unit_path = (char *) unit_path };
+        return (UnitStateWindowUnit *) hashmap_get(windows->units, &key);
+}
+
+bool unit_state_windows_hold(UnitStateWindows *windows, const char *unit_path, uint64_t now, uint64_t length) {
+        UnitStateWindowUnit *unit = unit_state_windows_find(windows, unit_path);
+        if (unit == NULL) {
+                /* Emitted anyway if the window can't be opened */
+                (void) unit_state_windows_open(windows, unit_path, now, length);
+                return false;
+        }
+
+        if (unit->pending) {
+                windows->n_collapsed++;
+        }
+        unit->pending = true;
+        return true;
+}
+
+bool unit_state_windows_open(UnitStateWindows *windows, const char *unit_path, uint64_t now, uint64_t length) {
+        _cleanup_free_ UnitStateWindow *window = malloc0(sizeof(UnitStateWindow));
+        if (window == NULL) {
+                return false;
+        }
+        window->unit_path = strdup(unit_path);
+        if (window->unit_path == NULL) {
+                return false;
+        }
+        window->deadline = now + length;
+
+        _cleanup_free_ char *unit_path_copy = strdup(unit_path);
+        if (unit_path_copy == NULL) {
+                free(window->unit_path);
+                return false;
+        }
+        UnitStateWindowUnit unit = { .unit_path = unit_path_copy, .deadline = window->deadline, .pending = false };
+        UnitStateWindowUnit *replaced = (UnitStateWindowUnit *) hashmap_set(windows->units, &unit);
+        if (replaced == NULL && hashmap_oom(windows->units)) {
+                free(window->unit_path);
+                return false;
+        }
+        steal_pointer(&unit_path_copy);
+        if (replaced != NULL) {
+                unit_state_window_unit_clear(replaced);
+        }
+
+        /* All windows have the same length, so appending keeps the queue ordered by deadline */
+        LIST_INIT(queue, window);
+        LIST_INSERT_AFTER(queue, windows->queue, windows->queue_tail, window);
+        windows->queue_tail = steal_pointer(&window);
+        return true;
+}
+
+bool unit_state_windows_close(UnitStateWindows *windows, const char *unit_path) {
+        UnitStateWindowUnit key = { .unit_path = (char *) unit_path };
+        UnitStateWindowUnit *unit = (UnitStateWindowUnit *) hashmap_delete(windows->units, &key);
+        if (unit == NULL) {
+                return false;
+        }
+
+        /* The queue entry is dropped once its deadline is reached */
+        bool pending = unit->pending;
+        unit_state_window_unit_clear(unit);
+        return pending;
+}
+
+char *unit_state_windows_expire(UnitStateWindows *windows, uint64_t now) {
+        UnitStateWindow *window = NULL;
+        while ((window = windows->queue) != NULL && window->deadline <= now) {
+                LIST_REMOVE(queue, windows->queue, window);
+                if (windows->queue_tail == window) {
+                        windows->queue_tail = NULL;
+                }
+
+                /* Skip entries of windows that were closed early */
+                UnitStateWindowUnit *unit = unit_state_windows_find(windows, window->unit_path);
+                if (unit != NULL && unit->deadline == window->deadline &&
+                    unit_state_windows_close(windows, window->unit_path)) {
+                        char *unit_path = steal_pointer(&window->unit_path);
+                        unit_state_window_free(window);
+                        return unit_path;
+                }
+                unit_state_window_free(window);
+        }
+        return NULL;
+}
+
+uint64_t unit_state_windows_get_next_deadline(UnitStateWindows *windows) {
+        return windows->queue != NULL ? windows->queue->deadline : 0;
+}
+
+uint64_t unit_state_windows_get_collapsed(UnitStateWindows *windows) {
+        return windows->n_collapsed;
+}
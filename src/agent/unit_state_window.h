@@ -0,0 +1,47 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include "libbluechi/common/common.h"
+
+/*
+ * Coalescing windows of UnitStateChanged, keyed by the object path of the unit.
+ * The first state change of a unit is emitted right away and opens a window.
+ * Further changes within the window are held back, and only the latest state
+ * is emitted once the window ends. A window is closed early when another
+ * event of the unit is emitted, so that the state is not reordered with it.
+ */
+typedef struct UnitStateWindows UnitStateWindows;
+
+UnitStateWindows *unit_state_windows_new(void);
+void unit_state_windows_free(UnitStateWindows *windows);
+
+/*
+ * Records a state change of the unit. Returns true if it is held back, or false if it
+ * must be emitted now, in which case a window ending at now + length is opened.
+ */
+bool unit_state_windows_hold(UnitStateWindows *windows, const char *unit_path, uint64_t now, uint64_t length);
+
+/* Opens a window ending at now + length, all windows are expected to have the same length */
+bool unit_state_windows_open(UnitStateWindows *windows, const char *unit_path, uint64_t now, uint64_t length);
+
+/* Closes the window of the unit, returns true if a change was held back in it */
+bool unit_state_windows_close(UnitStateWindows *windows, const char *unit_path);
+
+/*
+ * Closes the windows that ended by now, up to the first one holding back a change,
+ * and returns the path of its unit. Returns NULL if no ended window holds a change.
+ */
+char *unit_state_windows_expire(UnitStateWindows *windows, uint64_t now);
+
+/* End of the window that ends first, 0 if no window is open */
+uint64_t unit_state_windows_get_next_deadline(UnitStateWindows *windows);
+
+/* Number of held back changes that were replaced by a later one */
+uint64_t unit_state_windows_get_collapsed(UnitStateWindows *windows);
+
+DEFINE_CLEANUP_FUNC(UnitStateWindows, unit_state_windows_free)
+#define _cleanup_unit_state_windows_ _cleanup_(unit_state_windows_freep)
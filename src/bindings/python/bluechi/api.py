@@ -147,6 +147,16 @@ class Agent(ApiBase):
             dbus_address,
         )
 
+    @property
+    def collapsed_unit_state_changes(self) -> UInt64:
+        """
+          CollapsedUnitStateChanges:
+
+        The number of unit state changes that were collapsed into a later one within the window set
+        by UnitStateCoalesceWindow and therefore not sent to the BlueChi controller.
+        """
+        return self.get_proxy().CollapsedUnitStateChanges
+
     @property
     def controller_address(self) -> str:
         """
@@ -263,6 +273,26 @@ class Agent(ApiBase):
 
         self.get_properties_proxy().PropertiesChanged.connect(on_properties_changed)
 
+    @property
+    def unit_property_cache_hits(self) -> UInt64:
+        """
+          UnitPropertyCacheHits:
+
+        The number of GetUnitProperty and GetUnitProperties requests answered from the unit properties
+        cached within the time set by UnitPropertyCacheTTL.
+        """
+        return self.get_proxy().UnitPropertyCacheHits
+
+    @property
+    def unit_property_cache_misses(self) -> UInt64:
+        """
+          UnitPropertyCacheMisses:
+
+        The number of GetUnitProperty and GetUnitProperties requests that had to query systemd while
+        the cache set by UnitPropertyCacheTTL is enabled.
+        """
+        return self.get_proxy().UnitPropertyCacheMisses
+
 
 class Controller(ApiBase):
     """
@@ -335,6 +365,20 @@ class Controller(ApiBase):
         """
         return self.get_proxy().ListUnitFiles()
 
+    def list_unit_files_stream(self, timeout: UInt64) -> UInt32:
+        """
+          ListUnitFilesStream:
+        @timeout: The time in microseconds to wait for each node, 0 for the default
+        @id: The id of the listing, used in the UnitFilesListed and ListDone signals
+
+        List all systemd unit files on all nodes which are online, without waiting for all nodes to answer. The unit files
+        of each node are emitted in a UnitFilesListed signal to the caller as soon as the node answered, followed by a
+        ListDone signal once all nodes answered, failed or timed out.
+        """
+        return self.get_proxy().ListUnitFilesStream(
+            timeout,
+        )
+
     def list_units(
         self,
     ) -> Dict[
@@ -358,6 +402,132 @@ class Controller(ApiBase):
         """
         return self.get_proxy().ListUnits()
 
+    def list_units_cached(self, refresh: bool) -> Tuple[
+        Dict[
+            str,
+            List[Tuple[str, str, str, str, str, str, ObjPath, UInt32, str, ObjPath]],
+        ],
+        Dict[str, UInt64],
+    ]:
+        """
+          ListUnitsCached:
+        @refresh: List the units of all nodes again instead of using the cached units
+        @units: A dictionary for all nodes with the respective name and a list of all units on it, same as for ListUnits
+        @timestamps: A dictionary for all nodes with the respective name and the time of the last full listing of its units
+          in microseconds since epoch
+
+        List all loaded systemd units on all nodes which are online from the unit tables kept by the controller. Only nodes
+        which have not been listed yet or got disconnected since are asked for their units, unless refresh is set.
+        The unit states are kept up to date, all other fields reflect the last full listing.
+        """
+        return self.get_proxy().ListUnitsCached(
+            refresh,
+        )
+
+    def list_units_filtered(
+        self,
+        states: List[str],
+        patterns: List[str],
+        types: List[str],
+        fields: List[str],
+    ) -> Dict[
+        str, List[Tuple[str, str, str, str, str, str, ObjPath, UInt32, str, ObjPath]]
+    ]:
+        """
+          ListUnitsFiltered:
+        @states: Only list units in one of these load, active or sub states, all units if empty
+        @patterns: Only list units with a name matching one of these glob patterns, all units if empty
+        @types: Only list units of one of these types (e.g. service, socket), all units if empty
+        @fields: The fields to fill in, all fields if empty. The unit name is always filled in, the other fields are
+          left empty ("", "/" or 0) unless requested. Valid fields are name, description, load_state, active_state,
+          sub_state, following, object_path, job_id, job_type and job_path.
+        @units: A dictionary for all nodes with the respective name and a list of the matching units on it, same as for
+          ListUnits
+
+        List the loaded systemd units matching the filter on all nodes which are online. The filter is evaluated on the
+        nodes, so only the matching units and requested fields are transferred.
+        """
+        return self.get_proxy().ListUnitsFiltered(
+            states,
+            patterns,
+            types,
+            fields,
+        )
+
+    def list_units_stream(self, timeout: UInt64) -> UInt32:
+        """
+          ListUnitsStream:
+        @timeout: The time in microseconds to wait for each node, 0 for the default
+        @id: The id of the listing, used in the UnitsListed and ListDone signals
+
+        List all loaded systemd units on all nodes which are online, without waiting for all nodes to answer. The units of
+        each node are emitted in a UnitsListed signal to the caller as soon as the node answered, followed by a ListDone
+        signal once all nodes answered, failed or timed out.
+        """
+        return self.get_proxy().ListUnitsStream(
+            timeout,
+        )
+
+    def reload_unit_on_nodes(
+        self,
+        nodes: str,
+        name: str,
+        mode: str,
+        parallelism: UInt32,
+        batch_size: UInt32,
+        max_failures: UInt32,
+    ) -> ObjPath:
+        """
+          ReloadUnitOnNodes:
+        @nodes: Glob of the node names, empty or "*" for all nodes
+        @name: The name of the unit to reload
+        @mode: The mode used to reload the unit, see Node.ReloadUnit
+        @parallelism: Maximum number of nodes working on the unit at the same time, 0 for the whole batch
+        @batch_size: Number of nodes in each wave, 0 for all nodes in one wave
+        @max_failures: Number of failed nodes tolerated before no further nodes are started
+        @job: The path of the aggregate job
+
+        Reload the unit on all nodes matching the glob, see StartUnitOnNodes.
+        """
+        return self.get_proxy().ReloadUnitOnNodes(
+            nodes,
+            name,
+            mode,
+            parallelism,
+            batch_size,
+            max_failures,
+        )
+
+    def restart_unit_on_nodes(
+        self,
+        nodes: str,
+        name: str,
+        mode: str,
+        parallelism: UInt32,
+        batch_size: UInt32,
+        max_failures: UInt32,
+    ) -> ObjPath:
+        """
+          RestartUnitOnNodes:
+        @nodes: Glob of the node names, empty or "*" for all nodes
+        @name: The name of the unit to restart
+        @mode: The mode used to restart the unit, see Node.RestartUnit
+        @parallelism: Maximum number of nodes working on the unit at the same time, 0 for the whole batch
+        @batch_size: Number of nodes in each wave, 0 for all nodes in one wave
+        @max_failures: Number of failed nodes tolerated before no further nodes are started
+        @job: The path of the aggregate job
+
+        Restart the unit on all nodes matching the glob, see StartUnitOnNodes.
+        """
+        return self.get_proxy().RestartUnitOnNodes(
+            nodes,
+            name,
+            mode,
+            parallelism,
+            batch_size,
+            max_failures,
+        )
+
     def set_log_level(self, loglevel: str) -> None:
         """
           SetLogLevel:
@@ -369,6 +539,94 @@ class Controller(ApiBase):
             loglevel,
         )
 
+    def start_unit_on_nodes(
+        self,
+        nodes: str,
+        name: str,
+        mode: str,
+        parallelism: UInt32,
+        batch_size: UInt32,
+        max_failures: UInt32,
+    ) -> ObjPath:
+        """
+          StartUnitOnNodes:
+        @nodes: Glob of the node names, empty or "*" for all nodes
+        @name: The name of the unit to start
+        @mode: The mode used to start the unit, see Node.StartUnit
+        @parallelism: Maximum number of nodes working on the unit at the same time, 0 for the whole batch
+        @batch_size: Number of nodes in each wave, 0 for all nodes in one wave
+        @max_failures: Number of failed nodes tolerated before no further nodes are started
+        @job: The path of the aggregate job
+
+        Start the unit on all nodes matching the glob. The nodes are processed in waves of batch_size nodes, and the next wave
+        only starts once all nodes of the previous wave are done. Once more than max_failures nodes failed, no further nodes
+        are started. The aggregate job lists the job and result of each node in its Children property and is removed with
+        the result done, failed or canceled once all started jobs are done. Cancelling it cancels the jobs on all nodes.
+        """
+        return self.get_proxy().StartUnitOnNodes(
+            nodes,
+            name,
+            mode,
+            parallelism,
+            batch_size,
+            max_failures,
+        )
+
+    def stop_unit_on_nodes(
+        self,
+        nodes: str,
+        name: str,
+        mode: str,
+        parallelism: UInt32,
+        batch_size: UInt32,
+        max_failures: UInt32,
+    ) -> ObjPath:
+        """
+          StopUnitOnNodes:
+        @nodes: Glob of the node names, empty or "*" for all nodes
+        @name: The name of the unit to stop
+        @mode: The mode used to stop the unit, see Node.StopUnit
+        @parallelism: Maximum number of nodes working on the unit at the same time, 0 for the whole batch
+        @batch_size: Number of nodes in each wave, 0 for all nodes in one wave
+        @max_failures: Number of failed nodes tolerated before no further nodes are started
+        @job: The path of the aggregate job
+
+        Stop the unit on all nodes matching the glob, see StartUnitOnNodes.
+        """
+        return self.get_proxy().StopUnitOnNodes(
+            nodes,
+            name,
+            mode,
+            parallelism,
+            batch_size,
+            max_failures,
+        )
+
+    def on_job_group_removed(
+        self,
+        callback: Callable[
+            [
+                UInt32,
+                ObjPath,
+                str,
+                str,
+                List[Tuple[str, UInt32, str]],
+            ],
+            None,
+        ],
+    ) -> None:
+        """
+          JobGroupRemoved:
+        @id: The id of the job group
+        @group: The path of the job group
+        @node: The name of the node the jobs were on
+        @job_type: The type of the jobs
+        @jobs: The unit, job id and result of each job of the group
+
+        Emitted once all jobs of a job group finished. Units for which no job could be queued have the result failed.
+        """
+        self.get_proxy().JobGroupRemoved.connect(callback)
+
     def on_job_new(
         self,
         callback: Callable[
@@ -415,6 +673,76 @@ class Controller(ApiBase):
         """
         self.get_proxy().JobRemoved.connect(callback)
 
+    def on_list_done(
+        self,
+        callback: Callable[
+            [
+                UInt32,
+                Dict[str, str],
+            ],
+            None,
+        ],
+    ) -> None:
+        """
+          ListDone:
+        @id: The id returned by ListUnitsStream or ListUnitFilesStream
+        @errors: A dictionary with the name and the error message of each node that failed or timed out
+
+        Emitted to the caller of ListUnitsStream or ListUnitFilesStream once all nodes are done.
+        """
+        self.get_proxy().ListDone.connect(callback)
+
+    def on_unit_files_listed(
+        self,
+        callback: Callable[
+            [
+                UInt32,
+                str,
+                List[Tuple[str, str]],
+            ],
+            None,
+        ],
+    ) -> None:
+        """
+          UnitFilesListed:
+        @id: The id returned by ListUnitFilesStream
+        @node: The name of the node
+        @unitfiles: A list of all unit files on the node, same as for ListUnitFiles
+
+        Emitted to the caller of ListUnitFilesStream for each node that answered.
+        """
+        self.get_proxy().UnitFilesListed.connect(callback)
+
+    def on_units_listed(
+        self,
+        callback: Callable[
+            [
+                UInt32,
+                str,
+                List[Tuple[str, str, str, str, str, str, ObjPath, UInt32, str, ObjPath]],
+            ],
+            None,
+        ],
+    ) -> None:
+        """
+          UnitsListed:
+        @id: The id returned by ListUnitsStream
+        @node: The name of the node
+        @units: A list of all units on the node, same as for ListUnits
+
+        Emitted to the caller of ListUnitsStream for each node that answered.
+        """
+        self.get_proxy().UnitsListed.connect(callback)
+
+    @property
+    def fleet_requests_in_flight(self) -> UInt32:
+        """
+          FleetRequestsInFlight:
+
+        The number of requests to all nodes, such as ListUnits, that are currently processed.
+        """
+        return self.get_proxy().FleetRequestsInFlight
+
     @property
     def log_level(self) -> str:
         """
@@ -435,6 +763,25 @@ class Controller(ApiBase):
         """
         return self.get_proxy().LogTarget
 
+    @property
+    def queued_fleet_requests(self) -> UInt32:
+        """
+          QueuedFleetRequests:
+
+        The number of requests to all nodes that wait for one of the MaxFleetRequests in progress to finish.
+        """
+        return self.get_proxy().QueuedFleetRequests
+
+    @property
+    def rejected_fleet_requests(self) -> UInt64:
+        """
+          RejectedFleetRequests:
+
+        The number of requests to all nodes that were rejected with the org.eclipse.bluechi.TooManyRequests
+        error as MaxQueuedFleetRequests were queued already.
+        """
+        return self.get_proxy().RejectedFleetRequests
+
     @property
     def status(self) -> str:
         """
@@ -474,6 +821,16 @@ class Controller(ApiBase):
 
         self.get_properties_proxy().PropertiesChanged.connect(on_properties_changed)
 
+    @property
+    def throttled_requests(self) -> UInt64:
+        """
+          ThrottledRequests:
+
+        The number of requests to the public API that were rejected with the org.eclipse.bluechi.RateLimited
+        error as the client exceeded the APIRequestRate.
+        """
+        return self.get_proxy().ThrottledRequests
+
 
 class Job(ApiBase):
     """
@@ -499,6 +856,17 @@ class Job(ApiBase):
         """
         self.get_proxy().Cancel()
 
+    @property
+    def children(self) -> List[Tuple[str, ObjPath, str]]:
+        """
+          Children:
+
+        For the aggregate job of an operation on several nodes (e.g. Controller.StartUnitOnNodes), the node name, the path of
+        the job on the node ("/" if none was started) and its result ("" while pending) of each targeted node. Empty for all
+        other jobs, whose Node property is never empty.
+        """
+        return self.get_proxy().Children
+
     @property
     def id(self) -> UInt32:
         """
@@ -565,6 +933,67 @@ class Job(ApiBase):
         return self.get_proxy().Unit
 
 
+class JobGroup(ApiBase):
+    """
+    org.eclipse.bluechi.JobGroup:
+    @short_description: Public interface of BlueChi on the managing node for groups of jobs.
+
+    This interface is used to follow and cancel the jobs of several units on one node as a whole. The group exists until
+    all of its jobs finished and the JobGroupRemoved signal of the controller has been emitted.
+    """
+
+    def __init__(
+        self, group_path: ObjPath, bus: MessageBus = None, use_systembus=True
+    ) -> None:
+        super().__init__(BC_DBUS_INTERFACE, group_path, bus, use_systembus)
+
+        self.group_path = group_path
+
+    def cancel(self) -> None:
+        """
+          Cancel:
+
+        Cancels all jobs of the group that did not finish yet.
+        """
+        self.get_proxy().Cancel()
+
+    @property
+    def id(self) -> UInt32:
+        """
+          Id:
+
+        An integer giving the id of the job group.
+        """
+        return self.get_proxy().Id
+
+    @property
+    def job_type(self) -> str:
+        """
+          JobType:
+
+        Type of the jobs, e.g. start.
+        """
+        return self.get_proxy().JobType
+
+    @property
+    def jobs(self) -> List[Tuple[str, UInt32, str]]:
+        """
+          Jobs:
+
+        The unit, job id and result of each job of the group. The result is empty while the job is pending.
+        """
+        return self.get_proxy().Jobs
+
+    @property
+    def node(self) -> str:
+        """
+          Node:
+
+        The name of the node the jobs are on.
+        """
+        return self.get_proxy().Node
+
+
 class Metrics(ApiBase):
     """
     org.eclipse.bluechi.Metrics:
@@ -705,6 +1134,26 @@ class Monitor(ApiBase):
             units,
         )
 
+    def subscribe_properties(
+        self, node: str, units: List[str], properties: List[str]
+    ) -> UInt32:
+        """
+            SubscribeProperties:
+          @node: The name of the node to subscribe to
+          @units: A list of unit names to subscribe to
+          @properties: A list of property names to receive in UnitPropertiesChanged
+          @id: The id of the created subscription
+
+          Subscribe to changes of a list of units on a node like SubscribeList, but only forward the given properties in UnitPropertiesChanged. The
+        agent only sends the properties that any subscription for the same unit requires, the controller then drops the ones this subscription
+        didn't ask for. An empty list of properties forwards all properties.
+        """
+        return self.get_proxy().SubscribeProperties(
+            node,
+            units,
+            properties,
+        )
+
     def unsubscribe(self, id: UInt32) -> None:
         """
           Unsubscribe:
@@ -998,6 +1447,33 @@ class Node(ApiBase):
         """
         return self.get_proxy().ListUnits()
 
+    def list_units_filtered(
+        self,
+        states: List[str],
+        patterns: List[str],
+        types: List[str],
+        fields: List[str],
+    ) -> List[Tuple[str, str, str, str, str, str, ObjPath, UInt32, str, ObjPath]]:
+        """
+          ListUnitsFiltered:
+        @states: Only list units in one of these load, active or sub states, all units if empty
+        @patterns: Only list units with a name matching one of these glob patterns, all units if empty
+        @types: Only list units of one of these types (e.g. service, socket), all units if empty
+        @fields: The fields to fill in, all fields if empty. The unit name is always filled in, the other fields are
+          left empty ("", "/" or 0) unless requested. Valid fields are name, description, load_state, active_state,
+          sub_state, following, object_path, job_id, job_type and job_path.
+        @units: A list of the matching units on the node, same as for ListUnits
+
+        List the loaded systemd units matching the filter. The filter is evaluated on the node, so only the matching units
+        and requested fields are transferred.
+        """
+        return self.get_proxy().ListUnitsFiltered(
+            states,
+            patterns,
+            types,
+            fields,
+        )
+
     def reload(self) -> None:
         """
           Reload:
@@ -1051,6 +1527,38 @@ class Node(ApiBase):
             mode,
         )
 
+    def restart_unit_group(
+        self, names: List[str], mode: str, export_jobs: bool
+    ) -> ObjPath:
+        """
+          RestartUnitGroup:
+        @names: The names of the units to restart
+        @mode: The mode used to restart the units
+        @export_jobs: Whether the jobs of the group get their own D-Bus objects and signals
+        @group: The path of the job group
+
+        RestartUnitGroup() is similar to StartUnitGroup() but restarts the specified units rather than starting them.
+        """
+        return self.get_proxy().RestartUnitGroup(
+            names,
+            mode,
+            export_jobs,
+        )
+
+    def restart_units(self, names: List[str], mode: str) -> List[Tuple[ObjPath, str]]:
+        """
+          RestartUnits:
+        @names: The names of the units to restart
+        @mode: The mode used to restart the units
+        @jobs: The path for the job of each unit and an error, in the order of the names
+
+        RestartUnits() is similar to StartUnits() but restarts the specified units rather than starting them.
+        """
+        return self.get_proxy().RestartUnits(
+            names,
+            mode,
+        )
+
     def set_default_target(
         self, defaulttarget: str, force: bool
     ) -> List[Tuple[str, str, str]]:
@@ -1139,6 +1647,41 @@ class Node(ApiBase):
             mode,
         )
 
+    def start_unit_group(
+        self, names: List[str], mode: str, export_jobs: bool
+    ) -> ObjPath:
+        """
+          StartUnitGroup:
+        @names: The names of the units to start
+        @mode: The mode used to start the units
+        @export_jobs: Whether the jobs of the group get their own D-Bus objects and signals
+        @group: The path of the job group
+
+        StartUnitGroup() is similar to StartUnits() but returns a single job group. Once all of its jobs finished, a single
+        JobGroupRemoved signal with the results of all units is emitted on the controller. Without export_jobs, the jobs of the
+        group get no D-Bus object and no JobNew and JobRemoved signals.
+        """
+        return self.get_proxy().StartUnitGroup(
+            names,
+            mode,
+            export_jobs,
+        )
+
+    def start_units(self, names: List[str], mode: str) -> List[Tuple[ObjPath, str]]:
+        """
+          StartUnits:
+        @names: The names of the units to start
+        @mode: The mode used to start the units
+        @jobs: The path for the job of each unit and an error, in the order of the names
+
+        StartUnits() is similar to StartUnit() but queues the jobs of all named units on this node with a single request.
+        For each unit, either the path of its job and an empty error is returned, or "/" and the reason why no job was queued.
+        """
+        return self.get_proxy().StartUnits(
+            names,
+            mode,
+        )
+
     def stop_unit(self, name: str, mode: str) -> ObjPath:
         """
           StopUnit:
@@ -1153,6 +1696,38 @@ class Node(ApiBase):
             mode,
         )
 
+    def stop_unit_group(
+        self, names: List[str], mode: str, export_jobs: bool
+    ) -> ObjPath:
+        """
+          StopUnitGroup:
+        @names: The names of the units to stop
+        @mode: The mode used to stop the units
+        @export_jobs: Whether the jobs of the group get their own D-Bus objects and signals
+        @group: The path of the job group
+
+        StopUnitGroup() is similar to StartUnitGroup() but stops the specified units rather than starting them.
+        """
+        return self.get_proxy().StopUnitGroup(
+            names,
+            mode,
+            export_jobs,
+        )
+
+    def stop_units(self, names: List[str], mode: str) -> List[Tuple[ObjPath, str]]:
+        """
+          StopUnits:
+        @names: The names of the units to stop
+        @mode: The mode used to stop the units
+        @jobs: The path for the job of each unit and an error, in the order of the names
+
+        StopUnits() is similar to StartUnits() but stops the specified units rather than starting them.
+        """
+        return self.get_proxy().StopUnits(
+            names,
+            mode,
+        )
+
     def thaw_unit(self, name: str) -> None:
         """
           ThawUnit:
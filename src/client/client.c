@@ -38,22 +38,38 @@ void client_unref(Client *client) {
 }
 
 sd_bus_message *client_wait_for_job(Client *client, char *object_path) {
+        sd_bus_message *result = NULL;
+
+        if (client_wait_for_jobs(client, &object_path, 1, &result) < 0) {
+                return NULL;
+        }
+        return result;
+}
+
+/* Waits until the JobRemoved signals of all jobs arrived, ret_results[i] is set to the one of object_paths[i] */
+int client_wait_for_jobs(Client *client, char **object_paths, size_t n_jobs, sd_bus_message **ret_results) {
         int r = 0;
 
-        assert(client->pending_job_name == NULL);
-        client->pending_job_name = object_path;
+        assert(client->pending_job_names == NULL);
+        client->pending_job_names = object_paths;
+        client->pending_job_results = ret_results;
+        client->n_pending_jobs = n_jobs;
+        client->n_pending_job_results = 0;
+        for (size_t i = 0; i < n_jobs; i++) {
+                ret_results[i] = NULL;
+        }
 
         for (;;) {
+                /* Did we get all results? */
+                if (client->n_pending_job_results == client->n_pending_jobs) {
+                        break;
+                }
+
                 /* Process requests */
                 r = sd_bus_process(client->api_bus, NULL);
                 if (r < 0) {
                         fprintf(stderr, "Failed to process bus: %s\n", strerror(-r));
-                        return NULL;
-                }
-
-                /* Did we get the result? */
-                if (client->pending_job_result != NULL) {
-                        return steal_pointer(&client->pending_job_result);
+                        break;
                 }
 
                 if (r > 0) { /* request processed, try to process another one */
@@ -64,9 +80,20 @@ sd_bus_message *client_wait_for_job(Client *client, char *object_path) {
                 r = sd_bus_wait(client->api_bus, (uint64_t) -1);
                 if (r < 0) {
                         fprintf(stderr, "Failed to wait on bus: %s\n", strerror(-r));
-                        return NULL;
+                        break;
+                }
+        }
+
+        client->pending_job_names = NULL;
+        client->pending_job_results = NULL;
+        client->n_pending_jobs = 0;
+        if (r < 0) {
+                for (size_t i = 0; i < n_jobs; i++) {
+                        sd_bus_message_unrefp(&ret_results[i]);
                 }
+                return r;
         }
+        return 0;
 }
 
 int match_job_removed_signal(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
@@ -75,7 +102,7 @@ int match_job_removed_signal(sd_bus_message *m, void *userdata, UNUSED sd_bus_er
         int r = 0;
         Client *client = (Client *) userdata;
 
-        if (client->pending_job_name == NULL) {
+        if (client->pending_job_names == NULL) {
                 return 0;
         }
 
@@ -87,9 +114,12 @@ int match_job_removed_signal(sd_bus_message *m, void *userdata, UNUSED sd_bus_er
 
         (void) sd_bus_message_rewind(m, true);
 
-        if (streq(client->pending_job_name, job_path)) {
-                client->pending_job_result = sd_bus_message_ref(m);
-                return 1;
+        for (size_t i = 0; i < client->n_pending_jobs; i++) {
+                if (client->pending_job_results[i] == NULL && streq(client->pending_job_names[i], job_path)) {
+                        client->pending_job_results[i] = sd_bus_message_ref(m);
+                        client->n_pending_job_results++;
+                        return 1;
+                }
         }
 
         return 0;
@@ -16,8 +16,11 @@ struct Client {
         sd_bus *api_bus;
         char *object_path;
 
-        char *pending_job_name;
-        sd_bus_message *pending_job_result;
+        /* Jobs whose JobRemoved signal is awaited and the signals received so far */
+        char **pending_job_names;
+        sd_bus_message **pending_job_results;
+        size_t n_pending_jobs;
+        size_t n_pending_job_results;
 };
 
 Client *new_client();
@@ -26,6 +29,7 @@ void client_unref(Client *client);
 int client_open_sd_bus(Client *client);
 
 sd_bus_message *client_wait_for_job(Client *client, char *object_path);
+int client_wait_for_jobs(Client *client, char **object_paths, size_t n_jobs, sd_bus_message **ret_results);
 int match_job_removed_signal(sd_bus_message *m, void *userdata, sd_bus_error *error);
 
 DEFINE_CLEANUP_FUNC(Client, client_unref)
@@ -47,11 +47,11 @@ const Method methods[] = {
         { "list-unit-files", 0, 1,       OPT_FILTER,                              method_list_unit_files,    usage_method_list_unit_files    },
         { "is-enabled",      2, 2,       OPT_NONE,                                method_is_enabled,         usage_method_is_enabled         },
         { "list-units",      0, 1,       OPT_FILTER,                              method_list_units,         usage_method_list_units         },
-        { "start",           2, 2,       OPT_NONE,                                method_start,              usage_method_lifecycle          },
-        { "stop",            2, 2,       OPT_NONE,                                method_stop,               usage_method_lifecycle          },
+        { "start",           2, ARG_ANY, OPT_NONE,                                method_start,              usage_method_lifecycle          },
+        { "stop",            2, ARG_ANY, OPT_NONE,                                method_stop,               usage_method_lifecycle          },
         { "freeze",          2, 2,       OPT_NONE,                                method_freeze,             usage_method_freeze             },
         { "thaw",            2, 2,       OPT_NONE,                                method_thaw,               usage_method_thaw               },
-        { "restart",         2, 2,       OPT_NONE,                                method_restart,            usage_method_lifecycle          },
+        { "restart",         2, ARG_ANY, OPT_NONE,                                method_restart,            usage_method_lifecycle          },
         { "reload",          2, 2,       OPT_NONE,                                method_reload,             usage_method_lifecycle          },
         { "reset-failed",    0, ARG_ANY, OPT_NONE,                                method_reset_failed,       usage_method_reset_failed       },
         { "kill",            2, 2,       OPT_KILL_WHOM | OPT_SIGNAL,              method_kill,               usage_method_kill               },
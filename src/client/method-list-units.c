@@ -65,7 +65,139 @@ static int parse_unit_list(sd_bus_message *message, const char *node_name, UnitL
         return r;
 }
 
-static int method_list_units_on_all(sd_bus *api_bus, print_unit_list_fn print, const char *glob_filter) {
+/* State of a streamed listing of the units of all nodes, printed as the nodes answer */
+typedef struct UnitListStream {
+        uint32_t id;
+        bool done;
+        int n_failed_nodes;
+        const char *glob_filter;
+
+        bool header_printed;
+        unsigned long max_node_len;
+        unsigned long max_id_len;
+        unsigned long max_active_len;
+        unsigned long max_sub_len;
+} UnitListStream;
+
+static void print_unit_list_stream(UnitListStream *stream, UnitList *unit_list) {
+        UnitInfo *unit = NULL;
+        const char col_sep[] = " | ";
+
+        /* Columns only grow, later nodes with longer names can't be aligned with what is already printed */
+        LIST_FOREACH(units, unit, unit_list->units) {
+                stream->max_node_len = umaxl(stream->max_node_len, strlen(unit->node));
+                stream->max_id_len = umaxl(stream->max_id_len, strlen(unit->id));
+                stream->max_active_len = umaxl(stream->max_active_len, strlen(unit->active_state));
+                stream->max_sub_len = umaxl(stream->max_sub_len, strlen(unit->sub_state));
+        }
+
+        if (!stream->header_printed) {
+                unsigned long max_line_len = stream->max_node_len + strlen(col_sep) + stream->max_id_len +
+                                strlen(col_sep) + stream->max_active_len + strlen(col_sep) + stream->max_sub_len;
+                char sep_line[max_line_len + 1];
+
+                printf("%-*s%s%-*s%s%-*s%s%-*s\n",
+                       (int) stream->max_node_len,
+                       "NODE",
+                       col_sep,
+                       (int) stream->max_id_len,
+                       "ID",
+                       col_sep,
+                       (int) stream->max_active_len,
+                       "ACTIVE",
+                       col_sep,
+                       (int) stream->max_sub_len,
+                       "SUB");
+                memset(&sep_line, '=', sizeof(char) * max_line_len);
+                sep_line[max_line_len] = '\0';
+                printf("%s\n", sep_line);
+                stream->header_printed = true;
+        }
+
+        LIST_FOREACH(units, unit, unit_list->units) {
+                if (stream->glob_filter == NULL || match_glob(unit->id, stream->glob_filter)) {
+                        printf("%-*s%s%-*s%s%-*s%s%-*s\n",
+                               (int) stream->max_node_len,
+                               unit->node,
+                               col_sep,
+                               (int) stream->max_id_len,
+                               unit->id,
+                               col_sep,
+                               (int) stream->max_active_len,
+                               unit->active_state,
+                               col_sep,
+                               (int) stream->max_sub_len,
+                               unit->sub_state);
+                }
+        }
+        fflush(stdout);
+}
+
+static int on_units_listed_signal(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
+        UnitListStream *stream = userdata;
+        const char *node_name = NULL;
+        uint32_t id = 0;
+
+        int r = sd_bus_message_read(m, "us", &id, &node_name);
+        if (r < 0) {
+                fprintf(stderr, "Can't parse units listed signal: %s\n", strerror(-r));
+                return 0;
+        }
+        if (id != stream->id) {
+                return 0;
+        }
+
+        _cleanup_unit_list_ UnitList *unit_list = new_unit_list();
+        if (unit_list == NULL) {
+                fprintf(stderr, "Failed to create unit list, OOM\n");
+                return 0;
+        }
+        r = parse_unit_list(m, node_name, unit_list);
+        if (r < 0) {
+                stream->n_failed_nodes++;
+                return 0;
+        }
+
+        print_unit_list_stream(stream, unit_list);
+        return 0;
+}
+
+static int on_list_done_signal(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
+        UnitListStream *stream = userdata;
+        uint32_t id = 0;
+
+        int r = sd_bus_message_read(m, "u", &id);
+        if (r < 0) {
+                fprintf(stderr, "Can't parse list done signal: %s\n", strerror(-r));
+                return 0;
+        }
+        if (id != stream->id) {
+                return 0;
+        }
+        stream->done = true;
+
+        r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{ss}");
+        if (r < 0) {
+                fprintf(stderr, "Can't parse list done signal: %s\n", strerror(-r));
+                stream->n_failed_nodes++;
+                return 0;
+        }
+        for (;;) {
+                const char *node_name = NULL;
+                const char *message = NULL;
+                r = sd_bus_message_read(m, "{ss}", &node_name, &message);
+                if (r <= 0) {
+                        break;
+                }
+                fprintf(stderr, "Failed to list units of node %s: %s\n", node_name, message);
+                stream->n_failed_nodes++;
+        }
+
+        return 0;
+}
+
+/* Controllers without ListUnitsStream only answer once all nodes did */
+static int method_list_units_on_all_at_once(sd_bus *api_bus, print_unit_list_fn print, const char *glob_filter) {
         int r = 0;
         _cleanup_unit_list_ UnitList *unit_list = new_unit_list();
         if (unit_list == NULL) {
@@ -126,14 +258,43 @@ static int method_list_units_on_all(sd_bus *api_bus, print_unit_list_fn print, c
         return 0;
 }
 
-static int method_list_units_on(
-                sd_bus *api_bus, const char *node_name, print_unit_list_fn print, const char *glob_filter) {
+static int method_list_units_on_all(sd_bus *api_bus, print_unit_list_fn print, const char *glob_filter) {
         int r = 0;
-        _cleanup_unit_list_ UnitList *unit_list = new_unit_list();
+        UnitListStream stream = {
+                .glob_filter = glob_filter,
+                .max_node_len = strlen("NODE"),
+                .max_id_len = strlen("ID"),
+                .max_active_len = strlen("ACTIVE"),
+                .max_sub_len = strlen("SUB"),
+        };
+
+        _cleanup_sd_bus_slot_ sd_bus_slot *listed_slot = NULL;
+        r = sd_bus_match_signal(
+                        api_bus,
+                        &listed_slot,
+                        BC_INTERFACE_BASE_NAME,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "UnitsListed",
+                        on_units_listed_signal,
+                        &stream);
+        if (r < 0) {
+                fprintf(stderr, "Failed to match signal: %s\n", strerror(-r));
+                return r;
+        }
 
-        _cleanup_free_ char *object_path = NULL;
-        r = assemble_object_path_string(NODE_OBJECT_PATH_PREFIX, node_name, &object_path);
+        _cleanup_sd_bus_slot_ sd_bus_slot *done_slot = NULL;
+        r = sd_bus_match_signal(
+                        api_bus,
+                        &done_slot,
+                        BC_INTERFACE_BASE_NAME,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "ListDone",
+                        on_list_done_signal,
+                        &stream);
         if (r < 0) {
+                fprintf(stderr, "Failed to match signal: %s\n", strerror(-r));
                 return r;
         }
 
@@ -142,12 +303,101 @@ static int method_list_units_on(
         r = sd_bus_call_method(
                         api_bus,
                         BC_INTERFACE_BASE_NAME,
-                        object_path,
-                        NODE_INTERFACE,
-                        "ListUnits",
+                        BC_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "ListUnitsStream",
                         &error,
                         &message,
-                        "");
+                        "t",
+                        (uint64_t) 0);
+        if (r < 0 && sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+                return method_list_units_on_all_at_once(api_bus, print, glob_filter);
+        }
+        if (r < 0) {
+                fprintf(stderr, "Failed to issue method call: %s\n", error.message);
+                return r;
+        }
+
+        r = sd_bus_message_read(message, "u", &stream.id);
+        if (r < 0) {
+                fprintf(stderr, "Failed to parse response message: %s\n", strerror(-r));
+                return r;
+        }
+
+        /* Print the units of each node as soon as it answered */
+        while (!stream.done) {
+                r = sd_bus_process(api_bus, NULL);
+                if (r < 0) {
+                        fprintf(stderr, "Failed to process bus: %s\n", strerror(-r));
+                        return r;
+                }
+                if (r > 0) {
+                        continue;
+                }
+
+                r = sd_bus_wait(api_bus, (uint64_t) -1);
+                if (r < 0) {
+                        fprintf(stderr, "Failed to wait on bus: %s\n", strerror(-r));
+                        return r;
+                }
+        }
+
+        return stream.n_failed_nodes > 0 ? -EIO : 0;
+}
+
+static int method_list_units_on(
+                sd_bus *api_bus, const char *node_name, print_unit_list_fn print, const char *glob_filter) {
+        int r = 0;
+        _cleanup_unit_list_ UnitList *unit_list = new_unit_list();
+
+        _cleanup_free_ char *object_path = NULL;
+        r = assemble_object_path_string(NODE_OBJECT_PATH_PREFIX, node_name, &object_path);
+        if (r < 0) {
+                return r;
+        }
+
+        /* Let the node drop the units not matching the glob and the columns not shown */
+        _cleanup_sd_bus_message_ sd_bus_message *request = NULL;
+        r = sd_bus_message_new_method_call(
+                        api_bus, &request, BC_INTERFACE_BASE_NAME, object_path, NODE_INTERFACE, "ListUnitsFiltered");
+        if (r < 0) {
+                fprintf(stderr, "Failed to create new method call: %s\n", strerror(-r));
+                return r;
+        }
+
+        char *patterns[] = { (char *) glob_filter, NULL };
+        char *fields[] = { "active_state", "sub_state", NULL };
+        r = sd_bus_message_append(request, "as", 0);
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(request, glob_filter != NULL ? patterns : NULL);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append(request, "as", 0);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(request, fields);
+        }
+        if (r < 0) {
+                fprintf(stderr, "Failed to append filter: %s\n", strerror(-r));
+                return r;
+        }
+
+        _cleanup_sd_bus_error_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_sd_bus_message_ sd_bus_message *message = NULL;
+        r = sd_bus_call(api_bus, request, BC_DEFAULT_DBUS_TIMEOUT, &error, &message);
+        if (r < 0 && sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+                /* Agent predates ListUnitsFiltered */
+                sd_bus_error_free(&error);
+                r = sd_bus_call_method(
+                                api_bus,
+                                BC_INTERFACE_BASE_NAME,
+                                object_path,
+                                NODE_INTERFACE,
+                                "ListUnits",
+                                &error,
+                                &message,
+                                "");
+        }
         if (r < 0) {
                 fprintf(stderr, "Failed to issue method call: %s\n", error.message);
                 return r;
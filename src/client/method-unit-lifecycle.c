@@ -75,15 +75,142 @@ static int method_lifecycle_action_on(Client *client, char *node_name, char *uni
         return r;
 }
 
+/* Queues the jobs of all units with a single call and waits for all of them */
+static int method_lifecycle_action_on_units(
+                Client *client, char *node_name, char **units, size_t n_units, char *batch_method, char *method) {
+        _cleanup_sd_bus_error_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_sd_bus_message_ sd_bus_message *outgoing_message = NULL;
+        _cleanup_sd_bus_message_ sd_bus_message *message = NULL;
+        _cleanup_free_ char **job_paths = NULL;
+        _cleanup_free_ sd_bus_message **job_results = NULL;
+        size_t n_jobs = 0;
+        int result = 0;
+
+        int r = client_create_message_new_method_call(client, node_name, batch_method, &outgoing_message);
+        if (r < 0) {
+                fprintf(stderr, "Failed to create new method call: %s\n", strerror(-r));
+                return r;
+        }
+
+        r = sd_bus_message_open_container(outgoing_message, SD_BUS_TYPE_ARRAY, "s");
+        for (size_t i = 0; r >= 0 && i < n_units; i++) {
+                r = sd_bus_message_append(outgoing_message, "s", units[i]);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(outgoing_message);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append(outgoing_message, "s", "replace");
+        }
+        if (r < 0) {
+                fprintf(stderr, "Failed to append units and mode: %s\n", strerror(-r));
+                return r;
+        }
+
+        r = sd_bus_match_signal(
+                        client->api_bus,
+                        NULL,
+                        BC_INTERFACE_BASE_NAME,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "JobRemoved",
+                        match_job_removed_signal,
+                        client);
+        if (r < 0) {
+                fprintf(stderr, "Failed to match signal\n");
+                return r;
+        }
+
+        r = sd_bus_call(client->api_bus, outgoing_message, BC_DEFAULT_DBUS_TIMEOUT, &error, &message);
+        if (r < 0) {
+                fprintf(stderr, "Failed to issue method call: %s\n", error.message);
+                return r;
+        }
+
+        job_paths = malloc0(n_units * sizeof(char *));
+        job_results = malloc0(n_units * sizeof(sd_bus_message *));
+        if (job_paths == NULL || job_results == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return -ENOMEM;
+        }
+
+        r = sd_bus_message_enter_container(message, SD_BUS_TYPE_ARRAY, "(os)");
+        for (size_t i = 0; r >= 0 && i < n_units; i++) {
+                char *job_path = NULL, *job_error = NULL;
+                r = sd_bus_message_read(message, "(os)", &job_path, &job_error);
+                if (r <= 0) {
+                        break;
+                }
+                if (!streq(job_error, "")) {
+                        fprintf(stderr, "Failed to %s unit %s: %s\n", method, units[i], job_error);
+                        result = -EIO;
+                        continue;
+                }
+                job_paths[n_jobs++] = job_path;
+        }
+        if (r < 0) {
+                fprintf(stderr, "Failed to parse response message: %s\n", strerror(-r));
+                return r;
+        }
+
+        r = client_wait_for_jobs(client, job_paths, n_jobs, job_results);
+        if (r < 0) {
+                return r;
+        }
+
+        for (size_t i = 0; i < n_jobs; i++) {
+                char *job_path = NULL, *unit = NULL, *job_result = NULL, *node = NULL;
+                uint32_t id = 0;
+
+                r = sd_bus_message_read(job_results[i], "uosss", &id, &job_path, &node, &unit, &job_result);
+                if (r < 0) {
+                        fprintf(stderr, "Can't parse job result\n");
+                        result = r;
+                } else {
+                        printf("Unit %s %s operation result: %s\n", unit, method, job_result);
+                }
+                sd_bus_message_unrefp(&job_results[i]);
+        }
+
+        return result;
+}
+
 int method_start(Command *command, void *userdata) {
+        if (command->opargc > 2) {
+                return method_lifecycle_action_on_units(
+                                userdata,
+                                command->opargv[0],
+                                &command->opargv[1],
+                                command->opargc - 1,
+                                "StartUnits",
+                                "StartUnit");
+        }
         return method_lifecycle_action_on(userdata, command->opargv[0], command->opargv[1], "StartUnit");
 }
 
 int method_stop(Command *command, void *userdata) {
+        if (command->opargc > 2) {
+                return method_lifecycle_action_on_units(
+                                userdata,
+                                command->opargv[0],
+                                &command->opargv[1],
+                                command->opargc - 1,
+                                "StopUnits",
+                                "StopUnit");
+        }
         return method_lifecycle_action_on(userdata, command->opargv[0], command->opargv[1], "StopUnit");
 }
 
 int method_restart(Command *command, void *userdata) {
+        if (command->opargc > 2) {
+                return method_lifecycle_action_on_units(
+                                userdata,
+                                command->opargv[0],
+                                &command->opargv[1],
+                                command->opargc - 1,
+                                "RestartUnits",
+                                "RestartUnit");
+        }
         return method_lifecycle_action_on(userdata, command->opargv[0], command->opargv[1], "RestartUnit");
 }
 
@@ -93,11 +220,13 @@ int method_reload(Command *command, void *userdata) {
 
 void usage_method_lifecycle() {
         usage_print_header();
-        usage_print_description("Start/Stop/Restart/Reload a unit on a node");
-        usage_print_usage("bluechictl [start|stop|restart|reload] [nodename] [unitname]");
+        usage_print_description("Start/Stop/Restart/Reload units on a node");
+        usage_print_usage("bluechictl [start|stop|restart|reload] [nodename] [unitname...]");
+        printf("  Multiple units can be passed to start, stop and restart. Their jobs are queued at once.\n");
         printf("\n");
         printf("Examples:\n");
         printf("  bluechictl start primary interesting.service\n");
+        printf("  bluechictl start primary interesting.service other.service\n");
         printf("  bluechictl stop primary interesting.service\n");
         printf("  bluechictl restart primary interesting.service\n");
         printf("  bluechictl reload primary interesting.service\n");
@@ -21,9 +21,52 @@
 #include "metrics.h"
 #include "monitor.h"
 #include "node.h"
+#include "rollout.h"
+#include "unit_cache.h"
 
 #define DEBUG_MESSAGES 0
 
+typedef struct NodeIndexEntry {
+        const char *key;
+        Node *node;
+} NodeIndexEntry;
+
+static uint64_t node_index_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const NodeIndexEntry *entry = item;
+        return hashmap_sip(entry->key, strlen(entry->key), seed0, seed1);
+}
+
+static int node_index_compare(const void *a, const void *b, UNUSED void *udata) {
+        const NodeIndexEntry *entry_a = a;
+        const NodeIndexEntry *entry_b = b;
+
+        return strcmp(entry_a->key, entry_b->key);
+}
+
+static struct hashmap *node_index_new(void) {
+        return hashmap_new(sizeof(NodeIndexEntry), 0, 0, 0, node_index_hash, node_index_compare, NULL, NULL);
+}
+
+typedef struct JobIndexEntry {
+        uint32_t id;
+        Job *job;
+} JobIndexEntry;
+
+static uint64_t job_index_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const JobIndexEntry *entry = item;
+        return hashmap_sip(&entry->id, sizeof(entry->id), seed0, seed1);
+}
+
+static int job_index_compare(const void *a, const void *b, UNUSED void *udata) {
+        const JobIndexEntry *entry_a = a;
+        const JobIndexEntry *entry_b = b;
+
+        if (entry_a->id == entry_b->id) {
+                return 0;
+        }
+        return entry_a->id < entry_b->id ? -1 : 1;
+}
+
 Controller *controller_new(void) {
         int r = 0;
         _cleanup_sd_event_ sd_event *event = NULL;
@@ -60,8 +103,22 @@ Controller *controller_new(void) {
                 LIST_HEAD_INIT(controller->nodes);
                 LIST_HEAD_INIT(controller->anonymous_nodes);
                 LIST_HEAD_INIT(controller->jobs);
+                controller->jobs_tail = NULL;
                 LIST_HEAD_INIT(controller->monitors);
                 LIST_HEAD_INIT(controller->all_subscriptions);
+
+                controller->nodes_by_name = node_index_new();
+                controller->nodes_by_path = node_index_new();
+                controller->jobs_by_id = hashmap_new(
+                                sizeof(JobIndexEntry), 0, 0, 0, job_index_hash, job_index_compare, NULL, NULL);
+                controller->api_rate_limiter = rate_limiter_new();
+                LIST_HEAD_INIT(controller->pending_fleet_requests);
+                if (controller->nodes_by_name == NULL || controller->nodes_by_path == NULL ||
+                    controller->jobs_by_id == NULL || controller->api_rate_limiter == NULL) {
+                        bc_log_error("Out of memory");
+                        controller_unref(controller);
+                        return NULL;
+                }
         }
 
         return controller;
@@ -83,6 +140,13 @@ void controller_unref(Controller *controller) {
         assert(LIST_IS_EMPTY(controller->monitors));
         assert(LIST_IS_EMPTY(controller->nodes));
         assert(LIST_IS_EMPTY(controller->anonymous_nodes));
+        assert(LIST_IS_EMPTY(controller->pending_fleet_requests));
+
+        hashmap_free(controller->nodes_by_name);
+        hashmap_free(controller->nodes_by_path);
+        hashmap_free(controller->jobs_by_id);
+        rate_limiter_free(controller->api_rate_limiter);
+        sd_event_source_unrefp(&controller->pending_fleet_requests_source);
 
         if (controller->config) {
                 cfg_dispose(controller->config);
@@ -163,33 +227,50 @@ void controller_remove_subscription(Controller *controller, Subscription *sub) {
 }
 
 Node *controller_find_node(Controller *controller, const char *name) {
-        Node *node = NULL;
-
-        LIST_FOREACH(nodes, node, controller->nodes) {
-                if (strcmp(node->name, name) == 0) {
-                        return node;
-                }
-        }
+        const NodeIndexEntry key = { name, NULL };
+        const NodeIndexEntry *entry = hashmap_get(controller->nodes_by_name, &key);
 
-        return NULL;
+        return entry != NULL ? entry->node : NULL;
 }
 
-
 Node *controller_find_node_by_path(Controller *controller, const char *path) {
-        Node *node = NULL;
+        const NodeIndexEntry key = { path, NULL };
+        const NodeIndexEntry *entry = hashmap_get(controller->nodes_by_path, &key);
 
-        LIST_FOREACH(nodes, node, controller->nodes) {
-                if (streq(node->object_path, path)) {
-                        return node;
-                }
+        return entry != NULL ? entry->node : NULL;
+}
+
+/* The index entries borrow the name and object path strings of the node,
+ * so they must be dropped before the node is freed */
+static bool controller_index_node(Controller *controller, Node *node) {
+        const NodeIndexEntry by_name = { node->name, node };
+        hashmap_set(controller->nodes_by_name, &by_name);
+        if (hashmap_oom(controller->nodes_by_name)) {
+                return false;
+        }
+
+        const NodeIndexEntry by_path = { node->object_path, node };
+        hashmap_set(controller->nodes_by_path, &by_path);
+        if (hashmap_oom(controller->nodes_by_path)) {
+                hashmap_delete(controller->nodes_by_name, &by_name);
+                return false;
         }
 
-        return NULL;
+        return true;
+}
+
+static void controller_unindex_node(Controller *controller, Node *node) {
+        const NodeIndexEntry by_name = { node->name, NULL };
+        hashmap_delete(controller->nodes_by_name, &by_name);
+
+        const NodeIndexEntry by_path = { node->object_path, NULL };
+        hashmap_delete(controller->nodes_by_path, &by_path);
 }
 
 void controller_remove_node(Controller *controller, Node *node) {
         if (node->name) {
                 controller->number_of_nodes--;
+                controller_unindex_node(controller, node);
                 LIST_REMOVE(nodes, controller->nodes, node);
         } else {
                 LIST_REMOVE(nodes, controller->anonymous_nodes, node);
@@ -202,11 +283,29 @@ void controller_remove_node(Controller *controller, Node *node) {
         node_unref(node);
 }
 
+static void controller_append_job(Controller *controller, Job *job) {
+        LIST_INSERT_AFTER(jobs, controller->jobs, controller->jobs_tail, job_ref(job));
+        controller->jobs_tail = job;
+}
+
 bool controller_add_job(Controller *controller, Job *job) {
-        if (!job_export(job)) {
+        bool has_object = job_has_object(job);
+        if (has_object && !job_export(job)) {
                 return false;
         }
 
+        const JobIndexEntry entry = { job->id, job };
+        hashmap_set(controller->jobs_by_id, &entry);
+        if (hashmap_oom(controller->jobs_by_id)) {
+                bc_log_error("Out of memory");
+                return false;
+        }
+
+        if (!has_object) {
+                controller_append_job(controller, job);
+                return true;
+        }
+
         int r = sd_bus_emit_signal(
                         controller->api_bus,
                         BC_CONTROLLER_OBJECT_PATH,
@@ -217,58 +316,82 @@ bool controller_add_job(Controller *controller, Job *job) {
                         job->object_path);
         if (r < 0) {
                 bc_log_errorf("Failed to emit JobNew signal: %s", strerror(-r));
+                hashmap_delete(controller->jobs_by_id, &entry);
                 return false;
         }
 
-        LIST_APPEND(jobs, controller->jobs, job_ref(job));
+        controller_append_job(controller, job);
         return true;
 }
 
+Job *controller_find_job(Controller *controller, uint32_t job_id) {
+        const JobIndexEntry key = { job_id, NULL };
+        const JobIndexEntry *entry = hashmap_get(controller->jobs_by_id, &key);
+
+        return entry != NULL ? entry->job : NULL;
+}
+
+/* Removes the job from the controller without emitting JobRemoved */
+void controller_drop_job(Controller *controller, Job *job) {
+        const JobIndexEntry key = { job->id, NULL };
+        hashmap_delete(controller->jobs_by_id, &key);
+
+        if (controller->jobs_tail == job) {
+                controller->jobs_tail = job->jobs_prev;
+        }
+        LIST_REMOVE(jobs, controller->jobs, job);
+        job_unref(job);
+}
+
 void controller_remove_job(Controller *controller, Job *job, const char *result) {
-        int r = sd_bus_emit_signal(
-                        controller->api_bus,
-                        BC_CONTROLLER_OBJECT_PATH,
-                        CONTROLLER_INTERFACE,
-                        "JobRemoved",
-                        "uosss",
-                        job->id,
-                        job->object_path,
-                        job->node->name,
-                        job->unit,
-                        result);
-        if (r < 0) {
-                bc_log_errorf("Warning: Failed to send JobRemoved event: %s", strerror(-r));
-                /* We can't really return a failure here */
+        if (job_has_object(job)) {
+                int r = sd_bus_emit_signal(
+                                controller->api_bus,
+                                BC_CONTROLLER_OBJECT_PATH,
+                                CONTROLLER_INTERFACE,
+                                "JobRemoved",
+                                "uosss",
+                                job->id,
+                                job->object_path,
+                                job->node != NULL ? job->node->name : "",
+                                job->unit,
+                                result);
+                if (r < 0) {
+                        bc_log_errorf("Warning: Failed to send JobRemoved event: %s", strerror(-r));
+                        /* We can't really return a failure here */
+                }
         }
 
-        LIST_REMOVE(jobs, controller->jobs, job);
+        if (job->node == NULL) {
+                controller_drop_job(controller, job);
+                return;
+        }
+        if (job->rollout != NULL) {
+                rollout_job_finished(job->rollout, job, result);
+        }
+        if (job->group != NULL) {
+                job_group_finish_job(job->group, job->group_index, result);
+        }
         if (controller->metrics_enabled && streq(job->type, "start")) {
                 metrics_produce_job_report(job);
         }
-        job_unref(job);
+        controller_drop_job(controller, job);
 }
 
 void controller_job_state_changed(Controller *controller, uint32_t job_id, const char *state) {
-        JobState new_state = job_state_from_string(state);
-        Job *job = NULL;
-        LIST_FOREACH(jobs, job, controller->jobs) {
-                if (job->id == job_id) {
-                        job_set_state(job, new_state);
-                        break;
-                }
+        Job *job = controller_find_job(controller, job_id);
+        if (job != NULL) {
+                job_set_state(job, job_state_from_string(state));
         }
 }
 
 void controller_finish_job(Controller *controller, uint32_t job_id, const char *result) {
-        Job *job = NULL;
-        LIST_FOREACH(jobs, job, controller->jobs) {
-                if (job->id == job_id) {
-                        if (controller->metrics_enabled) {
-                                job->job_end_micros = get_time_micros();
-                        }
-                        controller_remove_job(controller, job, result);
-                        break;
+        Job *job = controller_find_job(controller, job_id);
+        if (job != NULL) {
+                if (controller->metrics_enabled) {
+                        job->job_end_micros = get_time_micros();
                 }
+                controller_remove_job(controller, job, result);
         }
 }
 
@@ -279,6 +402,10 @@ Node *controller_add_node(Controller *controller, const char *name) {
         }
 
         if (name) {
+                if (!controller_index_node(controller, node)) {
+                        bc_log_error("Out of memory");
+                        return NULL;
+                }
                 controller->number_of_nodes++;
                 LIST_APPEND(nodes, controller->nodes, node);
         } else {
@@ -332,6 +459,50 @@ bool controller_set_heartbeat_threshold(Controller *controller, const char *thre
         return true;
 }
 
+bool controller_set_api_request_rate(Controller *controller, const char *rate) {
+        long value = 0;
+
+        if (!parse_long(rate, &value) || value < 0) {
+                bc_log_errorf("Invalid API request rate format '%s'", rate);
+                return false;
+        }
+        controller->api_request_rate = value;
+        return true;
+}
+
+bool controller_set_api_request_burst(Controller *controller, const char *burst) {
+        long value = 0;
+
+        if (!parse_long(burst, &value) || value < 1) {
+                bc_log_errorf("Invalid API request burst format '%s'", burst);
+                return false;
+        }
+        controller->api_request_burst = value;
+        return true;
+}
+
+bool controller_set_max_fleet_requests(Controller *controller, const char *max) {
+        long value = 0;
+
+        if (!parse_long(max, &value) || value < 0) {
+                bc_log_errorf("Invalid maximum of fleet requests format '%s'", max);
+                return false;
+        }
+        controller->max_fleet_requests = value;
+        return true;
+}
+
+bool controller_set_max_queued_fleet_requests(Controller *controller, const char *max) {
+        long value = 0;
+
+        if (!parse_long(max, &value) || value < 0) {
+                bc_log_errorf("Invalid maximum of queued fleet requests format '%s'", max);
+                return false;
+        }
+        controller->max_queued_fleet_requests = value;
+        return true;
+}
+
 bool controller_parse_config(Controller *controller, const char *configfile) {
         int result = 0;
 
@@ -458,6 +629,34 @@ bool controller_apply_config(Controller *controller) {
                 }
         }
 
+        const char *rate = cfg_get_value(controller->config, CFG_API_REQUEST_RATE);
+        if (rate) {
+                if (!controller_set_api_request_rate(controller, rate)) {
+                        return false;
+                }
+        }
+
+        const char *burst = cfg_get_value(controller->config, CFG_API_REQUEST_BURST);
+        if (burst) {
+                if (!controller_set_api_request_burst(controller, burst)) {
+                        return false;
+                }
+        }
+
+        const char *max_fleet_requests = cfg_get_value(controller->config, CFG_MAX_FLEET_REQUESTS);
+        if (max_fleet_requests) {
+                if (!controller_set_max_fleet_requests(controller, max_fleet_requests)) {
+                        return false;
+                }
+        }
+
+        const char *max_queued_fleet_requests = cfg_get_value(controller->config, CFG_MAX_QUEUED_FLEET_REQUESTS);
+        if (max_queued_fleet_requests) {
+                if (!controller_set_max_queued_fleet_requests(controller, max_queued_fleet_requests)) {
+                        return false;
+                }
+        }
+
         /* Set socket options used for peer connections with the agents */
         const char *keepidle = cfg_get_value(controller->config, CFG_TCP_KEEPALIVE_TIME);
         if (keepidle) {
@@ -688,111 +887,6 @@ static bool controller_setup_node_connection_handler(Controller *controller) {
         return true;
 }
 
-static int controller_reset_heartbeat_timer(Controller *controller, sd_event_source **event_source);
-
-static bool controller_check_node_liveness(Controller *controller, Node *node, uint64_t now) {
-        uint64_t diff = 0;
-
-        if (controller->heartbeat_threshold_msec <= 0) {
-                /* checking liveness of node by heartbeat disabled since configured threshold is <=0" */
-                return true;
-        }
-
-        if (now == 0) {
-                bc_log_error("Current time is wrong");
-                return true;
-        }
-
-        if (now < node->last_seen_monotonic) {
-                bc_log_error("Clock skew detected");
-                return true;
-        }
-
-        diff = now - node->last_seen_monotonic;
-        if (diff > (uint64_t) controller->heartbeat_threshold_msec * USEC_PER_MSEC) {
-                bc_log_infof("Did not receive heartbeat from node '%s' since '%d'ms. Disconnecting it...",
-                             node->name,
-                             controller->heartbeat_threshold_msec);
-                node_disconnect(node);
-                return false;
-        }
-
-        return true;
-}
-
-static int controller_heartbeat_timer_callback(
-                sd_event_source *event_source, UNUSED uint64_t usec, void *userdata) {
-        Controller *controller = (Controller *) userdata;
-        Node *node = NULL;
-        uint64_t now = get_time_micros_monotonic();
-        int r = 0;
-
-        LIST_FOREACH(nodes, node, controller->nodes) {
-                if (!node_is_online(node)) {
-                        continue;
-                }
-
-                if (!controller_check_node_liveness(controller, node, now)) {
-                        continue;
-                }
-
-                r = sd_bus_emit_signal(
-                                node->agent_bus,
-                                INTERNAL_CONTROLLER_OBJECT_PATH,
-                                INTERNAL_CONTROLLER_INTERFACE,
-                                "Heartbeat",
-                                "");
-                if (r < 0) {
-                        bc_log_errorf("Failed to emit heartbeat signal to node '%s': %s",
-                                      node->name,
-                                      strerror(-r));
-                }
-        }
-
-        r = controller_reset_heartbeat_timer(controller, &event_source);
-        if (r < 0) {
-                bc_log_errorf("Failed to reset controller heartbeat timer: %s", strerror(-r));
-                return r;
-        }
-
-        return 0;
-}
-
-static int controller_reset_heartbeat_timer(Controller *controller, sd_event_source **event_source) {
-        return event_reset_time_relative(
-                        controller->event,
-                        event_source,
-                        CLOCK_BOOTTIME,
-                        controller->heartbeat_interval_msec * USEC_PER_MSEC,
-                        0,
-                        controller_heartbeat_timer_callback,
-                        controller,
-                        0,
-                        "controller-heartbeat-timer-source",
-                        false);
-}
-
-static int controller_setup_heartbeat_timer(Controller *controller) {
-        _cleanup_(sd_event_source_unrefp) sd_event_source *event_source = NULL;
-        int r = 0;
-
-        assert(controller);
-
-        if (controller->heartbeat_interval_msec <= 0) {
-                bc_log_warnf("Heartbeat disabled since configured interval '%d' is <=0",
-                             controller->heartbeat_interval_msec);
-                return 0;
-        }
-
-        r = controller_reset_heartbeat_timer(controller, &event_source);
-        if (r < 0) {
-                bc_log_errorf("Failed to reset controller heartbeat timer: %s", strerror(-r));
-                return r;
-        }
-
-        return sd_event_source_set_floating(event_source, true);
-}
-
 /************************************************************************
  ***************** AgentFleetRequest ************************************
  ************************************************************************/
@@ -804,28 +898,75 @@ typedef AgentRequest *(*agent_fleet_request_create_t)(
                 Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata);
 
 typedef struct AgentFleetRequest {
+        Controller *controller; /* weak ref */
         sd_bus_message *request_message;
         agent_fleet_request_encode_reply_t encode;
 
+        /* Streamed requests emit the result of each node as a signal when it
+         * arrives, and a ListDone signal instead of a reply at the end */
+        uint32_t stream_id;
+        const char *stream_signal;
+        sd_event_source *timeout_source;
+
         int n_done;
         int n_sub_req;
         struct {
                 Node *node;
                 sd_bus_message *m;
                 AgentRequest *agent_req;
+                bool done;
+                char *error; /* Only used by streamed requests */
         } sub_req[0];
 } AgentFleetRequest;
 
+/* A fleet request waiting for one of the requests in flight to finish */
+struct PendingFleetRequest {
+        sd_bus_message *request_message;
+        agent_fleet_request_create_t create_request;
+        agent_fleet_request_encode_reply_t encode;
+        const char *stream_signal;
+        uint64_t timeout;
+
+        LIST_FIELDS(PendingFleetRequest, pending_fleet_requests);
+};
+
+static void pending_fleet_request_free(PendingFleetRequest *pending) {
+        sd_bus_message_unrefp(&pending->request_message);
+        free(pending);
+}
+
+static int controller_schedule_pending_fleet_requests(Controller *controller);
+
+static bool controller_fleet_request_limit_reached(Controller *controller) {
+        return controller->max_fleet_requests > 0 &&
+                        controller->fleet_requests_in_flight >= (uint32_t) controller->max_fleet_requests;
+}
+
 static void agent_fleet_request_free(AgentFleetRequest *req) {
+        Controller *controller = req->controller;
+
         sd_bus_message_unref(req->request_message);
+        sd_event_source_unrefp(&req->timeout_source);
 
         for (int i = 0; i < req->n_sub_req; i++) {
+                /* Replies still outstanding must not call back into the freed request */
+                if (!req->sub_req[i].done) {
+                        agent_request_abandon(req->sub_req[i].agent_req);
+                }
                 node_unrefp(&req->sub_req[i].node);
                 sd_bus_message_unrefp(&req->sub_req[i].m);
                 agent_request_unrefp(&req->sub_req[i].agent_req);
+                free_and_null(req->sub_req[i].error);
         }
 
         free(req);
+
+        /* Make room for the next queued request */
+        controller->fleet_requests_in_flight--;
+        int r = controller_schedule_pending_fleet_requests(controller);
+        if (r < 0) {
+                bc_log_errorf("Failed to schedule queued fleet requests: %s", strerror(-r));
+        }
 }
 
 static void agent_fleet_request_freep(AgentFleetRequest **reqp) {
@@ -837,10 +978,73 @@ static void agent_fleet_request_freep(AgentFleetRequest **reqp) {
 
 #define _cleanup_agent_fleet_request_ _cleanup_(agent_fleet_request_freep)
 
+static int agent_fleet_request_new_stream_signal(
+                AgentFleetRequest *req, const char *member, sd_bus_message **ret) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_signal(
+                        req->controller->api_bus, &m, BC_CONTROLLER_OBJECT_PATH, CONTROLLER_INTERFACE, member);
+        if (r < 0) {
+                return r;
+        }
+
+        /* Only the caller is interested in the results */
+        const char *sender = sd_bus_message_get_sender(req->request_message);
+        if (sender != NULL) {
+                r = sd_bus_message_set_destination(m, sender);
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        r = sd_bus_message_append(m, "u", req->stream_id);
+        if (r < 0) {
+                return r;
+        }
+
+        *ret = steal_pointer(&m);
+        return 0;
+}
+
+static int agent_fleet_request_emit_stream_done(AgentFleetRequest *req) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = agent_fleet_request_new_stream_signal(req, "ListDone", &m);
+        if (r < 0) {
+                return r;
+        }
+
+        r = sd_bus_message_open_container(m, SD_BUS_TYPE_ARRAY, "{ss}");
+        if (r < 0) {
+                return r;
+        }
+        for (int i = 0; i < req->n_sub_req; i++) {
+                if (req->sub_req[i].error == NULL) {
+                        continue;
+                }
+                r = sd_bus_message_append(m, "{ss}", req->sub_req[i].node->name, req->sub_req[i].error);
+                if (r < 0) {
+                        return r;
+                }
+        }
+        r = sd_bus_message_close_container(m);
+        if (r < 0) {
+                return r;
+        }
+
+        return sd_bus_send(NULL, m, NULL);
+}
+
 static void agent_fleet_request_done(AgentFleetRequest *req) {
         /* All sub_req-requests are done, collect results and free when done */
         UNUSED _cleanup_agent_fleet_request_ AgentFleetRequest *free_me = req;
 
+        if (req->stream_signal != NULL) {
+                int r = agent_fleet_request_emit_stream_done(req);
+                if (r < 0) {
+                        bc_log_errorf("Failed to emit ListDone signal: %s", strerror(-r));
+                }
+                return;
+        }
+
         _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
         int r = sd_bus_message_new_method_return(req->request_message, &reply);
         if (r < 0) {
@@ -875,6 +1079,37 @@ static void agent_fleet_request_maybe_done(AgentFleetRequest *req) {
         }
 }
 
+/* Emits the result of a node right away, so it doesn't have to be kept until all nodes answered */
+static int agent_fleet_request_stream_result(AgentFleetRequest *req, int i) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = steal_pointer(&req->sub_req[i].m);
+
+        const sd_bus_error *err = sd_bus_message_get_error(m);
+        if (err != NULL) {
+                req->sub_req[i].error = strdup(err->message != NULL ? err->message : err->name);
+                return req->sub_req[i].error != NULL ? 0 : -ENOMEM;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *signal = NULL;
+        int r = agent_fleet_request_new_stream_signal(req, req->stream_signal, &signal);
+        if (r >= 0) {
+                r = sd_bus_message_append(signal, "s", req->sub_req[i].node->name);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_copy(signal, m, true);
+        }
+        if (r >= 0) {
+                r = sd_bus_send(NULL, signal, NULL);
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to emit %s signal for node '%s': %s",
+                              req->stream_signal,
+                              req->sub_req[i].node->name,
+                              strerror(-r));
+                req->sub_req[i].error = strdup("Failed to emit result");
+        }
+        return r;
+}
+
 static int agent_fleet_request_callback(
                 AgentRequest *agent_req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
         AgentFleetRequest *req = agent_req->userdata;
@@ -889,26 +1124,49 @@ static int agent_fleet_request_callback(
         assert(i != req->n_sub_req); /* we should have found the sub_req request */
 
         req->sub_req[i].m = sd_bus_message_ref(m);
+        req->sub_req[i].done = true;
         req->n_done++;
 
+        if (req->stream_signal != NULL) {
+                (void) agent_fleet_request_stream_result(req, i);
+        }
+
         agent_fleet_request_maybe_done(req);
 
         return 0;
 }
 
-static int agent_fleet_request_start(
-                sd_bus_message *request_message,
-                Controller *controller,
-                agent_fleet_request_create_t create_request,
-                agent_fleet_request_encode_reply_t encode) {
-        AgentFleetRequest *req = NULL;
+static int agent_fleet_request_timeout_callback(
+                UNUSED sd_event_source *event_source, UNUSED uint64_t usec, void *userdata) {
+        AgentFleetRequest *req = userdata;
 
-        req = malloc0_array(sizeof(*req), sizeof(req->sub_req[0]), controller->number_of_nodes);
+        /* Give up on the nodes that did not answer yet, and finish with what we have */
+        for (int i = 0; i < req->n_sub_req; i++) {
+                if (req->sub_req[i].done) {
+                        continue;
+                }
+                bc_log_debugf("Request to node '%s' timed out", req->sub_req[i].node->name);
+                agent_request_abandon(req->sub_req[i].agent_req);
+                req->sub_req[i].error = strdup("Request timed out");
+                req->sub_req[i].done = true;
+                req->n_done++;
+        }
+
+        agent_fleet_request_maybe_done(req);
+        return 0;
+}
+
+static AgentFleetRequest *agent_fleet_request_new(
+                sd_bus_message *request_message, Controller *controller, agent_fleet_request_create_t create_request) {
+        AgentFleetRequest *req = NULL;
+
+        req = malloc0_array(sizeof(*req), sizeof(req->sub_req[0]), controller->number_of_nodes);
         if (req == NULL) {
-                return sd_bus_reply_method_errorf(request_message, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+                return NULL;
         }
+        req->controller = controller;
         req->request_message = sd_bus_message_ref(request_message);
-        req->encode = encode;
+        controller->fleet_requests_in_flight++;
 
         Node *node = NULL;
         int i = 0;
@@ -923,6 +1181,20 @@ static int agent_fleet_request_start(
                 }
         }
 
+        return req;
+}
+
+static int agent_fleet_request_run(
+                sd_bus_message *request_message,
+                Controller *controller,
+                agent_fleet_request_create_t create_request,
+                agent_fleet_request_encode_reply_t encode) {
+        AgentFleetRequest *req = agent_fleet_request_new(request_message, controller, create_request);
+        if (req == NULL) {
+                return sd_bus_reply_method_errorf(request_message, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+        req->encode = encode;
+
 // Disabling -Wanalyzer-malloc-leak temporarily due to false-positive
 //      Leak detected is based on the assumption that controller_method_list_units_maybe_done is only
 //      called once directly after iterating over the list - when the conditional to free req is false.
@@ -936,6 +1208,166 @@ static int agent_fleet_request_start(
 }
 #pragma GCC diagnostic pop
 
+/* Replies with the id of the stream and emits the results of the nodes as stream_signal as they arrive.
+ * Nodes that take longer than the timeout (in microseconds, 0 for the default) are reported as failed. */
+static int agent_fleet_request_run_stream(
+                sd_bus_message *request_message,
+                Controller *controller,
+                agent_fleet_request_create_t create_request,
+                const char *stream_signal,
+                uint64_t timeout) {
+        static uint32_t next_stream_id = 0;
+        int r = 0;
+
+        _cleanup_agent_fleet_request_ AgentFleetRequest *req = agent_fleet_request_new(
+                        request_message, controller, create_request);
+        if (req == NULL) {
+                return sd_bus_reply_method_errorf(request_message, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+        req->stream_id = ++next_stream_id;
+        req->stream_signal = stream_signal;
+
+        if (timeout > 0 && req->n_done < req->n_sub_req) {
+                r = event_reset_time_relative(
+                                controller->event,
+                                &req->timeout_source,
+                                CLOCK_MONOTONIC,
+                                timeout,
+                                0,
+                                agent_fleet_request_timeout_callback,
+                                req,
+                                0,
+                                "agent-fleet-request-timeout",
+                                false);
+                if (r < 0) {
+                        return sd_bus_reply_method_errorf(
+                                        request_message,
+                                        SD_BUS_ERROR_FAILED,
+                                        "Failed to set up timeout: %s",
+                                        strerror(-r));
+                }
+        }
+
+        /* The reply goes out before any of the results */
+        r = sd_bus_reply_method_return(request_message, "u", req->stream_id);
+        if (r < 0) {
+                return r;
+        }
+
+        agent_fleet_request_maybe_done(steal_pointer(&req));
+        return 1;
+}
+
+static int pending_fleet_request_run(PendingFleetRequest *pending, Controller *controller) {
+        if (pending->stream_signal != NULL) {
+                return agent_fleet_request_run_stream(
+                                pending->request_message,
+                                controller,
+                                pending->create_request,
+                                pending->stream_signal,
+                                pending->timeout);
+        }
+        return agent_fleet_request_run(pending->request_message, controller, pending->create_request, pending->encode);
+}
+
+static int controller_pending_fleet_requests_callback(UNUSED sd_event_source *event_source, void *userdata) {
+        Controller *controller = userdata;
+
+        while (!LIST_IS_EMPTY(controller->pending_fleet_requests) &&
+               !controller_fleet_request_limit_reached(controller)) {
+                PendingFleetRequest *pending = LIST_POP(pending_fleet_requests, controller->pending_fleet_requests);
+                controller->queued_fleet_requests--;
+
+                int r = pending_fleet_request_run(pending, controller);
+                if (r < 0) {
+                        bc_log_errorf("Failed to start queued %s request: %s",
+                                      sd_bus_message_get_member(pending->request_message),
+                                      strerror(-r));
+                }
+                pending_fleet_request_free(pending);
+        }
+        return 0;
+}
+
+static int controller_schedule_pending_fleet_requests(Controller *controller) {
+        if (LIST_IS_EMPTY(controller->pending_fleet_requests)) {
+                return 0;
+        }
+        if (controller->pending_fleet_requests_source != NULL) {
+                return sd_event_source_set_enabled(controller->pending_fleet_requests_source, SD_EVENT_ONESHOT);
+        }
+
+        return sd_event_add_defer(
+                        controller->event,
+                        &controller->pending_fleet_requests_source,
+                        controller_pending_fleet_requests_callback,
+                        controller);
+}
+
+/* Runs the request right away unless MaxFleetRequests are in flight already, in which case it is queued.
+ * Once MaxQueuedFleetRequests are waiting as well, the request is rejected. */
+static int agent_fleet_request_admit(
+                sd_bus_message *request_message,
+                Controller *controller,
+                PendingFleetRequest *params) {
+        if (!controller_fleet_request_limit_reached(controller) &&
+            LIST_IS_EMPTY(controller->pending_fleet_requests)) {
+                params->request_message = request_message;
+                return pending_fleet_request_run(params, controller);
+        }
+
+        if (controller->queued_fleet_requests >= (uint64_t) controller->max_queued_fleet_requests) {
+                controller->rejected_fleet_requests++;
+                bc_log_debugf("Rejecting %s request, %u fleet requests are queued already",
+                              sd_bus_message_get_member(request_message),
+                              controller->queued_fleet_requests);
+                return sd_bus_reply_method_errorf(
+                                request_message,
+                                BC_BUS_ERROR_TOO_MANY_REQUESTS,
+                                "Too many requests to all nodes in progress, try again later");
+        }
+
+        PendingFleetRequest *pending = malloc0(sizeof(PendingFleetRequest));
+        if (pending == NULL) {
+                return sd_bus_reply_method_errorf(request_message, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+        *pending = *params;
+        pending->request_message = sd_bus_message_ref(request_message);
+        LIST_INIT(pending_fleet_requests, pending);
+        LIST_APPEND(pending_fleet_requests, controller->pending_fleet_requests, pending);
+        controller->queued_fleet_requests++;
+
+        return 1;
+}
+
+static int agent_fleet_request_start(
+                sd_bus_message *request_message,
+                Controller *controller,
+                agent_fleet_request_create_t create_request,
+                agent_fleet_request_encode_reply_t encode) {
+        PendingFleetRequest params = { .create_request = create_request, .encode = encode };
+        return agent_fleet_request_admit(request_message, controller, &params);
+}
+
+static int agent_fleet_request_start_stream(
+                sd_bus_message *request_message,
+                Controller *controller,
+                agent_fleet_request_create_t create_request,
+                const char *stream_signal) {
+        uint64_t timeout = 0;
+
+        int r = sd_bus_message_read(request_message, "t", &timeout);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                request_message, SD_BUS_ERROR_INVALID_ARGS, "Invalid argument for the timeout");
+        }
+
+        PendingFleetRequest params = {
+                .create_request = create_request, .stream_signal = stream_signal, .timeout = timeout
+        };
+        return agent_fleet_request_admit(request_message, controller, &params);
+}
+
 /************************************************************************
  ************** org.eclipse.bluechi.Controller.ListUnits *****
  ************************************************************************/
@@ -1015,6 +1447,143 @@ static int controller_method_list_units(sd_bus_message *m, void *userdata, UNUSE
                         m, controller, node_request_list_units, controller_method_list_units_encode_reply);
 }
 
+/************************************************************************
+ ************** org.eclipse.bluechi.Controller.ListUnitsFiltered ********
+ ************************************************************************/
+
+static AgentRequest *controller_request_list_units_filtered(
+                Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        AgentFleetRequest *req = userdata;
+        return node_request_list_units_filtered(node, req->request_message, cb, userdata, free_userdata);
+}
+
+static int controller_method_list_units_filtered(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Controller *controller = userdata;
+        return agent_fleet_request_start(
+                        m,
+                        controller,
+                        controller_request_list_units_filtered,
+                        controller_method_list_units_encode_reply);
+}
+
+/************************************************************************
+ ************** org.eclipse.bluechi.Controller.ListUnitsCached **********
+ ************************************************************************/
+
+/*
+ * Loads the listing into the unit cache as soon as the node replies, and not once all
+ * nodes did, so the events of the node received in between are applied to the cache.
+ */
+static int controller_unit_cache_refresh_callback(AgentRequest *agent_req, sd_bus_message *m, sd_bus_error *ret_error) {
+        Node *node = agent_req->node;
+
+        if (!sd_bus_message_is_method_error(m, NULL)) {
+                int r = unit_cache_load(node->unit_cache, m);
+                if (r < 0) {
+                        bc_log_errorf("Failed to load unit cache of node '%s': %s", node->name, strerror(-r));
+                }
+                r = sd_bus_message_rewind(m, true);
+                if (r < 0) {
+                        bc_log_errorf("Failed to rewind unit listing of node '%s': %s", node->name, strerror(-r));
+                }
+        }
+
+        return agent_fleet_request_callback(agent_req, m, ret_error);
+}
+
+static AgentRequest *controller_request_unit_cache_refresh(
+                Node *node, UNUSED agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        return node_request_unit_cache_refresh(node, controller_unit_cache_refresh_callback, userdata, free_userdata);
+}
+
+static AgentRequest *controller_request_stale_unit_cache_refresh(
+                Node *node, UNUSED agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        return node_request_stale_unit_cache_refresh(
+                        node, controller_unit_cache_refresh_callback, userdata, free_userdata);
+}
+
+static int controller_method_list_units_cached_encode_reply(AgentFleetRequest *req, sd_bus_message *reply) {
+        /* Only the nodes with a stale cache (or all on refresh) were asked, their caches are loaded already */
+        for (int i = 0; i < req->n_sub_req; i++) {
+                sd_bus_message *m = req->sub_req[i].m;
+                if (m != NULL && sd_bus_message_get_error(m) != NULL) {
+                        return -sd_bus_message_get_errno(m);
+                }
+        }
+
+        int r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, NODE_AND_UNIT_INFO_DICT_TYPESTRING);
+        if (r < 0) {
+                return r;
+        }
+
+        Node *node = NULL;
+        LIST_FOREACH(nodes, node, req->controller->nodes) {
+                if (!node_is_online(node) || !unit_cache_is_valid(node->unit_cache)) {
+                        continue;
+                }
+
+                r = sd_bus_message_open_container(reply, SD_BUS_TYPE_DICT_ENTRY, NODE_AND_UNIT_INFO_TYPESTRING);
+                if (r < 0) {
+                        return r;
+                }
+
+                r = sd_bus_message_append(reply, "s", node->name);
+                if (r < 0) {
+                        return r;
+                }
+
+                r = unit_cache_append(node->unit_cache, reply);
+                if (r < 0) {
+                        return r;
+                }
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0) {
+                return r;
+        }
+
+        r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "{st}");
+        if (r < 0) {
+                return r;
+        }
+
+        LIST_FOREACH(nodes, node, req->controller->nodes) {
+                if (!node_is_online(node) || !unit_cache_is_valid(node->unit_cache)) {
+                        continue;
+                }
+
+                r = sd_bus_message_append(reply, "{st}", node->name, node->unit_cache->timestamp);
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int controller_method_list_units_cached(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Controller *controller = userdata;
+        int refresh = 0;
+
+        int r = sd_bus_message_read(m, "b", &refresh);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_INVALID_ARGS, "Invalid argument for the refresh flag");
+        }
+
+        return agent_fleet_request_start(
+                        m,
+                        controller,
+                        refresh ? controller_request_unit_cache_refresh : controller_request_stale_unit_cache_refresh,
+                        controller_method_list_units_cached_encode_reply);
+}
+
 /************************************************************************
  ***** org.eclipse.bluechi.Controller.ListUnitFiles **************
  ************************************************************************/
@@ -1100,6 +1669,22 @@ static int controller_method_list_unit_files(sd_bus_message *m, void *userdata,
                         controller_method_list_unit_files_encode_reply);
 }
 
+/************************************************************************
+ ***** org.eclipse.bluechi.Controller.ListUnitsStream *******************
+ ***** org.eclipse.bluechi.Controller.ListUnitFilesStream ***************
+ ************************************************************************/
+
+static int controller_method_list_units_stream(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Controller *controller = userdata;
+        return agent_fleet_request_start_stream(m, controller, node_request_list_units, "UnitsListed");
+}
+
+static int controller_method_list_unit_files_stream(
+                sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Controller *controller = userdata;
+        return agent_fleet_request_start_stream(m, controller, node_request_list_unit_files, "UnitFilesListed");
+}
+
 /************************************************************************
  ***** org.eclipse.bluechi.Controller.ListNodes **************
  ************************************************************************/
@@ -1200,6 +1785,64 @@ static int controller_method_get_node(sd_bus_message *m, void *userdata, UNUSED
         return sd_bus_message_send(reply);
 }
 
+/************************************************************************
+ ***** org.eclipse.bluechi.Controller.StartUnitOnNodes *******
+ ***** org.eclipse.bluechi.Controller.StopUnitOnNodes ********
+ ***** org.eclipse.bluechi.Controller.RestartUnitOnNodes *****
+ ***** org.eclipse.bluechi.Controller.ReloadUnitOnNodes ******
+ ************************************************************************/
+
+static int controller_run_unit_lifecycle_method_on_nodes(
+                sd_bus_message *m, Controller *controller, const char *job_type, const char *method) {
+        const char *node_pattern = NULL;
+        const char *unit = NULL;
+        const char *mode = NULL;
+        uint32_t parallelism = 0;
+        uint32_t batch_size = 0;
+        uint32_t max_failures = 0;
+
+        int r = sd_bus_message_read(m, "sssuuu", &node_pattern, &unit, &mode, &parallelism, &batch_size, &max_failures);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_INVALID_ARGS, "Invalid arguments: %s", strerror(-r));
+        }
+
+        _cleanup_rollout_ Rollout *rollout = rollout_new(
+                        controller, node_pattern, unit, mode, method, parallelism, batch_size, max_failures);
+        if (rollout == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+        if (rollout->n_nodes == 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_INVALID_ARGS, "No node matches '%s'", node_pattern);
+        }
+
+        r = rollout_start(rollout, job_type);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Failed to start the rollout: %s", strerror(-r));
+        }
+
+        return sd_bus_reply_method_return(m, "o", rollout->job->object_path);
+}
+
+static int controller_method_start_unit_on_nodes(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return controller_run_unit_lifecycle_method_on_nodes(m, (Controller *) userdata, "start", "StartUnit");
+}
+
+static int controller_method_stop_unit_on_nodes(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return controller_run_unit_lifecycle_method_on_nodes(m, (Controller *) userdata, "stop", "StopUnit");
+}
+
+static int controller_method_restart_unit_on_nodes(
+                sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return controller_run_unit_lifecycle_method_on_nodes(m, (Controller *) userdata, "restart", "RestartUnit");
+}
+
+static int controller_method_reload_unit_on_nodes(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return controller_run_unit_lifecycle_method_on_nodes(m, (Controller *) userdata, "reload", "ReloadUnit");
+}
+
 /************************************************************************
  ***** org.eclipse.bluechi.Controller.CreateMonitor **********
  ************************************************************************/
@@ -1385,13 +2028,29 @@ static int controller_property_get_log_target(
 static const sd_bus_vtable controller_vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("ListUnits", "", NODE_AND_UNIT_INFO_DICT_ARRAY_TYPESTRING, controller_method_list_units, 0),
+        SD_BUS_METHOD("ListUnitsFiltered",
+                      "asasasas",
+                      NODE_AND_UNIT_INFO_DICT_ARRAY_TYPESTRING,
+                      controller_method_list_units_filtered,
+                      0),
+        SD_BUS_METHOD("ListUnitsCached",
+                      "b",
+                      NODE_AND_UNIT_INFO_DICT_ARRAY_TYPESTRING "a{st}",
+                      controller_method_list_units_cached,
+                      0),
         SD_BUS_METHOD("ListUnitFiles",
                       "",
                       NODE_AND_UNIT_FILE_INFO_DICT_ARRAY_TYPESTRING,
                       controller_method_list_unit_files,
                       0),
+        SD_BUS_METHOD("ListUnitsStream", "t", "u", controller_method_list_units_stream, 0),
+        SD_BUS_METHOD("ListUnitFilesStream", "t", "u", controller_method_list_unit_files_stream, 0),
         SD_BUS_METHOD("ListNodes", "", "a(soss)", controller_method_list_nodes, 0),
         SD_BUS_METHOD("GetNode", "s", "o", controller_method_get_node, 0),
+        SD_BUS_METHOD("StartUnitOnNodes", "sssuuu", "o", controller_method_start_unit_on_nodes, 0),
+        SD_BUS_METHOD("StopUnitOnNodes", "sssuuu", "o", controller_method_stop_unit_on_nodes, 0),
+        SD_BUS_METHOD("RestartUnitOnNodes", "sssuuu", "o", controller_method_restart_unit_on_nodes, 0),
+        SD_BUS_METHOD("ReloadUnitOnNodes", "sssuuu", "o", controller_method_reload_unit_on_nodes, 0),
         SD_BUS_METHOD("CreateMonitor", "", "o", controller_method_create_monitor, 0),
         SD_BUS_METHOD("SetLogLevel", "s", "", controller_method_set_log_level, 0),
         SD_BUS_METHOD("EnableMetrics", "", "", controller_method_metrics_enable, 0),
@@ -1403,9 +2062,46 @@ static const sd_bus_vtable controller_vtable[] = {
                         SD_BUS_PARAM(id) SD_BUS_PARAM(job) SD_BUS_PARAM(node) SD_BUS_PARAM(unit)
                                         SD_BUS_PARAM(result),
                         0),
+        SD_BUS_SIGNAL_WITH_NAMES(
+                        "JobGroupRemoved",
+                        "uossa(sus)",
+                        SD_BUS_PARAM(id) SD_BUS_PARAM(group) SD_BUS_PARAM(node) SD_BUS_PARAM(job_type)
+                                        SD_BUS_PARAM(jobs),
+                        0),
+        SD_BUS_SIGNAL_WITH_NAMES(
+                        "UnitsListed",
+                        "us" UNIT_INFO_STRUCT_ARRAY_TYPESTRING,
+                        SD_BUS_PARAM(id) SD_BUS_PARAM(node) SD_BUS_PARAM(units),
+                        0),
+        SD_BUS_SIGNAL_WITH_NAMES(
+                        "UnitFilesListed",
+                        "us" UNIT_FILE_INFO_STRUCT_ARRAY_TYPESTRING,
+                        SD_BUS_PARAM(id) SD_BUS_PARAM(node) SD_BUS_PARAM(unit_files),
+                        0),
+        SD_BUS_SIGNAL_WITH_NAMES("ListDone", "ua{ss}", SD_BUS_PARAM(id) SD_BUS_PARAM(errors), 0),
         SD_BUS_PROPERTY("LogLevel", "s", controller_property_get_loglevel, 0, SD_BUS_VTABLE_PROPERTY_EXPLICIT),
         SD_BUS_PROPERTY("LogTarget", "s", controller_property_get_log_target, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("Status", "s", controller_property_get_status, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("ThrottledRequests",
+                        "t",
+                        NULL,
+                        offsetof(Controller, throttled_requests),
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
+        SD_BUS_PROPERTY("FleetRequestsInFlight",
+                        "u",
+                        NULL,
+                        offsetof(Controller, fleet_requests_in_flight),
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
+        SD_BUS_PROPERTY("QueuedFleetRequests",
+                        "u",
+                        NULL,
+                        offsetof(Controller, queued_fleet_requests),
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
+        SD_BUS_PROPERTY("RejectedFleetRequests",
+                        "t",
+                        NULL,
+                        offsetof(Controller, rejected_fleet_requests),
+                        SD_BUS_VTABLE_PROPERTY_EXPLICIT),
         SD_BUS_VTABLE_END
 };
 
@@ -1422,6 +2118,27 @@ static int controller_dbus_filter(UNUSED sd_bus_message *m, void *userdata, UNUS
                              sd_bus_message_get_signature(m, true));
         }
 
+        if (controller->api_request_rate > 0 && iface != NULL && str_has_prefix(iface, BC_INTERFACE_BASE_NAME ".") &&
+            sd_bus_message_is_method_call(m, NULL, NULL)) {
+                const char *sender = sd_bus_message_get_sender(m);
+                uint64_t now = 0;
+                int r = sd_event_now(controller->event, CLOCK_MONOTONIC, &now);
+                if (r < 0) {
+                        now = get_time_micros_monotonic();
+                }
+
+                if (!rate_limiter_take(
+                                    controller->api_rate_limiter,
+                                    sender != NULL ? sender : "",
+                                    controller->api_request_rate,
+                                    controller->api_request_burst,
+                                    now)) {
+                        controller->throttled_requests++;
+                        return sd_bus_reply_method_errorf(
+                                        m, BC_BUS_ERROR_RATE_LIMITED, "Request rate limit exceeded, try again later");
+                }
+        }
+
         if (iface != NULL && streq(iface, NODE_INTERFACE)) {
                 Node *node = controller_find_node_by_path(controller, object_path);
 
@@ -1440,6 +2157,8 @@ void controller_remove_monitor(Controller *controller, Monitor *monitor) {
 }
 
 static void controller_client_disconnected(Controller *controller, const char *client_id) {
+        rate_limiter_forget(controller->api_rate_limiter, client_id);
+
         /* Free any monitors owned by the client */
 
         Monitor *monitor = NULL;
@@ -1470,6 +2189,29 @@ static int controller_name_owner_changed(sd_bus_message *m, void *userdata, UNUS
         return 0;
 }
 
+bool controller_export(Controller *controller) {
+        int r = sd_bus_add_filter(
+                        controller->api_bus, &controller->filter_slot, controller_dbus_filter, controller);
+        if (r < 0) {
+                bc_log_errorf("Failed to add controller filter: %s", strerror(-r));
+                return false;
+        }
+
+        r = sd_bus_add_object_vtable(
+                        controller->api_bus,
+                        &controller->controller_slot,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        controller_vtable,
+                        controller);
+        if (r < 0) {
+                bc_log_errorf("Failed to add controller vtable: %s", strerror(-r));
+                return false;
+        }
+
+        return true;
+}
+
 bool controller_start(Controller *controller) {
         bc_log_infof("Starting bluechi-controller %s", CONFIG_H_BC_VERSION);
         if (controller == NULL) {
@@ -1501,13 +2243,6 @@ bool controller_start(Controller *controller) {
                 return false;
         }
 
-        r = sd_bus_add_filter(
-                        controller->api_bus, &controller->filter_slot, controller_dbus_filter, controller);
-        if (r < 0) {
-                bc_log_errorf("Failed to add controller filter: %s", strerror(-r));
-                return false;
-        }
-
         r = sd_bus_match_signal(
                         controller->api_bus,
                         &controller->name_owner_changed_slot,
@@ -1522,15 +2257,7 @@ bool controller_start(Controller *controller) {
                 return false;
         }
 
-        r = sd_bus_add_object_vtable(
-                        controller->api_bus,
-                        &controller->controller_slot,
-                        BC_CONTROLLER_OBJECT_PATH,
-                        CONTROLLER_INTERFACE,
-                        controller_vtable,
-                        controller);
-        if (r < 0) {
-                bc_log_errorf("Failed to add controller vtable: %s", strerror(-r));
+        if (!controller_export(controller)) {
                 return false;
         }
 
@@ -1538,10 +2265,10 @@ bool controller_start(Controller *controller) {
                 return false;
         }
 
-        r = controller_setup_heartbeat_timer(controller);
-        if (r < 0) {
-                bc_log_errorf("Failed to set up controller heartbeat timer: %s", strerror(-r));
-                return false;
+        /* Heartbeats are sent by a timer of each node once it registered */
+        if (controller->heartbeat_interval_msec <= 0) {
+                bc_log_warnf("Heartbeat disabled since configured interval '%d' is <=0",
+                             controller->heartbeat_interval_msec);
         }
 
         ShutdownHook hook;
@@ -1587,6 +2314,12 @@ void controller_stop(Controller *controller) {
                 controller_remove_monitor(controller, monitor);
         }
 
+        PendingFleetRequest *pending = NULL;
+        while ((pending = LIST_POP(pending_fleet_requests, controller->pending_fleet_requests)) != NULL) {
+                pending_fleet_request_free(pending);
+        }
+        controller->queued_fleet_requests = 0;
+
         /* If all nodes were already offline, we don't need to emit a changed signal */
         bool status_changed = controller->number_of_nodes_online > 0;
 
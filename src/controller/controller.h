@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include <hashmap.h>
 #include <inttypes.h>
 #include <stdbool.h>
 
@@ -12,6 +13,7 @@
 #include "libbluechi/common/common.h"
 #include "libbluechi/socket.h"
 
+#include "rate_limit.h"
 #include "types.h"
 
 struct Controller {
@@ -43,8 +45,26 @@ struct Controller {
         int number_of_nodes_online;
         LIST_HEAD(Node, nodes);
         LIST_HEAD(Node, anonymous_nodes);
+        /* Indexes of the named nodes, keyed by name and object path */
+        struct hashmap *nodes_by_name;
+        struct hashmap *nodes_by_path;
+
+        /* Admission control of the public API */
+        long api_request_rate; /* Requests per second and client, 0 disables the limit */
+        long api_request_burst;
+        RateLimiter *api_rate_limiter;
+        uint64_t throttled_requests;
+        long max_fleet_requests; /* Fleet-wide requests in flight, 0 for no limit */
+        long max_queued_fleet_requests;
+        uint32_t fleet_requests_in_flight;
+        uint32_t queued_fleet_requests;
+        uint64_t rejected_fleet_requests;
+        LIST_HEAD(PendingFleetRequest, pending_fleet_requests);
+        sd_event_source *pending_fleet_requests_source;
 
         LIST_HEAD(Job, jobs);
+        Job *jobs_tail; /* Jobs are appended, so they are removed in the order they were created */
+        struct hashmap *jobs_by_id;
         LIST_HEAD(Monitor, monitors);
         LIST_HEAD(Subscription, all_subscriptions);
 
@@ -55,9 +75,14 @@ Controller *controller_new(void);
 void controller_unref(Controller *controller);
 
 bool controller_set_port(Controller *controller, const char *port);
+bool controller_set_api_request_rate(Controller *controller, const char *rate);
+bool controller_set_api_request_burst(Controller *controller, const char *burst);
+bool controller_set_max_fleet_requests(Controller *controller, const char *max);
+bool controller_set_max_queued_fleet_requests(Controller *controller, const char *max);
 bool controller_parse_config(Controller *controller, const char *configfile);
 bool controller_apply_config(Controller *controller);
 
+bool controller_export(Controller *controller);
 bool controller_start(Controller *controller);
 void controller_stop(Controller *controller);
 
@@ -70,7 +95,9 @@ void controller_remove_node(Controller *controller, Node *node);
 Node *controller_add_node(Controller *controller, const char *name);
 
 bool controller_add_job(Controller *controller, Job *job);
+Job *controller_find_job(Controller *controller, uint32_t job_id);
 void controller_remove_job(Controller *controller, Job *job, const char *result);
+void controller_drop_job(Controller *controller, Job *job);
 void controller_finish_job(Controller *controller, uint32_t job_id, const char *result);
 void controller_job_state_changed(Controller *controller, uint32_t job_id, const char *state);
 
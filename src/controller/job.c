@@ -4,11 +4,14 @@
  * SPDX-License-Identifier: LGPL-2.1-or-later
  */
 #include <stddef.h>
+#include <stdio.h>
 
 #include "controller.h"
 #include "job.h"
+#include "libbluechi/common/pool.h"
 #include "libbluechi/log/log.h"
 #include "node.h"
+#include "rollout.h"
 
 static int job_property_get_nodename(
                 sd_bus *bus,
@@ -26,6 +29,14 @@ static int job_property_get_state(
                 sd_bus_message *reply,
                 void *userdata,
                 sd_bus_error *ret_error);
+static int job_property_get_children(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *ret_error);
 static int job_method_cancel(sd_bus_message *m, void *userdata, sd_bus_error *ret_error);
 
 static const sd_bus_vtable job_vtable[] = {
@@ -36,13 +47,16 @@ static const sd_bus_vtable job_vtable[] = {
         SD_BUS_PROPERTY("Unit", "s", NULL, offsetof(Job, unit), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("JobType", "s", NULL, offsetof(Job, type), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("State", "s", job_property_get_state, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Children", "a(sos)", job_property_get_children, 0, SD_BUS_VTABLE_PROPERTY_EXPLICIT),
         SD_BUS_VTABLE_END
 };
 
-Job *job_new(Node *node, const char *unit, const char *type) {
+static Pool job_pool = POOL_INIT(Job, 1024);
+
+static Job *job_new_full(Controller *controller, Node *node, const char *unit, const char *type) {
         static uint32_t next_id = 0;
 
-        _cleanup_job_ Job *job = malloc0(sizeof(Job));
+        _cleanup_job_ Job *job = pool_alloc0(&job_pool);
         if (job == NULL) {
                 return NULL;
         }
@@ -50,24 +64,22 @@ Job *job_new(Node *node, const char *unit, const char *type) {
         job->ref_count = 1;
         job->state = JOB_WAITING;
         job->id = ++next_id;
+        job->controller = controller;
         job->node = node;
         LIST_INIT(jobs, job);
 
-        job->type = strdup(type);
+        job->type = pool_strdup(job->type_buf, sizeof(job->type_buf), type);
         if (job->type == NULL) {
                 return NULL;
         }
 
-        job->unit = strdup(unit);
+        job->unit = pool_strdup(job->unit_buf, sizeof(job->unit_buf), unit);
         if (job->unit == NULL) {
                 return NULL;
         }
 
-        int r = asprintf(&job->object_path, "%s/%u", JOB_OBJECT_PATH_PREFIX, job->id);
-        if (r < 0) {
-                bc_log_error("Out of memory");
-                return NULL;
-        }
+        snprintf(job->object_path_buf, sizeof(job->object_path_buf), "%s/%u", JOB_OBJECT_PATH_PREFIX, job->id);
+        job->object_path = job->object_path_buf;
 
         job->job_start_micros = 0;
         job->job_end_micros = 0;
@@ -75,6 +87,15 @@ Job *job_new(Node *node, const char *unit, const char *type) {
         return steal_pointer(&job);
 }
 
+Job *job_new(Node *node, const char *unit, const char *type) {
+        return job_new_full(node->controller, node, unit, type);
+}
+
+/* A job that is not on a single node, but summarizes the jobs of a rollout on several nodes */
+Job *job_new_aggregate(Controller *controller, const char *unit, const char *type) {
+        return job_new_full(controller, NULL, unit, type);
+}
+
 Job *job_ref(Job *job) {
         job->ref_count++;
         return job;
@@ -87,16 +108,25 @@ void job_unref(Job *job) {
         }
 
         sd_bus_slot_unrefp(&job->export_slot);
+        if (job->rollout != NULL) {
+                rollout_unref(job->rollout);
+        }
+        if (job->group != NULL) {
+                job_group_unref(job->group);
+        }
+
+        pool_strfree(job->unit_buf, job->unit);
+        pool_strfree(job->type_buf, job->type);
+        pool_free(&job_pool, job);
+}
 
-        free_and_null(job->object_path);
-        free_and_null(job->unit);
-        free_and_null(job->type);
-        free(job);
+/* Jobs of a group only get their own object if the group exports them */
+bool job_has_object(Job *job) {
+        return job->group == NULL || job->group->export_jobs;
 }
 
 bool job_export(Job *job) {
-        Node *node = job->node;
-        Controller *controller = node->controller;
+        Controller *controller = job->controller;
 
         int r = sd_bus_add_object_vtable(
                         controller->api_bus, &job->export_slot, job->object_path, JOB_INTERFACE, job_vtable, job);
@@ -109,10 +139,12 @@ bool job_export(Job *job) {
 }
 
 void job_set_state(Job *job, JobState state) {
-        Node *node = job->node;
-        Controller *controller = node->controller;
+        Controller *controller = job->controller;
 
         job->state = state;
+        if (!job_has_object(job)) {
+                return;
+        }
 
         int r = sd_bus_emit_properties_changed(
                         controller->api_bus, job->object_path, JOB_INTERFACE, "State", NULL);
@@ -132,7 +164,7 @@ static int job_property_get_nodename(
         Job *job = userdata;
         Node *node = job->node;
 
-        return sd_bus_message_append(reply, "s", node->name);
+        return sd_bus_message_append(reply, "s", node != NULL ? node->name : "");
 }
 
 static int job_property_get_state(
@@ -148,6 +180,27 @@ static int job_property_get_state(
         return sd_bus_message_append(reply, "s", job_state_to_string(job->state));
 }
 
+static int job_property_get_children(
+                UNUSED sd_bus *bus,
+                UNUSED const char *path,
+                UNUSED const char *interface,
+                UNUSED const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                UNUSED sd_bus_error *ret_error) {
+        Job *job = userdata;
+
+        if (job->node == NULL && job->rollout != NULL) {
+                return rollout_append_children(job->rollout, reply);
+        }
+
+        int r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "(sos)");
+        if (r < 0) {
+                return r;
+        }
+        return sd_bus_message_close_container(reply);
+}
+
 
 static int job_cancel_callback(UNUSED AgentRequest *req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
         if (sd_bus_message_is_method_error(m, NULL)) {
@@ -159,9 +212,33 @@ static int job_cancel_callback(UNUSED AgentRequest *req, sd_bus_message *m, UNUS
         return 0;
 }
 
+/* Asks the agent to cancel the job, the result is only logged */
+int job_cancel(Job *job) {
+        _cleanup_agent_request_ AgentRequest *req = NULL;
+        int r = node_create_request(&req, job->node, "JobCancel", job_cancel_callback, NULL, NULL);
+        if (req == NULL) {
+                return r;
+        }
+
+        r = sd_bus_message_append(req->message, "u", job->id);
+        if (r < 0) {
+                return r;
+        }
+
+        return agent_request_start(req);
+}
+
 static int job_method_cancel(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
         Job *job = (Job *) userdata;
 
+        /* The aggregate job of a rollout cancels the jobs on all of its nodes */
+        if (job->node == NULL) {
+                if (job->rollout != NULL) {
+                        rollout_cancel(job->rollout);
+                }
+                return sd_bus_reply_method_return(m, "");
+        }
+
         _cleanup_agent_request_ AgentRequest *req = NULL;
         int r = node_create_request(
                         &req,
@@ -205,3 +282,237 @@ static int job_method_cancel(sd_bus_message *m, void *userdata, UNUSED sd_bus_er
          */
         return sd_bus_reply_method_return(m, "");
 }
+
+/************************************************************************
+ ***************** JobGroup *********************************************
+ ************************************************************************/
+
+static int job_group_property_get_nodename(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *ret_error);
+static int job_group_property_get_jobs(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *ret_error);
+static int job_group_method_cancel(sd_bus_message *m, void *userdata, sd_bus_error *ret_error);
+
+static const sd_bus_vtable job_group_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_METHOD("Cancel", "", "", job_group_method_cancel, 0),
+        SD_BUS_PROPERTY("Id", "u", NULL, offsetof(JobGroup, id), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Node", "s", job_group_property_get_nodename, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("JobType", "s", NULL, offsetof(JobGroup, type), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Jobs", "a(sus)", job_group_property_get_jobs, 0, SD_BUS_VTABLE_PROPERTY_EXPLICIT),
+        SD_BUS_VTABLE_END
+};
+
+JobGroup *job_group_new(Node *node, const char *type, size_t n_jobs, bool export_jobs) {
+        static uint32_t next_id = 0;
+
+        _cleanup_job_group_ JobGroup *group = malloc0_array(sizeof(JobGroup), sizeof(JobGroupEntry), n_jobs);
+        if (group == NULL) {
+                return NULL;
+        }
+
+        group->ref_count = 1;
+        group->controller = node->controller;
+        group->node = node_ref(node);
+        group->id = ++next_id;
+        group->export_jobs = export_jobs;
+
+        group->type = strdup(type);
+        if (group->type == NULL) {
+                return NULL;
+        }
+
+        int r = asprintf(&group->object_path, "%s/%u", JOB_GROUP_OBJECT_PATH_PREFIX, group->id);
+        if (r < 0) {
+                bc_log_error("Out of memory");
+                return NULL;
+        }
+
+        return steal_pointer(&group);
+}
+
+JobGroup *job_group_ref(JobGroup *group) {
+        group->ref_count++;
+        return group;
+}
+
+void job_group_unref(JobGroup *group) {
+        group->ref_count--;
+        if (group->ref_count != 0) {
+                return;
+        }
+
+        for (size_t i = 0; i < group->n_jobs; i++) {
+                free_and_null(group->jobs[i].unit);
+                free_and_null(group->jobs[i].result);
+        }
+
+        sd_bus_slot_unrefp(&group->export_slot);
+        node_unrefp(&group->node);
+        free_and_null(group->object_path);
+        free_and_null(group->type);
+        free(group);
+}
+
+bool job_group_export(JobGroup *group) {
+        int r = sd_bus_add_object_vtable(
+                        group->controller->api_bus,
+                        &group->export_slot,
+                        group->object_path,
+                        JOB_GROUP_INTERFACE,
+                        job_group_vtable,
+                        group);
+        if (r < 0) {
+                bc_log_errorf("Failed to add job group vtable: %s", strerror(-r));
+                return false;
+        }
+
+        return true;
+}
+
+Job *job_group_add_unit(JobGroup *group, const char *unit) {
+        JobGroupEntry *entry = &group->jobs[group->n_jobs];
+
+        _cleanup_job_ Job *job = job_new(group->node, unit, group->type);
+        if (job == NULL) {
+                return NULL;
+        }
+
+        entry->unit = strdup(unit);
+        if (entry->unit == NULL) {
+                return NULL;
+        }
+        entry->job_id = job->id;
+
+        job->group = job_group_ref(group);
+        job->group_index = group->n_jobs;
+        group->n_jobs++;
+        group->n_pending++;
+
+        return steal_pointer(&job);
+}
+
+static int job_group_append_jobs(JobGroup *group, sd_bus_message *m) {
+        int r = sd_bus_message_open_container(m, SD_BUS_TYPE_ARRAY, "(sus)");
+        if (r < 0) {
+                return r;
+        }
+
+        for (size_t i = 0; i < group->n_jobs; i++) {
+                JobGroupEntry *entry = &group->jobs[i];
+                r = sd_bus_message_append(
+                                m, "(sus)", entry->unit, entry->job_id, entry->result != NULL ? entry->result : "");
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        return sd_bus_message_close_container(m);
+}
+
+static void job_group_done(JobGroup *group) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_signal(
+                        group->controller->api_bus,
+                        &m,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "JobGroupRemoved");
+        if (r >= 0) {
+                r = sd_bus_message_append(m, "uoss", group->id, group->object_path, group->node->name, group->type);
+        }
+        if (r >= 0) {
+                r = job_group_append_jobs(group, m);
+        }
+        if (r >= 0) {
+                r = sd_bus_send(NULL, m, NULL);
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to emit JobGroupRemoved signal: %s", strerror(-r));
+        }
+
+        sd_bus_slot_unrefp(&group->export_slot);
+}
+
+void job_group_finish_job(JobGroup *group, size_t index, const char *result) {
+        JobGroupEntry *entry = &group->jobs[index];
+        if (entry->done) {
+                return;
+        }
+
+        entry->done = true;
+        entry->result = strdup(result);
+        group->n_pending--;
+
+        if (group->sealed && group->n_pending == 0) {
+                job_group_done(group);
+        }
+}
+
+void job_group_seal(JobGroup *group) {
+        group->sealed = true;
+        if (group->n_pending == 0) {
+                job_group_done(group);
+        }
+}
+
+static int job_group_property_get_nodename(
+                UNUSED sd_bus *bus,
+                UNUSED const char *path,
+                UNUSED const char *interface,
+                UNUSED const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                UNUSED sd_bus_error *ret_error) {
+        JobGroup *group = userdata;
+
+        return sd_bus_message_append(reply, "s", group->node->name);
+}
+
+static int job_group_property_get_jobs(
+                UNUSED sd_bus *bus,
+                UNUSED const char *path,
+                UNUSED const char *interface,
+                UNUSED const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                UNUSED sd_bus_error *ret_error) {
+        return job_group_append_jobs((JobGroup *) userdata, reply);
+}
+
+static int job_group_method_cancel(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        JobGroup *group = userdata;
+
+        for (size_t i = 0; i < group->n_jobs; i++) {
+                if (group->jobs[i].done) {
+                        continue;
+                }
+                Job *job = controller_find_job(group->controller, group->jobs[i].job_id);
+                if (job == NULL) {
+                        continue;
+                }
+                int r = job_cancel(job);
+                if (r < 0) {
+                        return sd_bus_reply_method_errorf(
+                                        m,
+                                        SD_BUS_ERROR_FAILED,
+                                        "Failed to call the method to cancel job '%d': %s",
+                                        job->id,
+                                        strerror(-r));
+                }
+        }
+
+        return sd_bus_reply_method_return(m, "");
+}
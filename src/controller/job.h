@@ -9,15 +9,24 @@
 
 #include "types.h"
 
+/* Most unit names fit into the buffer of their job, see pool_strdup() */
+#define JOB_TYPE_BUF_SIZE 16
+#define JOB_UNIT_BUF_SIZE 64
+#define JOB_OBJECT_PATH_BUF_SIZE (sizeof(JOB_OBJECT_PATH_PREFIX "/") + 10)
+
 struct Job {
         int ref_count;
 
-        Node *node; /* weak ref */
+        Controller *controller; /* weak ref */
+        Node *node;             /* weak ref, NULL for the aggregate job of a rollout */
+        Rollout *rollout;       /* strong ref, set on the aggregate job of a rollout and its per-node jobs */
+        JobGroup *group;        /* strong ref */
+        size_t group_index;
 
         JobState state;
 
         uint32_t id;
-        char *object_path;
+        char *object_path; /* Points to object_path_buf */
         char *type;
         char *unit;
 
@@ -27,16 +36,74 @@ struct Job {
         uint64_t job_end_micros;
 
         LIST_FIELDS(Job, jobs);
+
+        char object_path_buf[JOB_OBJECT_PATH_BUF_SIZE];
+        char type_buf[JOB_TYPE_BUF_SIZE];
+        char unit_buf[JOB_UNIT_BUF_SIZE];
 };
 
 
 Job *job_new(Node *node, const char *unit, const char *type);
+Job *job_new_aggregate(Controller *controller, const char *unit, const char *type);
 Job *job_ref(Job *job);
 void job_unref(Job *job);
 
 void job_set_state(Job *job, JobState state);
 
 bool job_export(Job *job);
+int job_cancel(Job *job);
 
 DEFINE_CLEANUP_FUNC(Job, job_unref)
 #define _cleanup_job_ _cleanup_(job_unrefp)
+
+typedef struct JobGroupEntry {
+        char *unit;
+        uint32_t job_id;
+        char *result;
+        bool done;
+} JobGroupEntry;
+
+/*
+ * Jobs of several units on one node that are tracked as a whole. The group is
+ * exported as a single object and a single JobGroupRemoved signal carries the
+ * results of all jobs. Without export_jobs, the jobs of the group get neither
+ * a D-Bus object nor JobNew and JobRemoved signals.
+ *
+ * The group is kept alive by its jobs.
+ */
+struct JobGroup {
+        int ref_count;
+
+        Controller *controller; /* weak ref */
+        Node *node;
+
+        uint32_t id;
+        char *object_path;
+        char *type;
+        bool export_jobs;
+        bool sealed; /* All jobs are submitted, the group may finish */
+
+        sd_bus_slot *export_slot;
+
+        size_t n_pending;
+        size_t n_jobs;
+        JobGroupEntry jobs[0];
+};
+
+JobGroup *job_group_new(Node *node, const char *type, size_t n_jobs, bool export_jobs);
+JobGroup *job_group_ref(JobGroup *group);
+void job_group_unref(JobGroup *group);
+
+bool job_group_export(JobGroup *group);
+
+/* Creates the job of the next unit of the group */
+Job *job_group_add_unit(JobGroup *group, const char *unit);
+bool job_has_object(Job *job);
+
+/* Records the result of a job, or of a unit that never got a job queued */
+void job_group_finish_job(JobGroup *group, size_t index, const char *result);
+/* Called once all jobs are submitted, emits JobGroupRemoved right away if none is pending */
+void job_group_seal(JobGroup *group);
+
+DEFINE_CLEANUP_FUNC(JobGroup, job_group_unref)
+#define _cleanup_job_group_ _cleanup_(job_group_unrefp)
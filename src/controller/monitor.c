@@ -72,6 +72,13 @@ bool subscription_add_unit(Subscription *sub, const char *unit) {
         return true;
 }
 
+bool subscription_add_property(Subscription *sub, const char *property) {
+        if (strv_contains(sub->properties, property)) {
+                return true;
+        }
+        return strv_extend(&sub->properties, property);
+}
+
 bool subscription_has_node_wildcard(Subscription *sub) {
         return sub->node != NULL && streq(sub->node, SYMBOL_WILDCARD);
 }
@@ -99,6 +106,7 @@ void subscription_unref(Subscription *subscription) {
                 free_and_null(su);
         }
 
+        freev((void **) subscription->properties);
         free_and_null(subscription->node);
         free_and_null(subscription);
 }
@@ -111,6 +119,7 @@ void subscription_unref(Subscription *subscription) {
 static int monitor_method_close(sd_bus_message *m, void *userdata, sd_bus_error *ret_error);
 static int monitor_method_subscribe(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int monitor_method_subscribe_list(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int monitor_method_subscribe_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int monitor_method_unsubscribe(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int monitor_method_add_peer(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int monitor_method_remove_peer(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
@@ -121,6 +130,7 @@ static const sd_bus_vtable monitor_vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("Subscribe", "ss", "u", monitor_method_subscribe, 0),
         SD_BUS_METHOD("SubscribeList", "sas", "u", monitor_method_subscribe_list, 0),
+        SD_BUS_METHOD("SubscribeProperties", "sasas", "u", monitor_method_subscribe_properties, 0),
         SD_BUS_METHOD("Unsubscribe", "u", "", monitor_method_unsubscribe, 0),
         SD_BUS_METHOD("AddPeer", "s", "u", monitor_method_add_peer, 0),
         SD_BUS_METHOD("RemovePeer", "us", "", monitor_method_remove_peer, 0),
@@ -357,6 +367,74 @@ static int monitor_method_subscribe_list(sd_bus_message *m, void *userdata, UNUS
         return sd_bus_reply_method_return(m, "u", sub->id);
 }
 
+/***********************************************************
+ ***** org.eclipse.bluechi.Monitor.SubscribeProperties *****
+ ***********************************************************/
+
+static int monitor_read_subscription_strings(
+                sd_bus_message *m, Subscription *sub, bool (*add)(Subscription *sub, const char *s)) {
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "s");
+        if (r < 0) {
+                return r;
+        }
+
+        while (sd_bus_message_at_end(m, false) == 0) {
+                const char *s = NULL;
+                r = sd_bus_message_read(m, "s", &s);
+                if (r < 0) {
+                        return r;
+                }
+                if (!add(sub, s)) {
+                        return -ENOMEM;
+                }
+        }
+
+        return sd_bus_message_exit_container(m);
+}
+
+static int monitor_method_subscribe_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Monitor *monitor = userdata;
+        Controller *controller = monitor->controller;
+
+        const char *node = NULL;
+        int r = sd_bus_message_read(m, "s", &node);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                SD_BUS_ERROR_INVALID_ARGS,
+                                "Invalid argument for the node name: %s",
+                                strerror(-r));
+        }
+
+        _cleanup_subscription_ Subscription *sub = create_monitor_subscription(monitor, node);
+        if (sub == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to create a monitor subscription");
+        }
+
+        r = monitor_read_subscription_strings(m, sub, subscription_add_unit);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                r == -ENOMEM ? SD_BUS_ERROR_FAILED : SD_BUS_ERROR_INVALID_ARGS,
+                                "Invalid argument for an array of units: %s",
+                                strerror(-r));
+        }
+
+        r = monitor_read_subscription_strings(m, sub, subscription_add_property);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                r == -ENOMEM ? SD_BUS_ERROR_FAILED : SD_BUS_ERROR_INVALID_ARGS,
+                                "Invalid argument for an array of properties: %s",
+                                strerror(-r));
+        }
+
+        LIST_APPEND(subscriptions, monitor->subscriptions, subscription_ref(sub));
+        controller_add_subscription(controller, sub);
+
+        return sd_bus_reply_method_return(m, "u", sub->id);
+}
+
 /***********************************************************
  ********* org.eclipse.bluechi.Monitor.Unsubscribe *********
  ***********************************************************/
@@ -530,96 +608,73 @@ static int monitor_method_remove_peer(sd_bus_message *m, void *userdata, UNUSED
  ********* Monitor events *********
  **********************************/
 
-static sd_bus_message *assemble_unit_new_signal(
-                Monitor *monitor, const char *node, const char *unit, const char *reason);
-static sd_bus_message *assemble_unit_removed_signal(
-                Monitor *monitor, const char *node, const char *unit, const char *reason);
-static sd_bus_message *assemble_unit_property_changed_signal(
-                Monitor *monitor, const char *node, const char *unit, const char *interface, sd_bus_message *m);
-static sd_bus_message *assemble_unit_state_changed_signal(
-                Monitor *monitor,
-                const char *node,
-                const char *unit,
-                const char *active_state,
-                const char *substate,
-                const char *reason);
+/* Arguments of a unit event, shared by all signals emitted for it */
+typedef struct {
+        const char *node;
+        const char *unit;
+        const char *interface;
+        sd_bus_message *properties;
+        const char *active_state;
+        const char *substate;
+        const char *reason;
+} MonitorEvent;
 
-int monitor_on_unit_property_changed(
-                void *userdata, const char *node, const char *unit, const char *interface, sd_bus_message *m) {
-        Monitor *monitor = (Monitor *) userdata;
-        Controller *controller = monitor->controller;
+typedef sd_bus_message *(*monitor_assemble_signal_t)(Monitor *monitor, const MonitorEvent *event);
 
-        int r = 0;
-        _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
+static sd_bus_message *assemble_unit_new_signal(Monitor *monitor, const MonitorEvent *event);
+static sd_bus_message *assemble_unit_removed_signal(Monitor *monitor, const MonitorEvent *event);
+static sd_bus_message *assemble_unit_property_changed_signal(Monitor *monitor, const MonitorEvent *event);
+static sd_bus_message *assemble_unit_state_changed_signal(Monitor *monitor, const MonitorEvent *event);
+
+/*
+ * Emits the signal for an event to the monitor owner and all of its peers.
+ * sd-bus can't change the destination of a sealed message, so the signal
+ * has to be assembled for each of them.
+ */
+static void monitor_emit_event(
+                Monitor *monitor, const char *name, monitor_assemble_signal_t assemble, const MonitorEvent *event) {
+        Controller *controller = monitor->controller;
 
-        sig = assemble_unit_property_changed_signal(monitor, node, unit, interface, m);
+        _cleanup_sd_bus_message_ sd_bus_message *sig = assemble(monitor, event);
         if (sig != NULL) {
-                r = sd_bus_send_to(controller->api_bus, sig, monitor->owner, NULL);
+                int r = sd_bus_send_to(controller->api_bus, sig, monitor->owner, NULL);
                 if (r < 0) {
-                        bc_log_errorf("Monitor: %s, failed to send UnitPropertyChanged signal to monitor owner: %s",
+                        bc_log_errorf("Monitor: %s, failed to send %s signal to monitor owner: %s",
                                       monitor->object_path,
+                                      name,
                                       strerror(-r));
                 }
-                sd_bus_message_unrefp(&sig);
-                sig = NULL;
         }
 
         MonitorPeer *peer = NULL;
         MonitorPeer *next_peer = NULL;
         LIST_FOREACH_SAFE(peers, peer, next_peer, monitor->peers) {
-                sig = assemble_unit_property_changed_signal(monitor, node, unit, interface, m);
-                if (sig != NULL) {
-                        r = sd_bus_send_to(controller->api_bus, sig, peer->name, NULL);
-                        if (r < 0) {
-                                bc_log_errorf("Monitor: %s, failed to send UnitPropertyChanged signal to peer '%s': %s",
-                                              monitor->object_path,
-                                              peer->name,
-                                              strerror(-r));
-                        }
-                        sd_bus_message_unrefp(&sig);
-                        sig = NULL;
+                _cleanup_sd_bus_message_ sd_bus_message *peer_sig = assemble(monitor, event);
+                if (peer_sig == NULL) {
+                        continue;
                 }
-        }
-
-        return 0;
-}
-
-int monitor_on_unit_new(void *userdata, const char *node, const char *unit, const char *reason) {
-        Monitor *monitor = (Monitor *) userdata;
-        Controller *controller = monitor->controller;
-
-        int r = 0;
-        _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
-
-        sig = assemble_unit_new_signal(monitor, node, unit, reason);
-        if (sig != NULL) {
-                r = sd_bus_send_to(controller->api_bus, sig, monitor->owner, NULL);
+                int r = sd_bus_send_to(controller->api_bus, peer_sig, peer->name, NULL);
                 if (r < 0) {
-                        bc_log_errorf("Monitor: %s, failed to send UnitNew signal to monitor owner: %s",
+                        bc_log_errorf("Monitor: %s, failed to send %s signal to peer '%s': %s",
                                       monitor->object_path,
+                                      name,
+                                      peer->name,
                                       strerror(-r));
                 }
-                sd_bus_message_unrefp(&sig);
-                sig = NULL;
         }
+}
 
-        MonitorPeer *peer = NULL;
-        MonitorPeer *next_peer = NULL;
-        LIST_FOREACH_SAFE(peers, peer, next_peer, monitor->peers) {
-                sig = assemble_unit_new_signal(monitor, node, unit, reason);
-                if (sig != NULL) {
-                        r = sd_bus_send_to(controller->api_bus, sig, peer->name, NULL);
-                        if (r < 0) {
-                                bc_log_errorf("Monitor: %s, failed to send signal to peer '%s': %s",
-                                              monitor->object_path,
-                                              peer->name,
-                                              strerror(-r));
-                        }
-                        sd_bus_message_unrefp(&sig);
-                        sig = NULL;
-                }
-        }
+int monitor_on_unit_property_changed(
+                void *userdata, const char *node, const char *unit, const char *interface, sd_bus_message *m) {
+        MonitorEvent event = { .node = node, .unit = unit, .interface = interface, .properties = m };
+        monitor_emit_event(
+                        (Monitor *) userdata, "UnitPropertiesChanged", assemble_unit_property_changed_signal, &event);
+        return 0;
+}
 
+int monitor_on_unit_new(void *userdata, const char *node, const char *unit, const char *reason) {
+        MonitorEvent event = { .node = node, .unit = unit, .reason = reason };
+        monitor_emit_event((Monitor *) userdata, "UnitNew", assemble_unit_new_signal, &event);
         return 0;
 }
 
@@ -630,86 +685,25 @@ int monitor_on_unit_state_changed(
                 const char *active_state,
                 const char *substate,
                 const char *reason) {
-        Monitor *monitor = (Monitor *) userdata;
-        Controller *controller = monitor->controller;
-
-        int r = 0;
-        _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
-
-        sig = assemble_unit_state_changed_signal(monitor, node, unit, active_state, substate, reason);
-        if (sig != NULL) {
-                r = sd_bus_send_to(controller->api_bus, sig, monitor->owner, NULL);
-                if (r < 0) {
-                        bc_log_errorf("Monitor: %s, failed to send signal to monitor owner: %s",
-                                      monitor->object_path,
-                                      strerror(-r));
-                }
-                sd_bus_message_unrefp(&sig);
-                sig = NULL;
-        }
-
-        MonitorPeer *peer = NULL;
-        MonitorPeer *next_peer = NULL;
-        LIST_FOREACH_SAFE(peers, peer, next_peer, monitor->peers) {
-                sig = assemble_unit_state_changed_signal(monitor, node, unit, active_state, substate, reason);
-                if (sig != NULL) {
-                        r = sd_bus_send_to(controller->api_bus, sig, peer->name, NULL);
-                        if (r < 0) {
-                                bc_log_errorf("Monitor: %s, failed to send UnitStateChanged signal to peer '%s': %s",
-                                              monitor->object_path,
-                                              peer->name,
-                                              strerror(-r));
-                        }
-                        sd_bus_message_unrefp(&sig);
-                        sig = NULL;
-                }
-        }
-
+        MonitorEvent event = {
+                .node = node,
+                .unit = unit,
+                .active_state = active_state,
+                .substate = substate,
+                .reason = reason,
+        };
+        monitor_emit_event((Monitor *) userdata, "UnitStateChanged", assemble_unit_state_changed_signal, &event);
         return 0;
 }
 
 int monitor_on_unit_removed(void *userdata, const char *node, const char *unit, const char *reason) {
-        Monitor *monitor = (Monitor *) userdata;
-        Controller *controller = monitor->controller;
-
-        int r = 0;
-        _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
-
-        sig = assemble_unit_removed_signal(monitor, node, unit, reason);
-        if (sig != NULL) {
-                r = sd_bus_send_to(controller->api_bus, sig, monitor->owner, NULL);
-                if (r < 0) {
-                        bc_log_errorf("Monitor: %s, failed to send signal to monitor owner: %s",
-                                      monitor->object_path,
-                                      strerror(-r));
-                }
-                sd_bus_message_unrefp(&sig);
-                sig = NULL;
-        }
-
-        MonitorPeer *peer = NULL;
-        MonitorPeer *next_peer = NULL;
-        LIST_FOREACH_SAFE(peers, peer, next_peer, monitor->peers) {
-                sig = assemble_unit_removed_signal(monitor, node, unit, reason);
-                if (sig != NULL) {
-                        r = sd_bus_send_to(controller->api_bus, sig, peer->name, NULL);
-                        if (r < 0) {
-                                bc_log_errorf("Monitor: %s, failed to send UnitRemoved signal to peer '%s': %s",
-                                              monitor->object_path,
-                                              peer->name,
-                                              strerror(-r));
-                        }
-                        sd_bus_message_unrefp(&sig);
-                        sig = NULL;
-                }
-        }
-
+        MonitorEvent event = { .node = node, .unit = unit, .reason = reason };
+        monitor_emit_event((Monitor *) userdata, "UnitRemoved", assemble_unit_removed_signal, &event);
         return 0;
 }
 
 
-static sd_bus_message *assemble_unit_new_signal(
-                Monitor *monitor, const char *node, const char *unit, const char *reason) {
+static sd_bus_message *assemble_unit_new_signal(Monitor *monitor, const MonitorEvent *event) {
         Controller *controller = monitor->controller;
 
         _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
@@ -722,7 +716,7 @@ static sd_bus_message *assemble_unit_new_signal(
                 return NULL;
         }
 
-        r = sd_bus_message_append(sig, "sss", node, unit, reason);
+        r = sd_bus_message_append(sig, "sss", event->node, event->unit, event->reason);
         if (r < 0) {
                 bc_log_errorf("Monitor: %s, failed to append data to UnitNew signal: %s",
                               monitor->object_path,
@@ -733,8 +727,7 @@ static sd_bus_message *assemble_unit_new_signal(
         return steal_pointer(&sig);
 }
 
-static sd_bus_message *assemble_unit_removed_signal(
-                Monitor *monitor, const char *node, const char *unit, const char *reason) {
+static sd_bus_message *assemble_unit_removed_signal(Monitor *monitor, const MonitorEvent *event) {
         Controller *controller = monitor->controller;
 
         _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
@@ -747,7 +740,7 @@ static sd_bus_message *assemble_unit_removed_signal(
                 return NULL;
         }
 
-        r = sd_bus_message_append(sig, "sss", node, unit, reason);
+        r = sd_bus_message_append(sig, "sss", event->node, event->unit, event->reason);
         if (r < 0) {
                 bc_log_errorf("Monitor: %s, failed to append data to UnitRemoved signal: %s",
                               monitor->object_path,
@@ -758,9 +751,9 @@ static sd_bus_message *assemble_unit_removed_signal(
         return steal_pointer(&sig);
 }
 
-static sd_bus_message *assemble_unit_property_changed_signal(
-                Monitor *monitor, const char *node, const char *unit, const char *interface, sd_bus_message *m) {
+static sd_bus_message *assemble_unit_property_changed_signal(Monitor *monitor, const MonitorEvent *event) {
         Controller *controller = monitor->controller;
+        sd_bus_message *m = event->properties;
 
         _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
         int r = sd_bus_message_new_signal(
@@ -776,7 +769,7 @@ static sd_bus_message *assemble_unit_property_changed_signal(
                 return NULL;
         }
 
-        r = sd_bus_message_append(sig, "sss", node, unit, interface);
+        r = sd_bus_message_append(sig, "sss", event->node, event->unit, event->interface);
         if (r < 0) {
                 bc_log_errorf("Monitor: %s, failed to append data to UnitPropertiesChanged signal: %s",
                               monitor->object_path,
@@ -811,13 +804,7 @@ static sd_bus_message *assemble_unit_property_changed_signal(
         return steal_pointer(&sig);
 }
 
-static sd_bus_message *assemble_unit_state_changed_signal(
-                Monitor *monitor,
-                const char *node,
-                const char *unit,
-                const char *active_state,
-                const char *substate,
-                const char *reason) {
+static sd_bus_message *assemble_unit_state_changed_signal(Monitor *monitor, const MonitorEvent *event) {
         Controller *controller = monitor->controller;
 
         _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
@@ -830,7 +817,8 @@ static sd_bus_message *assemble_unit_state_changed_signal(
                 return NULL;
         }
 
-        r = sd_bus_message_append(sig, "sssss", node, unit, active_state, substate, reason);
+        r = sd_bus_message_append(
+                        sig, "sssss", event->node, event->unit, event->active_state, event->substate, event->reason);
         if (r < 0) {
                 bc_log_errorf("Monitor: %s, failed to append data to UnitStateChanged signal: %s",
                               monitor->object_path,
@@ -36,6 +36,7 @@ struct Subscription {
 
         char *node;
         LIST_HEAD(SubscribedUnit, subscribed_units);
+        char **properties; /* Properties forwarded in UnitPropertiesChanged, NULL for all */
 
         LIST_FIELDS(Subscription, subscriptions);     /* List in Monitor */
         LIST_FIELDS(Subscription, all_subscriptions); /* List in Controller */
@@ -50,6 +51,7 @@ Subscription *subscription_new(const char *node);
 Subscription *create_monitor_subscription(Monitor *monitor, const char *node);
 
 bool subscription_add_unit(Subscription *sub, const char *unit);
+bool subscription_add_property(Subscription *sub, const char *property);
 bool subscription_has_node_wildcard(Subscription *sub);
 
 Subscription *subscription_ref(Subscription *subscription);
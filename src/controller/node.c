@@ -11,7 +11,9 @@
 
 #include "libbluechi/bus/bus.h"
 #include "libbluechi/bus/utils.h"
+#include "libbluechi/common/event-util.h"
 #include "libbluechi/common/parse-util.h"
+#include "libbluechi/common/pool.h"
 #include "libbluechi/common/time-util.h"
 #include "libbluechi/log/log.h"
 
@@ -21,23 +23,34 @@
 #include "monitor.h"
 #include "node.h"
 #include "proxy_monitor.h"
+#include "rollout.h"
+#include "unit_cache.h"
 
 #define DEBUG_AGENT_MESSAGES 0
 
-static void node_send_agent_subscribe_all(Node *node);
+static void node_resync_agent(Node *node);
 static void node_start_proxy_dependency_all(Node *node);
 static int node_run_unit_lifecycle_method(sd_bus_message *m, Node *node, const char *job_type, const char *method);
 
 static int node_method_register(sd_bus_message *m, void *userdata, sd_bus_error *ret_error);
 static int node_disconnected(sd_bus_message *message, void *userdata, sd_bus_error *error);
 static int node_method_list_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_list_units_filtered(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_list_unit_files(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_set_unit_properties(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_start_unit(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_stop_unit(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_restart_unit(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_reload_unit(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_start_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_stop_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_start_unit_group(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_stop_unit_group(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_restart_unit_group(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_restart_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_passthrough_to_agent(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
+static int node_method_passthrough_read_only_to_agent(
+                sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_method_set_log_level(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error);
 static int node_property_get_status(
                 sd_bus *bus,
@@ -58,7 +71,7 @@ static int node_property_get_peer_ip(
 
 static const sd_bus_vtable internal_controller_controller_vtable[] = {
         SD_BUS_VTABLE_START(0),
-        SD_BUS_METHOD("Register", "s", "", node_method_register, 0),
+        SD_BUS_METHOD("Register", "s", "as", node_method_register, 0),
         SD_BUS_SIGNAL("Heartbeat", "", 0),
         SD_BUS_VTABLE_END
 };
@@ -66,8 +79,13 @@ static const sd_bus_vtable internal_controller_controller_vtable[] = {
 static const sd_bus_vtable node_vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("ListUnits", "", UNIT_INFO_STRUCT_ARRAY_TYPESTRING, node_method_list_units, 0),
+        SD_BUS_METHOD("ListUnitsFiltered",
+                      "asasasas",
+                      UNIT_INFO_STRUCT_ARRAY_TYPESTRING,
+                      node_method_list_units_filtered,
+                      0),
         SD_BUS_METHOD("ListUnitFiles", "", UNIT_FILE_INFO_STRUCT_ARRAY_TYPESTRING, node_method_list_unit_files, 0),
-        SD_BUS_METHOD("GetUnitFileState", "s", "s", node_method_passthrough_to_agent, 0),
+        SD_BUS_METHOD("GetUnitFileState", "s", "s", node_method_passthrough_read_only_to_agent, 0),
         SD_BUS_METHOD("StartUnit", "ss", "o", node_method_start_unit, 0),
         SD_BUS_METHOD("StartTransientUnit", "ssa(sv)a(sa(sv))", "o", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("StopUnit", "ss", "o", node_method_stop_unit, 0),
@@ -75,17 +93,23 @@ static const sd_bus_vtable node_vtable[] = {
         SD_BUS_METHOD("ThawUnit", "s", "", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("RestartUnit", "ss", "o", node_method_restart_unit, 0),
         SD_BUS_METHOD("ReloadUnit", "ss", "o", node_method_reload_unit, 0),
+        SD_BUS_METHOD("StartUnits", "ass", "a(os)", node_method_start_units, 0),
+        SD_BUS_METHOD("StopUnits", "ass", "a(os)", node_method_stop_units, 0),
+        SD_BUS_METHOD("RestartUnits", "ass", "a(os)", node_method_restart_units, 0),
+        SD_BUS_METHOD("StartUnitGroup", "assb", "o", node_method_start_unit_group, 0),
+        SD_BUS_METHOD("StopUnitGroup", "assb", "o", node_method_stop_unit_group, 0),
+        SD_BUS_METHOD("RestartUnitGroup", "assb", "o", node_method_restart_unit_group, 0),
         SD_BUS_METHOD("ResetFailed", "", "", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("ResetFailedUnit", "s", "", node_method_passthrough_to_agent, 0),
-        SD_BUS_METHOD("GetUnitProperties", "ss", "a{sv}", node_method_passthrough_to_agent, 0),
-        SD_BUS_METHOD("GetUnitProperty", "sss", "v", node_method_passthrough_to_agent, 0),
+        SD_BUS_METHOD("GetUnitProperties", "ss", "a{sv}", node_method_passthrough_read_only_to_agent, 0),
+        SD_BUS_METHOD("GetUnitProperty", "sss", "v", node_method_passthrough_read_only_to_agent, 0),
         SD_BUS_METHOD("SetUnitProperties", "sba(sv)", "", node_method_set_unit_properties, 0),
         SD_BUS_METHOD("EnableUnitFiles", "asbb", "ba(sss)", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("DisableUnitFiles", "asb", "a(sss)", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("Reload", "", "", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("KillUnit", "ssi", "", node_method_passthrough_to_agent, 0),
         SD_BUS_METHOD("SetLogLevel", "s", "", node_method_set_log_level, 0),
-        SD_BUS_METHOD("GetDefaultTarget", "", "s", node_method_passthrough_to_agent, 0),
+        SD_BUS_METHOD("GetDefaultTarget", "", "s", node_method_passthrough_read_only_to_agent, 0),
         SD_BUS_METHOD("SetDefaultTarget", "sb", "a(sss)", node_method_passthrough_to_agent, 0),
         SD_BUS_PROPERTY("Name", "s", NULL, offsetof(Node, name), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("Status", "s", node_property_get_status, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
@@ -127,12 +151,39 @@ struct UnitSubscription {
         LIST_FIELDS(UnitSubscription, subs);
 };
 
+/* A subscription receiving the events of a unit. It is counted once for
+ * every UnitSubscription routing it there, either via the unit itself or
+ * via a glob matching it, like the wildcard. */
+typedef struct {
+        Subscription *sub;
+        int n_refs;
+} UnitSubscriber;
+
 typedef struct {
         char *unit;
         LIST_HEAD(UnitSubscription, subs);
         bool loaded;
         UnitActiveState active_state;
-        char *substate;
+        const char *substate; /* Interned, see sub_state_intern() */
+
+        /* Deduplicated fan-out set of the subscriptions to this unit and, unless
+         * this is a glob itself, of the subscriptions to the globs matching it.
+         * Maintained by node_subscribe() and node_unsubscribe() so that
+         * dispatching an event is a plain array walk. */
+        UnitSubscriber *subscribers;
+        size_t n_subscribers;
+        size_t n_subscribers_allocated;
+
+        /* Union of the property allow-lists of the subscribers as last pushed
+         * to the agent, NULL if all properties are forwarded */
+        char **properties;
+
+        GlobPattern *glob; /* Set if unit is a glob, including the wildcard */
+
+        /* State when the agent disconnected, restored by an incremental resync */
+        bool offline_loaded;
+        UnitActiveState offline_active_state;
+        const char *offline_substate;
 } UnitSubscriptions;
 
 typedef struct {
@@ -142,10 +193,57 @@ typedef struct {
 static void unit_subscriptions_clear(void *item) {
         UnitSubscriptions *usubs = item;
         free_and_null(usubs->unit);
-        free_and_null(usubs->substate);
+        usubs->substate = NULL;
+        free_and_null(usubs->subscribers);
+        freev((void **) usubs->properties);
+        usubs->properties = NULL;
+        glob_pattern_free(usubs->glob);
+        usubs->glob = NULL;
         assert(LIST_IS_EMPTY(usubs->subs));
 }
 
+static bool unit_subscriptions_add_subscriber(UnitSubscriptions *usubs, Subscription *sub, int n_refs) {
+        for (size_t i = 0; i < usubs->n_subscribers; i++) {
+                if (usubs->subscribers[i].sub == sub) {
+                        usubs->subscribers[i].n_refs += n_refs;
+                        return true;
+                }
+        }
+
+        if (usubs->n_subscribers == usubs->n_subscribers_allocated) {
+                size_t n_allocated = usubs->n_subscribers_allocated > 0 ? usubs->n_subscribers_allocated * 2 : 4;
+                UnitSubscriber *subscribers = reallocarray(usubs->subscribers, n_allocated, sizeof(UnitSubscriber));
+                if (subscribers == NULL) {
+                        return false;
+                }
+                usubs->subscribers = subscribers;
+                usubs->n_subscribers_allocated = n_allocated;
+        }
+
+        usubs->subscribers[usubs->n_subscribers].sub = sub;
+        usubs->subscribers[usubs->n_subscribers].n_refs = n_refs;
+        usubs->n_subscribers++;
+        return true;
+}
+
+static void unit_subscriptions_remove_subscriber(UnitSubscriptions *usubs, Subscription *sub) {
+        for (size_t i = 0; i < usubs->n_subscribers; i++) {
+                if (usubs->subscribers[i].sub != sub) {
+                        continue;
+                }
+
+                usubs->subscribers[i].n_refs--;
+                if (usubs->subscribers[i].n_refs == 0) {
+                        /* Keep the order in which subscribers get the events */
+                        memmove(&usubs->subscribers[i],
+                                &usubs->subscribers[i + 1],
+                                (usubs->n_subscribers - i - 1) * sizeof(UnitSubscriber));
+                        usubs->n_subscribers--;
+                }
+                return;
+        }
+}
+
 static uint64_t unit_subscriptions_hash(const void *item, uint64_t seed0, uint64_t seed1) {
         const UnitSubscriptions *usubs = item;
         return hashmap_sip(usubs->unit, strlen(usubs->unit), seed0, seed1);
@@ -158,6 +256,23 @@ static int unit_subscriptions_compare(const void *a, const void *b, UNUSED void
         return strcmp(usubs_a->unit, usubs_b->unit);
 }
 
+typedef struct RequestInFlight {
+        const char *key; /* Owned by req */
+        AgentRequest *req;
+} RequestInFlight;
+
+static uint64_t request_in_flight_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const RequestInFlight *entry = item;
+        return hashmap_sip(entry->key, strlen(entry->key), seed0, seed1);
+}
+
+static int request_in_flight_compare(const void *a, const void *b, UNUSED void *udata) {
+        const RequestInFlight *entry_a = a;
+        const RequestInFlight *entry_b = b;
+
+        return strcmp(entry_a->key, entry_b->key);
+}
+
 
 Node *node_new(Controller *controller, const char *name) {
         _cleanup_node_ Node *node = malloc0(sizeof(Node));
@@ -186,8 +301,49 @@ Node *node_new(Controller *controller, const char *name) {
                 return NULL;
         }
 
+        /* Routes have no UnitSubscription of their own, only the fan-out set */
+        node->unit_routes = hashmap_new(
+                        sizeof(UnitSubscriptions),
+                        0,
+                        0,
+                        0,
+                        unit_subscriptions_hash,
+                        unit_subscriptions_compare,
+                        unit_subscriptions_clear,
+                        NULL);
+        if (node->unit_routes == NULL) {
+                return NULL;
+        }
+        node->n_unit_patterns = 0;
+
+        node->requests_in_flight = hashmap_new(
+                        sizeof(RequestInFlight),
+                        0,
+                        0,
+                        0,
+                        request_in_flight_hash,
+                        request_in_flight_compare,
+                        NULL,
+                        NULL);
+        if (node->requests_in_flight == NULL) {
+                return NULL;
+        }
+
+        node->unit_cache = unit_cache_new();
+        if (node->unit_cache == NULL) {
+                return NULL;
+        }
+        node->unit_cache_subscription = NULL;
+
+        node->agent_session_id = 0;
+        node->agent_event_seq = 0;
+        node->resync_dirty = false;
+        node->resync_slot = NULL;
+
         node->last_seen = 0;
         node->last_seen_monotonic = 0;
+        node->last_sent_monotonic = 0;
+        node->heartbeat_timer_source = NULL;
 
         node->name = NULL;
         if (name) {
@@ -242,7 +398,14 @@ void node_unref(Node *node) {
         node_unset_agent_bus(node);
         sd_bus_slot_unrefp(&node->export_slot);
 
+        if (node->unit_cache_subscription != NULL) {
+                node_unsubscribe(node, node->unit_cache_subscription);
+                subscription_unrefp(&node->unit_cache_subscription);
+        }
+        unit_cache_free(node->unit_cache);
         hashmap_free(node->unit_subscriptions);
+        hashmap_free(node->unit_routes);
+        hashmap_free(node->requests_in_flight);
 
         free_and_null(node->name);
         free_and_null(node->object_path);
@@ -348,67 +511,66 @@ bool node_is_online(Node *node) {
 }
 
 
-static uint64_t subscription_hashmap_hash(const void *item, UNUSED uint64_t seed0, UNUSED uint64_t seed1) {
-        const Subscription * const *subscriptionp = item;
-        return (uint64_t) ((uintptr_t) *subscriptionp);
-}
-
-static int subscription_hashmap_compare(const void *a, const void *b, UNUSED void *udata) {
-        const Subscription * const *subscription_a_p = a;
-        const Subscription * const *subscription_b_p = b;
-        if ((*subscription_a_p)->monitor == (*subscription_b_p)->monitor) {
-                return 0;
+/* Builds the fan-out set of a unit without subscriptions of its own from the globs matching it */
+static const UnitSubscriptions *node_add_unit_route(Node *node, const char *unit) {
+        UnitSubscriptions v = {
+                NULL, NULL, false, _UNIT_ACTIVE_STATE_INVALID, NULL, NULL, 0, 0, NULL, NULL, false,
+                _UNIT_ACTIVE_STATE_INVALID, NULL
+        };
+        void *item = NULL;
+        size_t i = 0;
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                const UnitSubscriptions *usubs_glob = item;
+                if (!glob_pattern_matches(usubs_glob->glob, unit)) {
+                        continue;
+                }
+                for (size_t j = 0; j < usubs_glob->n_subscribers; j++) {
+                        if (!unit_subscriptions_add_subscriber(&v, usubs_glob->subscribers[j].sub, 1)) {
+                                unit_subscriptions_clear(&v);
+                                return NULL;
+                        }
+                }
         }
-        return 1;
-}
 
-static struct hashmap *node_compute_unique_monitor_subscriptions(Node *node, const char *unit) {
-        struct hashmap *unique_subs = hashmap_new(
-                        sizeof(void *), 0, 0, 0, subscription_hashmap_hash, subscription_hashmap_compare, NULL, NULL);
-        if (unique_subs == NULL) {
+        v.unit = strdup(unit);
+        if (v.unit == NULL) {
+                unit_subscriptions_clear(&v);
                 return NULL;
         }
+        if (hashmap_set(node->unit_routes, &v) == NULL && hashmap_oom(node->unit_routes)) {
+                unit_subscriptions_clear(&v);
+                return NULL;
+        }
+
+        const UnitSubscriptionsKey key = { (char *) unit };
+        return hashmap_get(node->unit_routes, &key);
+}
 
+/* Returns the deduplicated subscriptions that receive the events of the unit */
+static const UnitSubscriber *node_get_unit_subscribers(Node *node, const char *unit, size_t *ret_n_subscribers) {
         const UnitSubscriptionsKey key = { (char *) unit };
         const UnitSubscriptions *usubs = hashmap_get(node->unit_subscriptions, &key);
-        if (usubs != NULL) {
-                UnitSubscription *usub = NULL;
-                UnitSubscription *next_usub = NULL;
-                LIST_FOREACH_SAFE(subs, usub, next_usub, usubs->subs) {
-                        Subscription *sub = usub->sub;
-                        hashmap_set(unique_subs, &sub);
-                        if (hashmap_oom(unique_subs)) {
-                                bc_log_error("Failed to compute vector of unique monitors, OOM");
-
-                                hashmap_free(unique_subs);
-                                unique_subs = NULL;
-                                return NULL;
-                        }
-                }
-        }
 
-        /* Only check for wildcards if the unit itself is not one. */
-        if (!streq(unit, SYMBOL_WILDCARD)) {
+        /* Units without subscriptions of their own only reach the glob subscriptions. With
+         * just the wildcard, these are its subscribers, otherwise the globs matching the unit
+         * are looked up once and remembered until the glob subscriptions change. */
+        if (usubs == NULL && node->n_unit_patterns == 0) {
                 const UnitSubscriptionsKey wildcard_key = { (char *) SYMBOL_WILDCARD };
-                const UnitSubscriptions *usubs_wildcard = hashmap_get(node->unit_subscriptions, &wildcard_key);
-                if (usubs_wildcard != NULL) {
-                        UnitSubscription *usub = NULL;
-                        UnitSubscription *next_usub = NULL;
-                        LIST_FOREACH_SAFE(subs, usub, next_usub, usubs_wildcard->subs) {
-                                Subscription *sub = usub->sub;
-                                hashmap_set(unique_subs, &sub);
-                                if (hashmap_oom(unique_subs)) {
-                                        bc_log_error("Failed to compute vector of unique monitors, OOM");
-
-                                        hashmap_free(unique_subs);
-                                        unique_subs = NULL;
-                                        return NULL;
-                                }
-                        }
+                usubs = hashmap_get(node->unit_subscriptions, &wildcard_key);
+        } else if (usubs == NULL && !is_glob(unit)) {
+                usubs = hashmap_get(node->unit_routes, &key);
+                if (usubs == NULL) {
+                        usubs = node_add_unit_route(node, unit);
                 }
         }
 
-        return unique_subs;
+        if (usubs == NULL) {
+                *ret_n_subscribers = 0;
+                return NULL;
+        }
+
+        *ret_n_subscribers = usubs->n_subscribers;
+        return usubs->subscribers;
 }
 
 
@@ -428,6 +590,113 @@ static int node_match_job_state_changed(sd_bus_message *m, void *userdata, UNUSE
         return 1;
 }
 
+/* Copies the entries of the a{sv} in m whose key is in properties, returns the number of copied entries */
+static int node_copy_filtered_properties(sd_bus_message *sig, sd_bus_message *m, char **properties) {
+        int n_copied = 0;
+
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+        if (r < 0) {
+                return r;
+        }
+        r = sd_bus_message_open_container(sig, SD_BUS_TYPE_ARRAY, "{sv}");
+        if (r < 0) {
+                return r;
+        }
+
+        while ((r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+                const char *property = NULL;
+                r = sd_bus_message_read(m, "s", &property);
+                if (r < 0) {
+                        return r;
+                }
+
+                if (strv_contains(properties, property)) {
+                        r = sd_bus_message_open_container(sig, SD_BUS_TYPE_DICT_ENTRY, "sv");
+                        if (r >= 0) {
+                                r = sd_bus_message_append(sig, "s", property);
+                        }
+                        if (r >= 0) {
+                                r = sd_bus_message_copy(sig, m, false);
+                        }
+                        if (r >= 0) {
+                                r = sd_bus_message_close_container(sig);
+                        }
+                        n_copied++;
+                } else {
+                        r = sd_bus_message_skip(m, "v");
+                }
+                if (r < 0) {
+                        return r;
+                }
+
+                r = sd_bus_message_exit_container(m);
+                if (r < 0) {
+                        return r;
+                }
+        }
+        if (r < 0) {
+                return r;
+        }
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0) {
+                return r;
+        }
+        r = sd_bus_message_close_container(sig);
+        if (r < 0) {
+                return r;
+        }
+
+        return n_copied;
+}
+
+/*
+ * Creates a sealed copy of the UnitPropertiesChanged signal m with only the properties of the allow-list.
+ * The agent filters on the union of the allow-lists of all subscriptions to the unit, so this keeps the
+ * properties other subscriptions asked for away from the subscription. Returns the number of kept properties.
+ */
+static int node_filter_unit_properties(
+                sd_bus_message *m, const char *unit, const char *interface, char **properties, sd_bus_message **ret) {
+        _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
+        uint64_t cookie = 0;
+        int n_copied = 0;
+
+        int r = sd_bus_message_get_cookie(m, &cookie);
+        if (r >= 0) {
+                r = sd_bus_message_new_signal(
+                                sd_bus_message_get_bus(m),
+                                &sig,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitPropertiesChanged");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append(sig, "ss", unit, interface);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_skip(m, "ss");
+        }
+        if (r >= 0) {
+                r = node_copy_filtered_properties(sig, m, properties);
+                n_copied = r;
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(sig, cookie, 0);
+        }
+
+        /* The signal may be an entry of an EventBatch, so only rewind the arguments */
+        int rewind_r = sd_bus_message_rewind(m, false);
+        if (r < 0) {
+                return r;
+        }
+        if (rewind_r < 0) {
+                return rewind_r;
+        }
+
+        *ret = steal_pointer(&sig);
+        return n_copied;
+}
+
 static int node_match_unit_properties_changed(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
         Node *node = userdata;
         const char *unit = NULL;
@@ -442,18 +711,38 @@ static int node_match_unit_properties_changed(sd_bus_message *m, void *userdata,
                 return 0;
         }
 
-        struct hashmap *unique_subs = node_compute_unique_monitor_subscriptions(node, unit);
-        if (unique_subs != NULL) {
-                Subscription **subp = NULL;
-                size_t i = 0;
-                while (hashmap_iter(unique_subs, &i, (void **) &subp)) {
-                        Subscription *sub = *subp;
-                        int r = sub->handle_unit_property_changed(sub->monitor, node->name, unit, interface, m);
-                        if (r < 0) {
-                                bc_log_error("Failed to emit UnitPropertyChanged signal");
+        /* Subscriptions with the same allow-list share the filtered signal */
+        _cleanup_sd_bus_message_ sd_bus_message *filtered = NULL;
+        char **filtered_properties = NULL;
+        int n_filtered = 0;
+
+        size_t n_subscribers = 0;
+        const UnitSubscriber *subscribers = node_get_unit_subscribers(node, unit, &n_subscribers);
+        for (size_t i = 0; i < n_subscribers; i++) {
+                Subscription *sub = subscribers[i].sub;
+                sd_bus_message *sig = m;
+                if (sub->properties != NULL) {
+                        if (filtered == NULL || !strv_equal(sub->properties, filtered_properties)) {
+                                filtered = sd_bus_message_unref(filtered);
+                                n_filtered = node_filter_unit_properties(
+                                                m, unit, interface, sub->properties, &filtered);
+                                if (n_filtered < 0) {
+                                        bc_log_errorf("Failed to filter UnitPropertiesChanged signal: %s",
+                                                      strerror(-n_filtered));
+                                        continue;
+                                }
+                                filtered_properties = sub->properties;
+                        }
+                        if (n_filtered == 0) {
+                                continue;
                         }
+                        sig = filtered;
+                }
+
+                int r = sub->handle_unit_property_changed(sub->monitor, node->name, unit, interface, sig);
+                if (r < 0) {
+                        bc_log_error("Failed to emit UnitPropertyChanged signal");
                 }
-                hashmap_free(unique_subs);
         }
 
         return 1;
@@ -477,23 +766,18 @@ static int node_match_unit_new(sd_bus_message *m, void *userdata, UNUSED sd_bus_
                 usubs->loaded = true;
                 if (is_wildcard(unit)) {
                         usubs->active_state = UNIT_ACTIVE;
-                        free(usubs->substate);
-                        usubs->substate = strdup("running");
+                        usubs->substate = sub_state_intern("running");
                 }
         }
 
-        struct hashmap *unique_subs = node_compute_unique_monitor_subscriptions(node, unit);
-        if (unique_subs != NULL) {
-                Subscription **subp = NULL;
-                size_t i = 0;
-                while (hashmap_iter(unique_subs, &i, (void **) &subp)) {
-                        Subscription *sub = *subp;
-                        int r = sub->handle_unit_new(sub->monitor, node->name, unit, reason);
-                        if (r < 0) {
-                                bc_log_errorf("Failed to emit UnitNew signal: %s", strerror(-r));
-                        }
+        size_t n_subscribers = 0;
+        const UnitSubscriber *subscribers = node_get_unit_subscribers(node, unit, &n_subscribers);
+        for (size_t i = 0; i < n_subscribers; i++) {
+                Subscription *sub = subscribers[i].sub;
+                int r = sub->handle_unit_new(sub->monitor, node->name, unit, reason);
+                if (r < 0) {
+                        bc_log_errorf("Failed to emit UnitNew signal: %s", strerror(-r));
                 }
-                hashmap_free(unique_subs);
         }
 
         return 1;
@@ -517,23 +801,25 @@ static int node_match_unit_state_changed(sd_bus_message *m, void *userdata, UNUS
         if (usubs != NULL) {
                 usubs->loaded = true;
                 usubs->active_state = active_state_from_string(active_state);
-                free(usubs->substate);
-                usubs->substate = strdup(substate);
-        }
-
-        struct hashmap *unique_subs = node_compute_unique_monitor_subscriptions(node, unit);
-        if (unique_subs != NULL) {
-                Subscription **subp = NULL;
-                size_t i = 0;
-                while (hashmap_iter(unique_subs, &i, (void **) &subp)) {
-                        Subscription *sub = *subp;
-                        int r = sub->handle_unit_state_changed(
-                                        sub->monitor, node->name, unit, active_state, substate, reason);
-                        if (r < 0) {
-                                bc_log_errorf("Failed to emit UnitStateChanged signal: %s", strerror(-r));
-                        }
+                usubs->substate = sub_state_intern_peer(substate);
+                if (usubs->substate != NULL && !streq(usubs->substate, substate)) {
+                        bc_log_warnf("Keeping unknown sub state '%s' of unit '%s' on node '%s' as '%s'",
+                                     substate,
+                                     unit,
+                                     node->name,
+                                     usubs->substate);
+                }
+        }
+
+        size_t n_subscribers = 0;
+        const UnitSubscriber *subscribers = node_get_unit_subscribers(node, unit, &n_subscribers);
+        for (size_t i = 0; i < n_subscribers; i++) {
+                Subscription *sub = subscribers[i].sub;
+                int r = sub->handle_unit_state_changed(
+                                sub->monitor, node->name, unit, active_state, substate, reason);
+                if (r < 0) {
+                        bc_log_errorf("Failed to emit UnitStateChanged signal: %s", strerror(-r));
                 }
-                hashmap_free(unique_subs);
         }
 
         return 1;
@@ -555,18 +841,19 @@ static int node_match_unit_removed(sd_bus_message *m, void *userdata, UNUSED sd_
                 usubs->loaded = false;
         }
 
-        struct hashmap *unique_subs = node_compute_unique_monitor_subscriptions(node, unit);
-        if (unique_subs != NULL) {
-                Subscription **subp = NULL;
-                size_t i = 0;
-                while (hashmap_iter(unique_subs, &i, (void **) &subp)) {
-                        Subscription *sub = *subp;
-                        int r = sub->handle_unit_removed(sub->monitor, node->name, unit, "real");
-                        if (r < 0) {
-                                bc_log_errorf("Failed to emit UnitRemoved signal: %s", strerror(-r));
-                        }
+        size_t n_subscribers = 0;
+        const UnitSubscriber *subscribers = node_get_unit_subscribers(node, unit, &n_subscribers);
+        for (size_t i = 0; i < n_subscribers; i++) {
+                Subscription *sub = subscribers[i].sub;
+                int r = sub->handle_unit_removed(sub->monitor, node->name, unit, "real");
+                if (r < 0) {
+                        bc_log_errorf("Failed to emit UnitRemoved signal: %s", strerror(-r));
                 }
-                hashmap_free(unique_subs);
+        }
+
+        UnitSubscriptions *route = (UnitSubscriptions *) hashmap_delete(node->unit_routes, &key);
+        if (route != NULL) {
+                unit_subscriptions_clear(route);
         }
 
         return 1;
@@ -588,26 +875,130 @@ static int node_match_job_done(UNUSED sd_bus_message *m, UNUSED void *userdata,
         return 1;
 }
 
-static int node_match_heartbeat(UNUSED sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
+/* Any message from the agent proves that it is alive, not only its heartbeats */
+static int node_on_agent_message(UNUSED sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
         Node *node = userdata;
         uint64_t now = 0;
         uint64_t now_monotonic = 0;
 
-        now = get_time_micros();
-        if (now == USEC_INFINITY) {
-                bc_log_error("Failed to get current time on heartbeat");
+        /* The time of the current event loop iteration is good enough and saves a syscall per message */
+        int r = sd_event_now(node->controller->event, CLOCK_REALTIME, &now);
+        if (r < 0) {
+                bc_log_errorf("Failed to get current time on agent message: %s", strerror(-r));
                 return 0;
         }
 
-        now_monotonic = get_time_micros_monotonic();
-        if (now_monotonic == USEC_INFINITY) {
-                bc_log_error("Failed to get current monotonic time on heartbeat");
+        r = sd_event_now(node->controller->event, CLOCK_MONOTONIC, &now_monotonic);
+        if (r < 0) {
+                bc_log_errorf("Failed to get current monotonic time on agent message: %s", strerror(-r));
                 return 0;
         }
 
         node->last_seen = now;
         node->last_seen_monotonic = now_monotonic;
-        return 1;
+        return 0;
+}
+
+/*
+ * Every online node has its own heartbeat timer. sd-event keeps timers ordered by deadline,
+ * so each tick only touches the node whose heartbeat is due, instead of sweeping the whole
+ * fleet. The first tick is offset by a hash of the node name, which spreads the heartbeats
+ * of nodes registering at the same time over the interval.
+ */
+#define NODE_HEARTBEAT_ACCURACY_USEC USEC_PER_MSEC
+
+static int node_reset_heartbeat_timer(Node *node, uint64_t usec);
+
+static bool node_check_liveness(Node *node, uint64_t now) {
+        Controller *controller = node->controller;
+
+        if (controller->heartbeat_threshold_msec <= 0) {
+                /* checking liveness of node by heartbeat disabled since configured threshold is <=0" */
+                return true;
+        }
+
+        if (now == 0) {
+                bc_log_error("Current time is wrong");
+                return true;
+        }
+
+        if (now < node->last_seen_monotonic) {
+                bc_log_error("Clock skew detected");
+                return true;
+        }
+
+        uint64_t diff = now - node->last_seen_monotonic;
+        if (diff > (uint64_t) controller->heartbeat_threshold_msec * USEC_PER_MSEC) {
+                bc_log_infof("Did not receive heartbeat from node '%s' since '%d'ms. Disconnecting it...",
+                             node->name,
+                             controller->heartbeat_threshold_msec);
+                node_disconnect(node);
+                return false;
+        }
+
+        return true;
+}
+
+static int node_heartbeat_timer_callback(UNUSED sd_event_source *event_source, UNUSED uint64_t usec, void *userdata) {
+        Node *node = userdata;
+        uint64_t now = get_time_micros_monotonic();
+
+        if (!node_check_liveness(node, now)) {
+                return 0;
+        }
+
+        /* Anything sent to the agent proves to it that we are alive, so only send a heartbeat
+         * when the link has been idle for the interval */
+        uint64_t interval = node->controller->heartbeat_interval_msec * USEC_PER_MSEC;
+        uint64_t idle = now > node->last_sent_monotonic ? now - node->last_sent_monotonic : 0;
+        if (idle >= interval) {
+                int r = sd_bus_emit_signal(
+                                node->agent_bus,
+                                INTERNAL_CONTROLLER_OBJECT_PATH,
+                                INTERNAL_CONTROLLER_INTERFACE,
+                                "Heartbeat",
+                                "");
+                if (r < 0) {
+                        bc_log_errorf("Failed to emit heartbeat signal to node '%s': %s", node->name, strerror(-r));
+                }
+                node->last_sent_monotonic = now;
+                idle = 0;
+        }
+
+        int r = node_reset_heartbeat_timer(node, interval - idle);
+        if (r < 0) {
+                bc_log_errorf("Failed to reset heartbeat timer of node '%s': %s", node->name, strerror(-r));
+                return r;
+        }
+
+        return 0;
+}
+
+static int node_reset_heartbeat_timer(Node *node, uint64_t usec) {
+        return event_reset_time_relative(
+                        node->controller->event,
+                        &node->heartbeat_timer_source,
+                        CLOCK_BOOTTIME,
+                        usec,
+                        NODE_HEARTBEAT_ACCURACY_USEC,
+                        node_heartbeat_timer_callback,
+                        node,
+                        0,
+                        "node-heartbeat-timer-source",
+                        false);
+}
+
+static void node_start_heartbeat(Node *node) {
+        if (node->controller->heartbeat_interval_msec <= 0) {
+                return;
+        }
+
+        uint64_t interval = node->controller->heartbeat_interval_msec * USEC_PER_MSEC;
+        uint64_t offset = hashmap_sip(node->name, strlen(node->name), 0, 0) % interval;
+        int r = node_reset_heartbeat_timer(node, offset);
+        if (r < 0) {
+                bc_log_errorf("Failed to set up heartbeat timer of node '%s': %s", node->name, strerror(-r));
+        }
 }
 
 static ProxyMonitor *node_find_proxy_monitor(Node *node, const char *target_node_name, const char *unit_name) {
@@ -723,48 +1114,158 @@ static int node_on_match_proxy_removed(sd_bus_message *m, void *userdata, UNUSED
         return 0;
 }
 
-bool node_set_agent_bus(Node *node, sd_bus *bus) {
-        int r = 0;
+/* Sent by the agent at the end of an EventBatch, see node_resync_agent() */
+static int node_match_event_sequence(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
+        Node *node = userdata;
+        uint64_t session_id = 0;
+        uint64_t seq = 0;
 
-        if (node->agent_bus != NULL) {
-                bc_log_error("Error: Trying to add two agents for a node");
-                return false;
+        int r = sd_bus_message_read(m, "tt", &session_id, &seq);
+        if (r < 0) {
+                bc_log_errorf("Invalid EventSequence event: %s", strerror(-r));
+                return 0;
         }
 
-        node->agent_bus = sd_bus_ref(bus);
+        node->agent_session_id = session_id;
+        node->agent_event_seq = seq;
+        return 1;
+}
 
-        // If getting peer IP fails, only log and proceed as normal.
-        _cleanup_free_ char *peer_ip = NULL;
-        uint16_t peer_port = 0;
-        r = get_peer_ip_address(node->agent_bus, &peer_ip, &peer_port);
-        if (r < 0 && r != -EINVAL) {
-                bc_log_errorf("Failed to get peer IP: %s", strerror(-r));
-        } else {
-                node->peer_ip = steal_pointer(&peer_ip);
-        }
+typedef struct {
+        const char *name;
+        sd_bus_message_handler_t handler;
+} EventBatchHandler;
+
+static const EventBatchHandler event_batch_handlers[] = {
+        { "JobDone",               node_match_job_done               },
+        { "JobStateChanged",       node_match_job_state_changed      },
+        { "UnitPropertiesChanged", node_match_unit_properties_changed },
+        { "UnitNew",               node_match_unit_new               },
+        { "UnitStateChanged",      node_match_unit_state_changed     },
+        { "UnitRemoved",           node_match_unit_removed           },
+        { "EventSequence",         node_match_event_sequence         },
+};
 
-#ifdef CONFIG_H_USE_SELINUX
-        char *peercon = NULL;
-        if (getpeercon(sd_bus_get_fd(bus), &peercon) == 0) {
-                node->peer_selinux_context = parse_selinux_type(peercon);
-                if (node->peer_selinux_context == NULL) {
-                        bc_log_errorf("Failed to parse peer selinux type '%s'", peercon);
+static sd_bus_message_handler_t node_find_event_batch_handler(const char *name) {
+        for (size_t i = 0; i < sizeof(event_batch_handlers) / sizeof(event_batch_handlers[0]); i++) {
+                if (streq(event_batch_handlers[i].name, name)) {
+                        return event_batch_handlers[i].handler;
                 }
-                freecon(peercon);
         }
-#endif
+        return NULL;
+}
 
-        if (node->name == NULL) {
-                // We only connect to this on the unnamed nodes so register
-                // can be called. We can't reconnect it during migration.
-                r = sd_bus_add_object_vtable(
-                                bus,
-                                &node->internal_controller_slot,
-                                INTERNAL_CONTROLLER_OBJECT_PATH,
-                                INTERNAL_CONTROLLER_INTERFACE,
-                                internal_controller_controller_vtable,
-                                node);
-                if (r < 0) {
+/* Dispatches one entry of an EventBatch, positioned at the variant holding the arguments */
+static int node_dispatch_batched_event(Node *node, sd_bus_message *m, const char *name) {
+        const char *contents = NULL;
+        int r = sd_bus_message_peek_type(m, NULL, &contents);
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_VARIANT, contents);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_peek_type(m, NULL, &contents);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_STRUCT, contents);
+        }
+        if (r < 0) {
+                return r;
+        }
+
+        /* The handlers read the arguments from the entered struct just as from a signal of its own */
+        sd_bus_message_handler_t handler = node_find_event_batch_handler(name);
+        if (handler != NULL) {
+                (void) handler(m, node, NULL);
+        } else {
+                bc_log_debugf("Ignoring unknown event '%s' in EventBatch of node '%s'", name, node->name);
+        }
+
+        /* Handlers may stop reading anywhere, so skip the struct as a whole */
+        r = sd_bus_message_rewind(m, false);
+        if (r >= 0) {
+                r = sd_bus_message_skip(m, contents);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_exit_container(m);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_exit_container(m);
+        }
+        return r;
+}
+
+static int node_match_event_batch(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *error) {
+        Node *node = userdata;
+
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, EVENT_BATCH_ENTRY_STRUCT_TYPESTRING);
+        if (r < 0) {
+                bc_log_errorf("Invalid EventBatch signal: %s", strerror(-r));
+                return 0;
+        }
+
+        while ((r = sd_bus_message_enter_container(m, SD_BUS_TYPE_STRUCT, EVENT_BATCH_ENTRY_TYPESTRING)) > 0) {
+                const char *name = NULL;
+                r = sd_bus_message_read(m, "s", &name);
+                if (r >= 0) {
+                        r = node_dispatch_batched_event(node, m, name);
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_exit_container(m);
+                }
+                if (r < 0) {
+                        break;
+                }
+        }
+        if (r < 0) {
+                bc_log_errorf("Invalid entry in EventBatch signal: %s", strerror(-r));
+                return 0;
+        }
+
+        return 1;
+}
+
+bool node_set_agent_bus(Node *node, sd_bus *bus) {
+        int r = 0;
+
+        if (node->agent_bus != NULL) {
+                bc_log_error("Error: Trying to add two agents for a node");
+                return false;
+        }
+
+        node->agent_bus = sd_bus_ref(bus);
+
+        // If getting peer IP fails, only log and proceed as normal.
+        _cleanup_free_ char *peer_ip = NULL;
+        uint16_t peer_port = 0;
+        r = get_peer_ip_address(node->agent_bus, &peer_ip, &peer_port);
+        if (r < 0 && r != -EINVAL) {
+                bc_log_errorf("Failed to get peer IP: %s", strerror(-r));
+        } else {
+                node->peer_ip = steal_pointer(&peer_ip);
+        }
+
+#ifdef CONFIG_H_USE_SELINUX
+        char *peercon = NULL;
+        if (getpeercon(sd_bus_get_fd(bus), &peercon) == 0) {
+                node->peer_selinux_context = parse_selinux_type(peercon);
+                if (node->peer_selinux_context == NULL) {
+                        bc_log_errorf("Failed to parse peer selinux type '%s'", peercon);
+                }
+                freecon(peercon);
+        }
+#endif
+
+        if (node->name == NULL) {
+                // We only connect to this on the unnamed nodes so register
+                // can be called. We can't reconnect it during migration.
+                r = sd_bus_add_object_vtable(
+                                bus,
+                                &node->internal_controller_slot,
+                                INTERNAL_CONTROLLER_OBJECT_PATH,
+                                INTERNAL_CONTROLLER_INTERFACE,
+                                internal_controller_controller_vtable,
+                                node);
+                if (r < 0) {
                         node_unset_agent_bus(node);
                         bc_log_errorf("Failed to add peer bus vtable: %s", strerror(-r));
                         return false;
@@ -855,6 +1356,20 @@ bool node_set_agent_bus(Node *node, sd_bus *bus) {
                         return false;
                 }
 
+                r = sd_bus_match_signal(
+                                bus,
+                                NULL,
+                                NULL,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                AGENT_EVENT_BATCH_SIGNAL_NAME,
+                                node_match_event_batch,
+                                node);
+                if (r < 0) {
+                        bc_log_errorf("Failed to add EventBatch peer bus match: %s", strerror(-r));
+                        return false;
+                }
+
                 r = sd_bus_match_signal(
                                 bus,
                                 NULL,
@@ -889,17 +1404,10 @@ bool node_set_agent_bus(Node *node, sd_bus *bus) {
                         bc_log_errorf("Failed to emit status property changed: %s", strerror(-r));
                 }
 
-                r = sd_bus_match_signal(
-                                bus,
-                                NULL,
-                                NULL,
-                                INTERNAL_AGENT_OBJECT_PATH,
-                                INTERNAL_AGENT_INTERFACE,
-                                AGENT_HEARTBEAT_SIGNAL_NAME,
-                                node_match_heartbeat,
-                                node);
+                /* Heartbeats of the agent are covered as well */
+                r = sd_bus_add_filter(bus, NULL, node_on_agent_message, node);
                 if (r < 0) {
-                        bc_log_errorf("Failed to add heartbeat signal match: %s", strerror(-r));
+                        bc_log_errorf("Failed to add agent message filter: %s", strerror(-r));
                         return false;
                 }
         }
@@ -925,10 +1433,9 @@ bool node_set_agent_bus(Node *node, sd_bus *bus) {
         }
 
 
-        /* Register any active subscriptions with new agent */
-        node_send_agent_subscribe_all(node);
+        node_resync_agent(node);
 
-        /* Register any active dependencies with new agent */
+        /* Register any active dependencies with new agent, starting them again is harmless */
         node_start_proxy_dependency_all(node);
 
         return true;
@@ -946,6 +1453,12 @@ void node_unset_agent_bus(Node *node) {
         sd_bus_slot_unrefp(&node->metrics_matching_slot);
         node->metrics_matching_slot = NULL;
 
+        sd_event_source_unrefp(&node->heartbeat_timer_source);
+        node->heartbeat_timer_source = NULL;
+
+        sd_bus_slot_unrefp(&node->resync_slot);
+        node->resync_slot = NULL;
+
         sd_bus_unrefp(&node->agent_bus);
         node->agent_bus = NULL;
 
@@ -961,7 +1474,9 @@ void node_unset_agent_bus(Node *node) {
         }
 }
 
-/* org.eclipse.bluechi.internal.Controller.Register(in s name)) */
+static const char *const peer_features[] = { PEER_FEATURE_EVENT_BATCH, PEER_FEATURE_RESYNC, NULL };
+
+/* org.eclipse.bluechi.internal.Controller.Register(in s name, out as features)) */
 static int node_method_register(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
         Node *node = userdata;
         Controller *controller = node->controller;
@@ -1020,6 +1535,8 @@ static int node_method_register(sd_bus_message *m, void *userdata, UNUSED sd_bus
                 node_enable_metrics(named_node);
         }
 
+        node_start_heartbeat(named_node);
+
         node_unset_agent_bus(node);
 
         /* update number of online nodes and check the new system state */
@@ -1027,7 +1544,17 @@ static int node_method_register(sd_bus_message *m, void *userdata, UNUSED sd_bus
 
         bc_log_infof("Registered managed node from fd %d as '%s'", sd_bus_get_fd(agent_bus), name);
 
-        return sd_bus_reply_method_return(m, "");
+        /* Agents not knowing about the features ignore the reply arguments */
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        r = sd_bus_message_new_method_return(m, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(reply, (char **) peer_features);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Internal error: Couldn't create reply: %s", strerror(-r));
+        }
+        return sd_bus_send(NULL, reply, NULL);
 }
 
 static int node_disconnected(UNUSED sd_bus_message *message, void *userdata, UNUSED sd_bus_error *error) {
@@ -1049,14 +1576,18 @@ void node_disconnect(Node *node) {
                 bool send_state_change = false;
 
                 if (!usubs->loaded) {
+                        /* Keeps the snapshot of units not yet restored by a pending resync */
                         continue;
                 }
 
+                usubs->offline_loaded = true;
+                usubs->offline_active_state = usubs->active_state;
+                usubs->offline_substate = usubs->substate;
+
                 if (usubs->active_state >= 0 && usubs->active_state != UNIT_INACTIVE) {
                         /* We previously reported an not-inactive valid state, send a virtual inactive state */
                         usubs->active_state = UNIT_INACTIVE;
-                        free(usubs->substate);
-                        usubs->substate = strdup("agent-offline");
+                        usubs->substate = sub_state_intern("agent-offline");
                         send_state_change = true;
                 }
 
@@ -1064,46 +1595,33 @@ void node_disconnect(Node *node) {
 
                 int r = 0;
                 if (send_state_change) {
-                        struct hashmap *unique_subs = node_compute_unique_monitor_subscriptions(
-                                        node, usubs->unit);
-                        if (unique_subs != NULL) {
-
-                                Subscription **subp = NULL;
-                                size_t s = 0;
-                                while (hashmap_iter(unique_subs, &s, (void **) &subp)) {
-                                        Subscription *sub = *subp;
-                                        r = sub->handle_unit_state_changed(
-                                                        sub->monitor,
-                                                        node->name,
-                                                        usubs->unit,
-                                                        active_state_to_string(usubs->active_state),
-                                                        usubs->substate,
-                                                        "virtual");
-                                        if (r < 0) {
-                                                bc_log_error("Failed to emit UnitStateChanged signal");
-                                        }
+                        for (size_t s = 0; s < usubs->n_subscribers; s++) {
+                                Subscription *sub = usubs->subscribers[s].sub;
+                                r = sub->handle_unit_state_changed(
+                                                sub->monitor,
+                                                node->name,
+                                                usubs->unit,
+                                                active_state_to_string(usubs->active_state),
+                                                usubs->substate,
+                                                "virtual");
+                                if (r < 0) {
+                                        bc_log_error("Failed to emit UnitStateChanged signal");
                                 }
-                                hashmap_free(unique_subs);
                         }
                 }
 
-
-                struct hashmap *unique_subs = node_compute_unique_monitor_subscriptions(node, usubs->unit);
-                if (unique_subs != NULL) {
-
-                        Subscription **subp = NULL;
-                        size_t s = 0;
-                        while (hashmap_iter(unique_subs, &s, (void **) &subp)) {
-                                Subscription *sub = *subp;
-                                r = sub->handle_unit_removed(sub->monitor, node->name, usubs->unit, "virtual");
-                                if (r < 0) {
-                                        bc_log_error("Failed to emit UnitRemoved signal");
-                                }
+                for (size_t s = 0; s < usubs->n_subscribers; s++) {
+                        Subscription *sub = usubs->subscribers[s].sub;
+                        r = sub->handle_unit_removed(sub->monitor, node->name, usubs->unit, "virtual");
+                        if (r < 0) {
+                                bc_log_error("Failed to emit UnitRemoved signal");
                         }
-                        hashmap_free(unique_subs);
                 }
         }
 
+        /* Changes while offline are missed, so the units must be listed again */
+        unit_cache_invalidate(node->unit_cache);
+
         ProxyMonitor *proxy_monitor = NULL;
         ProxyMonitor *next_proxy_monitor = NULL;
         LIST_FOREACH_SAFE(monitors, proxy_monitor, next_proxy_monitor, node->proxy_monitors) {
@@ -1121,10 +1639,15 @@ void node_disconnect(Node *node) {
                         Job *job = NULL;
                         Job *next_job = NULL;
                         LIST_FOREACH_SAFE(jobs, job, next_job, controller->jobs) {
-                                if (strcmp(job->node->name, node->name) == 0) {
+                                if (job->node == node) {
                                         bc_log_debugf("Removing job %d from node %s", job->id, job->node->name);
-                                        LIST_REMOVE(jobs, controller->jobs, job);
-                                        job_unref(job);
+                                        if (job->rollout != NULL) {
+                                                rollout_job_finished(job->rollout, job, "failed");
+                                        }
+                                        if (job->group != NULL) {
+                                                job_group_finish_job(job->group, job->group_index, "failed");
+                                        }
+                                        controller_drop_job(controller, job);
                                 }
                         }
                 }
@@ -1166,6 +1689,21 @@ static int node_property_get_peer_ip(
         return sd_bus_message_append(reply, "s", node->peer_ip);
 }
 
+static void node_forget_request_in_flight(Node *node, AgentRequest *req) {
+        if (req->single_flight_key == NULL) {
+                return;
+        }
+
+        RequestInFlight key = { req->single_flight_key, NULL };
+        const RequestInFlight *entry = hashmap_get(node->requests_in_flight, &key);
+        if (entry != NULL && entry->req == req) {
+                hashmap_delete(node->requests_in_flight, &key);
+        }
+}
+
+/* Every call to the agent takes a request, so released ones are recycled */
+static Pool agent_request_pool = POOL_INIT(AgentRequest, 1024);
+
 AgentRequest *agent_request_ref(AgentRequest *req) {
         req->ref_count++;
         return req;
@@ -1184,9 +1722,16 @@ void agent_request_unref(AgentRequest *req) {
         sd_bus_message_unrefp(&req->message);
 
         Node *node = req->node;
+        if (req->leader != NULL) {
+                LIST_REMOVE(followers, req->leader->followers, req);
+                agent_request_unref(req->leader);
+        }
+        node_forget_request_in_flight(node, req);
+        free(req->single_flight_key);
+
         LIST_REMOVE(outstanding_requests, node->outstanding_requests, req);
         node_unref(req->node);
-        free(req);
+        pool_free(&agent_request_pool, req);
 }
 
 int node_create_request(
@@ -1196,7 +1741,7 @@ int node_create_request(
                 agent_request_response_t cb,
                 void *userdata,
                 free_func_t free_userdata) {
-        AgentRequest *req = malloc0(sizeof(AgentRequest));
+        AgentRequest *req = pool_alloc0(&agent_request_pool);
         if (req == NULL) {
                 return -ENOMEM;
         }
@@ -1209,8 +1754,7 @@ int node_create_request(
                         INTERNAL_AGENT_INTERFACE,
                         method);
         if (r < 0) {
-                free(req);
-                req = NULL;
+                pool_free(&agent_request_pool, req);
                 return r;
         }
 
@@ -1221,24 +1765,54 @@ int node_create_request(
         req->userdata = userdata;
         req->free_userdata = free_userdata;
         req->is_cancelled = false;
+        LIST_HEAD_INIT(req->followers);
+        LIST_INIT(followers, req);
         LIST_APPEND(outstanding_requests, node->outstanding_requests, req);
 
         *ret = req;
         return 0;
 }
 
-static int agent_request_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
-        _cleanup_agent_request_ AgentRequest *req = userdata;
+static int agent_request_dispatch(AgentRequest *req, sd_bus_message *m, sd_bus_error *ret_error) {
         if (req->is_cancelled) {
                 bc_log_debugf("Response received to a cancelled request for node %s. Dropping message.",
                               req->node->name);
                 return 0;
         }
 
+        /* Each waiter reads the reply from the start */
+        int r = sd_bus_message_rewind(m, true);
+        if (r < 0) {
+                bc_log_errorf("Failed to rewind reply for node %s: %s", req->node->name, strerror(-r));
+        }
         return req->cb(req, m, ret_error);
 }
 
+static int agent_request_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        _cleanup_agent_request_ AgentRequest *req = userdata;
+
+        /* Identical requests started from now on need a call of their own */
+        node_forget_request_in_flight(req->node, req);
+
+        int r = agent_request_dispatch(req, m, ret_error);
+
+        while (!LIST_IS_EMPTY(req->followers)) {
+                _cleanup_agent_request_ AgentRequest *follower = LIST_POP(followers, req->followers);
+                follower->leader = NULL;
+                agent_request_unref(req);
+
+                agent_request_dispatch(follower, m, NULL);
+        }
+
+        return r;
+}
+
 int agent_request_cancel(AgentRequest *r) {
+        /* Already cancelled or abandoned, the pending reply drops the outstanding reference */
+        if (r->is_cancelled) {
+                return 0;
+        }
+
         _cleanup_agent_request_ AgentRequest *req = r;
         req->is_cancelled = true;
         _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
@@ -1247,9 +1821,107 @@ int agent_request_cancel(AgentRequest *r) {
         return req->cb(req, m, NULL);
 }
 
+/* Drops the reply of a started request when it arrives, without calling back */
+void agent_request_abandon(AgentRequest *req) {
+        req->is_cancelled = true;
+}
+
+static int request_key_append(char **key, const char *value) {
+        char *new_key = NULL;
+        int r = asprintf(&new_key, "%s %zu:%s", *key, strlen(value), value);
+        if (r < 0) {
+                return -ENOMEM;
+        }
+        free(*key);
+        *key = new_key;
+        return 0;
+}
+
+/* Builds the key of a call from its method and arguments, which may be strings and arrays of strings */
+static int request_key_new(const char *method, sd_bus_message *args, char **ret_key) {
+        _cleanup_free_ char *key = strdup(method);
+        if (key == NULL) {
+                return -ENOMEM;
+        }
+
+        int r = args != NULL ? sd_bus_message_rewind(args, true) : 0;
+        while (args != NULL && r >= 0) {
+                char type = 0;
+                const char *contents = NULL;
+                r = sd_bus_message_peek_type(args, &type, &contents);
+                if (r <= 0) {
+                        break;
+                }
+
+                if (type == SD_BUS_TYPE_STRING) {
+                        const char *value = NULL;
+                        r = sd_bus_message_read_basic(args, SD_BUS_TYPE_STRING, &value);
+                        if (r >= 0) {
+                                r = request_key_append(&key, value);
+                        }
+                } else if (type == SD_BUS_TYPE_ARRAY && streq(contents, "s")) {
+                        _cleanup_freev_ char **values = NULL;
+                        r = sd_bus_message_read_strv(args, &values);
+                        if (r >= 0) {
+                                r = request_key_append(&key, "as");
+                        }
+                        for (size_t i = 0; r >= 0 && values != NULL && values[i] != NULL; i++) {
+                                r = request_key_append(&key, values[i]);
+                        }
+                        if (r >= 0) {
+                                r = request_key_append(&key, "");
+                        }
+                } else {
+                        r = -EINVAL;
+                }
+        }
+        if (args != NULL) {
+                sd_bus_message_rewind(args, true);
+        }
+        if (r < 0) {
+                return r;
+        }
+
+        *ret_key = steal_pointer(&key);
+        return 0;
+}
+
+/* Marks a read-only request as shareable. Once started, identical requests (same method
+ * and args) of the node wait for the reply of the first one instead of calling the agent
+ * again. Without a key the request is simply not shared. */
+void agent_request_set_single_flight(AgentRequest *req, sd_bus_message *args) {
+        const char *method = sd_bus_message_get_member(req->message);
+
+        free_and_null(req->single_flight_key);
+        int r = request_key_new(method, args, &req->single_flight_key);
+        if (r < 0) {
+                bc_log_debugf("Not sharing %s request for node %s: %s", method, req->node->name, strerror(-r));
+        }
+}
+
+/* Attaches req to an identical request already waiting for the agent, returns false if there is none */
+static bool agent_request_join(AgentRequest *req) {
+        Node *node = req->node;
+
+        RequestInFlight key = { req->single_flight_key, NULL };
+        const RequestInFlight *entry = hashmap_get(node->requests_in_flight, &key);
+        if (entry == NULL) {
+                return false;
+        }
+
+        req->leader = agent_request_ref(entry->req);
+        LIST_APPEND(followers, req->leader->followers, req);
+        agent_request_ref(req); /* Keep alive while operation is outstanding */
+        return true;
+}
+
 int agent_request_start(AgentRequest *req) {
         Node *node = req->node;
 
+        if (req->single_flight_key != NULL && agent_request_join(req)) {
+                return 1;
+        }
+
         int r = sd_bus_call_async(
                         node->agent_bus,
                         &req->slot,
@@ -1262,21 +1934,76 @@ int agent_request_start(AgentRequest *req) {
         }
 
         agent_request_ref(req); /* Keep alive while operation is outstanding */
+        node->last_sent_monotonic = get_time_micros_monotonic();
+
+        if (req->single_flight_key != NULL) {
+                RequestInFlight entry = { req->single_flight_key, req };
+                hashmap_set(node->requests_in_flight, &entry);
+                if (hashmap_oom(node->requests_in_flight)) {
+                        bc_log_debugf("Not sharing %s request for node %s, OOM",
+                                      sd_bus_message_get_member(req->message),
+                                      node->name);
+                }
+        }
         return 1;
 }
 
+static AgentRequest *node_start_list_units(
+                Node *node, bool shared, agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        if (!node_has_agent(node)) {
+                return NULL;
+        }
+
+        _cleanup_agent_request_ AgentRequest *req = NULL;
+        node_create_request(&req, node, "ListUnits", cb, userdata, free_userdata);
+        if (req == NULL) {
+                return NULL;
+        }
+        if (shared) {
+                agent_request_set_single_flight(req, NULL);
+        }
+
+        if (agent_request_start(req) < 0) {
+                return NULL;
+        }
+
+        return steal_pointer(&req);
+}
+
 AgentRequest *node_request_list_units(
                 Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        return node_start_list_units(node, true, cb, userdata, free_userdata);
+}
+
+/* Forwards the filter arguments (as states, as patterns, as types, as fields) of request_message,
+ * so the agent only sends back the matching units and requested fields */
+AgentRequest *node_request_list_units_filtered(
+                Node *node,
+                sd_bus_message *request_message,
+                agent_request_response_t cb,
+                void *userdata,
+                free_func_t free_userdata) {
         if (!node_has_agent(node)) {
                 return NULL;
         }
 
         _cleanup_agent_request_ AgentRequest *req = NULL;
-        node_create_request(&req, node, "ListUnits", cb, userdata, free_userdata);
+        node_create_request(&req, node, "ListUnitsFiltered", cb, userdata, free_userdata);
         if (req == NULL) {
                 return NULL;
         }
 
+        agent_request_set_single_flight(req, request_message);
+
+        int r = sd_bus_message_rewind(request_message, true);
+        for (int i = 0; i < 4 && r >= 0; i++) {
+                r = sd_bus_message_copy(req->message, request_message, false);
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to copy filter for node '%s': %s", node->name, strerror(-r));
+                return NULL;
+        }
+
         if (agent_request_start(req) < 0) {
                 return NULL;
         }
@@ -1284,6 +2011,53 @@ AgentRequest *node_request_list_units(
         return steal_pointer(&req);
 }
 
+/* The unit cache follows the units of the node through a wildcard subscription. It is
+ * only set up once the cache is first needed, so the agent is not made to forward the
+ * events of all units otherwise. */
+static bool node_track_units(Node *node) {
+        if (node->unit_cache_subscription != NULL) {
+                return true;
+        }
+
+        node->unit_cache_subscription = create_unit_cache_subscription(node->unit_cache, node->name);
+        if (node->unit_cache_subscription == NULL) {
+                return false;
+        }
+        node_subscribe(node, node->unit_cache_subscription);
+        return true;
+}
+
+/* Requests a full listing of the units of the node, to be loaded into its unit cache by the caller */
+AgentRequest *node_request_unit_cache_refresh(
+                Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        if (!node_has_agent(node)) {
+                return NULL;
+        }
+
+        /* Subscribe before listing, so no change after the listing is missed. For the same reason
+         * the listing must not be shared with one that may have been sent before subscribing. */
+        if (!node_track_units(node)) {
+                bc_log_errorf("Failed to track units of node '%s', OOM", node->name);
+                return NULL;
+        }
+
+        AgentRequest *req = node_start_list_units(node, false, cb, userdata, free_userdata);
+        if (req != NULL) {
+                /* Events received from now on may be newer than the listing */
+                unit_cache_listing_requested(node->unit_cache, req->message);
+        }
+        return req;
+}
+
+/* Same as node_request_unit_cache_refresh(), but returns NULL if the unit cache is valid */
+AgentRequest *node_request_stale_unit_cache_refresh(
+                Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
+        if (unit_cache_is_valid(node->unit_cache)) {
+                return NULL;
+        }
+        return node_request_unit_cache_refresh(node, cb, userdata, free_userdata);
+}
+
 AgentRequest *node_request_list_unit_files(
                 Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata) {
         if (!node_has_agent(node)) {
@@ -1295,6 +2069,7 @@ AgentRequest *node_request_list_unit_files(
         if (req == NULL) {
                 return NULL;
         }
+        agent_request_set_single_flight(req, NULL);
 
         if (agent_request_start(req) < 0) {
                 return NULL;
@@ -1359,10 +2134,35 @@ static int node_method_list_units(sd_bus_message *m, void *userdata, UNUSED sd_b
 }
 
 /*************************************************************************
- ********** org.eclipse.bluechi.Node.ListUnitFiles ***********************
+ ********** org.eclipse.bluechi.Node.ListUnitsFiltered ******************
  ************************************************************************/
 
-static int method_list_unit_files_callback(AgentRequest *req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
+static int node_method_list_units_filtered(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Node *node = userdata;
+
+        if (node->is_shutdown) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Request not allowed: node is in shutdown state");
+        }
+
+        _cleanup_agent_request_ AgentRequest *agent_req = node_request_list_units_filtered(
+                        node,
+                        m,
+                        method_list_units_callback,
+                        sd_bus_message_ref(m),
+                        (free_func_t) sd_bus_message_unref);
+        if (agent_req == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "List units not found");
+        }
+
+        return 1;
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.ListUnitFiles ***********************
+ ************************************************************************/
+
+static int method_list_unit_files_callback(AgentRequest *req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
         sd_bus_message *request_message = req->userdata;
 
         if (sd_bus_message_is_method_error(m, NULL)) {
@@ -1528,9 +2328,7 @@ static int node_method_passthrough_to_agent_callback(
         return sd_bus_message_send(reply);
 }
 
-static int node_method_passthrough_to_agent(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
-        Node *node = userdata;
-
+static int node_passthrough_to_agent(sd_bus_message *m, Node *node, bool read_only) {
         if (node->is_shutdown) {
                 return sd_bus_reply_method_errorf(
                                 m, SD_BUS_ERROR_FAILED, "Request not allowed: node is in shutdown state");
@@ -1550,6 +2348,9 @@ static int node_method_passthrough_to_agent(sd_bus_message *m, void *userdata, U
                 return sd_bus_reply_method_errorf(
                                 m, SD_BUS_ERROR_FAILED, "Failed to create an agent request: %s", strerror(-r));
         }
+        if (read_only) {
+                agent_request_set_single_flight(req, m);
+        }
 
         r = sd_bus_message_copy(req->message, m, true);
         if (r < 0) {
@@ -1569,6 +2370,16 @@ static int node_method_passthrough_to_agent(sd_bus_message *m, void *userdata, U
         return 1;
 }
 
+static int node_method_passthrough_to_agent(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_passthrough_to_agent(m, (Node *) userdata, false);
+}
+
+/* Identical calls that are in progress at the same time share one call to the agent */
+static int node_method_passthrough_read_only_to_agent(
+                sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_passthrough_to_agent(m, (Node *) userdata, true);
+}
+
 /* Keep track of data related to setting up a job. For example calling
    the initial agent request before we know the job is actually going to
    happen. */
@@ -1578,6 +2389,8 @@ typedef struct {
         Job *job;
 } JobSetup;
 
+static Pool job_setup_pool = POOL_INIT(JobSetup, 1024);
+
 static JobSetup *job_setup_ref(JobSetup *setup) {
         setup->ref_count++;
         return setup;
@@ -1591,14 +2404,14 @@ static void job_setup_unref(JobSetup *setup) {
 
         job_unrefp(&setup->job);
         sd_bus_message_unrefp(&setup->request_message);
-        free(setup);
+        pool_free(&job_setup_pool, setup);
 }
 
 DEFINE_CLEANUP_FUNC(JobSetup, job_setup_unref)
 #define _cleanup_job_setup_ _cleanup_(job_setup_unrefp)
 
 static JobSetup *job_setup_new(sd_bus_message *request_message, Node *node, const char *unit, const char *type) {
-        _cleanup_job_setup_ JobSetup *setup = malloc0(sizeof(JobSetup));
+        _cleanup_job_setup_ JobSetup *setup = pool_alloc0(&job_setup_pool);
         if (setup == NULL) {
                 return NULL;
         }
@@ -1607,7 +2420,7 @@ static JobSetup *job_setup_new(sd_bus_message *request_message, Node *node, cons
         setup->request_message = sd_bus_message_ref(request_message);
         setup->job = job_new(node, unit, type);
         if (setup->job == NULL) {
-                NULL;
+                return NULL;
         }
 
         return steal_pointer(&setup);
@@ -1729,6 +2542,281 @@ static int node_method_reload_unit(sd_bus_message *m, void *userdata, UNUSED sd_
         return node_run_unit_lifecycle_method(m, (Node *) userdata, "reload", "ReloadUnit");
 }
 
+/* Same as JobSetup, for the jobs of all units of StartUnits and friends */
+typedef struct {
+        int ref_count;
+        sd_bus_message *request_message;
+        JobGroup *group; /* Only set for StartUnitGroup and friends */
+        size_t n_jobs;
+        Job **jobs;
+} JobBatchSetup;
+
+static JobBatchSetup *job_batch_setup_ref(JobBatchSetup *setup) {
+        setup->ref_count++;
+        return setup;
+}
+
+static void job_batch_setup_unref(JobBatchSetup *setup) {
+        setup->ref_count--;
+        if (setup->ref_count != 0) {
+                return;
+        }
+
+        for (size_t i = 0; i < setup->n_jobs; i++) {
+                job_unrefp(&setup->jobs[i]);
+        }
+        free(setup->jobs);
+        if (setup->group != NULL) {
+                job_group_unref(setup->group);
+        }
+        sd_bus_message_unrefp(&setup->request_message);
+        free(setup);
+}
+
+DEFINE_CLEANUP_FUNC(JobBatchSetup, job_batch_setup_unref)
+#define _cleanup_job_batch_setup_ _cleanup_(job_batch_setup_unrefp)
+
+static JobBatchSetup *job_batch_setup_new(
+                sd_bus_message *request_message, Node *node, char **units, const char *type, JobGroup *group) {
+        _cleanup_job_batch_setup_ JobBatchSetup *setup = malloc0(sizeof(JobBatchSetup));
+        if (setup == NULL) {
+                return NULL;
+        }
+
+        setup->ref_count = 1;
+        setup->request_message = sd_bus_message_ref(request_message);
+        setup->jobs = calloc(strv_length(units), sizeof(Job *));
+        if (setup->jobs == NULL) {
+                return NULL;
+        }
+
+        if (group != NULL) {
+                setup->group = job_group_ref(group);
+        }
+
+        for (size_t i = 0; units[i] != NULL; i++) {
+                setup->jobs[i] = group != NULL ? job_group_add_unit(group, units[i]) : job_new(node, units[i], type);
+                if (setup->jobs[i] == NULL) {
+                        return NULL;
+                }
+                setup->n_jobs++;
+        }
+
+        return steal_pointer(&setup);
+}
+
+static int unit_lifecycle_method_batch_callback(
+                AgentRequest *req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
+        Controller *controller = req->node->controller;
+        JobBatchSetup *setup = req->userdata;
+        _cleanup_freev_ char **errors = NULL;
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                /* Forward error */
+                return sd_bus_reply_method_error(setup->request_message, sd_bus_message_get_error(m));
+        }
+
+        int r = sd_bus_message_read_strv(m, &errors);
+        if (r < 0 || strv_length(errors) != setup->n_jobs) {
+                return sd_bus_reply_method_errorf(
+                                setup->request_message, SD_BUS_ERROR_FAILED, "Invalid reply from the agent");
+        }
+
+        if (setup->group != NULL) {
+                for (size_t i = 0; i < setup->n_jobs; i++) {
+                        if (!streq(errors[i], "")) {
+                                bc_log_debugf("Failed to queue job of unit '%s': %s", setup->jobs[i]->unit, errors[i]);
+                                job_group_finish_job(setup->group, i, "failed");
+                        } else if (!controller_add_job(controller, setup->jobs[i])) {
+                                job_group_finish_job(setup->group, i, "failed");
+                        }
+                }
+
+                /* The caller gets the group before its JobGroupRemoved signal */
+                r = sd_bus_reply_method_return(setup->request_message, "o", setup->group->object_path);
+                job_group_seal(setup->group);
+                return r;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        r = sd_bus_message_new_method_return(setup->request_message, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "(os)");
+        }
+        for (size_t i = 0; r >= 0 && i < setup->n_jobs; i++) {
+                Job *job = setup->jobs[i];
+                if (!streq(errors[i], "")) {
+                        r = sd_bus_message_append(reply, "(os)", "/", errors[i]);
+                } else if (!controller_add_job(controller, job)) {
+                        r = sd_bus_message_append(reply, "(os)", "/", "Failed to add a job");
+                } else {
+                        r = sd_bus_message_append(reply, "(os)", job->object_path, "");
+                }
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(reply);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                setup->request_message,
+                                SD_BUS_ERROR_FAILED,
+                                "Failed to create reply message: %s",
+                                strerror(-r));
+        }
+
+        return sd_bus_message_send(reply);
+}
+
+/* Queues the jobs of all units with one call to the agent, which submits them to systemd at once */
+static int node_run_unit_lifecycle_method_batch(
+                sd_bus_message *m, Node *node, const char *job_type, const char *method, bool grouped) {
+        _cleanup_freev_ char **units = NULL;
+        const char *mode = NULL;
+        int export_jobs = true;
+        uint64_t start_time = get_time_micros();
+
+        if (node->is_shutdown) {
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Request not allowed: node is in shutdown state");
+        }
+
+        int r = sd_bus_message_read_strv(m, &units);
+        if (r >= 0) {
+                r = sd_bus_message_read(m, "s", &mode);
+        }
+        if (r >= 0 && grouped) {
+                r = sd_bus_message_read(m, "b", &export_jobs);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                SD_BUS_ERROR_INVALID_ARGS,
+                                "Invalid argument for units or mode: %s",
+                                strerror(-r));
+        }
+
+        if (strv_length(units) == 0) {
+                if (grouped) {
+                        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_INVALID_ARGS, "No units given");
+                }
+                return sd_bus_reply_method_return(m, "a(os)", 0);
+        }
+
+        _cleanup_job_group_ JobGroup *group = NULL;
+        if (grouped) {
+                group = job_group_new(node, job_type, strv_length(units), export_jobs);
+                if (group == NULL) {
+                        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+                }
+                if (!job_group_export(group)) {
+                        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Failed to export job group");
+                }
+        }
+
+        _cleanup_job_batch_setup_ JobBatchSetup *setup = job_batch_setup_new(m, node, units, job_type, group);
+        if (setup == NULL) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_NO_MEMORY, "Out of memory");
+        }
+
+        if (node->controller->metrics_enabled) {
+                for (size_t i = 0; i < setup->n_jobs; i++) {
+                        setup->jobs[i]->job_start_micros = start_time;
+                }
+        }
+
+        _cleanup_agent_request_ AgentRequest *req = NULL;
+        r = node_create_request(
+                        &req,
+                        node,
+                        method,
+                        unit_lifecycle_method_batch_callback,
+                        job_batch_setup_ref(setup),
+                        (free_func_t) job_batch_setup_unref);
+        if (req == NULL) {
+                job_batch_setup_unref(setup);
+
+                return sd_bus_reply_method_errorf(
+                                m, SD_BUS_ERROR_FAILED, "Failed to create an agent request: %s", strerror(-r));
+        }
+
+        r = sd_bus_message_open_container(req->message, SD_BUS_TYPE_ARRAY, "(su)");
+        for (size_t i = 0; r >= 0 && i < setup->n_jobs; i++) {
+                r = sd_bus_message_append(req->message, "(su)", setup->jobs[i]->unit, setup->jobs[i]->id);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(req->message);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append(req->message, "s", mode);
+        }
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                SD_BUS_ERROR_FAILED,
+                                "Failed to append units, job IDs, and mode to the message: %s",
+                                strerror(-r));
+        }
+
+        r = agent_request_start(req);
+        if (r < 0) {
+                return sd_bus_reply_method_errorf(
+                                m,
+                                SD_BUS_ERROR_FAILED,
+                                "Failed to call the method to start the node: %s",
+                                strerror(-r));
+        }
+
+        return 1;
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.StartUnits *************************
+ ************************************************************************/
+
+static int node_method_start_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_run_unit_lifecycle_method_batch(m, (Node *) userdata, "start", "StartUnits", false);
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.StopUnits **************************
+ ************************************************************************/
+
+static int node_method_stop_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_run_unit_lifecycle_method_batch(m, (Node *) userdata, "stop", "StopUnits", false);
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.RestartUnits ***********************
+ ************************************************************************/
+
+static int node_method_restart_units(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_run_unit_lifecycle_method_batch(m, (Node *) userdata, "restart", "RestartUnits", false);
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.StartUnitGroup *********************
+ ************************************************************************/
+
+static int node_method_start_unit_group(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_run_unit_lifecycle_method_batch(m, (Node *) userdata, "start", "StartUnits", true);
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.StopUnitGroup **********************
+ ************************************************************************/
+
+static int node_method_stop_unit_group(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_run_unit_lifecycle_method_batch(m, (Node *) userdata, "stop", "StopUnits", true);
+}
+
+/*************************************************************************
+ ********** org.eclipse.bluechi.Node.RestartUnitGroup *******************
+ ************************************************************************/
+
+static int node_method_restart_unit_group(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        return node_run_unit_lifecycle_method_batch(m, (Node *) userdata, "restart", "RestartUnits", true);
+}
+
 /*************************************************************************
  ********** org.eclipse.bluechi.Node.SetLogLevel *******************
  ************************************************************************/
@@ -1803,7 +2891,8 @@ static int send_agent_simple_message(Node *node, const char *method, const char
 }
 
 static void node_send_agent_subscribe(Node *node, const char *unit) {
-        if (!node_has_agent(node)) {
+        if (!node_has_agent(node) || node->resync_slot != NULL) {
+                node->resync_dirty = true;
                 return;
         }
 
@@ -1815,7 +2904,8 @@ static void node_send_agent_subscribe(Node *node, const char *unit) {
 
 
 static void node_send_agent_unsubscribe(Node *node, const char *unit) {
-        if (!node_has_agent(node)) {
+        if (!node_has_agent(node) || node->resync_slot != NULL) {
+                node->resync_dirty = true;
                 return;
         }
 
@@ -1825,6 +2915,129 @@ static void node_send_agent_unsubscribe(Node *node, const char *unit) {
         }
 }
 
+static void node_send_agent_property_filter(Node *node, const char *unit, char **properties) {
+        if (!node_has_agent(node) || node->resync_slot != NULL) {
+                node->resync_dirty = true;
+                return;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_method_call(
+                        node->agent_bus,
+                        &m,
+                        BC_AGENT_DBUS_NAME,
+                        INTERNAL_AGENT_OBJECT_PATH,
+                        INTERNAL_AGENT_INTERFACE,
+                        "SetPropertyFilter");
+        if (r >= 0) {
+                r = sd_bus_message_append(m, "s", unit);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(m, properties);
+        }
+        if (r >= 0) {
+                r = sd_bus_send(node->agent_bus, m, NULL);
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to set property filter of unit '%s' w/ agent: %s", unit, strerror(-r));
+        }
+}
+
+/*
+ * Recomputes which properties the agent needs to forward for a unit and
+ * pushes them to the agent if they changed, or unconditionally if forced.
+ * A single subscriber without an allow-list requires all properties.
+ */
+static bool node_update_property_filter(Node *node, UnitSubscriptions *usubs, bool force) {
+        _cleanup_freev_ char **properties = NULL;
+        for (size_t i = 0; i < usubs->n_subscribers; i++) {
+                Subscription *sub = usubs->subscribers[i].sub;
+                if (sub->properties == NULL) {
+                        freev((void **) steal_pointer(&properties));
+                        break;
+                }
+                for (char **p = sub->properties; *p != NULL; p++) {
+                        if (!strv_contains(properties, *p) && !strv_extend(&properties, *p)) {
+                                return false;
+                        }
+                }
+        }
+        strv_sort(properties);
+
+        if (!force && strv_equal(properties, usubs->properties)) {
+                return true;
+        }
+
+        freev((void **) usubs->properties);
+        usubs->properties = steal_pointer(&properties);
+        node_send_agent_property_filter(node, usubs->unit, usubs->properties);
+        return true;
+}
+
+static bool node_update_all_property_filters(Node *node) {
+        void *item = NULL;
+        size_t i = 0;
+
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                if (!node_update_property_filter(node, item, false)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/* Adds the current subscribers of the globs matching a newly subscribed unit to its fan-out set */
+static bool node_seed_unit_subscribers(Node *node, UnitSubscriptions *usubs) {
+        void *item = NULL;
+        size_t i = 0;
+
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                const UnitSubscriptions *usubs_glob = item;
+                if (!glob_pattern_matches(usubs_glob->glob, usubs->unit)) {
+                        continue;
+                }
+                for (size_t j = 0; j < usubs_glob->n_subscribers; j++) {
+                        const UnitSubscriber *subscriber = &usubs_glob->subscribers[j];
+                        if (!unit_subscriptions_add_subscriber(usubs, subscriber->sub, subscriber->n_refs)) {
+                                return false;
+                        }
+                }
+        }
+        return true;
+}
+
+/* Adds a glob subscriber to the fan-out sets of all subscribed units matching the glob */
+static bool node_add_glob_subscriber(Node *node, UnitSubscriptions *usubs_glob, Subscription *sub) {
+        void *item = NULL;
+        size_t i = 0;
+
+        /* The routes are built again with the new subscriber */
+        hashmap_clear(node->unit_routes, false);
+
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                UnitSubscriptions *usubs = item;
+                if (usubs->glob == NULL && glob_pattern_matches(usubs_glob->glob, usubs->unit) &&
+                    !unit_subscriptions_add_subscriber(usubs, sub, 1)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static void node_remove_glob_subscriber(Node *node, UnitSubscriptions *usubs_glob, Subscription *sub) {
+        void *item = NULL;
+        size_t i = 0;
+
+        hashmap_clear(node->unit_routes, false);
+
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                UnitSubscriptions *usubs = item;
+                if (usubs->glob == NULL && glob_pattern_matches(usubs_glob->glob, usubs->unit)) {
+                        unit_subscriptions_remove_subscriber(usubs, sub);
+                }
+        }
+}
+
 /* Resubscribe to all subscriptions */
 static void node_send_agent_subscribe_all(Node *node) {
         void *item = NULL;
@@ -1833,6 +3046,7 @@ static void node_send_agent_subscribe_all(Node *node) {
         while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
                 UnitSubscriptions *usubs = item;
                 node_send_agent_subscribe(node, usubs->unit);
+                node_send_agent_property_filter(node, usubs->unit, usubs->properties);
         }
 }
 
@@ -1850,26 +3064,64 @@ void node_subscribe(Node *node, Subscription *sub) {
                 }
                 usub->sub = sub;
 
+                bool is_glob_unit = is_glob(sub_unit->name);
+                bool is_new_unit = false;
                 usubs = (UnitSubscriptions *) hashmap_get(node->unit_subscriptions, &key);
                 if (usubs == NULL) {
-                        UnitSubscriptions v = { NULL, NULL, false, _UNIT_ACTIVE_STATE_INVALID, NULL };
+                        is_new_unit = true;
+                        UnitSubscriptions v = {
+                                NULL, NULL, false, _UNIT_ACTIVE_STATE_INVALID, NULL, NULL, 0, 0, NULL, NULL, false,
+                                _UNIT_ACTIVE_STATE_INVALID, NULL
+                        };
                         v.unit = strdup(key.unit);
                         if (v.unit == NULL) {
                                 bc_log_error("Failed to subscribe to unit, OOM");
                                 return;
                         }
+                        if (is_glob_unit) {
+                                v.glob = glob_pattern_new(key.unit);
+                                if (v.glob == NULL) {
+                                        free(v.unit);
+                                        bc_log_error("Failed to subscribe to unit, OOM");
+                                        return;
+                                }
+                        }
 
                         usubs = (UnitSubscriptions *) hashmap_set(node->unit_subscriptions, &v);
                         if (usubs == NULL && hashmap_oom(node->unit_subscriptions)) {
                                 free(v.unit);
+                                glob_pattern_free(v.glob);
                                 bc_log_error("Failed to subscribe to unit, OOM");
                                 return;
                         }
+                        if (is_glob_unit && !is_wildcard(sub_unit->name)) {
+                                node->n_unit_patterns++;
+                        }
 
                         /* First sub to this unit, pass to agent */
                         node_send_agent_subscribe(node, sub_unit->name);
 
                         usubs = (UnitSubscriptions *) hashmap_get(node->unit_subscriptions, &key);
+
+                        /* Events of this unit now also reach the glob subscriptions through it */
+                        if (!is_glob_unit && !node_seed_unit_subscribers(node, usubs)) {
+                                bc_log_error("Failed to subscribe to unit, OOM");
+                                return;
+                        }
+                }
+
+                if (!unit_subscriptions_add_subscriber(usubs, sub, 1)) {
+                        bc_log_error("Failed to subscribe to unit, OOM");
+                        return;
+                }
+                if (is_glob_unit && !node_add_glob_subscriber(node, usubs, sub)) {
+                        bc_log_error("Failed to subscribe to unit, OOM");
+                        return;
+                }
+                if (!node_update_property_filter(node, usubs, is_new_unit) ||
+                    (is_glob_unit && !node_update_all_property_filters(node))) {
+                        bc_log_error("Failed to subscribe to unit, OOM");
+                        return;
                 }
 
                 LIST_APPEND(subs, usubs->subs, steal_pointer(&usub));
@@ -1931,13 +3183,27 @@ void node_unsubscribe(Node *node, Subscription *sub) {
                 LIST_REMOVE(subs, usubs->subs, found);
                 free_and_null(found);
 
+                bool is_glob_unit = is_glob(sub_unit->name);
+                unit_subscriptions_remove_subscriber(usubs, sub);
+                if (is_glob_unit) {
+                        node_remove_glob_subscriber(node, usubs, sub);
+                }
+
                 if (LIST_IS_EMPTY(usubs->subs)) {
                         /* Last subscription for this unit, tell agent */
                         node_send_agent_unsubscribe(node, sub_unit->name);
+                        if (is_glob_unit && !is_wildcard(sub_unit->name)) {
+                                node->n_unit_patterns--;
+                        }
                         deleted = (UnitSubscriptions *) hashmap_delete(node->unit_subscriptions, &key);
                         if (deleted) {
                                 unit_subscriptions_clear(deleted);
                         }
+                } else if (!node_update_property_filter(node, usubs, false)) {
+                        bc_log_error("Failed to update property filter, OOM");
+                }
+                if (is_glob_unit && !node_update_all_property_filters(node)) {
+                        bc_log_error("Failed to update property filter, OOM");
                 }
         }
 }
@@ -1962,6 +3228,177 @@ static void node_start_proxy_dependency_all(Node *node) {
         }
 }
 
+/* Sends all subscriptions to an agent that knows none of them */
+static void node_resync_agent_fully(Node *node) {
+        void *item = NULL;
+        size_t i = 0;
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                UnitSubscriptions *usubs = item;
+                usubs->offline_loaded = false;
+        }
+        node->resync_dirty = false;
+
+        node_send_agent_subscribe_all(node);
+}
+
+static int node_compare_unit_names(const void *a, const void *b) {
+        return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* Reports the units that didn't change while the agent was offline in their state from before */
+static void node_restore_offline_units(Node *node, char **changed_units) {
+        size_t n_changed_units = strv_length(changed_units);
+        void *item = NULL;
+        size_t i = 0;
+
+        while (hashmap_iter(node->unit_subscriptions, &i, &item)) {
+                UnitSubscriptions *usubs = item;
+                bool offline_loaded = usubs->offline_loaded;
+                usubs->offline_loaded = false;
+
+                /* Changed units are reported by the agent, even if they changed after the reconnect */
+                if (!offline_loaded || usubs->loaded ||
+                    bsearch(&usubs->unit,
+                            changed_units,
+                            n_changed_units,
+                            sizeof(char *),
+                            node_compare_unit_names) != NULL) {
+                        continue;
+                }
+
+                usubs->loaded = true;
+                usubs->active_state = usubs->offline_active_state;
+                usubs->substate = usubs->offline_substate;
+
+                for (size_t s = 0; s < usubs->n_subscribers; s++) {
+                        Subscription *sub = usubs->subscribers[s].sub;
+                        int r = sub->handle_unit_new(sub->monitor, node->name, usubs->unit, "virtual");
+                        if (r < 0) {
+                                bc_log_error("Failed to emit UnitNew signal");
+                        }
+                        if (usubs->active_state < 0) {
+                                continue;
+                        }
+                        r = sub->handle_unit_state_changed(
+                                        sub->monitor,
+                                        node->name,
+                                        usubs->unit,
+                                        active_state_to_string(usubs->active_state),
+                                        usubs->substate ? usubs->substate : "invalid",
+                                        "virtual");
+                        if (r < 0) {
+                                bc_log_error("Failed to emit UnitStateChanged signal");
+                        }
+                }
+        }
+}
+
+static int node_resync_callback(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        Node *node = userdata;
+
+        sd_bus_slot_unrefp(&node->resync_slot);
+        node->resync_slot = NULL;
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                /* Agents not supporting the resync keep their subscriptions, as before */
+                bc_log_infof("Node '%s' failed to resync: %s", node->name, sd_bus_message_get_error(m)->message);
+                node_resync_agent_fully(node);
+                return 0;
+        }
+
+        int incremental = 0;
+        uint64_t session_id = 0;
+        uint64_t seq = 0;
+        _cleanup_freev_ char **changed_units = NULL;
+        int r = sd_bus_message_read(m, "btt", &incremental, &session_id, &seq);
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(m, &changed_units);
+        }
+        if (r < 0) {
+                bc_log_errorf("Invalid reply to Resync of node '%s': %s", node->name, strerror(-r));
+                node_resync_agent_fully(node);
+                return 0;
+        }
+
+        node->agent_session_id = session_id;
+        node->agent_event_seq = seq;
+
+        if (!incremental) {
+                bc_log_infof("Resyncing all subscriptions of node '%s'", node->name);
+                node_resync_agent_fully(node);
+                return 0;
+        }
+        if (node->resync_dirty) {
+                /* Subscriptions changed while waiting for the reply, start over */
+                node_resync_agent(node);
+                return 0;
+        }
+
+        bc_log_infof("Resyncing node '%s' with %zu changed units", node->name, strv_length(changed_units));
+        node_restore_offline_units(node, changed_units);
+        return 0;
+}
+
+/*
+ * Once an agent (re)connected, it is asked for the units that changed since the
+ * last event received from it, and it keeps its subscriptions. Changes to the
+ * subscriptions are held back until it replied. If this is a new agent process,
+ * if too many events happened meanwhile, or if the subscriptions changed while
+ * it was offline, the agent drops its subscriptions instead and all of them are
+ * sent again. Proxy dependencies are not part of this, they are always started
+ * again and stopped right away.
+ */
+static void node_resync_agent(Node *node) {
+        uint64_t session_id = node->resync_dirty ? 0 : node->agent_session_id;
+        node->resync_dirty = false;
+
+        sd_bus_slot_unrefp(&node->resync_slot);
+        node->resync_slot = NULL;
+
+        if (node->name == NULL) {
+                node_resync_agent_fully(node);
+                return;
+        }
+
+        if (session_id == 0) {
+                /* Only drops what the agent may still have, no need to wait for the reply */
+                int r = sd_bus_call_method_async(
+                                node->agent_bus,
+                                NULL,
+                                BC_AGENT_DBUS_NAME,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "Resync",
+                                NULL,
+                                NULL,
+                                "tt",
+                                UINT64_C(0),
+                                UINT64_C(0));
+                if (r < 0) {
+                        bc_log_errorf("Failed to resync node '%s': %s", node->name, strerror(-r));
+                }
+                node_resync_agent_fully(node);
+                return;
+        }
+
+        int r = sd_bus_call_method_async(
+                        node->agent_bus,
+                        &node->resync_slot,
+                        BC_AGENT_DBUS_NAME,
+                        INTERNAL_AGENT_OBJECT_PATH,
+                        INTERNAL_AGENT_INTERFACE,
+                        "Resync",
+                        node_resync_callback,
+                        node,
+                        "tt",
+                        session_id,
+                        node->agent_event_seq);
+        if (r < 0) {
+                bc_log_errorf("Failed to resync node '%s': %s", node->name, strerror(-r));
+                node_resync_agent_fully(node);
+        }
+}
+
 static void node_stop_proxy_dependency(Node *node, ProxyDependency *dep) {
         if (!node_has_agent(node)) {
                 return;
@@ -27,13 +27,21 @@ struct AgentRequest {
 
         bool is_cancelled;
 
+        /* Identical read-only requests of a node share one call to the agent, see agent_request_start() */
+        char *single_flight_key; /* NULL if the request is never shared */
+        AgentRequest *leader;    /* The request that was sent to the agent, if this one waits for its reply */
+        LIST_HEAD(AgentRequest, followers);
+
         LIST_FIELDS(AgentRequest, outstanding_requests);
+        LIST_FIELDS(AgentRequest, followers);
 };
 
 AgentRequest *agent_request_ref(AgentRequest *req);
 void agent_request_unref(AgentRequest *req);
+void agent_request_set_single_flight(AgentRequest *req, sd_bus_message *args);
 int agent_request_start(AgentRequest *req);
 int agent_request_cancel(AgentRequest *r);
+void agent_request_abandon(AgentRequest *req);
 
 struct Node {
         int ref_count;
@@ -58,13 +66,26 @@ struct Node {
         char *peer_selinux_context;
 
         LIST_HEAD(AgentRequest, outstanding_requests);
+        struct hashmap *requests_in_flight; /* Started single flight requests by key */
         LIST_HEAD(ProxyMonitor, proxy_monitors);
         LIST_HEAD(ProxyDependency, proxy_dependencies);
         LIST_HEAD(ProxyTarget, allowed_proxy_targets);
 
         struct hashmap *unit_subscriptions;
+        size_t n_unit_patterns;        /* Subscribed globs other than the wildcard */
+        struct hashmap *unit_routes;   /* Fan-out sets of units only matched by globs, built on first use */
+        UnitCache *unit_cache;
+        Subscription *unit_cache_subscription; /* NULL until the cache is first requested */
+
+        /* Last unit event received from the agent, so that a reconnect only resyncs the changes since */
+        uint64_t agent_session_id; /* 0 if unknown */
+        uint64_t agent_event_seq;
+        bool resync_dirty;        /* Subscriptions or dependencies changed while offline */
+        sd_bus_slot *resync_slot; /* Pending Resync call */
         uint64_t last_seen;
         uint64_t last_seen_monotonic;
+        uint64_t last_sent_monotonic; /* Time of the last request or heartbeat sent to the agent */
+        sd_event_source *heartbeat_timer_source; /* NULL while offline */
 
         bool is_shutdown;
 };
@@ -87,8 +108,18 @@ int node_add_allowed_proxy_target(Node *node, const char *target_name);
 
 AgentRequest *node_request_list_units(
                 Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata);
+AgentRequest *node_request_list_units_filtered(
+                Node *node,
+                sd_bus_message *request_message,
+                agent_request_response_t cb,
+                void *userdata,
+                free_func_t free_userdata);
 AgentRequest *node_request_list_unit_files(
                 Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata);
+AgentRequest *node_request_unit_cache_refresh(
+                Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata);
+AgentRequest *node_request_stale_unit_cache_refresh(
+                Node *node, agent_request_response_t cb, void *userdata, free_func_t free_userdata);
 
 void node_subscribe(Node *node, Subscription *sub);
 void node_unsubscribe(Node *node, Subscription *sub);
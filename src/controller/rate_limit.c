@@ -0,0 +1,117 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <hashmap.h>
+#include <string.h>
+
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "rate_limit.h"
+
+struct RateLimiter {
+        struct hashmap *buckets;
+};
+
+typedef struct RateLimitBucket {
+        char *sender; /* key */
+        double tokens;
+        uint64_t last_refill;
+} RateLimitBucket;
+
+static uint64_t rate_limit_bucket_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const RateLimitBucket *bucket = item;
+        return hashmap_sip(bucket->sender, strlen(bucket->sender), seed0, seed1);
+}
+
+static int rate_limit_bucket_compare(const void *a, const void *b, UNUSED void *udata) {
+        const RateLimitBucket *bucket_a = a;
+        const RateLimitBucket *bucket_b = b;
+
+        return strcmp(bucket_a->sender, bucket_b->sender);
+}
+
+static void rate_limit_bucket_clear(void *item) {
+        RateLimitBucket *bucket = item;
+        free(bucket->sender);
+}
+
+RateLimiter *rate_limiter_new(void) {
+        _cleanup_free_ RateLimiter *limiter = malloc0(sizeof(RateLimiter));
+        if (limiter == NULL) {
+                return NULL;
+        }
+
+        limiter->buckets = hashmap_new(
+                        sizeof(RateLimitBucket),
+                        0,
+                        0,
+                        0,
+                        rate_limit_bucket_hash,
+                        rate_limit_bucket_compare,
+                        rate_limit_bucket_clear,
+                        NULL);
+        if (limiter->buckets == NULL) {
+                return NULL;
+        }
+
+        return steal_pointer(&limiter);
+}
+
+void rate_limiter_free(RateLimiter *limiter) {
+        if (limiter == NULL) {
+                return;
+        }
+        hashmap_free(limiter->buckets);
+        free(limiter);
+}
+
+bool rate_limiter_take(RateLimiter *limiter, const char *sender, long rate, long burst, uint64_t now) {
+        if (burst < 1) {
+                burst = 1;
+        }
+
+        RateLimitBucket key = { (char *) sender, 0, 0 };
+        RateLimitBucket *bucket = (RateLimitBucket *) hashmap_get(limiter->buckets, &key);
+        if (bucket == NULL) {
+                _cleanup_free_ char *sender_copy = strdup(sender);
+                if (sender_copy == NULL) {
+                        /* Don't punish the client for our own memory pressure */
+                        return true;
+                }
+
+                RateLimitBucket new_bucket = { sender_copy, (double) burst, now };
+                hashmap_set(limiter->buckets, &new_bucket);
+                if (hashmap_oom(limiter->buckets)) {
+                        return true;
+                }
+                steal_pointer(&sender_copy);
+                bucket = (RateLimitBucket *) hashmap_get(limiter->buckets, &key);
+        } else if (now > bucket->last_refill) {
+                bucket->tokens += (double) (now - bucket->last_refill) * (double) rate / (double) USEC_PER_SEC;
+                if (bucket->tokens > (double) burst) {
+                        bucket->tokens = (double) burst;
+                }
+                bucket->last_refill = now;
+        }
+
+        if (bucket->tokens < 1) {
+                return false;
+        }
+        bucket->tokens -= 1;
+        return true;
+}
+
+void rate_limiter_forget(RateLimiter *limiter, const char *sender) {
+        RateLimitBucket key = { (char *) sender, 0, 0 };
+        RateLimitBucket *bucket = (RateLimitBucket *) hashmap_delete(limiter->buckets, &key);
+        if (bucket != NULL) {
+                free(bucket->sender);
+        }
+}
+
+size_t rate_limiter_size(RateLimiter *limiter) {
+        return hashmap_count(limiter->buckets);
+}
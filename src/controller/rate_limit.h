@@ -0,0 +1,27 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Token buckets of the clients of the public API, keyed by their unique bus name.
+ * A bucket holds up to burst tokens and is refilled with rate tokens per second,
+ * each request takes one token.
+ */
+typedef struct RateLimiter RateLimiter;
+
+RateLimiter *rate_limiter_new(void);
+void rate_limiter_free(RateLimiter *limiter);
+
+/* Takes a token of sender at now (in microseconds), returns false if the bucket is empty */
+bool rate_limiter_take(RateLimiter *limiter, const char *sender, long rate, long burst, uint64_t now);
+
+/* Drops the bucket of a sender that disconnected */
+void rate_limiter_forget(RateLimiter *limiter, const char *sender);
+
+size_t rate_limiter_size(RateLimiter *limiter);
@@ -0,0 +1,362 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <fnmatch.h>
+
+#include "libbluechi/common/time-util.h"
+#include "libbluechi/log/log.h"
+
+#include "controller.h"
+#include "job.h"
+#include "node.h"
+#include "rollout.h"
+
+static bool rollout_matches_node(const char *node_pattern, Node *node) {
+        if (node_pattern[0] == '\0' || streq(node_pattern, "*")) {
+                return true;
+        }
+        return fnmatch(node_pattern, node->name, 0) == 0;
+}
+
+Rollout *rollout_new(
+                Controller *controller,
+                const char *node_pattern,
+                const char *unit,
+                const char *mode,
+                const char *method,
+                uint32_t parallelism,
+                uint32_t batch_size,
+                uint32_t max_failures) {
+        size_t n_nodes = 0;
+        Node *node = NULL;
+        LIST_FOREACH(nodes, node, controller->nodes) {
+                if (rollout_matches_node(node_pattern, node)) {
+                        n_nodes++;
+                }
+        }
+
+        _cleanup_rollout_ Rollout *rollout = malloc0_array(sizeof(Rollout), sizeof(RolloutNode), n_nodes);
+        if (rollout == NULL) {
+                return NULL;
+        }
+
+        rollout->ref_count = 1;
+        rollout->controller = controller;
+        rollout->method = method;
+        rollout->parallelism = parallelism;
+        rollout->batch_size = batch_size;
+        rollout->max_failures = max_failures;
+
+        LIST_FOREACH(nodes, node, controller->nodes) {
+                if (rollout_matches_node(node_pattern, node)) {
+                        rollout->nodes[rollout->n_nodes].node = node_ref(node);
+                        rollout->nodes[rollout->n_nodes].state = ROLLOUT_NODE_WAITING;
+                        rollout->n_nodes++;
+                }
+        }
+
+        rollout->unit = strdup(unit);
+        if (rollout->unit == NULL) {
+                return NULL;
+        }
+
+        rollout->mode = strdup(mode);
+        if (rollout->mode == NULL) {
+                return NULL;
+        }
+
+        return steal_pointer(&rollout);
+}
+
+Rollout *rollout_ref(Rollout *rollout) {
+        rollout->ref_count++;
+        return rollout;
+}
+
+void rollout_unref(Rollout *rollout) {
+        rollout->ref_count--;
+        if (rollout->ref_count != 0) {
+                return;
+        }
+
+        for (size_t i = 0; i < rollout->n_nodes; i++) {
+                node_unrefp(&rollout->nodes[i].node);
+                job_unrefp(&rollout->nodes[i].job);
+                free_and_null(rollout->nodes[i].job_path);
+                free_and_null(rollout->nodes[i].result);
+        }
+
+        sd_event_source_unrefp(&rollout->advance_source);
+        free_and_null(rollout->unit);
+        free_and_null(rollout->mode);
+        free(rollout);
+}
+
+static int rollout_advance_callback(UNUSED sd_event_source *event_source, void *userdata);
+
+/* Progress is made from the event loop, so that finishing jobs never change the job list while it is iterated */
+static int rollout_schedule_advance(Rollout *rollout) {
+        if (rollout->advance_source != NULL) {
+                return sd_event_source_set_enabled(rollout->advance_source, SD_EVENT_ONESHOT);
+        }
+
+        return sd_event_add_defer(
+                        rollout->controller->event, &rollout->advance_source, rollout_advance_callback, rollout);
+}
+
+static RolloutNode *rollout_find_node(Rollout *rollout, Job *job) {
+        for (size_t i = 0; i < rollout->n_nodes; i++) {
+                if (rollout->nodes[i].job == job) {
+                        return &rollout->nodes[i];
+                }
+        }
+        return NULL;
+}
+
+static void rollout_node_done(Rollout *rollout, RolloutNode *entry, const char *result) {
+        entry->state = ROLLOUT_NODE_DONE;
+        entry->result = strdup(result);
+        job_unrefp(&entry->job);
+
+        rollout->n_in_flight--;
+        if (!streq(result, "done")) {
+                rollout->n_failed++;
+        }
+
+        int r = rollout_schedule_advance(rollout);
+        if (r < 0) {
+                bc_log_errorf("Failed to schedule rollout of unit '%s': %s", rollout->unit, strerror(-r));
+        }
+}
+
+static int rollout_lifecycle_callback(AgentRequest *req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
+        Job *job = req->userdata;
+        Rollout *rollout = job->rollout;
+
+        RolloutNode *entry = rollout_find_node(rollout, job);
+        if (entry == NULL || entry->state != ROLLOUT_NODE_STARTING) {
+                return 0;
+        }
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                bc_log_errorf("Failed to %s unit '%s' on node '%s': %s",
+                              job->type,
+                              rollout->unit,
+                              entry->node->name,
+                              sd_bus_message_get_error(m)->message);
+                rollout_node_done(rollout, entry, "failed");
+                return 0;
+        }
+
+        if (!controller_add_job(rollout->controller, job)) {
+                rollout_node_done(rollout, entry, "failed");
+                return 0;
+        }
+        entry->state = ROLLOUT_NODE_RUNNING;
+
+        if (rollout->canceled) {
+                int r = job_cancel(job);
+                if (r < 0) {
+                        bc_log_errorf("Failed to cancel job %u: %s", job->id, strerror(-r));
+                }
+        }
+
+        return 0;
+}
+
+static int rollout_start_node(Rollout *rollout, RolloutNode *entry) {
+        Node *node = entry->node;
+
+        if (!node_is_online(node)) {
+                return -ENOTCONN;
+        }
+
+        _cleanup_job_ Job *job = job_new(node, rollout->unit, rollout->job->type);
+        if (job == NULL) {
+                return -ENOMEM;
+        }
+        job->rollout = rollout_ref(rollout);
+        if (rollout->controller->metrics_enabled) {
+                job->job_start_micros = get_time_micros();
+        }
+
+        entry->job_path = strdup(job->object_path);
+        if (entry->job_path == NULL) {
+                return -ENOMEM;
+        }
+
+        _cleanup_agent_request_ AgentRequest *req = NULL;
+        int r = node_create_request(
+                        &req, node, rollout->method, rollout_lifecycle_callback, job_ref(job), (free_func_t) job_unref);
+        if (req == NULL) {
+                job_unref(job);
+                return r;
+        }
+
+        r = sd_bus_message_append(req->message, "ssu", rollout->unit, rollout->mode, job->id);
+        if (r < 0) {
+                return r;
+        }
+
+        r = agent_request_start(req);
+        if (r < 0) {
+                return r;
+        }
+
+        entry->job = steal_pointer(&job);
+        return 0;
+}
+
+static bool rollout_is_stopping(Rollout *rollout) {
+        return rollout->canceled || rollout->n_failed > rollout->max_failures;
+}
+
+static void rollout_finish(Rollout *rollout) {
+        const char *result = "done";
+        if (rollout->canceled) {
+                result = "canceled";
+        } else if (rollout->n_failed > 0) {
+                result = "failed";
+        }
+
+        /* Nodes that were never started, either due to Cancel or too many failures */
+        for (size_t i = rollout->n_started; i < rollout->n_nodes; i++) {
+                rollout->nodes[i].state = ROLLOUT_NODE_DONE;
+                rollout->nodes[i].result = strdup("canceled");
+        }
+
+        bc_log_infof("Rollout of unit '%s' finished with result '%s' after %zu of %zu nodes, %zu failed",
+                     rollout->unit,
+                     result,
+                     rollout->n_started,
+                     rollout->n_nodes,
+                     rollout->n_failed);
+
+        Job *job = steal_pointer(&rollout->job);
+        controller_remove_job(rollout->controller, job, result);
+}
+
+static void rollout_advance(Rollout *rollout) {
+        if (rollout->job == NULL) {
+                return;
+        }
+
+        while (!rollout_is_stopping(rollout) && rollout->n_started < rollout->n_nodes) {
+                if (rollout->n_started == rollout->wave_end) {
+                        /* The next wave only starts once the current one is done */
+                        if (rollout->n_in_flight > 0) {
+                                break;
+                        }
+                        rollout->wave_end = rollout->n_nodes;
+                        if (rollout->batch_size > 0 && rollout->n_started + rollout->batch_size < rollout->n_nodes) {
+                                rollout->wave_end = rollout->n_started + rollout->batch_size;
+                        }
+                }
+                if (rollout->parallelism > 0 && rollout->n_in_flight >= rollout->parallelism) {
+                        break;
+                }
+
+                RolloutNode *entry = &rollout->nodes[rollout->n_started++];
+                entry->state = ROLLOUT_NODE_STARTING;
+                rollout->n_in_flight++;
+                if (rollout->job->state == JOB_WAITING) {
+                        job_set_state(rollout->job, JOB_RUNNING);
+                }
+
+                int r = rollout_start_node(rollout, entry);
+                if (r < 0) {
+                        bc_log_errorf("Failed to %s unit '%s' on node '%s': %s",
+                                      rollout->job->type,
+                                      rollout->unit,
+                                      entry->node->name,
+                                      strerror(-r));
+                        free_and_null(entry->job_path);
+                        rollout_node_done(rollout, entry, "failed");
+                }
+        }
+
+        if (rollout->n_in_flight == 0 && (rollout_is_stopping(rollout) || rollout->n_started == rollout->n_nodes)) {
+                rollout_finish(rollout);
+        }
+}
+
+static int rollout_advance_callback(UNUSED sd_event_source *event_source, void *userdata) {
+        /* Finishing the rollout drops the reference of the aggregate job */
+        _cleanup_rollout_ Rollout *rollout = rollout_ref(userdata);
+
+        rollout_advance(rollout);
+        return 0;
+}
+
+int rollout_start(Rollout *rollout, const char *job_type) {
+        _cleanup_job_ Job *job = job_new_aggregate(rollout->controller, rollout->unit, job_type);
+        if (job == NULL) {
+                return -ENOMEM;
+        }
+        job->rollout = rollout_ref(rollout);
+
+        /* The first wave starts after the caller got the path of the aggregate job */
+        int r = rollout_schedule_advance(rollout);
+        if (r < 0) {
+                return r;
+        }
+
+        if (!controller_add_job(rollout->controller, job)) {
+                sd_event_source_unrefp(&rollout->advance_source);
+                return -EIO;
+        }
+        rollout->job = job;
+
+        return 0;
+}
+
+void rollout_cancel(Rollout *rollout) {
+        rollout->canceled = true;
+
+        /* Jobs that are still starting are canceled once the agent queued them */
+        for (size_t i = 0; i < rollout->n_started; i++) {
+                if (rollout->nodes[i].state != ROLLOUT_NODE_RUNNING) {
+                        continue;
+                }
+                int r = job_cancel(rollout->nodes[i].job);
+                if (r < 0) {
+                        bc_log_errorf("Failed to cancel job %u: %s", rollout->nodes[i].job->id, strerror(-r));
+                }
+        }
+
+        int r = rollout_schedule_advance(rollout);
+        if (r < 0) {
+                bc_log_errorf("Failed to schedule rollout of unit '%s': %s", rollout->unit, strerror(-r));
+        }
+}
+
+void rollout_job_finished(Rollout *rollout, Job *job, const char *result) {
+        RolloutNode *entry = rollout_find_node(rollout, job);
+        if (entry != NULL && entry->state == ROLLOUT_NODE_RUNNING) {
+                rollout_node_done(rollout, entry, result);
+        }
+}
+
+int rollout_append_children(Rollout *rollout, sd_bus_message *reply) {
+        int r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "(sos)");
+        if (r < 0) {
+                return r;
+        }
+
+        for (size_t i = 0; i < rollout->n_nodes; i++) {
+                RolloutNode *entry = &rollout->nodes[i];
+                r = sd_bus_message_append(
+                                reply,
+                                "(sos)",
+                                entry->node->name,
+                                entry->job_path != NULL ? entry->job_path : "/",
+                                entry->result != NULL ? entry->result : "");
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        return sd_bus_message_close_container(reply);
+}
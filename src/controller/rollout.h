@@ -0,0 +1,81 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include "libbluechi/common/common.h"
+
+#include "types.h"
+
+typedef enum RolloutNodeState {
+        ROLLOUT_NODE_WAITING,  /* Not started yet */
+        ROLLOUT_NODE_STARTING, /* Waiting for the agent to queue the job */
+        ROLLOUT_NODE_RUNNING,  /* Job queued, waiting for it to finish */
+        ROLLOUT_NODE_DONE,
+} RolloutNodeState;
+
+typedef struct RolloutNode {
+        Node *node;
+        Job *job; /* Only set while the job is starting or running */
+        char *job_path;
+        char *result;
+        RolloutNodeState state;
+} RolloutNode;
+
+/*
+ * A unit lifecycle operation on a set of nodes. The nodes are processed in
+ * waves of batch_size nodes with at most parallelism jobs in flight, and the
+ * next wave only starts once the previous one is done. As soon as more than
+ * max_failures nodes failed, no further nodes are started. The progress is
+ * exposed as an aggregate job, which is removed once all started jobs are done.
+ */
+struct Rollout {
+        int ref_count;
+
+        Controller *controller; /* weak ref */
+        Job *job;               /* weak ref, the aggregate job owns the rollout */
+
+        char *unit;
+        char *mode;
+        const char *method;
+        uint32_t parallelism; /* 0 for the whole wave at once */
+        uint32_t batch_size;  /* 0 for all nodes in one wave */
+        uint32_t max_failures;
+
+        bool canceled;
+        size_t wave_end; /* Index after the last node of the current wave */
+        size_t n_started;
+        size_t n_in_flight;
+        size_t n_failed;
+        sd_event_source *advance_source;
+
+        size_t n_nodes;
+        RolloutNode nodes[0];
+};
+
+/* Selects all nodes if node_pattern is empty or "*", otherwise the nodes whose name matches the glob */
+Rollout *rollout_new(
+                Controller *controller,
+                const char *node_pattern,
+                const char *unit,
+                const char *mode,
+                const char *method,
+                uint32_t parallelism,
+                uint32_t batch_size,
+                uint32_t max_failures);
+Rollout *rollout_ref(Rollout *rollout);
+void rollout_unref(Rollout *rollout);
+
+/* Creates and adds the aggregate job of type job_type and starts the first wave */
+int rollout_start(Rollout *rollout, const char *job_type);
+void rollout_cancel(Rollout *rollout);
+
+/* Called when a job of the rollout finished with result, or got lost with its node */
+void rollout_job_finished(Rollout *rollout, Job *job, const char *result);
+
+int rollout_append_children(Rollout *rollout, sd_bus_message *reply);
+
+DEFINE_CLEANUP_FUNC(Rollout, rollout_unref)
+#define _cleanup_rollout_ _cleanup_(rollout_unrefp)
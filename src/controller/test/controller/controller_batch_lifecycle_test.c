@@ -0,0 +1,347 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+
+#include "controller/controller.h"
+#include "controller/job.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define MISSING_UNIT "missing.service"
+#define MISSING_UNIT_ERROR "Unit missing.service not found."
+
+/* Calls of the lifecycle methods received by the fake agent */
+static int n_agent_calls = 0;
+static int n_agent_units = 0;
+static bool agent_call_valid = true;
+
+typedef struct CallResult {
+        bool done;
+        char *error_name;
+        sd_bus_message *reply;
+} CallResult;
+
+/* Job signals received by the API client */
+static int n_job_new = 0;
+static int n_job_removed = 0;
+static sd_bus_message *job_group_removed = NULL;
+
+/* Fails the jobs of MISSING_UNIT and queues all others */
+static int test_on_agent_message(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (!is_agent_call(m)) {
+                return 0;
+        }
+        n_agent_calls++;
+        if (!sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "StartUnits")) {
+                agent_call_valid = false;
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Unexpected call");
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        int r = sd_bus_message_new_method_return(m, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "(su)");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "s");
+        }
+        uint32_t last_job_id = 0;
+        while (r >= 0) {
+                const char *unit = NULL;
+                uint32_t job_id = 0;
+                r = sd_bus_message_read(m, "(su)", &unit, &job_id);
+                if (r <= 0) {
+                        break;
+                }
+                if (job_id == last_job_id) {
+                        agent_call_valid = false;
+                }
+                last_job_id = job_id;
+                n_agent_units++;
+                r = sd_bus_message_append(reply, "s", streq(unit, MISSING_UNIT) ? MISSING_UNIT_ERROR : "");
+        }
+        const char *mode = NULL;
+        if (r >= 0) {
+                r = sd_bus_message_exit_container(m);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_read(m, "s", &mode);
+        }
+        if (r >= 0 && !streq(mode, "replace")) {
+                agent_call_valid = false;
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(reply);
+        }
+        if (r < 0) {
+                agent_call_valid = false;
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Invalid call");
+        }
+        (void) sd_bus_message_send(reply);
+        return 1;
+}
+
+static int test_on_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        CallResult *result = userdata;
+        result->done = true;
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                result->error_name = strdup(sd_bus_message_get_error(m)->name);
+        } else {
+                result->reply = sd_bus_message_ref(m);
+        }
+        return 0;
+}
+
+static int test_on_job_signal(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (sd_bus_message_is_signal(m, CONTROLLER_INTERFACE, "JobNew")) {
+                n_job_new++;
+        } else if (sd_bus_message_is_signal(m, CONTROLLER_INTERFACE, "JobRemoved")) {
+                n_job_removed++;
+        } else if (sd_bus_message_is_signal(m, CONTROLLER_INTERFACE, "JobGroupRemoved")) {
+                sd_bus_message_unrefp(&job_group_removed);
+                job_group_removed = sd_bus_message_ref(m);
+        }
+        return 0;
+}
+
+bool test_node_start_units() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL) {
+                fprintf(stderr, "FAILED: could not create controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        Node *node = controller_add_node(controller, "node-0");
+        if (client == NULL || node == NULL || !node_export(node)) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        CallResult result = { 0 };
+        int r = sd_bus_call_method_async(
+                        client,
+                        NULL,
+                        BC_DBUS_NAME,
+                        node->object_path,
+                        NODE_INTERFACE,
+                        "StartUnits",
+                        test_on_reply,
+                        &result,
+                        "ass",
+                        3,
+                        "a.service",
+                        MISSING_UNIT,
+                        "b.service",
+                        "replace");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call StartUnits: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+
+        bool ok = true;
+        if (n_agent_calls != 1 || n_agent_units != 3 || !agent_call_valid) {
+                fprintf(stderr,
+                        "FAILED: expected one valid call to the agent for 3 units, got %d calls for %d units\n",
+                        n_agent_calls,
+                        n_agent_units);
+                ok = false;
+        }
+        if (ok && (!result.done || result.reply == NULL)) {
+                fprintf(stderr,
+                        "FAILED: expected StartUnits to succeed, got %s\n",
+                        result.error_name != NULL ? result.error_name : "no reply");
+                ok = false;
+        }
+
+        const char *expected_errors[] = { "", MISSING_UNIT_ERROR, "" };
+        if (ok) {
+                r = sd_bus_message_enter_container(result.reply, SD_BUS_TYPE_ARRAY, "(os)");
+        }
+        for (int i = 0; ok && i < 3; i++) {
+                const char *job_path = NULL;
+                const char *job_error = NULL;
+                r = sd_bus_message_read(result.reply, "(os)", &job_path, &job_error);
+                if (r <= 0 || !streq(job_error, expected_errors[i])) {
+                        fprintf(stderr, "FAILED: unexpected result for unit %d\n", i);
+                        ok = false;
+                        break;
+                }
+
+                /* Only queued jobs are known to the controller */
+                Job *job = NULL;
+                LIST_FOREACH(jobs, job, controller->jobs) {
+                        if (streq(job->object_path, job_path)) {
+                                break;
+                        }
+                }
+                if ((job == NULL) != (i == 1)) {
+                        fprintf(stderr, "FAILED: unexpected job %s for unit %d\n", job_path, i);
+                        ok = false;
+                }
+        }
+        size_t n_jobs = 0;
+        Job *job = NULL;
+        LIST_FOREACH(jobs, job, controller->jobs) {
+                n_jobs++;
+        }
+        if (ok && n_jobs != 2) {
+                fprintf(stderr, "FAILED: expected 2 jobs\n");
+                ok = false;
+        }
+
+        /* The agent reports the jobs as done */
+        Job *next_job = NULL;
+        LIST_FOREACH_SAFE(jobs, job, next_job, controller->jobs) {
+                controller_finish_job(controller, job->id, "done");
+        }
+
+        sd_bus_message_unrefp(&result.reply);
+        free(result.error_name);
+        return ok;
+}
+
+/* A group without per-job objects reports all results in one signal */
+bool test_node_start_unit_group() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL) {
+                fprintf(stderr, "FAILED: could not create controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        Node *node = controller_add_node(controller, "node-0");
+        if (client == NULL || node == NULL || !node_export(node)) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+        n_agent_calls = 0;
+        n_agent_units = 0;
+
+        CallResult result = { 0 };
+        int r = sd_bus_match_signal(
+                        client,
+                        NULL,
+                        NULL,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        NULL,
+                        test_on_job_signal,
+                        NULL);
+        if (r >= 0) {
+                r = sd_bus_call_method_async(
+                                client,
+                                NULL,
+                                BC_DBUS_NAME,
+                                node->object_path,
+                                NODE_INTERFACE,
+                                "StartUnitGroup",
+                                test_on_reply,
+                                &result,
+                                "assb",
+                                3,
+                                "a.service",
+                                MISSING_UNIT,
+                                "b.service",
+                                "replace",
+                                false);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call StartUnitGroup: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+
+        bool ok = true;
+        const char *group_path = NULL;
+        if (n_agent_calls != 1 || n_agent_units != 3 || !agent_call_valid) {
+                fprintf(stderr, "FAILED: expected one valid call to the agent for 3 units\n");
+                ok = false;
+        }
+        if (ok && (!result.done || result.reply == NULL || sd_bus_message_read(result.reply, "o", &group_path) <= 0)) {
+                fprintf(stderr,
+                        "FAILED: expected StartUnitGroup to succeed, got %s\n",
+                        result.error_name != NULL ? result.error_name : "no reply");
+                ok = false;
+        }
+
+        /* The queued jobs are tracked, but not exported */
+        size_t n_jobs = 0;
+        Job *job = NULL;
+        LIST_FOREACH(jobs, job, controller->jobs) {
+                n_jobs++;
+                if (job->export_slot != NULL) {
+                        ok = false;
+                }
+        }
+        if (ok && (n_jobs != 2 || n_job_new != 0 || job_group_removed != NULL)) {
+                fprintf(stderr, "FAILED: expected 2 unexported jobs and no signals yet\n");
+                ok = false;
+        }
+
+        Job *next_job = NULL;
+        LIST_FOREACH_SAFE(jobs, job, next_job, controller->jobs) {
+                controller_finish_job(controller, job->id, "done");
+        }
+        dispatch_all(controller);
+
+        if (ok && (n_job_removed != 0 || job_group_removed == NULL)) {
+                fprintf(stderr, "FAILED: expected only a JobGroupRemoved signal\n");
+                ok = false;
+        }
+
+        const char *expected_units[] = { "a.service", MISSING_UNIT, "b.service" };
+        const char *expected_results[] = { "done", "failed", "done" };
+        const char *path = NULL;
+        if (ok) {
+                r = sd_bus_message_read(job_group_removed, "uoss", NULL, &path, NULL, NULL);
+                if (r >= 0) {
+                        r = sd_bus_message_enter_container(job_group_removed, SD_BUS_TYPE_ARRAY, "(sus)");
+                }
+                if (r < 0 || !streq(path, group_path)) {
+                        fprintf(stderr, "FAILED: unexpected JobGroupRemoved signal\n");
+                        ok = false;
+                }
+        }
+        for (int i = 0; ok && i < 3; i++) {
+                const char *unit = NULL;
+                const char *job_result = NULL;
+                r = sd_bus_message_read(job_group_removed, "(sus)", &unit, NULL, &job_result);
+                if (r <= 0 || !streq(unit, expected_units[i]) || !streq(job_result, expected_results[i])) {
+                        fprintf(stderr, "FAILED: unexpected result for unit %d\n", i);
+                        ok = false;
+                }
+        }
+
+        sd_bus_message_unrefp(&job_group_removed);
+        sd_bus_message_unrefp(&result.reply);
+        free(result.error_name);
+        return ok;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_node_start_units();
+        result = result && test_node_start_unit_group();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_EVENTS 100000
+#define EVENT_BATCH_SIZE 64
+
+/* Events received by the subscription, in order of arrival */
+static char received[256] = "";
+static long n_received = 0;
+
+static void record_event(const char *event) {
+        n_received++;
+        if (strlen(received) + strlen(event) + 2 < sizeof(received)) {
+                strcat(received, event);
+                strcat(received, ";");
+        }
+}
+
+static int test_on_unit_new(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, const char *reason) {
+        record_event(reason);
+        return 0;
+}
+
+static int test_on_unit_removed(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, UNUSED const char *reason) {
+        record_event("removed");
+        return 0;
+}
+
+static int test_on_unit_property_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *interface,
+                sd_bus_message *m) {
+        const char *property = NULL;
+        const char *value = NULL;
+        int r = sd_bus_message_skip(m, "ss");
+        if (r >= 0) {
+                r = sd_bus_message_read(m, "a{sv}", 1, &property, "s", &value);
+        }
+        record_event(r >= 0 ? value : "invalid");
+        return 0;
+}
+
+static int test_on_unit_state_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *active_state,
+                const char *substate,
+                UNUSED const char *reason) {
+        record_event(substate);
+        return 0;
+}
+
+Subscription *add_subscription(Controller *controller, const char *unit) {
+        _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+        if (sub == NULL || !subscription_add_unit(sub, unit)) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return NULL;
+        }
+        sub->handle_unit_new = test_on_unit_new;
+        sub->handle_unit_removed = test_on_unit_removed;
+        sub->handle_unit_state_changed = test_on_unit_state_changed;
+        sub->handle_unit_property_changed = test_on_unit_property_changed;
+
+        controller_add_subscription(controller, sub);
+        return steal_pointer(&sub);
+}
+
+int append_state_changed(sd_bus_message *batch, const char *substate) {
+        return append_entry(
+                        batch,
+                        "UnitStateChanged",
+                        "(ssss)",
+                        "ssss",
+                        "foo.service",
+                        "active",
+                        substate,
+                        "real");
+}
+
+bool wait_for_events(Controller *controller, long n_expected) {
+        while (n_received < n_expected) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: received %ld of %ld events\n", n_received, n_expected);
+                        return false;
+                }
+        }
+        if (n_received != n_expected) {
+                fprintf(stderr, "FAILED: received %ld events, expected %ld\n", n_received, n_expected);
+                return false;
+        }
+        return true;
+}
+
+bool test_controller_event_batch_dispatch() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, NULL, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+        _cleanup_subscription_ Subscription *sub = add_subscription(controller, "foo.service");
+        if (sub == NULL) {
+                return false;
+        }
+
+        /* Unknown events are skipped, all others are dispatched in order */
+        _cleanup_sd_bus_message_ sd_bus_message *batch = new_event_batch(agent_bus);
+        if (batch == NULL) {
+                return false;
+        }
+        int r = append_entry(batch, "UnitNew", "(ss)", "ss", "foo.service", "real");
+        if (r >= 0) {
+                r = append_entry(batch, "FutureEvent", "(uas)", "uas", 42, 2, "a", "b");
+        }
+        if (r >= 0) {
+                r = append_entry(
+                                batch,
+                                "UnitPropertiesChanged",
+                                "(ssa{sv})",
+                                "ssa{sv}",
+                                "foo.service",
+                                "org.freedesktop.systemd1.Unit",
+                                1,
+                                "SubState",
+                                "s",
+                                "start");
+        }
+        if (r >= 0) {
+                r = append_state_changed(batch, "running");
+        }
+        if (r >= 0) {
+                r = append_entry(batch, "UnitRemoved", "(s)", "s", "foo.service");
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not append events: %s\n", strerror(-r));
+                return false;
+        }
+        if (send_event_batch(agent_bus, batch) < 0 || !wait_for_events(controller, 4)) {
+                controller_remove_subscription(controller, sub);
+                return false;
+        }
+        controller_remove_subscription(controller, sub);
+
+        if (!streq(received, "real;start;running;removed;")) {
+                fprintf(stderr, "FAILED: unexpected events '%s'\n", received);
+                return false;
+        }
+        return true;
+}
+
+bool test_controller_event_batch_throughput() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, NULL, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+        _cleanup_subscription_ Subscription *sub = add_subscription(controller, "foo.service");
+        if (sub == NULL) {
+                return false;
+        }
+
+        bool result = false;
+        n_received = 0;
+        uint64_t start = get_time_micros_monotonic();
+        for (int i = 0; i < NUMBER_OF_EVENTS; i++) {
+                int r = sd_bus_emit_signal(
+                                agent_bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitStateChanged",
+                                "ssss",
+                                "foo.service",
+                                "active",
+                                "running",
+                                "real");
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not emit signal: %s\n", strerror(-r));
+                        goto out;
+                }
+                if ((i + 1) % EVENT_BATCH_SIZE == 0 && !wait_for_events(controller, i + 1)) {
+                        goto out;
+                }
+        }
+        if (!wait_for_events(controller, NUMBER_OF_EVENTS)) {
+                goto out;
+        }
+        uint64_t single_elapsed = get_time_micros_monotonic() - start;
+
+        n_received = 0;
+        start = get_time_micros_monotonic();
+        for (int i = 0; i < NUMBER_OF_EVENTS; i += EVENT_BATCH_SIZE) {
+                _cleanup_sd_bus_message_ sd_bus_message *batch = new_event_batch(agent_bus);
+                if (batch == NULL) {
+                        goto out;
+                }
+                int n_events = 0;
+                for (; n_events < EVENT_BATCH_SIZE && i + n_events < NUMBER_OF_EVENTS; n_events++) {
+                        int r = append_state_changed(batch, "running");
+                        if (r < 0) {
+                                fprintf(stderr, "FAILED: could not append event: %s\n", strerror(-r));
+                                goto out;
+                        }
+                }
+                if (send_event_batch(agent_bus, batch) < 0 || !wait_for_events(controller, i + n_events)) {
+                        goto out;
+                }
+        }
+        uint64_t batched_elapsed = get_time_micros_monotonic() - start;
+
+        fprintf(stdout,
+                "%d state changes: single signals %" PRIu64 "ms, batches of %d %" PRIu64 "ms\n",
+                NUMBER_OF_EVENTS,
+                single_elapsed / USEC_PER_MSEC,
+                EVENT_BATCH_SIZE,
+                batched_elapsed / USEC_PER_MSEC);
+        result = true;
+
+out:
+        controller_remove_subscription(controller, sub);
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_event_batch_dispatch();
+        result = result && test_controller_event_batch_throughput();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
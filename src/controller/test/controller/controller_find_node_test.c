@@ -0,0 +1,112 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/utils.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+
+#include "controller/controller.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+static bool add_nodes(Controller *controller, int number_of_nodes) {
+        for (int i = 0; i < number_of_nodes; i++) {
+                _cleanup_free_ char *name = NULL;
+                if (asprintf(&name, "node-%d", i) < 0) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return false;
+                }
+                if (controller_add_node(controller, name) == NULL) {
+                        fprintf(stderr, "FAILED: could not add node '%s'\n", name);
+                        return false;
+                }
+        }
+        return true;
+}
+
+bool test_controller_find_node(int number_of_nodes) {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (!add_nodes(controller, number_of_nodes)) {
+                return false;
+        }
+
+        for (int i = 0; i < number_of_nodes; i++) {
+                _cleanup_free_ char *name = NULL;
+                _cleanup_free_ char *path = NULL;
+                if (asprintf(&name, "node-%d", i) < 0 ||
+                    assemble_object_path_string(NODE_OBJECT_PATH_PREFIX, name, &path) < 0) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return false;
+                }
+
+                Node *by_name = controller_find_node(controller, name);
+                if (by_name == NULL || !streq(by_name->name, name)) {
+                        fprintf(stderr, "FAILED: expected to find node '%s' by name\n", name);
+                        return false;
+                }
+                Node *by_path = controller_find_node_by_path(controller, path);
+                if (by_path != by_name) {
+                        fprintf(stderr, "FAILED: expected to find node '%s' by path '%s'\n", name, path);
+                        return false;
+                }
+        }
+
+        if (controller_find_node(controller, "unknown") != NULL) {
+                fprintf(stderr, "FAILED: found node with unknown name\n");
+                return false;
+        }
+        if (controller_find_node_by_path(controller, NODE_OBJECT_PATH_PREFIX "/unknown") != NULL) {
+                fprintf(stderr, "FAILED: found node with unknown path\n");
+                return false;
+        }
+
+        return true;
+}
+
+bool test_controller_remove_node() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (!add_nodes(controller, 3)) {
+                return false;
+        }
+
+        Node *node = controller_find_node(controller, "node-1");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: expected to find node 'node-1'\n");
+                return false;
+        }
+        controller_remove_node(controller, node);
+
+        if (controller_find_node(controller, "node-1") != NULL ||
+            controller_find_node_by_path(controller, NODE_OBJECT_PATH_PREFIX "/node_2d1") != NULL) {
+                fprintf(stderr, "FAILED: found removed node 'node-1'\n");
+                return false;
+        }
+        if (controller_find_node(controller, "node-0") == NULL || controller_find_node(controller, "node-2") == NULL) {
+                fprintf(stderr, "FAILED: expected remaining nodes to be found\n");
+                return false;
+        }
+        if (controller->number_of_nodes != 2) {
+                fprintf(stderr, "FAILED: expected 2 nodes, but got %d\n", controller->number_of_nodes);
+                return false;
+        }
+
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_find_node(10);
+        result = result && test_controller_find_node(100);
+        result = result && test_controller_remove_node();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define HEARTBEAT_INTERVAL_MSEC 50
+#define HEARTBEAT_THRESHOLD_MSEC 175
+#define TEST_DURATION_MSEC 600
+
+typedef struct FakeAgent {
+        sd_bus *bus;
+        bool answer_heartbeats;
+        int n_heartbeats;
+} FakeAgent;
+
+static int fake_agent_filter(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        FakeAgent *agent = userdata;
+
+        if (!sd_bus_message_is_signal(m, INTERNAL_CONTROLLER_INTERFACE, "Heartbeat")) {
+                return 0;
+        }
+
+        agent->n_heartbeats++;
+        if (agent->answer_heartbeats) {
+                int r = sd_bus_emit_signal(
+                                agent->bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                AGENT_HEARTBEAT_SIGNAL_NAME,
+                                "");
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not emit heartbeat: %s\n", strerror(-r));
+                }
+        }
+        return 0;
+}
+
+/* Connects a fake agent to an anonymous node and registers it as the given node */
+bool register_fake_agent(Controller *controller, const char *name, FakeAgent *agent) {
+        Node *anonymous_node = controller_add_node(controller, NULL);
+        if (anonymous_node == NULL) {
+                fprintf(stderr, "FAILED: could not add anonymous node\n");
+                return false;
+        }
+        agent->bus = connect_fake_agent(controller, anonymous_node, fake_agent_filter, agent);
+        if (agent->bus == NULL) {
+                return false;
+        }
+
+        int r = sd_bus_call_method_async(
+                        agent->bus,
+                        NULL,
+                        BC_DBUS_NAME,
+                        INTERNAL_CONTROLLER_OBJECT_PATH,
+                        INTERNAL_CONTROLLER_INTERFACE,
+                        "Register",
+                        NULL,
+                        NULL,
+                        "s",
+                        name);
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not register fake agent: %s\n", strerror(-r));
+                return false;
+        }
+
+        return true;
+}
+
+bool test_controller_heartbeat_per_node() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        controller->heartbeat_interval_msec = HEARTBEAT_INTERVAL_MSEC;
+        controller->heartbeat_threshold_msec = HEARTBEAT_THRESHOLD_MSEC;
+        Node *alive = controller_add_node(controller, "node-alive");
+        Node *chatty = controller_add_node(controller, "node-chatty");
+        Node *silent = controller_add_node(controller, "node-silent");
+        if (alive == NULL || chatty == NULL || silent == NULL) {
+                fprintf(stderr, "FAILED: could not add nodes\n");
+                return false;
+        }
+
+        FakeAgent alive_agent = { NULL, true, 0 };
+        FakeAgent chatty_agent = { NULL, false, 0 };
+        FakeAgent silent_agent = { NULL, false, 0 };
+        bool result = false;
+        if (!register_fake_agent(controller, "node-alive", &alive_agent) ||
+            !register_fake_agent(controller, "node-chatty", &chatty_agent) ||
+            !register_fake_agent(controller, "node-silent", &silent_agent)) {
+                goto out;
+        }
+
+        uint64_t start = get_time_micros_monotonic();
+        while (get_time_micros_monotonic() - start < TEST_DURATION_MSEC * USEC_PER_MSEC) {
+                /* Never sends a heartbeat, but any other traffic proves it is alive */
+                int r = 0;
+                if (node_is_online(chatty)) {
+                        r = sd_bus_emit_signal(
+                                        chatty_agent.bus,
+                                        INTERNAL_AGENT_OBJECT_PATH,
+                                        INTERNAL_AGENT_INTERFACE,
+                                        "UnitRemoved",
+                                        "s",
+                                        "foo.service");
+                }
+                if (r >= 0) {
+                        r = sd_event_run(controller->event, 10 * USEC_PER_MSEC);
+                }
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: event loop failed: %s\n", strerror(-r));
+                        goto out;
+                }
+        }
+
+        if (!node_is_online(alive) || alive->heartbeat_timer_source == NULL) {
+                fprintf(stderr, "FAILED: expected node answering heartbeats to stay online\n");
+                goto out;
+        }
+        if (!node_is_online(chatty)) {
+                fprintf(stderr, "FAILED: expected node sending other messages to stay online\n");
+                goto out;
+        }
+        if (node_is_online(silent) || silent->heartbeat_timer_source != NULL) {
+                fprintf(stderr, "FAILED: expected silent node to be disconnected\n");
+                goto out;
+        }
+
+        /* Each node got heartbeats of its own timer, the silent one only until it was disconnected */
+        int expected_min = TEST_DURATION_MSEC / HEARTBEAT_INTERVAL_MSEC - 2;
+        if (alive_agent.n_heartbeats < expected_min) {
+                fprintf(stderr,
+                        "FAILED: expected at least %d heartbeats, got %d\n",
+                        expected_min,
+                        alive_agent.n_heartbeats);
+                goto out;
+        }
+        if (silent_agent.n_heartbeats > HEARTBEAT_THRESHOLD_MSEC / HEARTBEAT_INTERVAL_MSEC + 1) {
+                fprintf(stderr, "FAILED: silent node got %d heartbeats after timing out\n", silent_agent.n_heartbeats);
+                goto out;
+        }
+        result = true;
+
+out:
+        sd_bus_unrefp(&alive_agent.bus);
+        sd_bus_unrefp(&chatty_agent.bus);
+        sd_bus_unrefp(&silent_agent.bus);
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_heartbeat_per_node();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
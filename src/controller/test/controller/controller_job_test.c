@@ -0,0 +1,157 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+
+#include "controller/controller.h"
+#include "controller/job.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_JOBS 10
+
+bool test_controller_jobs_by_id() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        /* Signals for the jobs are queued on the api bus, the client never reads them */
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        if (client == NULL) {
+                return false;
+        }
+
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        uint32_t *job_ids = malloc0_array(0, sizeof(uint32_t), NUMBER_OF_JOBS);
+        if (job_ids == NULL) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return false;
+        }
+
+        bool result = false;
+        for (int i = 0; i < NUMBER_OF_JOBS; i++) {
+                _cleanup_job_ Job *job = job_new(node, "test.service", "start");
+                if (job == NULL || !controller_add_job(controller, job)) {
+                        fprintf(stderr, "FAILED: could not add job %d\n", i);
+                        goto out;
+                }
+                job_ids[i] = job->id;
+        }
+
+        /* JobStateChanged as emitted by the agent, in reverse order of creation */
+        for (int i = NUMBER_OF_JOBS - 1; i >= 0; i--) {
+                controller_job_state_changed(controller, job_ids[i], "running");
+                Job *job = controller_find_job(controller, job_ids[i]);
+                if (job == NULL || job->state != JOB_RUNNING) {
+                        fprintf(stderr, "FAILED: expected job %u to be running\n", job_ids[i]);
+                        goto out;
+                }
+        }
+
+        /* JobDone as emitted by the agent, interleaving both ends of the list */
+        for (int i = 0; i < NUMBER_OF_JOBS / 2; i++) {
+                controller_finish_job(controller, job_ids[i], "done");
+                controller_finish_job(controller, job_ids[NUMBER_OF_JOBS - 1 - i], "done");
+        }
+
+        for (int i = 0; i < NUMBER_OF_JOBS; i++) {
+                if (controller_find_job(controller, job_ids[i]) != NULL) {
+                        fprintf(stderr, "FAILED: found finished job %u\n", job_ids[i]);
+                        goto out;
+                }
+        }
+        if (!LIST_IS_EMPTY(controller->jobs)) {
+                fprintf(stderr, "FAILED: expected all jobs to be removed\n");
+                goto out;
+        }
+
+        /* Unknown job ids are ignored */
+        controller_job_state_changed(controller, job_ids[0], "running");
+        controller_finish_job(controller, job_ids[0], "done");
+
+        result = true;
+
+out:
+        free(job_ids);
+        controller_stop(controller);
+        return result;
+}
+
+bool check_jobs_order(Controller *controller, const char *step, Job *expected[], int n_expected) {
+        int i = 0;
+        Job *job = NULL;
+        LIST_FOREACH(jobs, job, controller->jobs) {
+                if (i >= n_expected || job != expected[i]) {
+                        fprintf(stderr, "FAILED: %s: unexpected job at position %d\n", step, i);
+                        return false;
+                }
+                i++;
+        }
+        if (i != n_expected) {
+                fprintf(stderr, "FAILED: %s: expected %d jobs, got %d\n", step, n_expected, i);
+                return false;
+        }
+        return true;
+}
+
+/* Jobs are kept in the order they were added, so they are cancelled in that order on shutdown */
+bool test_controller_jobs_order() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        if (client == NULL) {
+                return false;
+        }
+
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        Job *jobs[4] = { NULL };
+        for (int i = 0; i < 4; i++) {
+                _cleanup_job_ Job *job = job_new(node, "test.service", "start");
+                if (job == NULL || !controller_add_job(controller, job)) {
+                        fprintf(stderr, "FAILED: could not add job %d\n", i);
+                        return false;
+                }
+                jobs[i] = job;
+        }
+
+        bool result = check_jobs_order(controller, "added", jobs, 4);
+
+        /* Jobs added after the last one was removed still go to the end */
+        controller_finish_job(controller, jobs[3]->id, "done");
+        controller_finish_job(controller, jobs[0]->id, "done");
+        result = result && check_jobs_order(controller, "removed", (Job *[]) { jobs[1], jobs[2] }, 2);
+
+        _cleanup_job_ Job *job = job_new(node, "test.service", "stop");
+        if (job == NULL || !controller_add_job(controller, job)) {
+                fprintf(stderr, "FAILED: could not add job\n");
+                return false;
+        }
+        result = result && check_jobs_order(controller, "added again", (Job *[]) { jobs[1], jobs[2], job }, 3);
+
+        controller_stop(controller);
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_jobs_by_id();
+        result = result && test_controller_jobs_order();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_MONITORS 100
+#define NUMBER_OF_PEERS 100
+#define NUMBER_OF_EVENTS 5
+#define NUMBER_OF_SIGNALS ((long) NUMBER_OF_EVENTS * NUMBER_OF_MONITORS * (NUMBER_OF_PEERS + 1))
+
+static Monitor *monitors[NUMBER_OF_MONITORS];
+static long n_received = 0;
+
+static int benchmark_on_monitor_signal(
+                sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (sd_bus_message_is_signal(m, MONITOR_INTERFACE, "UnitPropertiesChanged")) {
+                n_received++;
+        }
+        return 0;
+}
+
+static bool add_monitors(Controller *controller) {
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                Monitor *monitor = monitor_new(controller, ":1.1");
+                if (monitor == NULL) {
+                        fprintf(stderr, "FAILED: could not create monitor\n");
+                        return false;
+                }
+                monitors[i] = monitor;
+
+                for (int j = 0; j < NUMBER_OF_PEERS; j++) {
+                        MonitorPeer *peer = malloc0(sizeof(MonitorPeer));
+                        if (peer == NULL || asprintf(&peer->name, ":1.%d", j + 2) < 0) {
+                                free(peer);
+                                fprintf(stderr, "FAILED: out of memory\n");
+                                return false;
+                        }
+                        peer->id = j;
+                        LIST_PREPEND(peers, monitor->peers, peer);
+                }
+        }
+        return true;
+}
+
+static void close_monitors(Controller *controller) {
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                if (monitors[i] == NULL) {
+                        continue;
+                }
+                monitor_close(monitors[i]);
+                monitor_unref(monitors[i]);
+                monitors[i] = NULL;
+
+                /* Closing a monitor notifies all peers */
+                dispatch_all(controller);
+        }
+}
+
+static bool wait_for_signals(Controller *controller, long n_expected) {
+        while (n_received < n_expected) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: received %ld of %ld signals\n", n_received, n_expected);
+                        return false;
+                }
+        }
+        return true;
+}
+
+static sd_bus_message *create_agent_properties_changed(sd_bus *bus) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_signal(
+                        bus, &m, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, "UnitPropertiesChanged");
+        if (r >= 0) {
+                r = sd_bus_message_append(
+                                m,
+                                "ssa{sv}",
+                                "foo.service",
+                                "org.freedesktop.systemd1.Unit",
+                                1,
+                                "SubState",
+                                "s",
+                                "running");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(m, 1, 0);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not create properties changed message: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&m);
+}
+
+/* Emits the events the way the controller does, assembling the signal for each destination */
+static bool emit_assembled(Controller *controller, sd_bus_message *m) {
+        for (int i = 0; i < NUMBER_OF_EVENTS; i++) {
+                for (int j = 0; j < NUMBER_OF_MONITORS; j++) {
+                        monitor_on_unit_property_changed(
+                                        monitors[j], "node-0", "foo.service", "org.freedesktop.systemd1.Unit", m);
+                }
+                if (!wait_for_signals(controller, n_received + NUMBER_OF_SIGNALS / NUMBER_OF_EVENTS)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static int send_copy(Controller *controller, Monitor *monitor, sd_bus_message *template, const char *destination) {
+        _cleanup_sd_bus_message_ sd_bus_message *sig = NULL;
+        int r = sd_bus_message_new_signal(
+                        controller->api_bus, &sig, monitor->object_path, MONITOR_INTERFACE, "UnitPropertiesChanged");
+        if (r >= 0) {
+                r = sd_bus_message_rewind(template, true);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_copy(sig, template, true);
+        }
+        if (r >= 0) {
+                r = sd_bus_send_to(controller->api_bus, sig, destination, NULL);
+        }
+        return r;
+}
+
+/* Emits the events by copying a signal body that is marshalled once per event */
+static bool emit_copied(Controller *controller, sd_bus_message *m) {
+        for (int i = 0; i < NUMBER_OF_EVENTS; i++) {
+                _cleanup_sd_bus_message_ sd_bus_message *template = NULL;
+                int r = sd_bus_message_new_signal(
+                                controller->api_bus,
+                                &template,
+                                monitors[0]->object_path,
+                                MONITOR_INTERFACE,
+                                "UnitPropertiesChanged");
+                if (r >= 0) {
+                        r = sd_bus_message_append(
+                                        template, "sss", "node-0", "foo.service", "org.freedesktop.systemd1.Unit");
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_rewind(m, true);
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_skip(m, "ss");
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_copy(template, m, false);
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_seal(template, 1, 0);
+                }
+
+                for (int j = 0; j < NUMBER_OF_MONITORS && r >= 0; j++) {
+                        r = send_copy(controller, monitors[j], template, monitors[j]->owner);
+                        MonitorPeer *peer = NULL;
+                        LIST_FOREACH(peers, peer, monitors[j]->peers) {
+                                if (r >= 0) {
+                                        r = send_copy(controller, monitors[j], template, peer->name);
+                                }
+                        }
+                }
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not send copied signal: %s\n", strerror(-r));
+                        return false;
+                }
+                if (!wait_for_signals(controller, n_received + NUMBER_OF_SIGNALS / NUMBER_OF_EVENTS)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/*
+ * Compares assembling each monitor signal for its destination, as the controller does,
+ * with marshalling the body once and copying it into the signal for each destination.
+ * Both include the time until the client received all signals.
+ */
+bool benchmark_controller_monitor_broadcast() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        _cleanup_sd_bus_ sd_bus *client_bus = connect_api_client(controller, benchmark_on_monitor_signal);
+        if (client_bus == NULL) {
+                return false;
+        }
+        _cleanup_sd_bus_message_ sd_bus_message *m = create_agent_properties_changed(client_bus);
+        if (m == NULL) {
+                return false;
+        }
+        bool result = false;
+        if (!add_monitors(controller)) {
+                goto out;
+        }
+
+        uint64_t start = get_time_micros_monotonic();
+        if (!emit_assembled(controller, m)) {
+                goto out;
+        }
+        uint64_t assembled_elapsed = get_time_micros_monotonic() - start;
+
+        start = get_time_micros_monotonic();
+        if (!emit_copied(controller, m)) {
+                goto out;
+        }
+        uint64_t copied_elapsed = get_time_micros_monotonic() - start;
+
+        fprintf(stdout,
+                "%ld signals to %d monitors with %d peers: assembled %.2fus, copied %.2fus per signal\n",
+                NUMBER_OF_SIGNALS,
+                NUMBER_OF_MONITORS,
+                NUMBER_OF_PEERS,
+                (double) assembled_elapsed / NUMBER_OF_SIGNALS,
+                (double) copied_elapsed / NUMBER_OF_SIGNALS);
+        result = true;
+
+out:
+        close_monitors(controller);
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && benchmark_controller_monitor_broadcast();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
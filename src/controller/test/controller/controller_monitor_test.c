@@ -0,0 +1,186 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_MONITORS 3
+#define NUMBER_OF_PEERS 2
+#define NUMBER_OF_EVENTS 2
+#define NUMBER_OF_DESTINATIONS (NUMBER_OF_MONITORS * (NUMBER_OF_PEERS + 1))
+
+static Monitor *monitors[NUMBER_OF_MONITORS];
+static long n_state_changed = 0;
+static long n_properties_changed = 0;
+static long n_invalid = 0;
+
+static bool check_properties(sd_bus_message *m) {
+        const char *node = NULL;
+        const char *unit = NULL;
+        const char *interface = NULL;
+        const char *property = NULL;
+        const char *value = NULL;
+        int r = sd_bus_message_read(m, "sss", &node, &unit, &interface);
+        if (r >= 0) {
+                r = sd_bus_message_read(m, "a{sv}", 1, &property, "s", &value);
+        }
+        return r >= 0 && streq(node, "node-0") && streq(unit, "foo.service") && streq(property, "SubState") &&
+               streq(value, "running");
+}
+
+static int test_on_monitor_signal(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (sd_bus_message_is_signal(m, MONITOR_INTERFACE, "UnitStateChanged")) {
+                n_state_changed++;
+        } else if (sd_bus_message_is_signal(m, MONITOR_INTERFACE, "UnitPropertiesChanged")) {
+                n_properties_changed++;
+                if (!check_properties(m)) {
+                        n_invalid++;
+                }
+        }
+        return 0;
+}
+
+static bool add_monitors(Controller *controller) {
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                Monitor *monitor = monitor_new(controller, ":1.1");
+                if (monitor == NULL) {
+                        fprintf(stderr, "FAILED: could not create monitor\n");
+                        return false;
+                }
+                monitors[i] = monitor;
+
+                for (int j = 0; j < NUMBER_OF_PEERS; j++) {
+                        MonitorPeer *peer = malloc0(sizeof(MonitorPeer));
+                        if (peer == NULL || asprintf(&peer->name, ":1.%d", j + 2) < 0) {
+                                free(peer);
+                                fprintf(stderr, "FAILED: out of memory\n");
+                                return false;
+                        }
+                        peer->id = j;
+                        LIST_PREPEND(peers, monitor->peers, peer);
+                }
+        }
+        return true;
+}
+
+static void close_monitors(Controller *controller) {
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                if (monitors[i] == NULL) {
+                        continue;
+                }
+                monitor_close(monitors[i]);
+                monitor_unref(monitors[i]);
+                monitors[i] = NULL;
+
+                /* Closing a monitor notifies all peers */
+                dispatch_all(controller);
+        }
+}
+
+static bool wait_for_signals(Controller *controller, long *n_signals, long n_expected) {
+        while (*n_signals < n_expected) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: received %ld of %ld signals\n", *n_signals, n_expected);
+                        return false;
+                }
+        }
+        if (*n_signals != n_expected) {
+                fprintf(stderr, "FAILED: received %ld signals, expected %ld\n", *n_signals, n_expected);
+                return false;
+        }
+        return true;
+}
+
+static sd_bus_message *create_agent_properties_changed(sd_bus *bus) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_signal(
+                        bus, &m, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, "UnitPropertiesChanged");
+        if (r >= 0) {
+                r = sd_bus_message_append(
+                                m,
+                                "ssa{sv}",
+                                "foo.service",
+                                "org.freedesktop.systemd1.Unit",
+                                1,
+                                "SubState",
+                                "s",
+                                "running");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(m, 1, 0);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not create properties changed message: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&m);
+}
+
+/* Each event reaches the owner and every peer of each monitor, with the same body */
+bool test_controller_monitor_broadcast() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        _cleanup_sd_bus_ sd_bus *client_bus = connect_api_client(controller, test_on_monitor_signal);
+        if (client_bus == NULL) {
+                return false;
+        }
+        _cleanup_sd_bus_message_ sd_bus_message *m = create_agent_properties_changed(client_bus);
+        if (m == NULL) {
+                return false;
+        }
+        bool result = false;
+        if (!add_monitors(controller)) {
+                goto out;
+        }
+
+        for (int i = 0; i < NUMBER_OF_EVENTS; i++) {
+                for (int j = 0; j < NUMBER_OF_MONITORS; j++) {
+                        monitor_on_unit_state_changed(
+                                        monitors[j], "node-0", "foo.service", "active", "running", "real");
+                }
+
+                if (!wait_for_signals(controller, &n_state_changed, (long) (i + 1) * NUMBER_OF_DESTINATIONS)) {
+                        goto out;
+                }
+        }
+
+        for (int i = 0; i < NUMBER_OF_EVENTS; i++) {
+                for (int j = 0; j < NUMBER_OF_MONITORS; j++) {
+                        monitor_on_unit_property_changed(
+                                        monitors[j], "node-0", "foo.service", "org.freedesktop.systemd1.Unit", m);
+                }
+
+                if (!wait_for_signals(controller, &n_properties_changed, (long) (i + 1) * NUMBER_OF_DESTINATIONS)) {
+                        goto out;
+                }
+        }
+        if (n_invalid != 0) {
+                fprintf(stderr, "FAILED: %ld properties changed signals had unexpected content\n", n_invalid);
+                goto out;
+        }
+        result = true;
+
+out:
+        close_monitors(controller);
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_monitor_broadcast();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
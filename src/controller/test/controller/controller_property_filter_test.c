@@ -0,0 +1,349 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+/* Last property filter pushed to the fake agent for the unit and the wildcard */
+static char **unit_filter = NULL;
+static char **wildcard_filter = NULL;
+static int n_filters = 0;
+
+static int test_on_unit_new(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, UNUSED const char *reason) {
+        return 0;
+}
+
+static int test_on_unit_removed(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, UNUSED const char *reason) {
+        return 0;
+}
+
+static int test_on_unit_property_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *interface,
+                UNUSED sd_bus_message *m) {
+        return 0;
+}
+
+static int test_on_unit_state_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *active_state,
+                UNUSED const char *substate,
+                UNUSED const char *reason) {
+        return 0;
+}
+
+static int test_on_agent_message(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (!sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "SetPropertyFilter")) {
+                return 0;
+        }
+
+        const char *unit = NULL;
+        char **properties = NULL;
+        int r = sd_bus_message_read(m, "s", &unit);
+        if (r >= 0) {
+                r = sd_bus_message_read_strv(m, &properties);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: invalid SetPropertyFilter call: %s\n", strerror(-r));
+                return 0;
+        }
+
+        char ***filter = is_wildcard(unit) ? &wildcard_filter : &unit_filter;
+        freev((void **) *filter);
+        *filter = properties;
+        n_filters++;
+        return 1;
+}
+
+Subscription *add_subscription(Controller *controller, const char *unit, const char *properties[]) {
+        _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+        if (sub == NULL || !subscription_add_unit(sub, unit)) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return NULL;
+        }
+        for (size_t i = 0; properties != NULL && properties[i] != NULL; i++) {
+                if (!subscription_add_property(sub, properties[i])) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return NULL;
+                }
+        }
+        sub->handle_unit_new = test_on_unit_new;
+        sub->handle_unit_removed = test_on_unit_removed;
+        sub->handle_unit_state_changed = test_on_unit_state_changed;
+        sub->handle_unit_property_changed = test_on_unit_property_changed;
+
+        controller_add_subscription(controller, sub);
+        return steal_pointer(&sub);
+}
+
+bool check_filter(Controller *controller, const char *step, char ***filter, int n_expected, char *expected[]) {
+        while (n_filters < n_expected) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: %s: got %d of %d property filters\n", step, n_filters, n_expected);
+                        return false;
+                }
+        }
+        if (n_filters != n_expected) {
+                fprintf(stderr, "FAILED: %s: got %d property filters, expected %d\n", step, n_filters, n_expected);
+                return false;
+        }
+        if (!strv_equal(*filter, expected)) {
+                fprintf(stderr, "FAILED: %s: unexpected property filter\n", step);
+                return false;
+        }
+        return true;
+}
+
+bool test_controller_property_filter() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        bool result = false;
+        Subscription *all = NULL;
+        Subscription *wildcard = NULL;
+        Subscription *state = add_subscription(
+                        controller, "foo.service", (const char *[]) { "SubState", "ActiveState", NULL });
+        Subscription *pid = add_subscription(
+                        controller, "foo.service", (const char *[]) { "MainPID", "SubState", NULL });
+        if (state == NULL || pid == NULL) {
+                goto out;
+        }
+
+        /* The filter is pushed with the first subscription and updated with the union of all allow-lists */
+        char *union_filter[] = { "ActiveState", "MainPID", "SubState", NULL };
+        if (!check_filter(controller, "union", &unit_filter, 2, union_filter)) {
+                goto out;
+        }
+
+        /* Subscriptions without allow-list need all properties */
+        all = add_subscription(controller, "foo.service", NULL);
+        if (all == NULL || !check_filter(controller, "all properties", &unit_filter, 3, (char *[]) { NULL })) {
+                goto out;
+        }
+        controller_remove_subscription(controller, all);
+        if (!check_filter(controller, "all properties removed", &unit_filter, 4, union_filter)) {
+                goto out;
+        }
+
+        /* Wildcard subscriptions add to the filter of every subscribed unit */
+        wildcard = add_subscription(controller, SYMBOL_WILDCARD, (const char *[]) { "NRestarts", NULL });
+        if (wildcard == NULL) {
+                goto out;
+        }
+        char *wildcard_union_filter[] = { "ActiveState", "MainPID", "NRestarts", "SubState", NULL };
+        if (!check_filter(controller, "wildcard", &unit_filter, 6, wildcard_union_filter) ||
+            !check_filter(controller, "wildcard", &wildcard_filter, 6, (char *[]) { "NRestarts", NULL })) {
+                goto out;
+        }
+
+        /* Unchanged unions are not pushed again */
+        controller_remove_subscription(controller, pid);
+        subscription_unrefp(&pid);
+        if (!check_filter(controller,
+                          "unchanged",
+                          &unit_filter,
+                          7,
+                          (char *[]) { "ActiveState", "NRestarts", "SubState", NULL })) {
+                goto out;
+        }
+        subscription_unref(add_subscription(controller, "foo.service", (const char *[]) { "SubState", NULL }));
+        dispatch_all(controller);
+        if (n_filters != 7) {
+                fprintf(stderr, "FAILED: expected unchanged filter not to be pushed again\n");
+                goto out;
+        }
+
+        result = true;
+
+out:
+        subscription_unrefp(&state);
+        subscription_unrefp(&pid);
+        subscription_unrefp(&all);
+        subscription_unrefp(&wildcard);
+        freev((void **) unit_filter);
+        freev((void **) wildcard_filter);
+        return result;
+}
+
+/* Properties received by a subscription, over all of its UnitPropertiesChanged events */
+typedef struct TestMonitor {
+        char **properties;
+        int n_events;
+} TestMonitor;
+
+static int test_on_filtered_properties(
+                void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *interface,
+                sd_bus_message *m) {
+        TestMonitor *test_monitor = monitor;
+        test_monitor->n_events++;
+
+        int r = sd_bus_message_skip(m, "ss");
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+        }
+        while (r >= 0 && (r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+                const char *property = NULL;
+                r = sd_bus_message_read(m, "s", &property);
+                if (r >= 0 && !strv_extend(&test_monitor->properties, property)) {
+                        r = -ENOMEM;
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_skip(m, "v");
+                }
+                if (r >= 0) {
+                        r = sd_bus_message_exit_container(m);
+                }
+        }
+        if (r >= 0) {
+                r = sd_bus_message_exit_container(m);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: invalid UnitPropertiesChanged event: %s\n", strerror(-r));
+        }
+
+        /* The event is passed on to the other subscriptions */
+        return sd_bus_message_rewind(m, false);
+}
+
+bool check_received(const char *name, TestMonitor *monitor, int n_expected, char *expected[]) {
+        if (monitor->n_events != n_expected || !strv_equal(monitor->properties, expected)) {
+                fprintf(stderr,
+                        "FAILED: expected %s subscription to get %d events with its properties, got %d\n",
+                        name,
+                        n_expected,
+                        monitor->n_events);
+                return false;
+        }
+        return true;
+}
+
+/* Each subscription only gets the properties of its own allow-list, even though the agent sends their union */
+bool test_controller_property_filter_per_subscription() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, NULL, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        bool result = false;
+        TestMonitor monitors[3] = { 0 };
+        Subscription *state = add_subscription(controller, "foo.service", (const char *[]) { "SubState", NULL });
+        Subscription *pid = add_subscription(
+                        controller, "foo.service", (const char *[]) { "MainPID", "SubState", NULL });
+        Subscription *all = add_subscription(controller, "foo.service", NULL);
+        if (state == NULL || pid == NULL || all == NULL) {
+                goto out;
+        }
+        Subscription *subs[] = { state, pid, all };
+        for (size_t i = 0; i < 3; i++) {
+                subs[i]->monitor = &monitors[i];
+                subs[i]->handle_unit_property_changed = test_on_filtered_properties;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *batch = new_event_batch(agent_bus);
+        if (batch == NULL) {
+                goto out;
+        }
+        int r = append_entry(
+                        batch,
+                        "UnitPropertiesChanged",
+                        "(ssa{sv})",
+                        "ssa{sv}",
+                        "foo.service",
+                        "org.freedesktop.systemd1.Service",
+                        3,
+                        "SubState",
+                        "s",
+                        "running",
+                        "MainPID",
+                        "u",
+                        42,
+                        "NRestarts",
+                        "u",
+                        1);
+        if (r >= 0) {
+                r = append_entry(
+                                batch,
+                                "UnitPropertiesChanged",
+                                "(ssa{sv})",
+                                "ssa{sv}",
+                                "foo.service",
+                                "org.freedesktop.systemd1.Service",
+                                1,
+                                "NRestarts",
+                                "u",
+                                2);
+        }
+        if (r >= 0) {
+                r = send_event_batch(agent_bus, batch);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not send event batch: %s\n", strerror(-r));
+                goto out;
+        }
+        dispatch_all(controller);
+
+        /* Events without any allowed property are dropped for the subscription */
+        result = check_received("SubState", &monitors[0], 1, (char *[]) { "SubState", NULL }) &&
+                        check_received("MainPID", &monitors[1], 1, (char *[]) { "SubState", "MainPID", NULL }) &&
+                        check_received("all properties",
+                                       &monitors[2],
+                                       2,
+                                       (char *[]) { "SubState", "MainPID", "NRestarts", "NRestarts", NULL });
+
+out:
+        subscription_unrefp(&state);
+        subscription_unrefp(&pid);
+        subscription_unrefp(&all);
+        for (size_t i = 0; i < 3; i++) {
+                freev((void **) monitors[i].properties);
+        }
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_property_filter();
+        result = result && test_controller_property_filter_per_subscription();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
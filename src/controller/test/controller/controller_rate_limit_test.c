@@ -0,0 +1,258 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/node.h"
+#include "controller/rate_limit.h"
+#include "controller/test/fixture.h"
+
+#define MAX_HELD_REQUESTS 8
+
+/* ListUnits calls the fake agent did not answer yet */
+static sd_bus_message *held_requests[MAX_HELD_REQUESTS];
+static int n_held_requests = 0;
+
+typedef struct CallResult {
+        bool done;
+        char *error_name;
+} CallResult;
+
+static int test_on_agent_message(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (!sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "ListUnits") ||
+            n_held_requests >= MAX_HELD_REQUESTS) {
+                return 0;
+        }
+        held_requests[n_held_requests++] = sd_bus_message_ref(m);
+        return 1;
+}
+
+static int test_on_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        CallResult *result = userdata;
+        result->done = true;
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                result->error_name = strdup(sd_bus_message_get_error(m)->name);
+        }
+        return 0;
+}
+
+bool call_controller(sd_bus *client, const char *method, CallResult *result) {
+        int r = sd_bus_call_method_async(
+                        client,
+                        NULL,
+                        BC_DBUS_NAME,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        method,
+                        test_on_reply,
+                        result,
+                        "");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call %s: %s\n", method, strerror(-r));
+                return false;
+        }
+        return true;
+}
+
+bool check_result(const char *name, CallResult *result, const char *expected_error) {
+        if (!result->done) {
+                fprintf(stderr, "FAILED: expected %s to be answered\n", name);
+                return false;
+        }
+        if (expected_error == NULL && result->error_name != NULL) {
+                fprintf(stderr, "FAILED: expected %s to succeed, but got %s\n", name, result->error_name);
+                return false;
+        }
+        if (expected_error != NULL && (result->error_name == NULL || !streq(result->error_name, expected_error))) {
+                fprintf(stderr,
+                        "FAILED: expected %s to fail with %s, but got %s\n",
+                        name,
+                        expected_error,
+                        result->error_name != NULL ? result->error_name : "success");
+                return false;
+        }
+        return true;
+}
+
+bool test_rate_limiter() {
+        RateLimiter *limiter = rate_limiter_new();
+        if (limiter == NULL) {
+                fprintf(stderr, "FAILED: could not create rate limiter\n");
+                return false;
+        }
+
+        bool result = true;
+        uint64_t now = USEC_PER_SEC;
+
+        /* A new client may make a burst of requests at once */
+        for (int i = 0; i < 3; i++) {
+                if (!rate_limiter_take(limiter, ":1.1", 10, 3, now)) {
+                        fprintf(stderr, "FAILED: expected request %d of the burst to be allowed\n", i);
+                        result = false;
+                }
+        }
+        if (rate_limiter_take(limiter, ":1.1", 10, 3, now)) {
+                fprintf(stderr, "FAILED: expected request after the burst to be limited\n");
+                result = false;
+        }
+
+        /* Clients are limited independently */
+        if (!rate_limiter_take(limiter, ":1.2", 10, 3, now)) {
+                fprintf(stderr, "FAILED: expected request of another client to be allowed\n");
+                result = false;
+        }
+
+        /* One token is refilled every 100ms at 10 requests per second */
+        now += 100 * USEC_PER_MSEC;
+        if (!rate_limiter_take(limiter, ":1.1", 10, 3, now) || rate_limiter_take(limiter, ":1.1", 10, 3, now)) {
+                fprintf(stderr, "FAILED: expected exactly one refilled token after 100ms\n");
+                result = false;
+        }
+
+        /* Refilling stops at the burst */
+        now += 10 * USEC_PER_SEC;
+        for (int i = 0; i < 3; i++) {
+                rate_limiter_take(limiter, ":1.1", 10, 3, now);
+        }
+        if (rate_limiter_take(limiter, ":1.1", 10, 3, now)) {
+                fprintf(stderr, "FAILED: expected refilled tokens to be capped at the burst\n");
+                result = false;
+        }
+
+        rate_limiter_forget(limiter, ":1.1");
+        if (rate_limiter_size(limiter) != 1) {
+                fprintf(stderr, "FAILED: expected 1 client to be tracked, got %zu\n", rate_limiter_size(limiter));
+                result = false;
+        }
+
+        rate_limiter_free(limiter);
+        return result;
+}
+
+bool test_controller_api_rate_limit() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL || !controller_set_api_request_rate(controller, "1") ||
+            !controller_set_api_request_burst(controller, "2")) {
+                fprintf(stderr, "FAILED: could not set up controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        if (client == NULL) {
+                return false;
+        }
+
+        CallResult results[3] = { 0 };
+        for (int i = 0; i < 3; i++) {
+                if (!call_controller(client, "ListNodes", &results[i])) {
+                        return false;
+                }
+        }
+        dispatch_all(controller);
+
+        bool result = check_result("first ListNodes", &results[0], NULL) &&
+                        check_result("second ListNodes", &results[1], NULL) &&
+                        check_result("third ListNodes", &results[2], BC_BUS_ERROR_RATE_LIMITED);
+        if (result && controller->throttled_requests != 1) {
+                fprintf(stderr,
+                        "FAILED: expected 1 throttled request, got %" PRIu64 "\n",
+                        controller->throttled_requests);
+                result = false;
+        }
+
+        for (int i = 0; i < 3; i++) {
+                free(results[i].error_name);
+        }
+        return result;
+}
+
+bool test_controller_fleet_request_admission() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL || !controller_set_max_fleet_requests(controller, "1") ||
+            !controller_set_max_queued_fleet_requests(controller, "1")) {
+                fprintf(stderr, "FAILED: could not set up controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        Node *node = controller_add_node(controller, "node-0");
+        if (client == NULL || node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        /* The first request is sent to the agent, the second waits for it and the third is rejected */
+        CallResult results[3] = { 0 };
+        bool result = true;
+        for (int i = 0; i < 3 && result; i++) {
+                result = call_controller(client, "ListUnits", &results[i]);
+        }
+        dispatch_all(controller);
+
+        if (result && (n_held_requests != 1 || controller->fleet_requests_in_flight != 1 ||
+                       controller->queued_fleet_requests != 1 || controller->rejected_fleet_requests != 1)) {
+                fprintf(stderr,
+                        "FAILED: expected 1 request at the agent, 1 in flight, 1 queued and 1 rejected, got %d, %u, %u "
+                        "and %" PRIu64 "\n",
+                        n_held_requests,
+                        controller->fleet_requests_in_flight,
+                        controller->queued_fleet_requests,
+                        controller->rejected_fleet_requests);
+                result = false;
+        }
+        result = result && check_result("third ListUnits", &results[2], BC_BUS_ERROR_TOO_MANY_REQUESTS);
+
+        /* Once the agent answers, the queued request is started */
+        for (int i = 0; i < 2 && result; i++) {
+                if (i >= n_held_requests) {
+                        fprintf(stderr, "FAILED: expected queued request to reach the agent\n");
+                        result = false;
+                        break;
+                }
+                int r = sd_bus_reply_method_return(held_requests[i], "a" UNIT_INFO_STRUCT_TYPESTRING, 0);
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not reply to ListUnits: %s\n", strerror(-r));
+                        result = false;
+                }
+                dispatch_all(controller);
+        }
+
+        result = result && check_result("first ListUnits", &results[0], NULL) &&
+                        check_result("second ListUnits", &results[1], NULL);
+        if (result && (controller->fleet_requests_in_flight != 0 || controller->queued_fleet_requests != 0)) {
+                fprintf(stderr, "FAILED: expected no fleet requests left\n");
+                result = false;
+        }
+
+        for (int i = 0; i < n_held_requests; i++) {
+                sd_bus_message_unrefp(&held_requests[i]);
+        }
+        for (int i = 0; i < 3; i++) {
+                free(results[i].error_name);
+        }
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_rate_limiter();
+        result = result && test_controller_api_rate_limit();
+        result = result && test_controller_fleet_request_admission();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
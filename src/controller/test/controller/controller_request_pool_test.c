@@ -0,0 +1,162 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/pool.h"
+#include "libbluechi/common/protocol.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/job.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_WARMUP_CALLS 100
+#define NUMBER_OF_CALLS 10000
+
+static int n_agent_calls = 0;
+
+typedef struct CallResult {
+        bool done;
+        char *error_name;
+} CallResult;
+
+/* Queues every job */
+static int test_on_agent_message(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (!is_agent_call(m)) {
+                return 0;
+        }
+        n_agent_calls++;
+        if (!sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "StartUnit")) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Unexpected call");
+        }
+        return sd_bus_reply_method_return(m, "");
+}
+
+static int test_on_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        CallResult *result = userdata;
+        result->done = true;
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                free(result->error_name);
+                result->error_name = strdup(sd_bus_message_get_error(m)->name);
+        }
+        return 0;
+}
+
+/* Calls StartUnit on the node and lets the agent report the job as done right away */
+bool start_unit_round_trip(Controller *controller, sd_bus *client, Node *node) {
+        CallResult result = { false, NULL };
+        int r = sd_bus_call_method_async(
+                        client,
+                        NULL,
+                        BC_DBUS_NAME,
+                        node->object_path,
+                        NODE_INTERFACE,
+                        "StartUnit",
+                        test_on_reply,
+                        &result,
+                        "ss",
+                        "a.service",
+                        "replace");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call StartUnit: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+
+        if (!result.done || result.error_name != NULL || controller->jobs == NULL) {
+                fprintf(stderr,
+                        "FAILED: expected StartUnit to queue a job, got %s\n",
+                        result.error_name != NULL ? result.error_name : "no reply");
+                free(result.error_name);
+                return false;
+        }
+
+        controller_finish_job(controller, controller->jobs->id, "done");
+        dispatch_all(controller);
+        return true;
+}
+
+/*
+ * Reports the objects and strings of the request path that are allocated per
+ * StartUnit round trip, after the pools had a chance to fill up.
+ */
+bool test_start_unit_allocations() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL) {
+                fprintf(stderr, "FAILED: could not create controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        Node *node = controller_add_node(controller, "node-0");
+        if (client == NULL || node == NULL || !node_export(node)) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        for (int i = 0; i < NUMBER_OF_WARMUP_CALLS; i++) {
+                if (!start_unit_round_trip(controller, client, node)) {
+                        return false;
+                }
+        }
+
+        PoolStats before = *pool_get_stats();
+        uint64_t start = get_time_micros();
+        for (int i = 0; i < NUMBER_OF_CALLS; i++) {
+                if (!start_unit_round_trip(controller, client, node)) {
+                        return false;
+                }
+        }
+        uint64_t elapsed = get_time_micros() - start;
+        const PoolStats *after = pool_get_stats();
+
+        printf("%d StartUnit round trips in %" PRIu64 " us, per round trip: %.2f allocated, %.2f recycled, %.2f "
+               "inline strings\n",
+               NUMBER_OF_CALLS,
+               elapsed,
+               (double) (after->n_malloc - before.n_malloc) / NUMBER_OF_CALLS,
+               (double) (after->n_recycled - before.n_recycled) / NUMBER_OF_CALLS,
+               (double) (after->n_inline - before.n_inline) / NUMBER_OF_CALLS);
+
+        bool result = true;
+        if (n_agent_calls != NUMBER_OF_WARMUP_CALLS + NUMBER_OF_CALLS) {
+                fprintf(stderr, "FAILED: expected a call to the agent per round trip, got %d\n", n_agent_calls);
+                result = false;
+        }
+        /* AgentRequest, JobSetup and Job are recycled, unit, type and job path fit into the job */
+        if (after->n_malloc != before.n_malloc) {
+                fprintf(stderr,
+                        "FAILED: expected no allocations in steady state, got %" PRIu64 "\n",
+                        after->n_malloc - before.n_malloc);
+                result = false;
+        }
+        if (after->n_recycled - before.n_recycled != 3 * NUMBER_OF_CALLS) {
+                fprintf(stderr,
+                        "FAILED: expected 3 recycled objects per round trip, got %" PRIu64 "\n",
+                        after->n_recycled - before.n_recycled);
+                result = false;
+        }
+
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_start_unit_allocations();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define AGENT_SESSION_ID 42
+
+/* Events received by the subscription, in order of arrival */
+static char received[512] = "";
+static int n_received = 0;
+
+/* Calls received by the fake agent */
+static int n_subscribes = 0;
+static int n_resets = 0;
+static int n_resyncs = 0;
+static int n_start_deps = 0;
+static int n_stop_deps = 0;
+
+/* Behavior of the fake agent on Resync */
+static bool reject_resync = false;
+static char *changed_units[] = { "bar.service", NULL, NULL };
+
+static void record_event(const char *unit, const char *event) {
+        n_received++;
+        if (strlen(received) + strlen(unit) + strlen(event) + 3 < sizeof(received)) {
+                strcat(received, unit);
+                strcat(received, ":");
+                strcat(received, event);
+                strcat(received, ";");
+        }
+}
+
+static int test_on_unit_new(UNUSED void *monitor, UNUSED const char *node, const char *unit, const char *reason) {
+        record_event(unit, reason);
+        return 0;
+}
+
+static int test_on_unit_removed(
+                UNUSED void *monitor, UNUSED const char *node, const char *unit, UNUSED const char *reason) {
+        record_event(unit, "removed");
+        return 0;
+}
+
+static int test_on_unit_property_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *interface,
+                UNUSED sd_bus_message *m) {
+        return 0;
+}
+
+static int test_on_unit_state_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                const char *unit,
+                UNUSED const char *active_state,
+                const char *substate,
+                UNUSED const char *reason) {
+        record_event(unit, substate);
+        return 0;
+}
+
+static int test_on_agent_message(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "Subscribe")) {
+                n_subscribes++;
+                return sd_bus_reply_method_return(m, "");
+        }
+        if (sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "SetPropertyFilter")) {
+                return sd_bus_reply_method_return(m, "");
+        }
+        if (sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "StartDep")) {
+                n_start_deps++;
+                return 1;
+        }
+        if (sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "StopDep")) {
+                n_stop_deps++;
+                return 1;
+        }
+        if (!sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "Resync")) {
+                return 0;
+        }
+
+        uint64_t session_id = 0;
+        uint64_t seq = 0;
+        int r = sd_bus_message_read(m, "tt", &session_id, &seq);
+        if (r < 0) {
+                fprintf(stderr, "FAILED: invalid Resync call: %s\n", strerror(-r));
+                return 0;
+        }
+        if (session_id == 0) {
+                /* Not waiting for a reply */
+                n_resets++;
+                return 1;
+        }
+
+        n_resyncs++;
+        if (reject_resync) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_UNKNOWN_METHOD, "Unknown method Resync");
+        }
+
+        /* Only the changed units changed since the last event received by the controller */
+        bool incremental = session_id == AGENT_SESSION_ID && seq == 2;
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        r = sd_bus_message_new_method_return(m, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_append(reply, "btt", incremental, (uint64_t) AGENT_SESSION_ID, (uint64_t) 3);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_append_strv(reply, incremental ? changed_units : NULL);
+        }
+        if (r >= 0) {
+                r = sd_bus_send(NULL, reply, NULL);
+        }
+        return r;
+}
+
+/* Disconnects the fake agent and waits for the node to notice */
+bool disconnect_fake_agent(Controller *controller, Node *node, sd_bus **agent_bus) {
+        *agent_bus = sd_bus_close_unref(*agent_bus);
+        while (node_has_agent(node)) {
+                if (sd_event_run(controller->event, USEC_PER_SEC) <= 0) {
+                        fprintf(stderr, "FAILED: node did not notice the disconnect\n");
+                        return false;
+                }
+        }
+        return true;
+}
+
+Subscription *add_subscription(Controller *controller, const char *units[]) {
+        _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+        if (sub == NULL) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return NULL;
+        }
+        for (size_t i = 0; units[i] != NULL; i++) {
+                if (!subscription_add_unit(sub, units[i])) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return NULL;
+                }
+        }
+        sub->handle_unit_new = test_on_unit_new;
+        sub->handle_unit_removed = test_on_unit_removed;
+        sub->handle_unit_state_changed = test_on_unit_state_changed;
+        sub->handle_unit_property_changed = test_on_unit_property_changed;
+
+        controller_add_subscription(controller, sub);
+        return steal_pointer(&sub);
+}
+
+/* Reports foo.service and bar.service as running, ending at sequence number 2 */
+int send_units_running(sd_bus *agent_bus) {
+        _cleanup_sd_bus_message_ sd_bus_message *batch = NULL;
+        int r = sd_bus_message_new_signal(
+                        agent_bus, &batch, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, "EventBatch");
+        if (r >= 0) {
+                r = sd_bus_message_open_container(batch, SD_BUS_TYPE_ARRAY, "(sv)");
+        }
+        const char *units[] = { "foo.service", "bar.service" };
+        for (size_t i = 0; i < 2 && r >= 0; i++) {
+                r = append_entry(batch, "UnitNew", "(ss)", "ss", units[i], "real");
+                if (r >= 0) {
+                        r = append_entry(
+                                        batch,
+                                        "UnitStateChanged",
+                                        "(ssss)",
+                                        "ssss",
+                                        units[i],
+                                        "active",
+                                        "running",
+                                        "real");
+                }
+        }
+        if (r >= 0) {
+                r = append_entry(batch,
+                                 AGENT_EVENT_SEQUENCE_SIGNAL_NAME,
+                                 "(tt)",
+                                 "tt",
+                                 (uint64_t) AGENT_SESSION_ID,
+                                 (uint64_t) 2);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(batch);
+        }
+        if (r >= 0) {
+                r = sd_bus_send(agent_bus, batch, NULL);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not send EventBatch: %s\n", strerror(-r));
+        }
+        return r;
+}
+
+bool wait_for(Controller *controller, const char *step, int *counter, int n_expected) {
+        while (*counter < n_expected) {
+                if (sd_event_run(controller->event, USEC_PER_SEC) <= 0) {
+                        fprintf(stderr, "FAILED: %s: got %d of %d\n", step, *counter, n_expected);
+                        return false;
+                }
+        }
+        dispatch_all(controller);
+        if (*counter != n_expected) {
+                fprintf(stderr, "FAILED: %s: got %d, expected %d\n", step, *counter, n_expected);
+                return false;
+        }
+        return true;
+}
+
+void clear_received() {
+        received[0] = '\0';
+        n_received = 0;
+}
+
+bool check_received(const char *step, const char *expected) {
+        if (!streq(received, expected)) {
+                fprintf(stderr, "FAILED: %s: unexpected events '%s'\n", step, received);
+                return false;
+        }
+        clear_received();
+        return true;
+}
+
+/* Reports the units as running and disconnects, so that the next connect can resync incrementally */
+bool run_and_disconnect(Controller *controller, Node *node, sd_bus **agent_bus) {
+        if (send_units_running(*agent_bus) < 0 || !wait_for(controller, "running again", &n_received, 4) ||
+            !disconnect_fake_agent(controller, node, agent_bus)) {
+                return false;
+        }
+        clear_received();
+        return true;
+}
+
+bool test_controller_resync() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        bool result = false;
+        _cleanup_sd_bus_ sd_bus *agent_bus = NULL;
+        Subscription *extra = NULL;
+        Subscription *late = NULL;
+        Subscription *sub = add_subscription(controller, (const char *[]) { "foo.service", "bar.service", NULL });
+        if (sub == NULL) {
+                goto out;
+        }
+
+        /* A new agent drops what it may still have and gets all subscriptions */
+        agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL || !wait_for(controller, "first connect", &n_subscribes, 2)) {
+                goto out;
+        }
+        if (n_resets != 1 || n_resyncs != 0) {
+                fprintf(stderr, "FAILED: first connect: expected a reset, got %d resets\n", n_resets);
+                goto out;
+        }
+        if (send_units_running(agent_bus) < 0 || !wait_for(controller, "running", &n_received, 4) ||
+            !check_received("running",
+                            "foo.service:real;foo.service:running;bar.service:real;bar.service:running;")) {
+                goto out;
+        }
+
+        /* Units that didn't change are restored on reconnect, without subscribing again */
+        if (!disconnect_fake_agent(controller, node, &agent_bus) ||
+            !check_received("disconnect",
+                            "foo.service:agent-offline;foo.service:removed;"
+                            "bar.service:agent-offline;bar.service:removed;")) {
+                goto out;
+        }
+        agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL || !wait_for(controller, "reconnect", &n_received, 2) ||
+            !check_received("reconnect", "foo.service:virtual;foo.service:running;")) {
+                goto out;
+        }
+        if (n_subscribes != 2 || n_resyncs != 1 || n_resets != 1 || node->agent_event_seq != 3) {
+                fprintf(stderr, "FAILED: reconnect: expected an incremental resync\n");
+                goto out;
+        }
+
+        /* Subscriptions changed while offline need a full resync */
+        if (!disconnect_fake_agent(controller, node, &agent_bus)) {
+                goto out;
+        }
+        extra = add_subscription(controller, (const char *[]) { "baz.service", NULL });
+        if (extra == NULL) {
+                goto out;
+        }
+        clear_received();
+        agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL || !wait_for(controller, "changed offline", &n_subscribes, 5)) {
+                goto out;
+        }
+        if (n_resets != 2 || n_resyncs != 1 || n_received != 0) {
+                fprintf(stderr, "FAILED: changed offline: expected a reset without restored units\n");
+                goto out;
+        }
+
+        /* A rejected resync sends all subscriptions, including those changed while waiting for it */
+        if (!run_and_disconnect(controller, node, &agent_bus)) {
+                goto out;
+        }
+        reject_resync = true;
+        agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL || node->resync_slot == NULL) {
+                fprintf(stderr, "FAILED: rejected: expected a pending resync\n");
+                goto out;
+        }
+        late = add_subscription(controller, (const char *[]) { "qux.service", NULL });
+        if (late == NULL) {
+                goto out;
+        }
+
+        /* Proxy dependencies are not held back by the pending resync */
+        if (node_add_proxy_dependency(node, "dep.service") < 0 ||
+            node_remove_proxy_dependency(node, "dep.service") < 0) {
+                fprintf(stderr, "FAILED: could not add and remove proxy dependency\n");
+                goto out;
+        }
+        if (!wait_for(controller, "rejected", &n_subscribes, 9)) {
+                goto out;
+        }
+        if (n_resets != 2 || n_resyncs != 2 || n_start_deps != 1 || n_stop_deps != 1) {
+                fprintf(stderr,
+                        "FAILED: rejected: expected a full resync and both dependency calls, got %d/%d\n",
+                        n_start_deps,
+                        n_stop_deps);
+                goto out;
+        }
+
+        /* The full resync settled the subscriptions, so the next reconnect is incremental again */
+        reject_resync = false;
+        if (!run_and_disconnect(controller, node, &agent_bus)) {
+                goto out;
+        }
+        agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL || !wait_for(controller, "after rejected", &n_received, 2) ||
+            !check_received("after rejected", "foo.service:virtual;foo.service:running;")) {
+                goto out;
+        }
+        if (n_resets != 2 || n_resyncs != 3) {
+                fprintf(stderr, "FAILED: after rejected: expected an incremental resync\n");
+                goto out;
+        }
+
+        /* A change the agent held back when it went offline is reported as changed, not restored */
+        if (!run_and_disconnect(controller, node, &agent_bus)) {
+                goto out;
+        }
+        changed_units[1] = (char *) "foo.service";
+        agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL || !wait_for(controller, "held back", &n_resyncs, 4)) {
+                goto out;
+        }
+        if (n_resets != 2 || n_received != 0 || node->agent_event_seq != 3) {
+                fprintf(stderr, "FAILED: held back: expected an incremental resync without restored units\n");
+                goto out;
+        }
+
+        result = true;
+
+out:
+        if (sub != NULL) {
+                controller_remove_subscription(controller, sub);
+        }
+        if (extra != NULL) {
+                controller_remove_subscription(controller, extra);
+        }
+        if (late != NULL) {
+                controller_remove_subscription(controller, late);
+        }
+        subscription_unrefp(&sub);
+        subscription_unrefp(&extra);
+        subscription_unrefp(&late);
+        return result;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_resync();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
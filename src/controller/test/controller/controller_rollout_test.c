@@ -0,0 +1,348 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+
+#include "controller/controller.h"
+#include "controller/job.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define N_NODES 4
+#define UNIT "app.service"
+
+static const char *node_names[N_NODES] = { "node-a1", "node-a2", "node-a3", "node-b1" };
+
+/* Answers the lifecycle calls of the controller for one node */
+typedef struct FakeAgent {
+        sd_bus *bus;
+        int n_calls;
+        uint32_t last_job_id;
+        bool fail; /* Reply with an error instead of queueing the job */
+        bool call_valid;
+} FakeAgent;
+
+typedef struct RolloutResult {
+        bool done;
+        char *error_name;
+        char *job_path;
+        char *result; /* Result of JobRemoved of the aggregate job */
+} RolloutResult;
+
+static int test_on_agent_message(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        FakeAgent *agent = userdata;
+
+        if (!is_agent_call(m)) {
+                return 0;
+        }
+        agent->n_calls++;
+
+        const char *unit = NULL;
+        const char *mode = NULL;
+        int r = sd_bus_message_read(m, "ssu", &unit, &mode, &agent->last_job_id);
+        if (r < 0 || !sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "RestartUnit") ||
+            !streq(unit, UNIT) || !streq(mode, "replace")) {
+                agent->call_valid = false;
+        }
+
+        if (agent->fail) {
+                return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_FAILED, "Unit " UNIT " not found.");
+        }
+        return sd_bus_reply_method_return(m, "");
+}
+
+static int test_on_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        RolloutResult *result = userdata;
+        result->done = true;
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                result->error_name = strdup(sd_bus_message_get_error(m)->name);
+                return 0;
+        }
+
+        const char *job_path = NULL;
+        if (sd_bus_message_read(m, "o", &job_path) > 0) {
+                result->job_path = strdup(job_path);
+        }
+        return 0;
+}
+
+static int test_on_job_removed(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        RolloutResult *result = userdata;
+        uint32_t id = 0;
+        const char *job_path = NULL;
+        const char *node = NULL;
+        const char *unit = NULL;
+        const char *job_result = NULL;
+
+        int r = sd_bus_message_read(m, "uosss", &id, &job_path, &node, &unit, &job_result);
+        if (r > 0 && result->job_path != NULL && streq(job_path, result->job_path)) {
+                result->result = strdup(job_result);
+        }
+        return 0;
+}
+
+/* Sets up the nodes with their agents and calls RestartUnitOnNodes */
+bool start_rollout(
+                Controller *controller,
+                sd_bus *client,
+                FakeAgent *agents,
+                RolloutResult *result,
+                const char *node_pattern,
+                uint32_t parallelism,
+                uint32_t batch_size,
+                uint32_t max_failures) {
+        for (int i = 0; i < N_NODES; i++) {
+                Node *node = controller_add_node(controller, node_names[i]);
+                if (node != NULL) {
+                        agents[i].call_valid = true;
+                        agents[i].bus = connect_fake_agent(controller, node, test_on_agent_message, &agents[i]);
+                }
+                if (agents[i].bus == NULL) {
+                        fprintf(stderr, "FAILED: could not add node %s\n", node_names[i]);
+                        return false;
+                }
+        }
+
+        int r = sd_bus_match_signal(
+                        client,
+                        NULL,
+                        NULL,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "JobRemoved",
+                        test_on_job_removed,
+                        result);
+        if (r >= 0) {
+                r = sd_bus_call_method_async(
+                                client,
+                                NULL,
+                                BC_DBUS_NAME,
+                                BC_CONTROLLER_OBJECT_PATH,
+                                CONTROLLER_INTERFACE,
+                                "RestartUnitOnNodes",
+                                test_on_reply,
+                                result,
+                                "sssuuu",
+                                node_pattern,
+                                UNIT,
+                                "replace",
+                                parallelism,
+                                batch_size,
+                                max_failures);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call RestartUnitOnNodes: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+
+        if (!result->done || result->job_path == NULL) {
+                fprintf(stderr,
+                        "FAILED: expected RestartUnitOnNodes to succeed, got %s\n",
+                        result->error_name != NULL ? result->error_name : "no reply");
+                return false;
+        }
+        return true;
+}
+
+bool expect_calls(FakeAgent *agents, const int *expected_calls) {
+        for (int i = 0; i < N_NODES; i++) {
+                if (agents[i].n_calls != expected_calls[i] || !agents[i].call_valid) {
+                        fprintf(stderr,
+                                "FAILED: expected %d valid calls to %s, got %d\n",
+                                expected_calls[i],
+                                node_names[i],
+                                agents[i].n_calls);
+                        return false;
+                }
+        }
+        return true;
+}
+
+static int test_on_get_children(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        sd_bus_message **reply = userdata;
+        *reply = sd_bus_message_ref(m);
+        return 0;
+}
+
+bool expect_child(
+                Controller *controller,
+                sd_bus *client,
+                const char *job_path,
+                int index,
+                const char *node,
+                const char *result) {
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        int r = sd_bus_call_method_async(
+                        client,
+                        NULL,
+                        BC_DBUS_NAME,
+                        job_path,
+                        "org.freedesktop.DBus.Properties",
+                        "Get",
+                        test_on_get_children,
+                        &reply,
+                        "ss",
+                        JOB_INTERFACE,
+                        "Children");
+        if (r >= 0) {
+                dispatch_all(controller);
+                r = reply != NULL && !sd_bus_message_is_method_error(reply, NULL) ? 0 : -EIO;
+        }
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_VARIANT, "a(sos)");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sos)");
+        }
+        const char *child_node = NULL;
+        const char *child_path = NULL;
+        const char *child_result = NULL;
+        for (int i = 0; r >= 0 && i <= index; i++) {
+                r = sd_bus_message_read(reply, "(sos)", &child_node, &child_path, &child_result);
+                if (r == 0) {
+                        r = -ENOENT;
+                }
+        }
+        if (r < 0 || !streq(child_node, node) || !streq(child_result, result)) {
+                fprintf(stderr, "FAILED: expected child %d to be %s with result '%s'\n", index, node, result);
+                return false;
+        }
+        return true;
+}
+
+void finish_remaining_jobs(Controller *controller) {
+        Job *job = NULL;
+        Job *next_job = NULL;
+        LIST_FOREACH_SAFE(jobs, job, next_job, controller->jobs) {
+                controller_finish_job(controller, job->id, "done");
+        }
+        dispatch_all(controller);
+}
+
+void rollout_result_clear(RolloutResult *result) {
+        free(result->error_name);
+        free(result->job_path);
+        free(result->result);
+}
+
+void fake_agents_clear(FakeAgent *agents) {
+        for (int i = 0; i < N_NODES; i++) {
+                sd_bus_unrefp(&agents[i].bus);
+        }
+}
+
+/* One node at a time in waves of two, only the nodes matching the glob */
+bool test_rollout_waves() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL) {
+                fprintf(stderr, "FAILED: could not create controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        if (client == NULL) {
+                return false;
+        }
+        FakeAgent agents[N_NODES] = { 0 };
+        RolloutResult result = { 0 };
+
+        bool ok = start_rollout(controller, client, agents, &result, "node-a*", 1, 2, 0);
+        if (ok) {
+                const int expected_calls[N_NODES] = { 1, 0, 0, 0 };
+                ok = expect_calls(agents, expected_calls);
+        }
+
+        if (ok) {
+                controller_finish_job(controller, agents[0].last_job_id, "done");
+                dispatch_all(controller);
+                const int expected_calls[N_NODES] = { 1, 1, 0, 0 };
+                ok = expect_calls(agents, expected_calls);
+        }
+
+        /* The second wave starts once the first one is done */
+        if (ok) {
+                controller_finish_job(controller, agents[1].last_job_id, "done");
+                dispatch_all(controller);
+                const int expected_calls[N_NODES] = { 1, 1, 1, 0 };
+                ok = expect_calls(agents, expected_calls);
+        }
+        ok = ok && expect_child(controller, client, result.job_path, 1, "node-a2", "done");
+        ok = ok && expect_child(controller, client, result.job_path, 2, "node-a3", "");
+
+        if (ok) {
+                controller_finish_job(controller, agents[2].last_job_id, "failed");
+                dispatch_all(controller);
+                if (result.result == NULL || !streq(result.result, "failed")) {
+                        fprintf(stderr, "FAILED: expected the aggregate job to fail\n");
+                        ok = false;
+                }
+        }
+        if (ok && !LIST_IS_EMPTY(controller->jobs)) {
+                fprintf(stderr, "FAILED: expected no jobs to be left\n");
+                ok = false;
+        }
+
+        finish_remaining_jobs(controller);
+        fake_agents_clear(agents);
+        rollout_result_clear(&result);
+        return ok;
+}
+
+/* No further nodes are started once more than max_failures nodes failed */
+bool test_rollout_stop_on_failure() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL) {
+                fprintf(stderr, "FAILED: could not create controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        if (client == NULL) {
+                return false;
+        }
+        FakeAgent agents[N_NODES] = { 0 };
+        agents[0].fail = true;
+        RolloutResult result = { 0 };
+
+        bool ok = start_rollout(controller, client, agents, &result, "*", 0, 2, 0);
+        if (ok) {
+                const int expected_calls[N_NODES] = { 1, 1, 0, 0 };
+                ok = expect_calls(agents, expected_calls);
+        }
+        ok = ok && expect_child(controller, client, result.job_path, 0, "node-a1", "failed");
+
+        /* The running job still finishes, but no further wave starts */
+        if (ok) {
+                controller_finish_job(controller, agents[1].last_job_id, "done");
+                dispatch_all(controller);
+                const int expected_calls[N_NODES] = { 1, 1, 0, 0 };
+                ok = expect_calls(agents, expected_calls);
+        }
+        if (ok && (result.result == NULL || !streq(result.result, "failed"))) {
+                fprintf(stderr, "FAILED: expected the aggregate job to fail\n");
+                ok = false;
+        }
+
+        finish_remaining_jobs(controller);
+        fake_agents_clear(agents);
+        rollout_result_clear(&result);
+        return ok;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_rollout_waves();
+        result = result && test_rollout_stop_on_failure();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
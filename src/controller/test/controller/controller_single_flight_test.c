@@ -0,0 +1,297 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+
+#include "controller/controller.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_CALLS 5
+#define MAX_HELD_REQUESTS 16
+
+/* Calls the fake agent did not answer yet */
+static sd_bus_message *held_requests[MAX_HELD_REQUESTS];
+static int n_held_requests = 0;
+
+typedef struct CallResult {
+        bool done;
+        bool failed;
+        char *value; /* Description of the unit or name of the first listed unit */
+} CallResult;
+
+static int test_on_agent_message(sd_bus_message *m, UNUSED void *userdata, UNUSED sd_bus_error *ret_error) {
+        if (!is_agent_call(m) || n_held_requests >= MAX_HELD_REQUESTS) {
+                return 0;
+        }
+        held_requests[n_held_requests++] = sd_bus_message_ref(m);
+        return 1;
+}
+
+static int reply_held_request(sd_bus_message *m) {
+        if (sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "ListUnits")) {
+                return sd_bus_reply_method_return(
+                                m,
+                                "a" UNIT_INFO_STRUCT_TYPESTRING,
+                                1,
+                                "foo.service",
+                                "Foo",
+                                "loaded",
+                                "active",
+                                "running",
+                                "",
+                                "/org/freedesktop/systemd1/unit/foo_2eservice",
+                                0,
+                                "",
+                                "/");
+        }
+
+        /* GetUnitProperties returns the unit name as Description */
+        const char *unit = NULL;
+        int r = sd_bus_message_read(m, "s", &unit);
+        if (r < 0) {
+                return r;
+        }
+        return sd_bus_reply_method_return(m, "a{sv}", 1, "Description", "s", unit);
+}
+
+static int test_on_get_unit_properties_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        CallResult *result = userdata;
+        result->done = true;
+        result->failed = sd_bus_message_is_method_error(m, NULL);
+
+        const char *name = NULL;
+        const char *description = NULL;
+        int r = sd_bus_message_read(m, "a{sv}", 1, &name, "s", &description);
+        if (r < 0 || description == NULL || !streq(name, "Description")) {
+                result->failed = true;
+                return 0;
+        }
+        result->value = strdup(description);
+        return 0;
+}
+
+static int test_on_list_units_reply(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        CallResult *result = userdata;
+        result->done = true;
+        result->failed = sd_bus_message_is_method_error(m, NULL);
+
+        const char *node = NULL;
+        const char *unit = NULL;
+        int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, NODE_AND_UNIT_INFO_DICT_TYPESTRING);
+        if (r > 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, NODE_AND_UNIT_INFO_TYPESTRING);
+        }
+        if (r > 0) {
+                r = sd_bus_message_read(m, "s", &node);
+        }
+        if (r > 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        }
+        if (r > 0) {
+                r = sd_bus_message_read(
+                                m,
+                                UNIT_INFO_STRUCT_TYPESTRING,
+                                &unit,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL);
+        }
+        if (r <= 0 || unit == NULL) {
+                result->failed = true;
+                return 0;
+        }
+        result->value = strdup(unit);
+        return 0;
+}
+
+/* Answers all calls the fake agent holds, in order */
+bool reply_held_requests(Controller *controller) {
+        for (int i = 0; i < n_held_requests; i++) {
+                int r = reply_held_request(held_requests[i]);
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not reply to agent call: %s\n", strerror(-r));
+                        return false;
+                }
+                sd_bus_message_unrefp(&held_requests[i]);
+        }
+        n_held_requests = 0;
+        dispatch_all(controller);
+        return true;
+}
+
+void clear_held_requests() {
+        for (int i = 0; i < n_held_requests; i++) {
+                sd_bus_message_unrefp(&held_requests[i]);
+        }
+        n_held_requests = 0;
+}
+
+bool check_results(const char *method, CallResult *results, int n_results, const char *expected_value) {
+        bool result = true;
+        for (int i = 0; i < n_results; i++) {
+                if (!results[i].done || results[i].failed || results[i].value == NULL ||
+                    !streq(results[i].value, expected_value)) {
+                        fprintf(stderr,
+                                "FAILED: expected %s call %d to return '%s', but got '%s'\n",
+                                method,
+                                i,
+                                expected_value,
+                                results[i].value != NULL ? results[i].value : "nothing");
+                        result = false;
+                }
+        }
+        return result;
+}
+
+void clear_results(CallResult *results, int n_results) {
+        for (int i = 0; i < n_results; i++) {
+                free_and_null(results[i].value);
+        }
+}
+
+bool call_get_unit_properties(sd_bus *client, const char *unit, CallResult *result) {
+        int r = sd_bus_call_method_async(
+                        client,
+                        NULL,
+                        BC_DBUS_NAME,
+                        NODE_OBJECT_PATH_PREFIX "/node_2d0",
+                        NODE_INTERFACE,
+                        "GetUnitProperties",
+                        test_on_get_unit_properties_reply,
+                        result,
+                        "ss",
+                        unit,
+                        "org.freedesktop.systemd1.Unit");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call GetUnitProperties: %s\n", strerror(-r));
+                return false;
+        }
+        return true;
+}
+
+bool test_controller_single_flight_get_unit_properties(Controller *controller, sd_bus *client) {
+        CallResult results[NUMBER_OF_CALLS] = { 0 };
+        CallResult other_result = { 0 };
+        bool result = true;
+
+        for (int i = 0; i < NUMBER_OF_CALLS && result; i++) {
+                result = call_get_unit_properties(client, "foo.service", &results[i]);
+        }
+        result = result && call_get_unit_properties(client, "bar.service", &other_result);
+        dispatch_all(controller);
+
+        /* One call per distinct unit reaches the agent */
+        if (result && n_held_requests != 2) {
+                fprintf(stderr,
+                        "FAILED: expected %d identical and 1 other call to reach the agent as 2, but got %d\n",
+                        NUMBER_OF_CALLS,
+                        n_held_requests);
+                result = false;
+        }
+        result = result && reply_held_requests(controller);
+        result = result && check_results("GetUnitProperties", results, NUMBER_OF_CALLS, "foo.service");
+        result = result && check_results("GetUnitProperties", &other_result, 1, "bar.service");
+
+        /* Once answered, the next call goes to the agent again */
+        if (result) {
+                clear_results(results, NUMBER_OF_CALLS);
+                result = call_get_unit_properties(client, "foo.service", &results[0]);
+                dispatch_all(controller);
+                if (result && n_held_requests != 1) {
+                        fprintf(stderr,
+                                "FAILED: expected a new call to reach the agent, but got %d\n",
+                                n_held_requests);
+                        result = false;
+                }
+                result = result && reply_held_requests(controller) &&
+                                check_results("GetUnitProperties", results, 1, "foo.service");
+        }
+
+        clear_held_requests();
+        clear_results(results, NUMBER_OF_CALLS);
+        clear_results(&other_result, 1);
+        return result;
+}
+
+bool test_controller_single_flight_list_units(Controller *controller, sd_bus *client) {
+        CallResult results[NUMBER_OF_CALLS] = { 0 };
+        bool result = true;
+
+        for (int i = 0; i < NUMBER_OF_CALLS && result; i++) {
+                int r = sd_bus_call_method_async(
+                                client,
+                                NULL,
+                                BC_DBUS_NAME,
+                                BC_CONTROLLER_OBJECT_PATH,
+                                CONTROLLER_INTERFACE,
+                                "ListUnits",
+                                test_on_list_units_reply,
+                                &results[i],
+                                "");
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not call ListUnits: %s\n", strerror(-r));
+                        result = false;
+                }
+        }
+        dispatch_all(controller);
+
+        if (result && n_held_requests != 1) {
+                fprintf(stderr,
+                        "FAILED: expected %d identical ListUnits to reach the agent once, but got %d\n",
+                        NUMBER_OF_CALLS,
+                        n_held_requests);
+                result = false;
+        }
+        result = result && reply_held_requests(controller);
+        result = result && check_results("ListUnits", results, NUMBER_OF_CALLS, "foo.service");
+
+        clear_held_requests();
+        clear_results(results, NUMBER_OF_CALLS);
+        return result;
+}
+
+bool test_controller_single_flight() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        if (controller == NULL) {
+                fprintf(stderr, "FAILED: could not create controller\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        Node *node = controller_add_node(controller, "node-0");
+        if (client == NULL || node == NULL || !node_export(node)) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        return test_controller_single_flight_get_unit_properties(controller, client) &&
+                        test_controller_single_flight_list_units(controller, client);
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_single_flight();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,412 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+
+#define NUMBER_OF_MONITORS 20
+#define NUMBER_OF_SIGNALS 10
+#define SIGNAL_BATCH_SIZE 1000
+#define NUMBER_OF_UNITS 10000
+
+typedef struct TestMonitor {
+        Subscription *sub;
+        int n_state_changed;
+} TestMonitor;
+
+static TestMonitor monitors[NUMBER_OF_MONITORS];
+static long n_received = 0;
+
+static int test_on_unit_new(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, UNUSED const char *reason) {
+        return 0;
+}
+
+static int test_on_unit_removed(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, UNUSED const char *reason) {
+        return 0;
+}
+
+static int test_on_unit_property_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *interface,
+                UNUSED sd_bus_message *m) {
+        return 0;
+}
+
+static int test_on_unit_state_changed(
+                void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *active_state,
+                UNUSED const char *substate,
+                UNUSED const char *reason) {
+        TestMonitor *test_monitor = monitor;
+        test_monitor->n_state_changed++;
+        n_received++;
+        return 0;
+}
+
+bool emit_state_changes(
+                Controller *controller, sd_bus *agent_bus, const char *unit, int n_signals, long n_expected) {
+        long n_target = n_received + n_expected;
+        for (int i = 0; i < n_signals; i++) {
+                int r = sd_bus_emit_signal(
+                                agent_bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitStateChanged",
+                                "ssss",
+                                unit,
+                                "active",
+                                "running",
+                                "real");
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not emit signal: %s\n", strerror(-r));
+                        return false;
+                }
+
+                /* Dispatch regularly to keep the write queue of the agent bus bounded */
+                if ((i + 1) % SIGNAL_BATCH_SIZE != 0 && i + 1 != n_signals) {
+                        continue;
+                }
+                dispatch_all(controller);
+        }
+
+        while (n_received < n_target) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: received %ld of %ld events\n", n_received, n_target);
+                        return false;
+                }
+        }
+        if (n_received != n_target) {
+                fprintf(stderr, "FAILED: received %ld events, expected %ld\n", n_received, n_target);
+                return false;
+        }
+        return true;
+}
+
+bool check_state_changes(const char *step, int expected_wildcard, int expected_unit) {
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                int expected = i % 2 == 0 ? expected_unit : expected_wildcard;
+                if (monitors[i].sub == NULL) {
+                        continue;
+                }
+                if (monitors[i].n_state_changed != expected) {
+                        fprintf(stderr,
+                                "FAILED: %s: expected monitor %d to get %d events, but got %d\n",
+                                step,
+                                i,
+                                expected,
+                                monitors[i].n_state_changed);
+                        return false;
+                }
+                monitors[i].n_state_changed = 0;
+        }
+        return true;
+}
+
+bool test_controller_subscription_fan_out() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, NULL, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        /*
+         * Even monitors watch the unit, odd monitors watch all units. Every
+         * tenth monitor watches both and must still get each event only once.
+         */
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+                if (sub == NULL) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return false;
+                }
+                sub->monitor = &monitors[i];
+                sub->handle_unit_new = test_on_unit_new;
+                sub->handle_unit_removed = test_on_unit_removed;
+                sub->handle_unit_state_changed = test_on_unit_state_changed;
+                sub->handle_unit_property_changed = test_on_unit_property_changed;
+
+                bool added = subscription_add_unit(sub, i % 2 == 0 ? "foo.service" : SYMBOL_WILDCARD);
+                if (added && i % 10 == 0) {
+                        added = subscription_add_unit(sub, SYMBOL_WILDCARD);
+                }
+                if (!added) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return false;
+                }
+
+                controller_add_subscription(controller, sub);
+                monitors[i].sub = sub;
+        }
+
+        long n_expected = (long) NUMBER_OF_SIGNALS * NUMBER_OF_MONITORS;
+        if (!emit_state_changes(controller, agent_bus, "foo.service", NUMBER_OF_SIGNALS, n_expected)) {
+                return false;
+        }
+        if (!check_state_changes("subscribed unit", NUMBER_OF_SIGNALS, NUMBER_OF_SIGNALS)) {
+                return false;
+        }
+
+        /* Units without own subscriptions only reach the wildcard monitors */
+        n_expected = 10 * (NUMBER_OF_MONITORS / 2 + NUMBER_OF_MONITORS / 10);
+        if (!emit_state_changes(controller, agent_bus, "bar.service", 10, n_expected)) {
+                return false;
+        }
+        for (int i = 0; i < NUMBER_OF_MONITORS; i++) {
+                int expected = (i % 2 == 1 || i % 10 == 0) ? 10 : 0;
+                if (monitors[i].n_state_changed != expected) {
+                        fprintf(stderr,
+                                "FAILED: expected monitor %d to get %d events for unsubscribed unit, but got %d\n",
+                                i,
+                                expected,
+                                monitors[i].n_state_changed);
+                        return false;
+                }
+                monitors[i].n_state_changed = 0;
+        }
+
+        /* Dropping the wildcard monitors leaves only the unit monitors */
+        for (int i = 1; i < NUMBER_OF_MONITORS; i += 2) {
+                controller_remove_subscription(controller, monitors[i].sub);
+                monitors[i].sub = NULL;
+        }
+        if (!emit_state_changes(controller, agent_bus, "foo.service", 10, 10 * (NUMBER_OF_MONITORS / 2))) {
+                return false;
+        }
+        if (!check_state_changes("wildcard monitors removed", 0, 10)) {
+                return false;
+        }
+
+        return true;
+}
+
+bool add_test_monitor(Controller *controller, int i, const char *unit, const char *other_unit) {
+        _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+        if (sub == NULL) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return false;
+        }
+        sub->monitor = &monitors[i];
+        sub->handle_unit_new = test_on_unit_new;
+        sub->handle_unit_removed = test_on_unit_removed;
+        sub->handle_unit_state_changed = test_on_unit_state_changed;
+        sub->handle_unit_property_changed = test_on_unit_property_changed;
+
+        if (!subscription_add_unit(sub, unit) || (other_unit != NULL && !subscription_add_unit(sub, other_unit))) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return false;
+        }
+
+        controller_add_subscription(controller, sub);
+        monitors[i].sub = sub;
+        return true;
+}
+
+/* Emits an event for unit and checks which of the first n monitors got it */
+bool expect_receivers(Controller *controller, sd_bus *agent_bus, const char *unit, int n, const bool *expected) {
+        long n_expected = 0;
+        for (int i = 0; i < n; i++) {
+                n_expected += expected[i] ? 1 : 0;
+        }
+        if (!emit_state_changes(controller, agent_bus, unit, 1, n_expected)) {
+                return false;
+        }
+
+        bool result = true;
+        for (int i = 0; i < n; i++) {
+                if (monitors[i].n_state_changed != (expected[i] ? 1 : 0)) {
+                        fprintf(stderr,
+                                "FAILED: expected monitor %d to get %d events for %s, but got %d\n",
+                                i,
+                                expected[i] ? 1 : 0,
+                                unit,
+                                monitors[i].n_state_changed);
+                        result = false;
+                }
+                monitors[i].n_state_changed = 0;
+        }
+        return result;
+}
+
+bool test_controller_subscription_globs() {
+        memset(monitors, 0, sizeof(monitors));
+
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, NULL, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        bool result = add_test_monitor(controller, 0, "app-*.service", NULL);
+        result = result && add_test_monitor(controller, 1, "*.timer", NULL);
+        result = result && add_test_monitor(controller, 2, "app-web.service", NULL);
+        result = result && add_test_monitor(controller, 3, SYMBOL_WILDCARD, NULL);
+        result = result && add_test_monitor(controller, 4, "app-*.service", SYMBOL_WILDCARD);
+        result = result && add_test_monitor(controller, 5, "app-web.service", "app-???.service");
+        if (!result) {
+                return false;
+        }
+
+        /* Every monitor gets each event once, no matter how many of its units match */
+        const bool web[] = { true, false, true, true, true, true };
+        const bool db[] = { true, false, false, true, true, false };
+        const bool timer[] = { false, true, false, true, true, false };
+        const bool other[] = { false, false, false, true, true, false };
+        result = result && expect_receivers(controller, agent_bus, "app-web.service", 6, web);
+        result = result && expect_receivers(controller, agent_bus, "app-db.service", 6, db);
+        result = result && expect_receivers(controller, agent_bus, "app-db.service", 6, db);
+        result = result && expect_receivers(controller, agent_bus, "backup.timer", 6, timer);
+        result = result && expect_receivers(controller, agent_bus, "other.socket", 6, other);
+        if (!result) {
+                return false;
+        }
+
+        /* Routes of units only matched by globs follow the removal of a glob subscription */
+        controller_remove_subscription(controller, monitors[0].sub);
+        monitors[0].sub = NULL;
+        controller_remove_subscription(controller, monitors[4].sub);
+        monitors[4].sub = NULL;
+
+        const bool web_after[] = { false, false, true, true, false, true };
+        const bool db_after[] = { false, false, false, true, false, false };
+        const bool timer_after[] = { false, true, false, true, false, false };
+        result = result && expect_receivers(controller, agent_bus, "app-web.service", 6, web_after);
+        result = result && expect_receivers(controller, agent_bus, "app-db.service", 6, db_after);
+        result = result && expect_receivers(controller, agent_bus, "backup.timer", 6, timer_after);
+
+        return result;
+}
+
+bool emit_unit_states(Controller *controller, sd_bus *agent_bus, const char *substate) {
+        char unit[64];
+        for (int i = 0; i < NUMBER_OF_UNITS; i++) {
+                snprintf(unit, sizeof(unit), "transient-%d.service", i);
+                int r = sd_bus_emit_signal(
+                                agent_bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitStateChanged",
+                                "ssss",
+                                unit,
+                                "active",
+                                substate,
+                                "real");
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not emit signal: %s\n", strerror(-r));
+                        return false;
+                }
+                if ((i + 1) % SIGNAL_BATCH_SIZE == 0) {
+                        dispatch_all(controller);
+                }
+        }
+        dispatch_all(controller);
+        return true;
+}
+
+/* Measures the heap used to keep the state of many subscribed units */
+bool test_controller_subscription_state_memory() {
+        memset(monitors, 0, sizeof(monitors));
+
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, NULL, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+        if (sub == NULL) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return false;
+        }
+        sub->monitor = &monitors[0];
+        sub->handle_unit_new = test_on_unit_new;
+        sub->handle_unit_removed = test_on_unit_removed;
+        sub->handle_unit_state_changed = test_on_unit_state_changed;
+        sub->handle_unit_property_changed = test_on_unit_property_changed;
+
+        char unit[64];
+        for (int i = 0; i < NUMBER_OF_UNITS; i++) {
+                snprintf(unit, sizeof(unit), "transient-%d.service", i);
+                if (!subscription_add_unit(sub, unit)) {
+                        fprintf(stderr, "FAILED: out of memory\n");
+                        return false;
+                }
+        }
+        controller_add_subscription(controller, sub);
+
+        /* Let the fake agent receive the subscriptions before measuring */
+        dispatch_all(controller);
+
+        /* The first state of each unit is stored, later ones replace it */
+        size_t before = mallinfo2().uordblks;
+        if (!emit_unit_states(controller, agent_bus, "start-pre") ||
+            !emit_unit_states(controller, agent_bus, "running")) {
+                return false;
+        }
+        size_t after = mallinfo2().uordblks;
+
+        if (monitors[0].n_state_changed != 2 * NUMBER_OF_UNITS) {
+                fprintf(stderr,
+                        "FAILED: expected %d state changes, got %d\n",
+                        2 * NUMBER_OF_UNITS,
+                        monitors[0].n_state_changed);
+                return false;
+        }
+
+        long per_unit = ((long) after - (long) before) / NUMBER_OF_UNITS;
+        fprintf(stdout, "state of %d units: %ld bytes per unit\n", NUMBER_OF_UNITS, per_unit);
+        if (per_unit > 8) {
+                fprintf(stderr, "FAILED: expected the unit state to need no heap memory\n");
+                return false;
+        }
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_subscription_fan_out();
+        result = result && test_controller_subscription_globs();
+        result = result && test_controller_subscription_state_memory();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,641 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/bus/utils.h"
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/time-util.h"
+
+#include "controller/controller.h"
+#include "controller/monitor.h"
+#include "controller/node.h"
+#include "controller/test/fixture.h"
+#include "controller/unit_cache.h"
+
+#define NUMBER_OF_UNITS 1000
+#define NUMBER_OF_LISTINGS 100
+
+static int n_list_units = 0;
+static int n_replies = 0;
+static int load_result = 0;
+
+/* Events received by the test subscription, in order of arrival */
+static char received[256] = "";
+static long n_received = 0;
+
+static void record_event(const char *event) {
+        n_received++;
+        if (strlen(received) + strlen(event) + 2 < sizeof(received)) {
+                strcat(received, event);
+                strcat(received, ";");
+        }
+}
+
+static int test_on_unit_new(
+                UNUSED void *monitor, UNUSED const char *node, UNUSED const char *unit, const char *reason) {
+        record_event(reason);
+        return 0;
+}
+
+static int test_on_unit_property_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *interface,
+                sd_bus_message *m) {
+        const char *property = NULL;
+        const char *value = NULL;
+        int r = sd_bus_message_skip(m, "ss");
+        if (r >= 0) {
+                r = sd_bus_message_read(m, "a{sv}", 1, &property, "s", &value);
+        }
+        record_event(r >= 0 ? value : "invalid");
+        return 0;
+}
+
+static int test_on_unit_state_changed(
+                UNUSED void *monitor,
+                UNUSED const char *node,
+                UNUSED const char *unit,
+                UNUSED const char *active_state,
+                const char *substate,
+                UNUSED const char *reason) {
+        record_event(substate);
+        return 0;
+}
+
+/* The fake agent has NUMBER_OF_UNITS running units */
+static int reply_list_units(sd_bus_message *m) {
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        int r = sd_bus_message_new_method_return(m, &reply);
+        if (r >= 0) {
+                r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        }
+        for (int i = 0; i < NUMBER_OF_UNITS && r >= 0; i++) {
+                char name[64];
+                snprintf(name, sizeof(name), "unit-%d.service", i);
+                r = sd_bus_message_append(
+                                reply,
+                                UNIT_INFO_STRUCT_TYPESTRING,
+                                name,
+                                "Test unit",
+                                "loaded",
+                                "active",
+                                "running",
+                                "",
+                                "/org/freedesktop/systemd1/unit/test",
+                                0,
+                                "",
+                                "/");
+        }
+        if (r >= 0) {
+                r = sd_bus_message_close_container(reply);
+        }
+        if (r >= 0) {
+                r = sd_bus_send(NULL, reply, NULL);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not reply to ListUnits: %s\n", strerror(-r));
+        }
+        return r;
+}
+
+/* If userdata is set, the first ListUnits call is stored there instead of being answered */
+static int test_on_agent_message(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        sd_bus_message **held_request = userdata;
+
+        if (!sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "ListUnits")) {
+                return 0;
+        }
+        n_list_units++;
+
+        if (held_request != NULL && *held_request == NULL) {
+                *held_request = sd_bus_message_ref(m);
+                return 1;
+        }
+        (void) reply_list_units(m);
+        return 1;
+}
+
+static int test_on_list_units(AgentRequest *req, sd_bus_message *m, UNUSED sd_bus_error *ret_error) {
+        n_replies++;
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                load_result = -sd_bus_message_get_errno(m);
+                return 0;
+        }
+        load_result = unit_cache_load(req->node->unit_cache, m);
+        return 0;
+}
+
+bool wait_for_listing(Controller *controller, int n_expected) {
+        while (n_replies < n_expected) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: got %d of %d ListUnits replies\n", n_replies, n_expected);
+                        return false;
+                }
+        }
+        if (load_result < 0) {
+                fprintf(stderr, "FAILED: could not load unit cache: %s\n", strerror(-load_result));
+                return false;
+        }
+        return true;
+}
+
+/* Looks up a unit in what the cache returns, expected_sub_state NULL means it must not be listed */
+bool check_unit(sd_bus *bus,
+                Node *node,
+                const char *name,
+                const char *expected_load_state,
+                const char *expected_sub_state) {
+        _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+        int r = sd_bus_message_new_signal(bus, &m, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, "Test");
+        if (r >= 0) {
+                r = unit_cache_append(node->unit_cache, m);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_seal(m, 1, 0);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not encode unit cache: %s\n", strerror(-r));
+                return false;
+        }
+
+        for (;;) {
+                _cleanup_unit_ UnitInfo *unit = new_unit();
+                r = unit != NULL ? bus_parse_unit_info(m, unit) : -ENOMEM;
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not parse unit cache: %s\n", strerror(-r));
+                        return false;
+                }
+                if (r == 0) {
+                        break;
+                }
+                if (!streq(unit->id, name)) {
+                        continue;
+                }
+                if (expected_sub_state == NULL) {
+                        fprintf(stderr, "FAILED: unit %s is still cached\n", name);
+                        return false;
+                }
+                if (!streq(unit->load_state, expected_load_state) || !streq(unit->sub_state, expected_sub_state)) {
+                        fprintf(stderr,
+                                "FAILED: expected unit %s to be %s/%s, but got %s/%s\n",
+                                name,
+                                expected_load_state,
+                                expected_sub_state,
+                                unit->load_state,
+                                unit->sub_state);
+                        return false;
+                }
+                return true;
+        }
+
+        if (expected_sub_state != NULL) {
+                fprintf(stderr, "FAILED: unit %s is not cached\n", name);
+                return false;
+        }
+        return true;
+}
+
+bool test_controller_unit_cache_events() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        /* Nothing is cached before the first listing */
+        if (unit_cache_is_valid(node->unit_cache) || node->unit_cache_subscription != NULL) {
+                fprintf(stderr, "FAILED: expected empty unit cache before the first listing\n");
+                return false;
+        }
+
+        _cleanup_agent_request_ AgentRequest *req = node_request_stale_unit_cache_refresh(
+                        node, test_on_list_units, NULL, NULL);
+        if (req == NULL || !wait_for_listing(controller, 1)) {
+                fprintf(stderr, "FAILED: could not list units of stale cache\n");
+                return false;
+        }
+        agent_request_unrefp(&req);
+        if (!check_unit(agent_bus, node, "unit-1.service", "loaded", "running")) {
+                return false;
+        }
+
+        /* A valid cache is not listed again, unless forced */
+        req = node_request_stale_unit_cache_refresh(node, test_on_list_units, NULL, NULL);
+        if (req != NULL || n_list_units != 1) {
+                fprintf(stderr, "FAILED: expected valid cache not to be listed again\n");
+                return false;
+        }
+
+        /* The cache follows the events of the node */
+        int r = sd_bus_emit_signal(
+                        agent_bus,
+                        INTERNAL_AGENT_OBJECT_PATH,
+                        INTERNAL_AGENT_INTERFACE,
+                        "UnitStateChanged",
+                        "ssss",
+                        "unit-1.service",
+                        "inactive",
+                        "dead",
+                        "real");
+        if (r >= 0) {
+                r = sd_bus_emit_signal(
+                                agent_bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitNew",
+                                "ss",
+                                "new.service",
+                                "real");
+        }
+        if (r >= 0) {
+                r = sd_bus_emit_signal(
+                                agent_bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitPropertiesChanged",
+                                "ssa{sv}",
+                                "unit-3.service",
+                                "org.freedesktop.systemd1.Unit",
+                                1,
+                                "LoadState",
+                                "s",
+                                "not-found");
+        }
+        if (r >= 0) {
+                r = sd_bus_emit_signal(
+                                agent_bus,
+                                INTERNAL_AGENT_OBJECT_PATH,
+                                INTERNAL_AGENT_INTERFACE,
+                                "UnitRemoved",
+                                "s",
+                                "unit-2.service");
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not emit signal: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+
+        if (!check_unit(agent_bus, node, "unit-1.service", "loaded", "dead") ||
+            !check_unit(agent_bus, node, "new.service", "loaded", "dead") ||
+            !check_unit(agent_bus, node, "unit-3.service", "not-found", "running") ||
+            !check_unit(agent_bus, node, "unit-2.service", NULL, NULL)) {
+                return false;
+        }
+
+        /* A forced refresh replaces the cached units */
+        req = node_request_unit_cache_refresh(node, test_on_list_units, NULL, NULL);
+        if (req == NULL || !wait_for_listing(controller, 2) || n_list_units != 2) {
+                fprintf(stderr, "FAILED: expected forced refresh to list units again\n");
+                return false;
+        }
+        if (!check_unit(agent_bus, node, "unit-1.service", "loaded", "running") ||
+            !check_unit(agent_bus, node, "new.service", NULL, NULL)) {
+                return false;
+        }
+
+        /* An invalidated cache ignores events until it is listed again */
+        unit_cache_invalidate(node->unit_cache);
+        r = sd_bus_emit_signal(
+                        agent_bus,
+                        INTERNAL_AGENT_OBJECT_PATH,
+                        INTERNAL_AGENT_INTERFACE,
+                        "UnitNew",
+                        "ss",
+                        "new.service",
+                        "real");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not emit signal: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+        if (hashmap_count(node->unit_cache->units) != 0) {
+                fprintf(stderr, "FAILED: expected invalidated cache to stay empty\n");
+                return false;
+        }
+
+        return true;
+}
+
+/* The unit cache and another subscription of the same unit both get all events of a batch */
+bool test_controller_unit_cache_event_batch() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        n_replies = 0;
+        _cleanup_agent_request_ AgentRequest *req = node_request_unit_cache_refresh(
+                        node, test_on_list_units, NULL, NULL);
+        if (req == NULL || !wait_for_listing(controller, 1)) {
+                fprintf(stderr, "FAILED: could not list units\n");
+                return false;
+        }
+
+        _cleanup_subscription_ Subscription *sub = subscription_new("node-0");
+        if (sub == NULL || !subscription_add_unit(sub, "unit-1.service")) {
+                fprintf(stderr, "FAILED: out of memory\n");
+                return false;
+        }
+        sub->handle_unit_new = test_on_unit_new;
+        sub->handle_unit_state_changed = test_on_unit_state_changed;
+        sub->handle_unit_property_changed = test_on_unit_property_changed;
+        controller_add_subscription(controller, sub);
+
+        _cleanup_sd_bus_message_ sd_bus_message *batch = new_event_batch(agent_bus);
+        if (batch == NULL) {
+                return false;
+        }
+        int r = append_entry(
+                        batch,
+                        "UnitPropertiesChanged",
+                        "(ssa{sv})",
+                        "ssa{sv}",
+                        "unit-1.service",
+                        "org.freedesktop.systemd1.Unit",
+                        1,
+                        "LoadState",
+                        "s",
+                        "not-found");
+        if (r >= 0) {
+                r = append_entry(batch, "UnitNew", "(ss)", "ss", "unit-1.service", "real");
+        }
+        if (r >= 0) {
+                r = append_entry(
+                                batch,
+                                "UnitStateChanged",
+                                "(ssss)",
+                                "ssss",
+                                "unit-1.service",
+                                "inactive",
+                                "dead",
+                                "real");
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not append events: %s\n", strerror(-r));
+                return false;
+        }
+        bool result = send_event_batch(agent_bus, batch) >= 0;
+        while (result && n_received < 3) {
+                r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: received %ld of 3 events\n", n_received);
+                        result = false;
+                }
+        }
+        controller_remove_subscription(controller, sub);
+        if (!result) {
+                return false;
+        }
+
+        if (!streq(received, "not-found;real;dead;")) {
+                fprintf(stderr, "FAILED: unexpected events '%s'\n", received);
+                return false;
+        }
+        return check_unit(agent_bus, node, "unit-1.service", "not-found", "dead");
+}
+
+/*
+ * The agent copies listings of more than a slice of units in turns with its other
+ * traffic, so events newer than a listing may arrive before the listing itself.
+ */
+bool test_controller_unit_cache_listing_race() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *held_request = NULL;
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(
+                        controller, node, test_on_agent_message, &held_request);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        n_replies = 0;
+        _cleanup_agent_request_ AgentRequest *req = node_request_unit_cache_refresh(
+                        node, test_on_list_units, NULL, NULL);
+        if (req == NULL) {
+                fprintf(stderr, "FAILED: could not list units\n");
+                return false;
+        }
+        while (held_request == NULL) {
+                int r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: expected a ListUnits call\n");
+                        return false;
+                }
+        }
+
+        /* Changes after the listing was taken, sent while it is still being copied */
+        _cleanup_sd_bus_message_ sd_bus_message *batch = new_event_batch(agent_bus);
+        if (batch == NULL) {
+                return false;
+        }
+        int r = append_entry(
+                        batch,
+                        "UnitStateChanged",
+                        "(ssss)",
+                        "ssss",
+                        "unit-1.service",
+                        "inactive",
+                        "dead",
+                        "real");
+        if (r >= 0) {
+                r = append_entry(batch, "UnitRemoved", "(s)", "s", "unit-2.service");
+        }
+        if (r >= 0) {
+                r = append_entry(batch, "UnitNew", "(ss)", "ss", "new.service", "real");
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not append events: %s\n", strerror(-r));
+                return false;
+        }
+        if (send_event_batch(agent_bus, batch) < 0) {
+                return false;
+        }
+        dispatch_all(controller);
+
+        if (reply_list_units(held_request) < 0 || !wait_for_listing(controller, 1)) {
+                return false;
+        }
+        return check_unit(agent_bus, node, "unit-1.service", "loaded", "dead") &&
+                        check_unit(agent_bus, node, "unit-2.service", NULL, NULL) &&
+                        check_unit(agent_bus, node, "new.service", "loaded", "dead") &&
+                        check_unit(agent_bus, node, "unit-3.service", "loaded", "running");
+}
+
+static int test_on_list_units_cached(sd_bus_message *m, void *userdata, UNUSED sd_bus_error *ret_error) {
+        sd_bus_message **reply = userdata;
+        *reply = sd_bus_message_ref(m);
+        return 0;
+}
+
+/* The listing of a node is cached when it replies, so its events are kept while other nodes are waited for */
+bool test_controller_unit_cache_list_units_cached() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *fast_node = controller_add_node(controller, "node-fast");
+        Node *slow_node = controller_add_node(controller, "node-slow");
+        if (fast_node == NULL || slow_node == NULL) {
+                fprintf(stderr, "FAILED: could not add nodes\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *held_request = NULL;
+        _cleanup_sd_bus_ sd_bus *fast_bus = connect_fake_agent(controller, fast_node, test_on_agent_message, NULL);
+        _cleanup_sd_bus_ sd_bus *slow_bus = connect_fake_agent(
+                        controller, slow_node, test_on_agent_message, &held_request);
+        _cleanup_sd_bus_ sd_bus *client = connect_api_client(controller, NULL);
+        if (fast_bus == NULL || slow_bus == NULL || client == NULL) {
+                return false;
+        }
+
+        _cleanup_sd_bus_message_ sd_bus_message *reply = NULL;
+        int r = sd_bus_call_method_async(
+                        client,
+                        NULL,
+                        BC_DBUS_NAME,
+                        BC_CONTROLLER_OBJECT_PATH,
+                        CONTROLLER_INTERFACE,
+                        "ListUnitsCached",
+                        test_on_list_units_cached,
+                        &reply,
+                        "b",
+                        false);
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not call ListUnitsCached: %s\n", strerror(-r));
+                return false;
+        }
+        while (held_request == NULL || !unit_cache_is_valid(fast_node->unit_cache)) {
+                r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: expected the listing of node-fast to be cached right away\n");
+                        return false;
+                }
+        }
+
+        r = sd_bus_emit_signal(
+                        fast_bus,
+                        INTERNAL_AGENT_OBJECT_PATH,
+                        INTERNAL_AGENT_INTERFACE,
+                        "UnitStateChanged",
+                        "ssss",
+                        "unit-1.service",
+                        "inactive",
+                        "dead",
+                        "real");
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not emit signal: %s\n", strerror(-r));
+                return false;
+        }
+        dispatch_all(controller);
+
+        if (reply_list_units(held_request) < 0) {
+                return false;
+        }
+        while (reply == NULL) {
+                r = sd_event_run(controller->event, USEC_PER_SEC);
+                if (r <= 0) {
+                        fprintf(stderr, "FAILED: expected a reply to ListUnitsCached\n");
+                        return false;
+                }
+        }
+        if (sd_bus_message_is_method_error(reply, NULL)) {
+                fprintf(stderr, "FAILED: ListUnitsCached failed: %s\n", sd_bus_message_get_error(reply)->message);
+                return false;
+        }
+
+        return check_unit(fast_bus, fast_node, "unit-1.service", "loaded", "dead") &&
+                        check_unit(slow_bus, slow_node, "unit-1.service", "loaded", "running");
+}
+
+bool test_controller_unit_cache_listing_time() {
+        _test_cleanup_controller_ Controller *controller = controller_new();
+        Node *node = controller_add_node(controller, "node-0");
+        if (node == NULL) {
+                fprintf(stderr, "FAILED: could not add node\n");
+                return false;
+        }
+
+        _cleanup_sd_bus_ sd_bus *agent_bus = connect_fake_agent(controller, node, test_on_agent_message, NULL);
+        if (agent_bus == NULL) {
+                return false;
+        }
+
+        /* Listing from the agent, even one answering right away */
+        n_replies = 0;
+        uint64_t start = get_time_micros_monotonic();
+        for (int i = 0; i < NUMBER_OF_LISTINGS; i++) {
+                _cleanup_agent_request_ AgentRequest *req = node_request_unit_cache_refresh(
+                                node, test_on_list_units, NULL, NULL);
+                if (req == NULL || !wait_for_listing(controller, i + 1)) {
+                        return false;
+                }
+        }
+        uint64_t agent_elapsed = get_time_micros_monotonic() - start;
+
+        /* Listing from the cache */
+        start = get_time_micros_monotonic();
+        for (int i = 0; i < NUMBER_OF_LISTINGS; i++) {
+                _cleanup_sd_bus_message_ sd_bus_message *m = NULL;
+                int r = sd_bus_message_new_signal(
+                                agent_bus, &m, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, "Test");
+                if (r >= 0) {
+                        r = unit_cache_append(node->unit_cache, m);
+                }
+                if (r < 0) {
+                        fprintf(stderr, "FAILED: could not encode unit cache: %s\n", strerror(-r));
+                        return false;
+                }
+        }
+        uint64_t cache_elapsed = get_time_micros_monotonic() - start;
+
+        fprintf(stdout,
+                "%d listings of %d units: agent %" PRIu64 "ms, cache %" PRIu64 "ms\n",
+                NUMBER_OF_LISTINGS,
+                NUMBER_OF_UNITS,
+                agent_elapsed / USEC_PER_MSEC,
+                cache_elapsed / USEC_PER_MSEC);
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_controller_unit_cache_events();
+        result = result && test_controller_unit_cache_event_batch();
+        result = result && test_controller_unit_cache_listing_race();
+        result = result && test_controller_unit_cache_list_units_cached();
+        result = result && test_controller_unit_cache_listing_time();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
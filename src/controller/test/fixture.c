@@ -0,0 +1,139 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "libbluechi/bus/bus.h"
+#include "libbluechi/common/protocol.h"
+
+#include "fixture.h"
+
+void controller_stop_and_unref(Controller *controller) {
+        if (controller) {
+                controller_stop(controller);
+        }
+        controller_unrefp(&controller);
+}
+
+sd_bus *connect_client(sd_event *event, int fd, sd_bus_message_handler_t filter, void *userdata) {
+        _cleanup_sd_bus_ sd_bus *bus = NULL;
+        int r = sd_bus_new(&bus);
+        if (r >= 0) {
+                r = sd_bus_set_fd(bus, fd, fd);
+        }
+        if (r >= 0 && filter != NULL) {
+                r = sd_bus_add_filter(bus, NULL, filter, userdata);
+        }
+        if (r >= 0) {
+                r = sd_bus_start(bus);
+        }
+        if (r >= 0) {
+                r = sd_bus_attach_event(bus, event, SD_EVENT_PRIORITY_NORMAL);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not set up client bus: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&bus);
+}
+
+sd_bus *connect_fake_agent(Controller *controller, Node *node, sd_bus_message_handler_t filter, void *userdata) {
+        int fds[2] = { -1, -1 };
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+                fprintf(stderr, "FAILED: could not create socket pair: %s\n", strerror(errno));
+                return NULL;
+        }
+
+        _cleanup_sd_bus_ sd_bus *node_bus = peer_bus_open_server(
+                        controller->event, "test-node-bus", BC_DBUS_NAME, fds[0]);
+        if (node_bus == NULL || !node_set_agent_bus(node, node_bus)) {
+                fprintf(stderr, "FAILED: could not set up node bus\n");
+                close(fds[1]);
+                return NULL;
+        }
+
+        return connect_client(controller->event, fds[1], filter, userdata);
+}
+
+sd_bus *connect_api_client(Controller *controller, sd_bus_message_handler_t filter) {
+        int fds[2] = { -1, -1 };
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+                fprintf(stderr, "FAILED: could not create socket pair: %s\n", strerror(errno));
+                return NULL;
+        }
+
+        controller->api_bus = peer_bus_open_server(controller->event, "test-api-bus", BC_DBUS_NAME, fds[0]);
+        if (controller->api_bus == NULL || !controller_export(controller)) {
+                fprintf(stderr, "FAILED: could not open test api bus\n");
+                close(fds[1]);
+                return NULL;
+        }
+
+        return connect_client(controller->event, fds[1], filter, NULL);
+}
+
+void dispatch_all(Controller *controller) {
+        while (sd_event_run(controller->event, 0) > 0) {
+                ;
+        }
+}
+
+bool is_agent_call(sd_bus_message *m) {
+        return sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, NULL) &&
+                        !sd_bus_message_is_method_call(m, INTERNAL_AGENT_INTERFACE, "Resync");
+}
+
+sd_bus_message *new_event_batch(sd_bus *agent_bus) {
+        _cleanup_sd_bus_message_ sd_bus_message *batch = NULL;
+        int r = sd_bus_message_new_signal(
+                        agent_bus, &batch, INTERNAL_AGENT_OBJECT_PATH, INTERNAL_AGENT_INTERFACE, "EventBatch");
+        if (r >= 0) {
+                r = sd_bus_message_open_container(batch, SD_BUS_TYPE_ARRAY, "(sv)");
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not create EventBatch: %s\n", strerror(-r));
+                return NULL;
+        }
+        return steal_pointer(&batch);
+}
+
+int append_entry(sd_bus_message *batch, const char *name, const char *contents, const char *types, ...) {
+        int r = sd_bus_message_open_container(batch, SD_BUS_TYPE_STRUCT, "sv");
+        if (r >= 0) {
+                r = sd_bus_message_append(batch, "s", name);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_open_container(batch, SD_BUS_TYPE_VARIANT, contents);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_open_container(batch, SD_BUS_TYPE_STRUCT, types);
+        }
+        if (r >= 0) {
+                va_list ap;
+                va_start(ap, types);
+                r = sd_bus_message_appendv(batch, types, ap);
+                va_end(ap);
+        }
+        for (int i = 0; i < 3 && r >= 0; i++) {
+                r = sd_bus_message_close_container(batch);
+        }
+        return r;
+}
+
+int send_event_batch(sd_bus *agent_bus, sd_bus_message *batch) {
+        int r = sd_bus_message_close_container(batch);
+        if (r >= 0) {
+                r = sd_bus_send(agent_bus, batch, NULL);
+        }
+        if (r < 0) {
+                fprintf(stderr, "FAILED: could not send EventBatch: %s\n", strerror(-r));
+        }
+        return r;
+}
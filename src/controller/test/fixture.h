@@ -0,0 +1,45 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#include "libbluechi/common/common.h"
+
+#include "controller/controller.h"
+#include "controller/node.h"
+
+/* Stops everything the test left behind before dropping the controller */
+void controller_stop_and_unref(Controller *controller);
+
+DEFINE_CLEANUP_FUNC(Controller, controller_stop_and_unref)
+#define _test_cleanup_controller_ _cleanup_(controller_stop_and_unrefp)
+
+/* Starts a client bus on the socket, passing every incoming message to the optional filter */
+sd_bus *connect_client(sd_event *event, int fd, sd_bus_message_handler_t filter, void *userdata);
+
+/* Connects the node to a fake agent over a socket pair and returns the agent end of the bus */
+sd_bus *connect_fake_agent(Controller *controller, Node *node, sd_bus_message_handler_t filter, void *userdata);
+
+/* Exports the controller on a peer api bus and returns the client end of it */
+sd_bus *connect_api_client(Controller *controller, sd_bus_message_handler_t filter);
+
+/* Runs the event loop until nothing is left to dispatch */
+void dispatch_all(Controller *controller);
+
+/* Returns true for calls the fake agent is expected to answer, i.e. all but the Resync sent on connect */
+bool is_agent_call(sd_bus_message *m);
+
+/* Creates an EventBatch signal of the fake agent, with the array of events opened */
+sd_bus_message *new_event_batch(sd_bus *agent_bus);
+
+/* Appends an EventBatch entry the same way the agent does, the arguments are appended as a struct of types */
+int append_entry(sd_bus_message *batch, const char *name, const char *contents, const char *types, ...);
+
+/* Closes the array of events and sends the batch */
+int send_event_batch(sd_bus *agent_bus, sd_bus_message *batch);
@@ -9,6 +9,7 @@ typedef struct Controller Controller;
 typedef struct Node Node;
 typedef struct AgentRequest AgentRequest;
 typedef struct Job Job;
+typedef struct JobGroup JobGroup;
 typedef struct Monitor Monitor;
 typedef struct ProxyMonitor ProxyMonitor;
 typedef struct Subscription Subscription;
@@ -16,3 +17,6 @@ typedef struct SubscribedUnit SubscribedUnit;
 typedef struct MonitorPeer MonitorPeer;
 typedef struct ProxyDependency ProxyDependency;
 typedef struct ProxyTarget ProxyTarget;
+typedef struct UnitCache UnitCache;
+typedef struct PendingFleetRequest PendingFleetRequest;
+typedef struct Rollout Rollout;
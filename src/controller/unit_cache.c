@@ -0,0 +1,492 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "libbluechi/bus/utils.h"
+#include "libbluechi/common/string-util.h"
+#include "libbluechi/common/time-util.h"
+#include "libbluechi/log/log.h"
+
+#include "monitor.h"
+#include "unit_cache.h"
+
+typedef struct CachedUnit {
+        const char *name; /* borrowed from unit->id */
+        UnitInfo *unit;
+} CachedUnit;
+
+static uint64_t cached_unit_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const CachedUnit *cached = item;
+        return hashmap_sip(cached->name, strlen(cached->name), seed0, seed1);
+}
+
+static int cached_unit_compare(const void *a, const void *b, UNUSED void *udata) {
+        const CachedUnit *cached_a = a;
+        const CachedUnit *cached_b = b;
+
+        return strcmp(cached_a->name, cached_b->name);
+}
+
+static void cached_unit_clear(void *item) {
+        CachedUnit *cached = item;
+        unit_unref(cached->unit);
+}
+
+/* What the events told about a unit while a listing was on its way */
+typedef struct UnitChange {
+        char *name;
+        uint64_t cookie; /* requested_cookie of the cache when the last event was received */
+        bool added;      /* The unit exists, even if the listing does not have it */
+        bool removed;
+        char *load_state; /* NULL if not changed */
+        char *active_state;
+        char *sub_state;
+} UnitChange;
+
+static uint64_t unit_change_hash(const void *item, uint64_t seed0, uint64_t seed1) {
+        const UnitChange *change = item;
+        return hashmap_sip(change->name, strlen(change->name), seed0, seed1);
+}
+
+static int unit_change_compare(const void *a, const void *b, UNUSED void *udata) {
+        const UnitChange *change_a = a;
+        const UnitChange *change_b = b;
+
+        return strcmp(change_a->name, change_b->name);
+}
+
+static void unit_change_clear(void *item) {
+        UnitChange *change = item;
+        free_and_null(change->name);
+        free_and_null(change->load_state);
+        free_and_null(change->active_state);
+        free_and_null(change->sub_state);
+}
+
+UnitCache *unit_cache_new(void) {
+        _cleanup_unit_cache_ UnitCache *cache = malloc0(sizeof(UnitCache));
+        if (cache == NULL) {
+                return NULL;
+        }
+
+        cache->units = hashmap_new(
+                        sizeof(CachedUnit), 0, 0, 0, cached_unit_hash, cached_unit_compare, cached_unit_clear, NULL);
+        if (cache->units == NULL) {
+                return NULL;
+        }
+        cache->timestamp = 0;
+
+        cache->changes = hashmap_new(
+                        sizeof(UnitChange), 0, 0, 0, unit_change_hash, unit_change_compare, unit_change_clear, NULL);
+        if (cache->changes == NULL) {
+                return NULL;
+        }
+        cache->requested_cookie = 0;
+        cache->loaded_cookie = 0;
+
+        return steal_pointer(&cache);
+}
+
+void unit_cache_free(UnitCache *cache) {
+        if (cache == NULL) {
+                return;
+        }
+
+        if (cache->units != NULL) {
+                hashmap_free(cache->units);
+        }
+        if (cache->changes != NULL) {
+                hashmap_free(cache->changes);
+        }
+        free(cache);
+}
+
+bool unit_cache_is_valid(UnitCache *cache) {
+        return cache->timestamp != 0;
+}
+
+void unit_cache_invalidate(UnitCache *cache) {
+        hashmap_clear(cache->units, false);
+        cache->timestamp = 0;
+
+        /* Listings still on their way are loaded without the events missed meanwhile */
+        hashmap_clear(cache->changes, false);
+        cache->requested_cookie = 0;
+        cache->loaded_cookie = 0;
+}
+
+/* To be called once the call for a listing to be loaded with unit_cache_load() has been sent */
+void unit_cache_listing_requested(UnitCache *cache, sd_bus_message *call) {
+        uint64_t cookie = 0;
+        if (sd_bus_message_get_cookie(call, &cookie) >= 0) {
+                cache->requested_cookie = cookie;
+        }
+}
+
+static bool unit_cache_listing_pending(UnitCache *cache) {
+        return cache->requested_cookie > cache->loaded_cookie;
+}
+
+/*
+ * Returns in ret the change of the unit to record an event in, or NULL if no listing
+ * is on its way. Returns -ENOMEM if out of memory.
+ */
+static int unit_cache_get_change(UnitCache *cache, const char *name, UnitChange **ret) {
+        *ret = NULL;
+        if (!unit_cache_listing_pending(cache)) {
+                return 0;
+        }
+
+        const UnitChange key = { .name = (char *) name };
+        UnitChange *change = (UnitChange *) hashmap_get(cache->changes, &key);
+        if (change == NULL) {
+                UnitChange new_change = { .name = strdup(name) };
+                if (new_change.name == NULL) {
+                        return -ENOMEM;
+                }
+                hashmap_set(cache->changes, &new_change);
+                if (hashmap_oom(cache->changes)) {
+                        free(new_change.name);
+                        return -ENOMEM;
+                }
+                change = (UnitChange *) hashmap_get(cache->changes, &key);
+        }
+
+        change->cookie = cache->requested_cookie;
+        *ret = change;
+        return 0;
+}
+
+static bool unit_cache_set(UnitCache *cache, UnitInfo *unit) {
+        const CachedUnit cached = { unit->id, unit };
+        CachedUnit *replaced = (CachedUnit *) hashmap_set(cache->units, &cached);
+        if (replaced != NULL) {
+                cached_unit_clear(replaced);
+        } else if (hashmap_oom(cache->units)) {
+                return false;
+        }
+        return true;
+}
+
+static UnitInfo *unit_cache_get(UnitCache *cache, const char *name) {
+        const CachedUnit key = { name, NULL };
+        const CachedUnit *cached = hashmap_get(cache->units, &key);
+        return cached != NULL ? cached->unit : NULL;
+}
+
+static void unit_cache_remove(UnitCache *cache, const char *name) {
+        const CachedUnit key = { name, NULL };
+        CachedUnit *deleted = (CachedUnit *) hashmap_delete(cache->units, &key);
+        if (deleted != NULL) {
+                cached_unit_clear(deleted);
+        }
+}
+
+static UnitInfo *unit_cache_add_unit(UnitCache *cache, const char *name);
+
+/* Applies the changes received since the listing with the given cookie was requested */
+static int unit_cache_apply_changes(UnitCache *cache, uint64_t cookie) {
+        void *item = NULL;
+        size_t i = 0;
+        while (hashmap_iter(cache->changes, &i, &item)) {
+                const UnitChange *change = item;
+                if (change->cookie < cookie) {
+                        continue;
+                }
+                if (change->removed) {
+                        unit_cache_remove(cache, change->name);
+                        continue;
+                }
+
+                /* Changes of units the events did not add only apply if the listing has the unit */
+                UnitInfo *unit = unit_cache_get(cache, change->name);
+                if (unit == NULL && change->added) {
+                        unit = unit_cache_add_unit(cache, change->name);
+                        if (unit == NULL) {
+                                return -ENOMEM;
+                        }
+                }
+                if (unit == NULL) {
+                        continue;
+                }
+                if ((change->load_state != NULL && !copy_str(&unit->load_state, change->load_state)) ||
+                    (change->active_state != NULL && !copy_str(&unit->active_state, change->active_state)) ||
+                    (change->sub_state != NULL && !copy_str(&unit->sub_state, change->sub_state))) {
+                        return -ENOMEM;
+                }
+        }
+
+        cache->loaded_cookie = cookie;
+        if (!unit_cache_listing_pending(cache)) {
+                hashmap_clear(cache->changes, false);
+        }
+        return 0;
+}
+
+/*
+ * Loads the reply of a listing requested with unit_cache_listing_requested(). Events received
+ * while the listing was on its way may be newer than the listing, so they are applied on top.
+ */
+int unit_cache_load(UnitCache *cache, sd_bus_message *m) {
+        uint64_t cookie = 0;
+        int r = sd_bus_message_get_reply_cookie(m, &cookie);
+        if (r < 0) {
+                return r;
+        }
+
+        hashmap_clear(cache->units, false);
+        cache->timestamp = 0;
+
+        r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        if (r < 0) {
+                unit_cache_invalidate(cache);
+                return r;
+        }
+
+        for (;;) {
+                _cleanup_unit_ UnitInfo *unit = new_unit();
+                if (unit == NULL) {
+                        r = -ENOMEM;
+                        break;
+                }
+
+                r = bus_parse_unit_info(m, unit);
+                if (r <= 0) {
+                        break;
+                }
+                if (unit->id == NULL || !unit_cache_set(cache, unit)) {
+                        r = -ENOMEM;
+                        break;
+                }
+                steal_pointer(&unit);
+        }
+        if (r >= 0) {
+                r = sd_bus_message_exit_container(m);
+        }
+        if (r >= 0) {
+                r = unit_cache_apply_changes(cache, cookie);
+        }
+        if (r < 0) {
+                unit_cache_invalidate(cache);
+                return r;
+        }
+
+        cache->timestamp = get_time_micros();
+        return 0;
+}
+
+int unit_cache_append(UnitCache *cache, sd_bus_message *reply) {
+        int r = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, UNIT_INFO_STRUCT_TYPESTRING);
+        if (r < 0) {
+                return r;
+        }
+
+        void *item = NULL;
+        size_t i = 0;
+        while (hashmap_iter(cache->units, &i, &item)) {
+                const UnitInfo *unit = ((CachedUnit *) item)->unit;
+                r = sd_bus_message_append(
+                                reply,
+                                UNIT_INFO_STRUCT_TYPESTRING,
+                                unit->id,
+                                unit->description,
+                                unit->load_state,
+                                unit->active_state,
+                                unit->sub_state,
+                                unit->following,
+                                unit->unit_path,
+                                unit->job_id,
+                                unit->job_type,
+                                unit->job_path);
+                if (r < 0) {
+                        return r;
+                }
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+/* Units loaded after the last full listing only carry what the events tell about them */
+static UnitInfo *unit_cache_add_unit(UnitCache *cache, const char *name) {
+        _cleanup_unit_ UnitInfo *unit = new_unit();
+        if (unit == NULL) {
+                return NULL;
+        }
+
+        _cleanup_free_ char *escaped = bus_path_escape(name);
+        if (escaped == NULL) {
+                return NULL;
+        }
+
+        unit->id = strdup(name);
+        unit->description = strdup("");
+        unit->load_state = strdup("loaded");
+        unit->active_state = strdup("inactive");
+        unit->sub_state = strdup("dead");
+        unit->following = strdup("");
+        unit->unit_path = strcat_dup(SYSTEMD_OBJECT_PATH "/unit/", escaped);
+        unit->job_type = strdup("");
+        unit->job_path = strdup("/");
+        if (unit->id == NULL || unit->description == NULL || unit->load_state == NULL ||
+            unit->active_state == NULL || unit->sub_state == NULL || unit->following == NULL ||
+            unit->unit_path == NULL || unit->job_type == NULL || unit->job_path == NULL) {
+                return NULL;
+        }
+
+        if (!unit_cache_set(cache, unit)) {
+                return NULL;
+        }
+        return steal_pointer(&unit);
+}
+
+static UnitInfo *unit_cache_ensure_unit(UnitCache *cache, const char *name) {
+        UnitInfo *unit = unit_cache_get(cache, name);
+        if (unit != NULL) {
+                return unit;
+        }
+        return unit_cache_add_unit(cache, name);
+}
+
+static int unit_cache_on_unit_new(void *userdata, const char *node, const char *unit, UNUSED const char *reason) {
+        UnitCache *cache = userdata;
+        if (is_wildcard(unit)) {
+                return 0;
+        }
+
+        UnitChange *change = NULL;
+        int r = unit_cache_get_change(cache, unit, &change);
+        if (change != NULL) {
+                change->added = true;
+                change->removed = false;
+        }
+        if (r >= 0 && unit_cache_is_valid(cache) && unit_cache_ensure_unit(cache, unit) == NULL) {
+                r = -ENOMEM;
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to cache new unit '%s' of node '%s', invalidating cache", unit, node);
+                unit_cache_invalidate(cache);
+                return r;
+        }
+        return 0;
+}
+
+static int unit_cache_on_unit_state_changed(
+                void *userdata,
+                const char *node,
+                const char *unit,
+                const char *active_state,
+                const char *substate,
+                UNUSED const char *reason) {
+        UnitCache *cache = userdata;
+        if (is_wildcard(unit)) {
+                return 0;
+        }
+
+        UnitChange *change = NULL;
+        int r = unit_cache_get_change(cache, unit, &change);
+        if (change != NULL) {
+                change->added = true;
+                change->removed = false;
+                if (!copy_str(&change->active_state, active_state) || !copy_str(&change->sub_state, substate)) {
+                        r = -ENOMEM;
+                }
+        }
+        if (r >= 0 && unit_cache_is_valid(cache)) {
+                UnitInfo *info = unit_cache_ensure_unit(cache, unit);
+                if (info == NULL || !copy_str(&info->active_state, active_state) ||
+                    !copy_str(&info->sub_state, substate)) {
+                        r = -ENOMEM;
+                }
+        }
+        if (r < 0) {
+                bc_log_errorf("Failed to cache state of unit '%s' of node '%s', invalidating cache", unit, node);
+                unit_cache_invalidate(cache);
+                return r;
+        }
+        return 0;
+}
+
+static int unit_cache_on_unit_property_changed(
+                void *userdata, const char *node, const char *unit, UNUSED const char *interface, sd_bus_message *m) {
+        UnitCache *cache = userdata;
+        UnitInfo *info = unit_cache_is_valid(cache) ? unit_cache_get(cache, unit) : NULL;
+        if (info == NULL && !unit_cache_listing_pending(cache)) {
+                return 0;
+        }
+
+        const char *load_state = NULL;
+        int r = sd_bus_message_skip(m, "ss");
+        if (r >= 0) {
+                r = bus_parse_property_string(m, "LoadState", &load_state);
+        }
+        if (r >= 0) {
+                UnitChange *change = NULL;
+                r = unit_cache_get_change(cache, unit, &change);
+                if (change != NULL && !copy_str(&change->load_state, load_state)) {
+                        r = -ENOMEM;
+                }
+        }
+        if (r >= 0 && info != NULL && !copy_str(&info->load_state, load_state)) {
+                r = -ENOMEM;
+        }
+        if (r == -ENOMEM) {
+                bc_log_errorf("Failed to cache load state of unit '%s' of node '%s', invalidating cache", unit, node);
+                unit_cache_invalidate(cache);
+        }
+
+        /* Leave the message at the start of the event for the other subscribers, it may be part of a batch */
+        int rewind_r = sd_bus_message_rewind(m, false);
+        if (rewind_r < 0) {
+                return rewind_r;
+        }
+        return r == -ENOENT ? 0 : r;
+}
+
+static int unit_cache_on_unit_removed(void *userdata, const char *node, const char *unit, UNUSED const char *reason) {
+        UnitCache *cache = userdata;
+
+        UnitChange *change = NULL;
+        int r = unit_cache_get_change(cache, unit, &change);
+        if (r < 0) {
+                bc_log_errorf("Failed to cache removal of unit '%s' of node '%s', invalidating cache", unit, node);
+                unit_cache_invalidate(cache);
+                return r;
+        }
+        if (change != NULL) {
+                change->added = false;
+                change->removed = true;
+                free_and_null(change->load_state);
+                free_and_null(change->active_state);
+                free_and_null(change->sub_state);
+        }
+
+        if (unit_cache_is_valid(cache)) {
+                unit_cache_remove(cache, unit);
+        }
+        return 0;
+}
+
+Subscription *create_unit_cache_subscription(UnitCache *cache, const char *node) {
+        _cleanup_subscription_ Subscription *subscription = subscription_new(node);
+        if (subscription == NULL) {
+                return NULL;
+        }
+
+        subscription->monitor = cache; /* Weak ref, the cache is owned by the node */
+        subscription->free_monitor = NULL;
+
+        subscription->handle_unit_new = unit_cache_on_unit_new;
+        subscription->handle_unit_removed = unit_cache_on_unit_removed;
+        subscription->handle_unit_state_changed = unit_cache_on_unit_state_changed;
+        subscription->handle_unit_property_changed = unit_cache_on_unit_property_changed;
+
+        /* Only the load state is taken from property changes, so don't make
+         * the agent forward all properties of all units */
+        if (!subscription_add_unit(subscription, SYMBOL_WILDCARD) ||
+            !subscription_add_property(subscription, "LoadState")) {
+                return NULL;
+        }
+
+        return steal_pointer(&subscription);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <hashmap.h>
+
+#include "libbluechi/common/common.h"
+
+#include "types.h"
+
+/*
+ * In-memory copy of the units of a node. It is filled from a full ListUnits
+ * reply of the agent and then kept up to date by a wildcard subscription, so
+ * the controller can list the units of a node without asking the agent.
+ *
+ * Only the name, load, active and sub state of units are tracked from the
+ * event stream. All other fields reflect the last full listing.
+ *
+ * The agent may send events that are newer than a listing before the listing
+ * itself, e.g. in between the slices of a large reply. So while a listing is on
+ * its way, the events are also kept aside and applied again once it is loaded.
+ */
+struct UnitCache {
+        struct hashmap *units;
+
+        /* Realtime of the last full listing, 0 while the cache is invalid */
+        uint64_t timestamp;
+
+        /* Changes received since the last requested listing was sent, see unit_cache_load() */
+        struct hashmap *changes;
+        uint64_t requested_cookie; /* Cookie of the call of the last requested listing */
+        uint64_t loaded_cookie;    /* Cookie of the call of the last loaded listing */
+};
+
+UnitCache *unit_cache_new(void);
+void unit_cache_free(UnitCache *cache);
+
+bool unit_cache_is_valid(UnitCache *cache);
+void unit_cache_invalidate(UnitCache *cache);
+
+void unit_cache_listing_requested(UnitCache *cache, sd_bus_message *call);
+int unit_cache_load(UnitCache *cache, sd_bus_message *m);
+int unit_cache_append(UnitCache *cache, sd_bus_message *reply);
+
+Subscription *create_unit_cache_subscription(UnitCache *cache, const char *node);
+
+DEFINE_CLEANUP_FUNC(UnitCache, unit_cache_free)
+#define _cleanup_unit_cache_ _cleanup_(unit_cache_freep)
@@ -582,6 +582,18 @@ int cfg_agent_def_conf(struct config *config) {
                 return result;
         }
 
+        if ((result = cfg_set_value(
+                             config,
+                             CFG_UNIT_STATE_COALESCE_WINDOW,
+                             AGENT_DEFAULT_UNIT_STATE_COALESCE_WINDOW_MSEC)) != 0) {
+                return result;
+        }
+
+        if ((result = cfg_set_value(
+                             config, CFG_UNIT_PROPERTY_CACHE_TTL, AGENT_DEFAULT_UNIT_PROPERTY_CACHE_TTL_MSEC)) != 0) {
+                return result;
+        }
+
         return 0;
 }
 
@@ -626,5 +638,24 @@ int cfg_controller_def_conf(struct config *config) {
                 return result;
         }
 
+        if ((result = cfg_set_value(config, CFG_API_REQUEST_RATE, CONTROLLER_DEFAULT_API_REQUEST_RATE)) != 0) {
+                return result;
+        }
+
+        if ((result = cfg_set_value(config, CFG_API_REQUEST_BURST, CONTROLLER_DEFAULT_API_REQUEST_BURST)) != 0) {
+                return result;
+        }
+
+        if ((result = cfg_set_value(config, CFG_MAX_FLEET_REQUESTS, CONTROLLER_DEFAULT_MAX_FLEET_REQUESTS)) != 0) {
+                return result;
+        }
+
+        if ((result = cfg_set_value(
+                             config,
+                             CFG_MAX_QUEUED_FLEET_REQUESTS,
+                             CONTROLLER_DEFAULT_MAX_QUEUED_FLEET_REQUESTS)) != 0) {
+                return result;
+        }
+
         return 0;
 }
@@ -32,6 +32,12 @@
 #define CFG_TCP_KEEPALIVE_INTERVAL "TCPKeepAliveInterval"
 #define CFG_TCP_KEEPALIVE_COUNT "TCPKeepAliveCount"
 #define CFG_CONNECTION_RETRY_COUNT_UNTIL_QUIET "ConnectionRetryCountUntilQuiet"
+#define CFG_UNIT_STATE_COALESCE_WINDOW "UnitStateCoalesceWindow"
+#define CFG_UNIT_PROPERTY_CACHE_TTL "UnitPropertyCacheTTL"
+#define CFG_API_REQUEST_RATE "APIRequestRate"
+#define CFG_API_REQUEST_BURST "APIRequestBurst"
+#define CFG_MAX_FLEET_REQUESTS "MaxFleetRequests"
+#define CFG_MAX_QUEUED_FLEET_REQUESTS "MaxQueuedFleetRequests"
 
 /*
  * Global section - this is used, when configuration options are specified in the configuration file
@@ -0,0 +1,78 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "pool.h"
+
+static PoolStats pool_stats = { 0, 0, 0 };
+
+void *pool_alloc0(Pool *pool) {
+        void *p = pool->free_list;
+        if (p == NULL) {
+                p = malloc0(pool->size);
+                if (p != NULL) {
+                        pool_stats.n_malloc++;
+                }
+                return p;
+        }
+
+        pool->free_list = *(void **) p;
+        pool->n_free--;
+        pool_stats.n_recycled++;
+        memset(p, 0, pool->size);
+        return p;
+}
+
+void pool_free(Pool *pool, void *p) {
+        if (p == NULL) {
+                return;
+        }
+
+        if (pool->n_free >= pool->max_free) {
+                free(p);
+                return;
+        }
+
+        *(void **) p = pool->free_list;
+        pool->free_list = p;
+        pool->n_free++;
+}
+
+void pool_clear(Pool *pool) {
+        while (pool->free_list != NULL) {
+                void *p = pool->free_list;
+                pool->free_list = *(void **) p;
+                free(p);
+        }
+        pool->n_free = 0;
+}
+
+char *pool_strdup(char *buf, size_t size, const char *s) {
+        size_t len = strlen(s);
+        if (len < size) {
+                memcpy(buf, s, len + 1);
+                pool_stats.n_inline++;
+                return buf;
+        }
+
+        char *copy = strdup(s);
+        if (copy != NULL) {
+                pool_stats.n_malloc++;
+        }
+        return copy;
+}
+
+void pool_strfree(const char *buf, char *s) {
+        if (s != buf) {
+                free(s);
+        }
+}
+
+const PoolStats *pool_get_stats(void) {
+        return &pool_stats;
+}
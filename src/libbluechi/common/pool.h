@@ -0,0 +1,51 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Free list of objects of a fixed size. Released objects are kept for reuse
+ * instead of being returned to malloc, up to max_free of them. Pools are not
+ * thread safe and are meant to be static variables of the module owning the
+ * type, e.g.
+ *
+ *     static Pool job_pool = POOL_INIT(Job, 256);
+ */
+typedef struct Pool {
+        size_t size;
+        size_t max_free;
+        size_t n_free;
+        void *free_list;
+} Pool;
+
+/* Free objects link to the next one, so they take at least the size of a pointer */
+#define POOL_OBJECT_SIZE(type) (sizeof(type) > sizeof(void *) ? sizeof(type) : sizeof(void *))
+#define POOL_INIT(type, max) { POOL_OBJECT_SIZE(type), (max), 0, NULL }
+
+/* Returns a zeroed object, taken from the free list if possible */
+void *pool_alloc0(Pool *pool);
+void pool_free(Pool *pool, void *p);
+/* Returns all objects on the free list to malloc */
+void pool_clear(Pool *pool);
+
+/*
+ * Small strings are stored in a buffer embedded in their object and only
+ * allocated if they don't fit. Returns either buf or a new copy of s, which
+ * must be released with pool_strfree() using the same buf.
+ */
+char *pool_strdup(char *buf, size_t size, const char *s);
+void pool_strfree(const char *buf, char *s);
+
+/* Counters of all pools of the process */
+typedef struct PoolStats {
+        uint64_t n_malloc;   /* Objects and strings that had to be allocated */
+        uint64_t n_recycled; /* Objects taken from a free list */
+        uint64_t n_inline;   /* Strings copied into the buffer of their object */
+} PoolStats;
+
+const PoolStats *pool_get_stats(void);
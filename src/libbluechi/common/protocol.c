@@ -47,3 +47,129 @@ UnitActiveState active_state_from_string(const char *s) {
         }
         return _UNIT_ACTIVE_STATE_INVALID;
 }
+
+/* All sub states of systemd units, sorted for bsearch() */
+static const char * const unit_sub_state_table[] = {
+        "abandoned",
+        "activating",
+        "activating-done",
+        "active",
+        "agent-offline", /* Set by the controller if the node is offline */
+        "auto-restart",
+        "auto-restart-queued",
+        "cleaning",
+        "condition",
+        "deactivating",
+        "deactivating-sigkill",
+        "deactivating-sigterm",
+        "dead",
+        "dead-before-auto-restart",
+        "dead-resources-pinned",
+        "elapsed",
+        "exited",
+        "failed",
+        "failed-before-auto-restart",
+        "final-sigkill",
+        "final-sigterm",
+        "final-watchdog",
+        "invalid",
+        "listening",
+        "mounted",
+        "mounting",
+        "mounting-done",
+        "plugged",
+        "reload",
+        "reload-notify",
+        "reload-signal",
+        "remounting",
+        "remounting-sigkill",
+        "remounting-sigterm",
+        "running",
+        "start",
+        "start-chown",
+        "start-post",
+        "start-pre",
+        "stop",
+        "stop-post",
+        "stop-pre",
+        "stop-pre-sigkill",
+        "stop-pre-sigterm",
+        "stop-sigkill",
+        "stop-sigterm",
+        "stop-watchdog",
+        "tentative",
+        "unmounting",
+        "unmounting-sigkill",
+        "unmounting-sigterm",
+        "waiting",
+};
+
+/*
+ * Sub states of newer systemd versions, copied on first use and freed at exit. Only a few
+ * short ones are kept for sub states received from peers, see sub_state_intern_peer().
+ */
+static char **unit_sub_state_extra = NULL;
+
+static int sub_state_compare(const void *key, const void *item) {
+        return strcmp(key, *(const char * const *) item);
+}
+
+static const char *sub_state_find(const char *s) {
+        const char * const *known = bsearch(
+                        s,
+                        unit_sub_state_table,
+                        sizeof(unit_sub_state_table) / sizeof(unit_sub_state_table[0]),
+                        sizeof(unit_sub_state_table[0]),
+                        sub_state_compare);
+        return known != NULL ? *known : NULL;
+}
+
+/* Returns the interned string equal to s, or NULL and the number of copied sub states if there is none yet */
+static const char *sub_state_lookup(const char *s, size_t *ret_n_extra) {
+        const char *known = sub_state_find(s);
+        if (known != NULL) {
+                return known;
+        }
+
+        size_t n = strv_length(unit_sub_state_extra);
+        for (size_t i = 0; i < n; i++) {
+                if (streq(unit_sub_state_extra[i], s)) {
+                        return unit_sub_state_extra[i];
+                }
+        }
+        *ret_n_extra = n;
+        return NULL;
+}
+
+static const char *sub_state_copy(const char *s, size_t n_extra) {
+        if (!strv_extend(&unit_sub_state_extra, s)) {
+                return NULL;
+        }
+        return unit_sub_state_extra[n_extra];
+}
+
+const char *sub_state_intern(const char *s) {
+        size_t n_extra = 0;
+        const char *interned = sub_state_lookup(s, &n_extra);
+        if (interned != NULL) {
+                return interned;
+        }
+        return sub_state_copy(s, n_extra);
+}
+
+const char *sub_state_intern_peer(const char *s) {
+        size_t n_extra = 0;
+        const char *interned = sub_state_lookup(s, &n_extra);
+        if (interned != NULL) {
+                return interned;
+        }
+        if (n_extra >= SUB_STATE_EXTRA_MAX || strlen(s) > SUB_STATE_MAX_LENGTH) {
+                return sub_state_find("invalid");
+        }
+        return sub_state_copy(s, n_extra);
+}
+
+__attribute__((destructor)) static void sub_state_extra_free(void) {
+        freev((void **) unit_sub_state_extra);
+        unit_sub_state_extra = NULL;
+}
@@ -33,8 +33,20 @@
 #define AGENT_DEFAULT_CONTROLLER_HEARTBEAT_THRESHOLD_MSEC "0"
 #define CONTROLLER_DEFAULT_HEARTBEAT_INTERVAL_MSEC "0"
 #define CONTROLLER_DEFAULT_NODE_HEARTBEAT_THRESHOLD_MSEC "6000"
+/* Requests per second a client of the public API may make, 0 disables the limit */
+#define CONTROLLER_DEFAULT_API_REQUEST_RATE "0"
+/* Requests a client of the public API may make at once before it is limited to the rate */
+#define CONTROLLER_DEFAULT_API_REQUEST_BURST "20"
+/* Requests to all nodes that are processed at the same time, 0 disables the limit */
+#define CONTROLLER_DEFAULT_MAX_FLEET_REQUESTS "0"
+/* Requests to all nodes that wait for a free slot before new ones are rejected */
+#define CONTROLLER_DEFAULT_MAX_QUEUED_FLEET_REQUESTS "64"
 /* Number of connection retries until logs are silenced */
 #define AGENT_DEFAULT_CONNECTION_RETRY_COUNT_UNTIL_QUIET "10"
+/* Window in which unit state changes are coalesced, 0 disables it */
+#define AGENT_DEFAULT_UNIT_STATE_COALESCE_WINDOW_MSEC "0"
+/* Time for which unit properties read from systemd are reused, 0 disables caching */
+#define AGENT_DEFAULT_UNIT_PROPERTY_CACHE_TTL_MSEC "0"
 
 
 /* BlueChi DBus service names */
@@ -54,11 +66,13 @@
 #define AGENT_INTERFACE BC_INTERFACE_BASE_NAME ".Agent"
 #define NODE_INTERFACE BC_INTERFACE_BASE_NAME ".Node"
 #define JOB_INTERFACE BC_INTERFACE_BASE_NAME ".Job"
+#define JOB_GROUP_INTERFACE BC_INTERFACE_BASE_NAME ".JobGroup"
 #define MONITOR_INTERFACE BC_INTERFACE_BASE_NAME ".Monitor"
 #define METRICS_INTERFACE BC_INTERFACE_BASE_NAME ".Metrics"
 
 #define NODE_OBJECT_PATH_PREFIX BC_OBJECT_PATH "/node"
 #define JOB_OBJECT_PATH_PREFIX BC_OBJECT_PATH "/job"
+#define JOB_GROUP_OBJECT_PATH_PREFIX BC_OBJECT_PATH "/jobgroup"
 #define MONITOR_OBJECT_PATH_PREFIX BC_OBJECT_PATH "/monitor"
 #define METRICS_OBJECT_PATH BC_OBJECT_PATH "/metrics"
 
@@ -77,6 +91,8 @@
 #define BC_BUS_ERROR_OFFLINE "org.eclipse.bluechi.Offline"
 #define BC_BUS_ERROR_NO_SUCH_SUBSCRIPTION "org.eclipse.bluechi.NoSuchSubscription"
 #define BC_BUS_ERROR_ACTIVATION_FAILED "org.eclipse.bluechi.ActivationFailed"
+#define BC_BUS_ERROR_RATE_LIMITED "org.eclipse.bluechi.RateLimited"
+#define BC_BUS_ERROR_TOO_MANY_REQUESTS "org.eclipse.bluechi.TooManyRequests"
 
 /* Systemd protocol */
 #define SYSTEMD_BUS_NAME "org.freedesktop.systemd1"
@@ -88,6 +104,12 @@
 /* Signal names */
 #define AGENT_HEARTBEAT_SIGNAL_NAME "Heartbeat"
 #define CONTROLLER_HEARTBEAT_SIGNAL_NAME "Heartbeat"
+#define AGENT_EVENT_BATCH_SIGNAL_NAME "EventBatch"
+#define AGENT_EVENT_SEQUENCE_SIGNAL_NAME "EventSequence"
+
+/* Features of the peer connection offered by the controller in the Register reply */
+#define PEER_FEATURE_EVENT_BATCH "EventBatch"
+#define PEER_FEATURE_RESYNC "Resync"
 
 /* Typestrings */
 #define UNIT_INFO_TYPESTRING "ssssssouso"
@@ -106,6 +128,9 @@
 #define NODE_AND_UNIT_FILE_INFO_DICT_TYPESTRING "{" NODE_AND_UNIT_FILE_INFO_TYPESTRING "}"
 #define NODE_AND_UNIT_FILE_INFO_DICT_ARRAY_TYPESTRING "a" NODE_AND_UNIT_FILE_INFO_DICT_TYPESTRING
 
+#define EVENT_BATCH_ENTRY_TYPESTRING "sv"
+#define EVENT_BATCH_ENTRY_STRUCT_TYPESTRING "(" EVENT_BATCH_ENTRY_TYPESTRING ")"
+
 typedef enum JobState {
         JOB_WAITING,
         JOB_RUNNING,
@@ -129,3 +154,19 @@ typedef enum UnitActiveState {
 
 const char *active_state_to_string(UnitActiveState s);
 UnitActiveState active_state_from_string(const char *s);
+
+/*
+ * Returns a string equal to the unit sub state s that stays valid for the lifetime of the process,
+ * and the same pointer for equal sub states, or NULL if out of memory. The sub states known from
+ * systemd are static, others are copied once. Unit state caches keep these instead of copies.
+ */
+const char *sub_state_intern(const char *s);
+
+/*
+ * Same as sub_state_intern() for sub states received from a peer, which must not grow the copies
+ * without bounds. Up to SUB_STATE_EXTRA_MAX unknown sub states of at most SUB_STATE_MAX_LENGTH
+ * characters are copied, any further ones are returned as "invalid".
+ */
+#define SUB_STATE_EXTRA_MAX 32
+#define SUB_STATE_MAX_LENGTH 64
+const char *sub_state_intern_peer(const char *s);
@@ -91,3 +91,175 @@ bool string_builder_printf(StringBuilder *builder, const char *format, ...) {
 
         return true;
 }
+
+size_t strv_length(char *const *l) {
+        size_t n = 0;
+        if (l != NULL) {
+                while (l[n] != NULL) {
+                        n++;
+                }
+        }
+        return n;
+}
+
+bool strv_contains(char *const *l, const char *s) {
+        if (l == NULL) {
+                return false;
+        }
+        for (; *l != NULL; l++) {
+                if (streq(*l, s)) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+bool strv_extend(char ***l, const char *s) {
+        size_t n = strv_length(*l);
+
+        char *dup = strdup(s);
+        if (dup == NULL) {
+                return false;
+        }
+
+        char **new_l = reallocarray(*l, n + 2, sizeof(char *));
+        if (new_l == NULL) {
+                free(dup);
+                return false;
+        }
+
+        new_l[n] = dup;
+        new_l[n + 1] = NULL;
+        *l = new_l;
+
+        return true;
+}
+
+static int strv_compare(const void *a, const void *b) {
+        return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+void strv_sort(char **l) {
+        size_t n = strv_length(l);
+        if (n > 1) {
+                qsort(l, n, sizeof(char *), strv_compare);
+        }
+}
+
+bool strv_equal(char *const *a, char *const *b) {
+        size_t n = strv_length(a);
+        if (n != strv_length(b)) {
+                return false;
+        }
+        for (size_t i = 0; i < n; i++) {
+                if (!streq(a[i], b[i])) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+typedef struct GlobSegment {
+        size_t offset; /* into GlobPattern.glob */
+        size_t length;
+} GlobSegment;
+
+/* The glob split at each SYMBOL_GLOB_ALL, the first segment is anchored at the start
+ * and the last one at the end of the string. Segments may be empty. */
+struct GlobPattern {
+        char *glob;
+        size_t min_length;
+        size_t n_segments;
+        GlobSegment segments[0];
+};
+
+GlobPattern *glob_pattern_new(const char *glob) {
+        size_t n_segments = 1;
+        for (const char *c = glob; *c != '\0'; c++) {
+                if (*c == SYMBOL_GLOB_ALL) {
+                        n_segments++;
+                }
+        }
+
+        GlobPattern *pattern = calloc(1, sizeof(GlobPattern) + n_segments * sizeof(GlobSegment));
+        if (pattern == NULL) {
+                return NULL;
+        }
+        pattern->glob = strdup(glob);
+        if (pattern->glob == NULL) {
+                free(pattern);
+                return NULL;
+        }
+
+        size_t start = 0;
+        for (size_t i = 0;; i++) {
+                if (glob[i] != SYMBOL_GLOB_ALL && glob[i] != '\0') {
+                        continue;
+                }
+                GlobSegment *segment = &pattern->segments[pattern->n_segments++];
+                segment->offset = start;
+                segment->length = i - start;
+                pattern->min_length += segment->length;
+                if (glob[i] == '\0') {
+                        break;
+                }
+                start = i + 1;
+        }
+
+        return pattern;
+}
+
+void glob_pattern_free(GlobPattern *pattern) {
+        if (pattern == NULL) {
+                return;
+        }
+        free(pattern->glob);
+        free(pattern);
+}
+
+static bool glob_segment_matches_at(const GlobPattern *pattern, const GlobSegment *segment, const char *str) {
+        const char *glob = pattern->glob + segment->offset;
+        for (size_t i = 0; i < segment->length; i++) {
+                if (glob[i] != SYMBOL_GLOB_ONE && glob[i] != str[i]) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+bool glob_pattern_matches(const GlobPattern *pattern, const char *str) {
+        if (pattern == NULL || str == NULL) {
+                return false;
+        }
+
+        size_t length = strlen(str);
+        if (length < pattern->min_length) {
+                return false;
+        }
+
+        const GlobSegment *first = &pattern->segments[0];
+        if (pattern->n_segments == 1) {
+                return length == first->length && glob_segment_matches_at(pattern, first, str);
+        }
+
+        const GlobSegment *last = &pattern->segments[pattern->n_segments - 1];
+        size_t end = length - last->length;
+        if (!glob_segment_matches_at(pattern, first, str) || !glob_segment_matches_at(pattern, last, str + end)) {
+                return false;
+        }
+
+        /* Taking the leftmost match of each segment in between leaves the most room for the following ones */
+        size_t pos = first->length;
+        for (size_t i = 1; i < pattern->n_segments - 1; i++) {
+                const GlobSegment *segment = &pattern->segments[i];
+                while (pos + segment->length <= end && !glob_segment_matches_at(pattern, segment, str + pos)) {
+                        pos++;
+                }
+                if (pos + segment->length > end) {
+                        return false;
+                }
+                pos += segment->length;
+        }
+
+        return pos <= end;
+}
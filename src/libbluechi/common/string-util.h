@@ -85,6 +85,17 @@ static inline bool match_glob(const char *str, const char *glob) {
 }
 // NOLINTEND(misc-no-recursion)
 
+/*
+ * A glob with the same syntax as match_glob(), split at each SYMBOL_GLOB_ALL up
+ * front. Matching then searches the literal parts left to right and never
+ * backtracks, so a pattern compiled once is cheap to test against many names.
+ */
+typedef struct GlobPattern GlobPattern;
+
+GlobPattern *glob_pattern_new(const char *glob);
+void glob_pattern_free(GlobPattern *pattern);
+bool glob_pattern_matches(const GlobPattern *pattern, const char *str);
+
 static inline bool isempty(const char *a) {
         return !a || a[0] == '\0';
 }
@@ -116,3 +127,10 @@ bool string_builder_init(StringBuilder *builder, size_t initial_capacity);
 void string_builder_destroy(StringBuilder *builder);
 bool string_builder_append(StringBuilder *builder, const char *str);
 bool string_builder_printf(StringBuilder *builder, const char *format, ...);
+
+/* NULL-terminated arrays of strings, a NULL array is treated as an empty one. Free with freev(). */
+size_t strv_length(char *const *l);
+bool strv_contains(char *const *l, const char *s);
+bool strv_extend(char ***l, const char *s);
+void strv_sort(char **l);
+bool strv_equal(char *const *a, char *const *b);
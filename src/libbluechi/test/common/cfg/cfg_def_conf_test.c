@@ -127,6 +127,24 @@ bool test_cfg_agent_def_conf() {
                         value);
                 result = false;
         }
+        value = cfg_get_value(config, CFG_UNIT_STATE_COALESCE_WINDOW);
+        if (!streq(value, AGENT_DEFAULT_UNIT_STATE_COALESCE_WINDOW_MSEC)) {
+                fprintf(stderr,
+                        "Expected config option %s to have default value '%s', but got '%s'\n",
+                        CFG_UNIT_STATE_COALESCE_WINDOW,
+                        AGENT_DEFAULT_UNIT_STATE_COALESCE_WINDOW_MSEC,
+                        value);
+                result = false;
+        }
+        value = cfg_get_value(config, CFG_UNIT_PROPERTY_CACHE_TTL);
+        if (!streq(value, AGENT_DEFAULT_UNIT_PROPERTY_CACHE_TTL_MSEC)) {
+                fprintf(stderr,
+                        "Expected config option %s to have default value '%s', but got '%s'\n",
+                        CFG_UNIT_PROPERTY_CACHE_TTL,
+                        AGENT_DEFAULT_UNIT_PROPERTY_CACHE_TTL_MSEC,
+                        value);
+                result = false;
+        }
 
         cfg_dispose(config);
         return result;
@@ -248,6 +266,42 @@ bool test_cfg_controller_def_conf() {
                         value);
                 result = false;
         }
+        value = cfg_get_value(config, CFG_API_REQUEST_RATE);
+        if (!streq(value, CONTROLLER_DEFAULT_API_REQUEST_RATE)) {
+                fprintf(stderr,
+                        "Expected config option %s to have default value '%s', but got '%s'\n",
+                        CFG_API_REQUEST_RATE,
+                        CONTROLLER_DEFAULT_API_REQUEST_RATE,
+                        value);
+                result = false;
+        }
+        value = cfg_get_value(config, CFG_API_REQUEST_BURST);
+        if (!streq(value, CONTROLLER_DEFAULT_API_REQUEST_BURST)) {
+                fprintf(stderr,
+                        "Expected config option %s to have default value '%s', but got '%s'\n",
+                        CFG_API_REQUEST_BURST,
+                        CONTROLLER_DEFAULT_API_REQUEST_BURST,
+                        value);
+                result = false;
+        }
+        value = cfg_get_value(config, CFG_MAX_FLEET_REQUESTS);
+        if (!streq(value, CONTROLLER_DEFAULT_MAX_FLEET_REQUESTS)) {
+                fprintf(stderr,
+                        "Expected config option %s to have default value '%s', but got '%s'\n",
+                        CFG_MAX_FLEET_REQUESTS,
+                        CONTROLLER_DEFAULT_MAX_FLEET_REQUESTS,
+                        value);
+                result = false;
+        }
+        value = cfg_get_value(config, CFG_MAX_QUEUED_FLEET_REQUESTS);
+        if (!streq(value, CONTROLLER_DEFAULT_MAX_QUEUED_FLEET_REQUESTS)) {
+                fprintf(stderr,
+                        "Expected config option %s to have default value '%s', but got '%s'\n",
+                        CFG_MAX_QUEUED_FLEET_REQUESTS,
+                        CONTROLLER_DEFAULT_MAX_QUEUED_FLEET_REQUESTS,
+                        value);
+                result = false;
+        }
 
         cfg_dispose(config);
         return result;
@@ -0,0 +1,97 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/pool.h"
+
+typedef struct TestObject {
+        int value;
+        char name_buf[8];
+        char *name;
+} TestObject;
+
+bool test_pool_recycle() {
+        Pool pool = POOL_INIT(TestObject, 2);
+        const PoolStats *stats = pool_get_stats();
+        uint64_t n_malloc = stats->n_malloc;
+        uint64_t n_recycled = stats->n_recycled;
+        bool result = true;
+
+        TestObject *a = pool_alloc0(&pool);
+        TestObject *b = pool_alloc0(&pool);
+        TestObject *c = pool_alloc0(&pool);
+        if (a == NULL || b == NULL || c == NULL) {
+                fprintf(stderr, "FAILED: could not allocate objects\n");
+                return false;
+        }
+        a->value = 42;
+
+        /* Only max_free objects are kept */
+        pool_free(&pool, a);
+        pool_free(&pool, b);
+        pool_free(&pool, c);
+        if (pool.n_free != 2) {
+                fprintf(stderr, "FAILED: expected 2 free objects, got %zu\n", pool.n_free);
+                result = false;
+        }
+
+        /* Recycled objects are zeroed like new ones */
+        TestObject *d = pool_alloc0(&pool);
+        TestObject *e = pool_alloc0(&pool);
+        if (d != b || e != a || d->value != 0 || e->value != 0 || e->name != NULL) {
+                fprintf(stderr, "FAILED: expected the free objects to be recycled and zeroed\n");
+                result = false;
+        }
+        if (stats->n_malloc - n_malloc != 3 || stats->n_recycled - n_recycled != 2) {
+                fprintf(stderr,
+                        "FAILED: expected 3 allocated and 2 recycled objects, got %" PRIu64 " and %" PRIu64 "\n",
+                        stats->n_malloc - n_malloc,
+                        stats->n_recycled - n_recycled);
+                result = false;
+        }
+
+        pool_free(&pool, d);
+        pool_free(&pool, e);
+        pool_clear(&pool);
+        if (pool.n_free != 0 || pool.free_list != NULL) {
+                fprintf(stderr, "FAILED: expected no free objects after clear\n");
+                result = false;
+        }
+
+        return result;
+}
+
+bool test_pool_strdup(const char *s, bool expect_inline) {
+        TestObject object = { 0 };
+        object.name = pool_strdup(object.name_buf, sizeof(object.name_buf), s);
+
+        bool result = true;
+        if (object.name == NULL || !streq(object.name, s) || (object.name == object.name_buf) != expect_inline) {
+                fprintf(stderr, "FAILED: unexpected copy of '%s'\n", s);
+                result = false;
+        }
+
+        pool_strfree(object.name_buf, object.name);
+        return result;
+}
+
+int main() {
+        bool result = true;
+
+        result = result && test_pool_recycle();
+        result = result && test_pool_strdup("", true);
+        result = result && test_pool_strdup("a.slice", true);
+        result = result && test_pool_strdup("a.target", false);
+        result = result && test_pool_strdup("very-long-name.service", false);
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
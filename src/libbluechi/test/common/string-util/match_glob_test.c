@@ -37,6 +37,26 @@ bool test_match_glob(const char *in, const char *glob, bool expected) {
         return false;
 }
 
+bool test_glob_pattern(const char *in, const char *glob, bool expected) {
+        GlobPattern *pattern = glob_pattern_new(glob);
+        if (pattern == NULL) {
+                fprintf(stdout, "FAILED: glob_pattern_new('%s') - Out of memory\n", glob);
+                return false;
+        }
+        bool result = glob_pattern_matches(pattern, in);
+        glob_pattern_free(pattern);
+        if (result == expected) {
+                return true;
+        }
+        fprintf(stdout,
+                "FAILED: glob_pattern_matches('%s', '%s') - Expected %s, but got %s\n",
+                in,
+                glob,
+                bool_to_str(expected),
+                bool_to_str(result));
+        return false;
+}
+
 int main() {
         bool result = true;
 
@@ -73,6 +93,37 @@ int main() {
         result = result && test_match_glob("glob.check.service", "*.service*", true);
         result = result && test_match_glob("glob.check.service", "*.service?", false);
 
+        result = result && test_glob_pattern(NULL, "", false);
+        result = result && test_glob_pattern("", "", true);
+        result = result && test_glob_pattern("", "?", false);
+        result = result && test_glob_pattern("", "*", true);
+        result = result && test_glob_pattern("", "**", true);
+        result = result && test_glob_pattern("x", "?", true);
+        result = result && test_glob_pattern("x", "*", true);
+        result = result && test_glob_pattern("xt", "?", false);
+        result = result && test_glob_pattern("xt", "?t", true);
+        result = result && test_glob_pattern("xt", "*t", true);
+        result = result && test_glob_pattern("xt", "x*t", true);
+        result = result && test_glob_pattern("xt", "xt*t", false);
+        result = result && test_glob_pattern("aba", "ab*ba", false);
+        result = result && test_glob_pattern("abba", "ab*ba", true);
+        result = result && test_glob_pattern("glob.check.service", "glob.check.service", true);
+        result = result && test_glob_pattern("glob.check.service", "glob.check.servic", false);
+        result = result && test_glob_pattern("glob.check.service", "?", false);
+        result = result && test_glob_pattern("glob.check.service", "*", true);
+        result = result && test_glob_pattern("glob.check.service", "*.check.*", true);
+        result = result && test_glob_pattern("glob.check.service", "*.ch??k.*", true);
+        result = result && test_glob_pattern("glob.check.service", "*.ch?k.*", false);
+        result = result && test_glob_pattern("glob.check.service", "*.service", true);
+        result = result && test_glob_pattern("glob.check.service", "*.service*", true);
+        result = result && test_glob_pattern("glob.check.service", "*.service?", false);
+        result = result && test_glob_pattern("glob.check.service", "g*.*e*.s*e", true);
+        result = result && test_glob_pattern("glob.check.service", "g*.*x*.s*e", false);
+        result = result && test_glob_pattern("app-web.service", "app-*.service", true);
+        result = result && test_glob_pattern("app-.service", "app-*.service", true);
+        result = result && test_glob_pattern("app.service", "app-*.service", false);
+        result = result && test_glob_pattern("app-web.timer", "app-*.service", false);
+
         if (result) {
                 return EXIT_SUCCESS;
         }
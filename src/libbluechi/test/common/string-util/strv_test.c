@@ -0,0 +1,74 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/string-util.h"
+
+bool test_strv_extend_contains() {
+        bool result = true;
+        _cleanup_freev_ char **l = NULL;
+
+        if (strv_length(l) != 0 || strv_contains(l, "SubState")) {
+                fprintf(stdout, "FAILED: expected NULL to be an empty list\n");
+                result = false;
+        }
+
+        if (!strv_extend(&l, "SubState") || !strv_extend(&l, "ActiveState") || !strv_extend(&l, "MainPID")) {
+                fprintf(stdout, "FAILED: failed to extend list\n");
+                return false;
+        }
+
+        if (strv_length(l) != 3) {
+                fprintf(stdout, "FAILED: expected length 3, but got %zu\n", strv_length(l));
+                result = false;
+        }
+        if (!strv_contains(l, "ActiveState") || !strv_contains(l, "MainPID") || strv_contains(l, "NRestarts")) {
+                fprintf(stdout, "FAILED: unexpected result of strv_contains\n");
+                result = false;
+        }
+
+        strv_sort(l);
+        if (!streq(l[0], "ActiveState") || !streq(l[1], "MainPID") || !streq(l[2], "SubState") || l[3] != NULL) {
+                fprintf(stdout, "FAILED: list not sorted\n");
+                result = false;
+        }
+
+        return result;
+}
+
+bool test_strv_equal() {
+        bool result = true;
+        char *a[] = { "ActiveState", "SubState", NULL };
+        char *b[] = { "ActiveState", "SubState", NULL };
+        char *c[] = { "ActiveState", NULL };
+        char *empty[] = { NULL };
+
+        if (!strv_equal(a, b) || !strv_equal(NULL, NULL) || !strv_equal(NULL, empty)) {
+                fprintf(stdout, "FAILED: expected lists to be equal\n");
+                result = false;
+        }
+        if (strv_equal(a, c) || strv_equal(c, a) || strv_equal(a, NULL)) {
+                fprintf(stdout, "FAILED: expected lists to differ\n");
+                result = false;
+        }
+
+        return result;
+}
+
+int main() {
+        bool result = true;
+
+        result = result && test_strv_extend_contains();
+        result = result && test_strv_equal();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright Contributors to the Eclipse BlueChi project
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libbluechi/common/common.h"
+#include "libbluechi/common/protocol.h"
+
+bool test_sub_state_intern_known() {
+        char running[] = "running";
+        const char *interned = sub_state_intern(running);
+        if (interned == NULL || interned == running || !streq(interned, "running") ||
+            sub_state_intern("running") != interned) {
+                fprintf(stderr, "FAILED: expected the same static string for a known sub state\n");
+                return false;
+        }
+        return true;
+}
+
+bool test_sub_state_intern_peer() {
+        char buf[SUB_STATE_MAX_LENGTH + 2];
+        const char *invalid = sub_state_intern("invalid");
+
+        /* Unknown sub states are copied once, until the limit is reached */
+        for (int i = 0; i < SUB_STATE_EXTRA_MAX; i++) {
+                snprintf(buf, sizeof(buf), "future-%d", i);
+                const char *interned = sub_state_intern_peer(buf);
+                if (interned == NULL || interned == buf || interned == invalid || !streq(interned, buf) ||
+                    sub_state_intern_peer(buf) != interned) {
+                        fprintf(stderr, "FAILED: expected '%s' to be copied once\n", buf);
+                        return false;
+                }
+        }
+        if (sub_state_intern_peer("one-too-many") != invalid) {
+                fprintf(stderr, "FAILED: expected sub states beyond the limit to be invalid\n");
+                return false;
+        }
+        if (!streq(sub_state_intern_peer("future-0"), "future-0")) {
+                fprintf(stderr, "FAILED: expected sub states within the limit to be kept\n");
+                return false;
+        }
+
+        memset(buf, 'x', sizeof(buf) - 1);
+        buf[sizeof(buf) - 1] = '\0';
+        if (sub_state_intern_peer(buf) != invalid) {
+                fprintf(stderr, "FAILED: expected overlong sub states to be invalid\n");
+                return false;
+        }
+        return true;
+}
+
+bool test_sub_state_intern_unlimited() {
+        char buf[SUB_STATE_MAX_LENGTH + 2];
+        const char *invalid = sub_state_intern("invalid");
+
+        /* Sub states of the local systemd are copied beyond the limit for peers */
+        const char *interned = sub_state_intern("one-too-many");
+        if (interned == NULL || interned == invalid || !streq(interned, "one-too-many") ||
+            sub_state_intern_peer("one-too-many") != interned) {
+                fprintf(stderr, "FAILED: expected sub states beyond the limit to be copied\n");
+                return false;
+        }
+
+        memset(buf, 'x', sizeof(buf) - 1);
+        buf[sizeof(buf) - 1] = '\0';
+        interned = sub_state_intern(buf);
+        if (interned == NULL || interned == invalid || !streq(interned, buf)) {
+                fprintf(stderr, "FAILED: expected overlong sub states to be copied\n");
+                return false;
+        }
+        return true;
+}
+
+int main() {
+        bool result = true;
+        result = result && test_sub_state_intern_known();
+        result = result && test_sub_state_intern_peer();
+        result = result && test_sub_state_intern_unlimited();
+
+        if (result) {
+                return EXIT_SUCCESS;
+        }
+        return EXIT_FAILURE;
+}